@@ -0,0 +1,249 @@
+/*************************************************************************
+ *
+ * finger print library - protocol microbenchmarks
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Runs the frame encoder and parsers against the in-memory loopback port
+ * and reports ns/op and bytes/s. With --json <file> the results are also
+ * written as JSON to compare releases.
+ *
+ * usage: fps_bench [--min-time ms] [--json file] [--filter name]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fps_loopback.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_ADDRESS           FPS_DEFAULT_ADDRESS
+#define BENCH_PACKET_LENGTH     128
+#define BENCH_IMAGE_SIZE        (256 * 288 / 2)
+#define BENCH_MAX_RESULTS       16
+
+typedef struct {
+    const char* name;
+    uint64_t iterations;
+    double nsPerOp;
+    double bytesPerOp;
+}BENCH_RESULT;
+
+typedef struct {
+    __FPS stream;
+    __FPS_LOOPBACK loop;
+    uint8_t* rx;
+    uint32_t rxLength;
+    uint8_t* image;
+    uint32_t bytesPerOp;  //bytes crossing the wire in one operation
+}BENCH_CONTEXT;
+
+static BENCH_RESULT results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t minTimeMs = 200;
+static const char* filter = NULL;
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void check(uint8_t response, const char* what) {
+    if (response != FPS_RX_OK) {
+        fprintf(stderr, "%s failed with 0x%02X\n", what, response);
+        exit(1);
+    }
+}
+
+static void setupContext(BENCH_CONTEXT* ctx, uint32_t rxCapacity) {
+    memset(ctx, 0, sizeof(BENCH_CONTEXT));
+    ctx->rx = (uint8_t*)malloc(rxCapacity);
+    if (ctx->rx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    resetParameters(&ctx->stream);
+    ctx->stream.deviceAddress = BENCH_ADDRESS;
+    ctx->stream.dataPacketLength = BENCH_PACKET_LENGTH;
+    ctx->stream.port = &fpsLoopbackPort;
+    ctx->stream.portContext = &ctx->loop;
+}
+
+static void startLoop(BENCH_CONTEXT* ctx) {
+    fpsLoopbackInit(&ctx->loop, ctx->rx, ctx->rxLength, NULL, 0);
+}
+
+static void freeContext(BENCH_CONTEXT* ctx) {
+    free(ctx->rx);
+    free(ctx->image);
+}
+/*
+*   @brief: run op until minTimeMs has passed and store ns/op
+*
+*/
+static void runBench(const char* name, void (*op)(BENCH_CONTEXT*), BENCH_CONTEXT* ctx) {
+    uint64_t iterations = 1, elapsed = 0;
+    if (filter != NULL && strstr(name, filter) == NULL) return;
+    op(ctx); //warm up and validate once
+    for (;;) {
+        uint64_t start = nowNs();
+        for (uint64_t i = 0; i < iterations; i++) op(ctx);
+        elapsed = nowNs() - start;
+        if (elapsed >= (uint64_t)minTimeMs * 1000000ULL || iterations >= (1ULL << 40)) break;
+        iterations = elapsed < 1000000ULL ? iterations * 16 : iterations * 2;
+    }
+    BENCH_RESULT* result = &results[resultCount++];
+    result->name = name;
+    result->iterations = iterations;
+    result->nsPerOp = (double)elapsed / (double)iterations;
+    result->bytesPerOp = ctx->bytesPerOp;
+    printf("%-24s %12llu it %12.1f ns/op %14.0f bytes/s\n", name, (unsigned long long)iterations,
+           result->nsPerOp, result->bytesPerOp * 1e9 / result->nsPerOp);
+}
+
+//---------------------------------------------------------------------------
+static void opSendPacket(BENCH_CONTEXT* ctx) {
+    static uint8_t args[5] = { 1, 0x00, 0x00, 0x03, 0xE8 };
+    fpsLoopbackRewind(&ctx->loop);
+    sendPacket(&ctx->stream, FPS_CMD_HISPEEDSEARCH, args, sizeof(args));
+}
+
+static void benchSendPacket(void) {
+    BENCH_CONTEXT ctx;
+    setupContext(&ctx, 1);
+    startLoop(&ctx);
+    ctx.bytesPerOp = 12 + 5;
+    runBench("sendPacket", opSendPacket, &ctx);
+    freeContext(&ctx);
+}
+
+static void opReceivePacket(BENCH_CONTEXT* ctx) {
+    fpsLoopbackRewind(&ctx->loop);
+    check(receivePacket(&ctx->stream, ctx->stream.commandTimeout), "receivePacket");
+}
+
+static void benchReceivePacket(void) {
+    BENCH_CONTEXT ctx;
+    uint8_t payload[5] = { FPS_RESP_OK, 0x00, 0x2A, 0x00, 0x64 }; //search result: id 42, score 100
+    setupContext(&ctx, 64);
+    ctx.rxLength = fpsLoopbackFrame(ctx.rx, BENCH_ADDRESS, FPS_ID_ACKPACKET, payload, sizeof(payload));
+    startLoop(&ctx);
+    ctx.bytesPerOp = ctx.rxLength;
+    runBench("receivePacket", opReceivePacket, &ctx);
+    freeContext(&ctx);
+}
+
+static void opReceiveDataPacket(BENCH_CONTEXT* ctx) {
+    uint16_t length;
+    fpsLoopbackRewind(&ctx->loop);
+    check(receiveDataPacket(&ctx->stream, ctx->image, &length, ctx->stream.commandTimeout), "receiveDataPacket");
+}
+
+static void benchReceiveDataPacket(void) {
+    BENCH_CONTEXT ctx;
+    uint8_t payload[BENCH_PACKET_LENGTH];
+    for (uint32_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)(i * 7);
+    setupContext(&ctx, BENCH_PACKET_LENGTH + 16);
+    ctx.image = (uint8_t*)malloc(BENCH_PACKET_LENGTH);
+    ctx.rxLength = fpsLoopbackFrame(ctx.rx, BENCH_ADDRESS, FPS_ID_DATAPACKET, payload, sizeof(payload));
+    startLoop(&ctx);
+    ctx.bytesPerOp = ctx.rxLength;
+    runBench("receiveDataPacket", opReceiveDataPacket, &ctx);
+    freeContext(&ctx);
+}
+
+static void opGetImage(BENCH_CONTEXT* ctx) {
+    fpsLoopbackRewind(&ctx->loop);
+    check(getImage(&ctx->stream, ctx->image), "getImage");
+    if (ctx->stream.rxConfirmationCode != FPS_RESP_OK) check(FPS_RESP_RECIEVEERR, "getImage");
+}
+
+static void benchGetImage(void) {
+    BENCH_CONTEXT ctx;
+    uint8_t ack[1] = { FPS_RESP_OK };
+    uint8_t payload[BENCH_PACKET_LENGTH];
+    uint32_t packets = BENCH_IMAGE_SIZE / BENCH_PACKET_LENGTH;
+    setupContext(&ctx, packets * (BENCH_PACKET_LENGTH + 11) + 16);
+    ctx.image = (uint8_t*)malloc(BENCH_IMAGE_SIZE);
+    ctx.rxLength = fpsLoopbackFrame(ctx.rx, BENCH_ADDRESS, FPS_ID_ACKPACKET, ack, sizeof(ack));
+    for (uint32_t p = 0; p < packets; p++) {
+        for (uint32_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)(p + i);
+        ctx.rxLength += fpsLoopbackFrame(ctx.rx + ctx.rxLength, BENCH_ADDRESS,
+                                         p + 1 == packets ? FPS_ID_ENDDATAPACKET : FPS_ID_DATAPACKET, payload, sizeof(payload));
+    }
+    startLoop(&ctx);
+    ctx.bytesPerOp = ctx.rxLength + 12;
+    runBench("getImage", opGetImage, &ctx);
+    freeContext(&ctx);
+}
+
+static void opReadSysPara(BENCH_CONTEXT* ctx) {
+    fpsLoopbackRewind(&ctx->loop);
+    check(readSysPara(&ctx->stream), "readSysPara");
+}
+
+static void benchReadSysPara(void) {
+    BENCH_CONTEXT ctx;
+    uint8_t ack[1] = { FPS_RESP_OK };
+    uint8_t para[64] = { 0 };
+    para[5] = 0xE8; para[4] = 0x03;  //library size 1000
+    para[7] = 3;                      //security level
+    para[8] = para[9] = para[10] = para[11] = 0xFF;  //address
+    para[13] = 2;                     //128 bytes per packet
+    para[15] = 6;                     //57600 baud
+    memcpy(&para[28], "R308", 4);
+    setupContext(&ctx, 128);
+    ctx.rxLength = fpsLoopbackFrame(ctx.rx, BENCH_ADDRESS, FPS_ID_ACKPACKET, ack, sizeof(ack));
+    ctx.rxLength += fpsLoopbackFrame(ctx.rx + ctx.rxLength, BENCH_ADDRESS, FPS_ID_DATAPACKET, para, sizeof(para));
+    ctx.rxLength += fpsLoopbackFrame(ctx.rx + ctx.rxLength, BENCH_ADDRESS, FPS_ID_ENDDATAPACKET, NULL, 0);
+    startLoop(&ctx);
+    ctx.bytesPerOp = ctx.rxLength + 12;
+    runBench("readSysPara", opReadSysPara, &ctx);
+    freeContext(&ctx);
+}
+
+//---------------------------------------------------------------------------
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL));
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"bytes_per_op\": %.0f, \"bytes_per_second\": %.0f}%s\n",
+                results[i].name, (unsigned long long)results[i].iterations, results[i].nsPerOp, results[i].bytesPerOp,
+                results[i].bytesPerOp * 1e9 / results[i].nsPerOp, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) minTimeMs = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--min-time ms] [--json file] [--filter name]\n", argv[0]);
+            return 2;
+        }
+    }
+    benchSendPacket();
+    benchReceivePacket();
+    benchReceiveDataPacket();
+    benchGetImage();
+    benchReadSysPara();
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    return 0;
+}
+
+/********************************END OF FILE*****************************************************/
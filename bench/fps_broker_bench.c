@@ -0,0 +1,313 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker load test
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Starts the broker on a simulated module that runs in scaled real time
+ * and connects concurrent clients through its socket:
+ *  - door: identify at FPS_PRIORITY_IDENTIFY, one every 50 ms
+ *  - enroll: two scans, generateTemplate and saveTemplate as one chain,
+ *    then deleteTemplate, at FPS_PRIORITY_ENROLL
+ *  - monitor: template count and scheduler statistics at FPS_PRIORITY_HEALTH
+ *  - sync (--clients of them): loadTemplate chained with a template
+ *    export into shared memory, every tenth time a whole image, at
+ *    FPS_PRIORITY_BACKGROUND
+ * and reports the latency of every request class from the client's view.
+ * The run is repeated with every client at the same priority, which shows
+ * what the door would wait without the scheduler.
+ *
+ * usage: fps_broker_bench [--clients n] [--seconds n] [--speed percent] [--json file]
+ *
+ **************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "fps_sim.h"
+#include "fps_broker.h"
+#include "fps_broker_client.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          1000
+#define BENCH_ENROLLED          300
+#define BENCH_FINGER_BASE       1000  //finger of the template at location i is BENCH_FINGER_BASE + i
+#define BENCH_FINGER_LOCATION   5  //location of the finger on the sensor
+#define BENCH_ENROLL_LOCATION   900
+#define BENCH_MAX_CLIENTS       (FPS_BROKER_MAX_CLIENTS - 3)
+#define BENCH_MAX_RESULTS       16
+
+enum { CLASS_IDENTIFY, CLASS_ENROLL, CLASS_MONITOR, CLASS_SYNC, CLASS_IMAGE, CLASS_COUNT };
+static const char* classNames[CLASS_COUNT] = { "identify", "enroll", "monitor", "sync", "image" };
+
+typedef struct {
+    uint64_t* samples;  //latency in microseconds
+    uint32_t count;
+    uint32_t capacity;
+}SAMPLES;
+
+typedef struct {
+    uint8_t role;  //CLASS_IDENTIFY .. CLASS_SYNC
+    uint8_t id;
+    uint8_t fair;  //all clients at FPS_PRIORITY_BACKGROUND
+    SAMPLES samples[CLASS_COUNT];
+    uint32_t errors;
+}CLIENT;
+
+typedef struct {
+    const char* mode;
+    const char* requestClass;
+    uint32_t count;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+}BENCH_RESULT;
+
+static BENCH_RESULT results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t syncClients = 4;
+static uint32_t seconds = 3;
+static uint32_t speedPercent = 10;
+static char socketPath[64];
+static volatile int running = 1;
+
+static uint64_t nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void sleepMs(uint32_t ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void addSample(SAMPLES* samples, uint64_t us) {
+    if (samples->count == samples->capacity) {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 256;
+        samples->samples = (uint64_t*)realloc(samples->samples, samples->capacity * sizeof(uint64_t));
+        if (samples->samples == NULL) exit(1);
+    }
+    samples->samples[samples->count++] = us;
+}
+
+static uint8_t priorityOf(const CLIENT* client, uint8_t priority) {
+    return client->fair ? FPS_PRIORITY_BACKGROUND : priority;
+}
+
+//send requests as one chain and wait for all responses; the status of the first failure
+static uint8_t runChain(__FPS_BROKER_CONN* conn, __FPS_BROKER_REQUEST* requests, uint8_t count, __FPS_BROKER_RESPONSE* last) {
+    uint8_t status = FPS_RESP_OK;
+    for (uint8_t i = 0; i < count; i++) {
+        requests[i].flags = i + 1 < count ? FPS_BROKER_FLAG_CHAIN : 0;
+        if (fpsBrokerSend(conn, &requests[i]) != FPS_RESP_OK) return FPS_BROKER_ERR_CONNECTION;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (fpsBrokerReceive(conn, last, NULL) != FPS_RESP_OK) return FPS_BROKER_ERR_CONNECTION;
+        if (status == FPS_RESP_OK) status = last->status;
+    }
+    return status;
+}
+
+static void doorStep(CLIENT* client, __FPS_BROKER_CONN* conn) {
+    __FPS_BROKER_RESPONSE response;
+    uint64_t start = nowUs();
+    uint8_t status = fpsBrokerCall(conn, FPS_BROKER_OP_IDENTIFY, 0, priorityOf(client, FPS_PRIORITY_IDENTIFY), 0, 0, 0, &response, NULL);
+    addSample(&client->samples[CLASS_IDENTIFY], nowUs() - start);
+    if (status != FPS_RESP_OK || response.fingerId != BENCH_FINGER_LOCATION) client->errors++;
+    sleepMs(50);
+}
+
+static void enrollStep(CLIENT* client, __FPS_BROKER_CONN* conn) {
+    uint8_t priority = priorityOf(client, FPS_PRIORITY_ENROLL);
+    __FPS_BROKER_REQUEST chain[6] = {
+        { 0, FPS_BROKER_OP_GENERATE_IMAGE, 0, priority, 0, { 0, 0, 0 } },
+        { 0, FPS_BROKER_OP_GENERATE_CHAR, 0, priority, 0, { 1, 0, 0 } },
+        { 0, FPS_BROKER_OP_GENERATE_IMAGE, 0, priority, 0, { 0, 0, 0 } },
+        { 0, FPS_BROKER_OP_GENERATE_CHAR, 0, priority, 0, { 2, 0, 0 } },
+        { 0, FPS_BROKER_OP_GENERATE_TEMPLATE, 0, priority, 0, { 0, 0, 0 } },
+        { 0, FPS_BROKER_OP_SAVE, 0, priority, 0, { 1, BENCH_ENROLL_LOCATION, 0 } },
+    };
+    __FPS_BROKER_RESPONSE response;
+    uint64_t start = nowUs();
+    uint8_t status = runChain(conn, chain, 6, &response);
+    addSample(&client->samples[CLASS_ENROLL], nowUs() - start);
+    if (status != FPS_RESP_OK) client->errors++;
+    if (fpsBrokerCall(conn, FPS_BROKER_OP_DELETE, 0, priority, BENCH_ENROLL_LOCATION, 1, 0, &response, NULL) != FPS_RESP_OK) client->errors++;
+    sleepMs(200);
+}
+
+static void monitorStep(CLIENT* client, __FPS_BROKER_CONN* conn) {
+    __FPS_BROKER_RESPONSE response;
+    uint8_t data[FPS_BROKER_MAX_DATA];
+    uint64_t start = nowUs();
+    uint8_t status = fpsBrokerCall(conn, FPS_BROKER_OP_TEMPLATE_COUNT, 0, priorityOf(client, FPS_PRIORITY_HEALTH), 0, 0, 0, &response, NULL);
+    addSample(&client->samples[CLASS_MONITOR], nowUs() - start);
+    if (status != FPS_RESP_OK || response.templateCount < BENCH_ENROLLED) client->errors++;
+    if (fpsBrokerCall(conn, FPS_BROKER_OP_STATS, 0, 0, 0, 0, 0, &response, data) != FPS_RESP_OK) client->errors++;
+    sleepMs(100);
+}
+
+static void syncStep(CLIENT* client, __FPS_BROKER_CONN* conn, uint32_t step) {
+    uint8_t priority = priorityOf(client, FPS_PRIORITY_BACKGROUND);
+    __FPS_BROKER_RESPONSE response;
+    uint64_t start = nowUs();
+    if (step % 10 == 9) {
+        uint8_t status = fpsBrokerCall(conn, FPS_BROKER_OP_GET_IMAGE, 0, priority, 0, 0, 0, &response, NULL);
+        addSample(&client->samples[CLASS_IMAGE], nowUs() - start);
+        if (status != FPS_RESP_OK) client->errors++;
+        return;
+    }
+    uint16_t location = (uint16_t)(1 + step % (BENCH_ENROLLED - 1));
+    __FPS_BROKER_REQUEST chain[2] = {
+        { 0, FPS_BROKER_OP_LOAD, 0, priority, 0, { 1, location, 0 } },
+        { 0, FPS_BROKER_OP_EXPORT_TEMPLATE, 0, priority, 0, { 1, FPS_IMAGE_SIZE, 0 } },
+    };
+    uint8_t status = runChain(conn, chain, 2, &response);
+    addSample(&client->samples[CLASS_SYNC], nowUs() - start);
+    const uint8_t* exported = conn->shm + FPS_IMAGE_SIZE;
+    uint32_t finger = (uint32_t)exported[0] | ((uint32_t)exported[1] << 8) | ((uint32_t)exported[2] << 16) | ((uint32_t)exported[3] << 24);
+    if (status != FPS_RESP_OK || finger != BENCH_FINGER_BASE + (uint32_t)location) client->errors++;
+}
+
+static void* clientThread(void* arg) {
+    CLIENT* client = (CLIENT*)arg;
+    __FPS_BROKER_CONN conn;
+    if (fpsBrokerConnect(&conn, socketPath) != 0 || fpsBrokerAttachShm(&conn, FPS_IMAGE_SIZE + FPS_TEMPLATE_SIZE) != FPS_RESP_OK) {
+        client->errors++;
+        return NULL;
+    }
+    for (uint32_t step = 0; running; step++) {
+        if (client->role == CLASS_IDENTIFY) doorStep(client, &conn);
+        else if (client->role == CLASS_ENROLL) enrollStep(client, &conn);
+        else if (client->role == CLASS_MONITOR) monitorStep(client, &conn);
+        else syncStep(client, &conn, step + client->id * 7u);  //the sync clients start at different locations
+    }
+    fpsBrokerDisconnect(&conn);
+    return NULL;
+}
+
+static int compareUs(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char* mode, const char* requestClass, SAMPLES* samples) {
+    if (samples->count == 0 || resultCount >= BENCH_MAX_RESULTS) return;
+    qsort(samples->samples, samples->count, sizeof(uint64_t), compareUs);
+    BENCH_RESULT* result = &results[resultCount++];
+    result->mode = mode;
+    result->requestClass = requestClass;
+    result->count = samples->count;
+    result->p50Ms = samples->samples[samples->count / 2] / 1000.0;
+    result->p99Ms = samples->samples[(uint32_t)(samples->count * 0.99)] / 1000.0;
+    result->maxMs = samples->samples[samples->count - 1] / 1000.0;
+    printf("%-10s %-9s %6u requests  p50 %8.1f ms  p99 %8.1f ms  max %8.1f ms\n", mode, requestClass, result->count,
+           result->p50Ms, result->p99Ms, result->maxMs);
+}
+
+//one run with the given clients; returns the number of failed requests
+static uint32_t run(const char* mode, uint8_t fair, uint32_t background) {
+    static __FPS_SIM sim;
+    static __FPS stream;
+    static __FPS_BROKER broker;
+    static CLIENT clients[BENCH_MAX_CLIENTS];
+    pthread_t threads[BENCH_MAX_CLIENTS];
+    uint32_t clientCount = background == 0 ? 1 : 3 + background;
+    uint32_t errors = 0;
+
+    if (fpsSimInit(&sim, BENCH_CAPACITY) != 0) exit(1);
+    for (uint16_t location = 0; location < BENCH_ENROLLED; location++) {
+        fpsSimMakeTemplate(BENCH_FINGER_BASE + location, sim.library + (uint32_t)location * FPS_TEMPLATE_SIZE);
+        sim.used[location / 8] |= (uint8_t)(1 << (location % 8));
+    }
+    fpsSimPlaceFinger(&sim, BENCH_FINGER_BASE + BENCH_FINGER_LOCATION);
+    sim.realTimePercent = speedPercent;
+    fpsSimAttach(&sim, &stream);
+    if (fpsBrokerInit(&broker) != 0 || fpsBrokerAddSensor(&broker, &stream) != 0 || fpsBrokerStart(&broker, socketPath) != 0) {
+        perror("broker");
+        exit(1);
+    }
+
+    memset(clients, 0, sizeof(clients));
+    running = 1;
+    for (uint32_t i = 0; i < clientCount; i++) {
+        clients[i].role = i < CLASS_SYNC ? (uint8_t)i : CLASS_SYNC;
+        clients[i].id = (uint8_t)i;
+        clients[i].fair = fair;
+        if (pthread_create(&threads[i], NULL, clientThread, &clients[i]) != 0) exit(1);
+    }
+    sleepMs(seconds * 1000);
+    running = 0;
+    for (uint32_t i = 0; i < clientCount; i++) pthread_join(threads[i], NULL);
+    fpsBrokerStop(&broker);
+
+    SAMPLES merged[CLASS_COUNT];
+    memset(merged, 0, sizeof(merged));
+    for (uint32_t i = 0; i < clientCount; i++) {
+        errors += clients[i].errors;
+        for (int c = 0; c < CLASS_COUNT; c++) {
+            for (uint32_t s = 0; s < clients[i].samples[c].count; s++) addSample(&merged[c], clients[i].samples[c].samples[s]);
+            free(clients[i].samples[c].samples);
+        }
+    }
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        report(mode, classNames[c], &merged[c]);
+        free(merged[c].samples);
+    }
+    printf("%-10s %llu requests in %llu batches, %u errors\n", mode, (unsigned long long)broker.requests,
+           (unsigned long long)broker.batches, errors);
+    fpsBrokerDestroy(&broker);
+    fpsSimFree(&sim);
+    return errors;
+}
+
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"sync_clients\": %u,\n  \"speed_percent\": %u,\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL), syncClients, speedPercent);
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"mode\": \"%s\", \"class\": \"%s\", \"requests\": %u, \"p50_ms\": %.1f, \"p99_ms\": %.1f, \"max_ms\": %.1f}%s\n",
+                results[i].mode, results[i].requestClass, results[i].count, results[i].p50Ms, results[i].p99Ms, results[i].maxMs,
+                i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    uint32_t errors = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) syncClients = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speedPercent = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--clients n] [--seconds n] [--speed percent] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (syncClients == 0 || syncClients > BENCH_MAX_CLIENTS - 3 || seconds == 0 || speedPercent == 0) return 2;
+    snprintf(socketPath, sizeof(socketPath), "/tmp/fps_broker_bench.%d.sock", (int)getpid());
+
+    printf("%u sync clients, %u s per run, module at %u%% of real time\n", syncClients, seconds, speedPercent);
+    errors += run("alone", 0, 0);
+    errors += run("priority", 0, syncClients);
+    errors += run("fair", 1, syncClients);
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    return errors ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,372 @@
+/*************************************************************************
+ *
+ * finger print library - several modules on one line benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Runs the same identification loop (generateImage, generateCharacter,
+ * searchLibrary, then exportCharacter and importCharacter of the template,
+ * four data packets each way, and matchTemplates) on simulated modules
+ * with different addresses, once with every module on a line of its own
+ * and once with all modules on one line shared through R30X_bus. Each
+ * module has its own thread. The modules run in real time scaled by
+ * --percent (10: ten times faster), times and rates are in module time.
+ * Faster than real time overstates the polling delays of the library.
+ *
+ * The shared line is half-duplex: it records when every byte is on it,
+ * hands the bytes of the modules to the bus as they arrive and counts a
+ * frame of the host that overlaps a frame of a module. Overlaps with the
+ * data packets of an export are what the bus must prevent; replies of
+ * modules that finish at the same moment can overlap on any multi-drop
+ * line without polling and are counted apart. Frames are delivered
+ * intact either way, every exported and imported template is checked.
+ *
+ * usage: fps_bus_bench [--modules n] [--seconds s] [--percent p] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "fps_sim.h"
+#include "R30X_bus.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          200
+#define BENCH_TEMPLATES         100  //enrolled at locations 0 to BENCH_TEMPLATES - 1
+#define BENCH_FINGER_BASE       7000  //finger of location i is BENCH_FINGER_BASE + i
+#define BENCH_MAX_MODULES       FPS_BUS_MAX_ENDPOINTS
+#define BENCH_ADDRESS_BASE      0xFFFFFF10UL
+
+//a half-duplex line with the modules on it
+typedef struct {
+    pthread_mutex_t lock;
+    __FPS_SIM* sims[BENCH_MAX_MODULES];
+    uint8_t simCount;
+    uint32_t baud;
+    int8_t current;  //module whose frame the bus is reading, -1 between frames
+    uint64_t hostUntil;  //the last frame of the host is on the line until
+
+    uint64_t dataCollisions;  //frames of the host that overlap a data packet of a module
+    uint64_t replyCollisions;  //other frames of the host that overlap a reply
+    uint64_t replyOverlaps;  //replies that start before the reply of another module ended
+}BENCH_LINE;
+
+typedef struct {
+    const char* name;
+    uint8_t lines;
+    uint8_t modulesPerLine;
+    double seconds;  //module time
+    uint64_t cycles;
+    uint64_t errors;  //failed commands and wrong templates
+    uint64_t dataCollisions;
+    uint64_t replyCollisions;
+    uint64_t replyOverlaps;
+    uint64_t holdsExpired;
+    double perMinute;
+}BENCH_RESULT;
+
+typedef struct {
+    __FPS stream;
+    __FPS_SIM sim;
+    uint16_t location;  //of the finger on the sensor
+    uint64_t cycles;
+    uint64_t errors;
+}BENCH_MODULE;
+
+static BENCH_MODULE modules[BENCH_MAX_MODULES];
+static BENCH_RESULT results[2];
+static uint8_t moduleCount = 4;
+static uint32_t seconds = 30;
+static uint32_t percent = 100;
+static uint64_t wallBaseNs;
+static volatile uint8_t stopping;
+
+static uint64_t wallNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+//module time in microseconds, shared by all lines
+static uint64_t nowUs(void) {
+    return (wallNs() - wallBaseNs) / 10 / percent;
+}
+
+static void sleepUntilUs(uint64_t us) {
+    uint64_t target = wallBaseNs + us * 10 * percent;
+    uint64_t now = wallNs();
+    if (target <= now) return;
+    struct timespec ts = { (time_t)((target - now) / 1000000000ULL), (long)((target - now) % 1000000000ULL) };
+    nanosleep(&ts, NULL);
+}
+
+static uint64_t lineTime(const BENCH_LINE* line, uint32_t bytes) {
+    return (uint64_t)bytes * 10000000ULL / line->baud;
+}
+
+//first reply frame of a module the bus has not read completely, -1 if none
+static int32_t pendingFrame(const __FPS_SIM* sim) {
+    for (uint16_t i = 0; i < sim->outFrames; i++) {
+        if (sim->outFrameEnd[i] > sim->outTail) return i;
+    }
+    return -1;
+}
+
+static uint32_t frameStart(const __FPS_SIM* sim, int32_t frame) {
+    return frame > 0 ? sim->outFrameEnd[frame - 1] : 0;
+}
+
+//when the first byte of a reply frame is on the line
+static uint64_t frameBegin(const BENCH_LINE* line, const __FPS_SIM* sim, int32_t frame) {
+    return sim->outFrameTime[frame] - lineTime(line, sim->outFrameEnd[frame] - frameStart(sim, frame));
+}
+
+static uint32_t lineRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    BENCH_LINE* line = (BENCH_LINE*)context;
+    uint64_t deadline = wallNs() + (uint64_t)timeout * 1000000ULL;
+    pthread_mutex_lock(&line->lock);
+    while (!stopping) {
+        uint64_t now = nowUs(), next = UINT64_MAX;
+        if (line->current < 0) {  //the module that started to talk first
+            for (uint8_t i = 0; i < line->simCount; i++) {
+                int32_t frame = pendingFrame(line->sims[i]);
+                if (frame < 0) continue;
+                uint64_t begin = frameBegin(line, line->sims[i], frame);
+                if (begin < next) {
+                    next = begin;
+                    if (begin <= now) line->current = (int8_t)i;
+                }
+            }
+        }
+        if (line->current >= 0) {
+            __FPS_SIM* sim = line->sims[line->current];
+            int32_t frame = pendingFrame(sim);
+            uint64_t begin = frameBegin(line, sim, frame);
+            uint32_t start = frameStart(sim, frame), end = sim->outFrameEnd[frame];
+            uint64_t remaining = sim->outFrameTime[frame] > now ? sim->outFrameTime[frame] - now : 0;
+            uint32_t missing = (uint32_t)((remaining * line->baud + 9999999ULL) / 10000000ULL);  //the last byte is there at the frame end
+            uint32_t arrived = now <= begin ? 0 : end - start > missing ? end - start - missing : 0;
+            if (start + arrived > sim->outTail) {
+                uint32_t count = start + arrived - sim->outTail;
+                if (count > BytesToRead) count = BytesToRead;
+                memcpy(pBuf, sim->out + sim->outTail, count);
+                sim->outTail += count;
+                if (sim->outTail == end) line->current = -1;
+                pthread_mutex_unlock(&line->lock);
+                return count;
+            }
+            next = now + lineTime(line, 1);
+        }
+        pthread_mutex_unlock(&line->lock);
+        if (wallNs() >= deadline) return 0;
+        uint64_t wait = next == UINT64_MAX ? 1000 : next - now;
+        if (wait > 1000) wait = 1000;  //a write may queue a reply in the meantime
+        sleepUntilUs(now + wait);
+        pthread_mutex_lock(&line->lock);
+    }
+    pthread_mutex_unlock(&line->lock);
+    return 0;
+}
+
+static uint32_t lineWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    BENCH_LINE* line = (BENCH_LINE*)context;
+    (void)timeout;
+    pthread_mutex_lock(&line->lock);
+    uint64_t start = nowUs();
+    if (start < line->hostUntil) start = line->hostUntil;
+    uint64_t end = start + lineTime(line, BytesToWrite);
+    line->hostUntil = end;
+    for (uint8_t i = 0; i < line->simCount; i++) {
+        __FPS_SIM* sim = line->sims[i];
+        for (int32_t frame = pendingFrame(sim); frame >= 0 && frame < sim->outFrames; frame++) {
+            if (frameBegin(line, sim, frame) >= end || sim->outFrameTime[frame] <= start) continue;
+            uint8_t type = sim->out[frameStart(sim, frame) + 6];
+            if (type == FPS_ID_DATAPACKET || type == FPS_ID_ENDDATAPACKET) line->dataCollisions++;
+            else line->replyCollisions++;
+            break;
+        }
+    }
+    for (uint8_t i = 0; i < line->simCount; i++) {  //every module hears the frame, only the addressed one answers
+        __FPS_SIM* sim = line->sims[i];
+        int32_t before = sim->outFrames;
+        if (sim->outHead == sim->outTail) before = 0;  //the module starts a new queue
+        sim->clockUs = start;
+        sim->lineUs = start;
+        fpsSimPort.write(sim, pBuf, BytesToWrite, timeout);
+        for (int32_t frame = before; frame < sim->outFrames; frame++) {  //new replies against the replies of the others
+            uint64_t begin = frameBegin(line, sim, frame);
+            for (uint8_t j = 0; j < line->simCount; j++) {
+                __FPS_SIM* other = line->sims[j];
+                if (j == i) continue;
+                for (int32_t k = pendingFrame(other); k >= 0 && k < other->outFrames; k++) {
+                    if (frameBegin(line, other, k) < sim->outFrameTime[frame] && begin < other->outFrameTime[k]) {
+                        line->replyOverlaps++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&line->lock);
+    sleepUntilUs(end);  //the write returns when the bytes are sent
+    return BytesToWrite;
+}
+
+static uint8_t lineInitialize(void* context, uint32_t baud) {
+    BENCH_LINE* line = (BENCH_LINE*)context;
+    return baud != line->baud;
+}
+
+static uint8_t lineDeinitialize(void* context) {
+    (void)context;
+    return 0;
+}
+
+static const __FPS_PORT linePort = { lineRead, lineWrite, lineInitialize, lineDeinitialize };
+
+//---------------------------------------------------------------------------
+static void* moduleLoop(void* arg) {
+    BENCH_MODULE* module = (BENCH_MODULE*)arg;
+    __FPS* stream = &module->stream;
+    uint8_t exported[FPS_TEMPLATE_SIZE], expected[FPS_TEMPLATE_SIZE];
+    fpsSimMakeTemplate(BENCH_FINGER_BASE + module->location, expected);
+    while (!stopping) {
+        uint8_t ok = generateImage(stream) == FPS_RESP_OK &&
+                     generateCharacter(stream, 1) == FPS_RESP_OK &&
+                     searchLibrary(stream, 1, 0, BENCH_TEMPLATES) == FPS_RESP_OK && stream->fingerId == module->location &&
+                     exportCharacter(stream, 1, exported) == FPS_RESP_OK && memcmp(exported, expected, FPS_TEMPLATE_SIZE) == 0 &&
+                     importCharacter(stream, 2, exported) == FPS_RESP_OK &&
+                     matchTemplates(stream) == FPS_RESP_OK;
+        if (stopping) break;  //the last cycle may be cut short
+        if (ok) module->cycles++;
+        else module->errors++;
+    }
+    return NULL;
+}
+
+static void run(BENCH_RESULT* result, const char* name, uint8_t modulesPerLine) {
+    uint8_t lineCount = (uint8_t)(moduleCount / modulesPerLine);
+    BENCH_LINE* lines = (BENCH_LINE*)calloc(lineCount, sizeof(BENCH_LINE));
+    __FPS_BUS* buses = (__FPS_BUS*)calloc(lineCount, sizeof(__FPS_BUS));
+    pthread_t threads[BENCH_MAX_MODULES];
+    if (lines == NULL || buses == NULL) exit(1);
+
+    memset(result, 0, sizeof(BENCH_RESULT));
+    result->name = name;
+    result->lines = lineCount;
+    result->modulesPerLine = modulesPerLine;
+    for (uint8_t i = 0; i < moduleCount; i++) {
+        BENCH_MODULE* module = &modules[i];
+        BENCH_LINE* line = &lines[i / modulesPerLine];
+        if (fpsSimInit(&module->sim, BENCH_CAPACITY) != 0) exit(1);
+        module->sim.address = BENCH_ADDRESS_BASE + i;
+        for (uint16_t location = 0; location < BENCH_TEMPLATES; location++) {
+            fpsSimMakeTemplate(BENCH_FINGER_BASE + location, module->sim.library + (uint32_t)location * FPS_TEMPLATE_SIZE);
+            module->sim.used[location / 8] |= (uint8_t)(1 << (location % 8));
+        }
+        module->location = (uint16_t)(i * 7 % BENCH_TEMPLATES);
+        fpsSimPlaceFinger(&module->sim, BENCH_FINGER_BASE + module->location);
+        fpsSimAttach(&module->sim, &module->stream);
+        module->cycles = module->errors = 0;
+        line->sims[line->simCount++] = &module->sim;
+        line->baud = module->sim.baud;
+    }
+    for (uint8_t i = 0; i < lineCount; i++) {
+        pthread_mutex_init(&lines[i].lock, NULL);
+        lines[i].current = -1;
+        if (R30X_busStart(&buses[i], &linePort, &lines[i], lines[i].baud) != 0) exit(1);
+    }
+    for (uint8_t i = 0; i < moduleCount; i++) {
+        if (R30X_busAttach(&buses[i / modulesPerLine], &modules[i].stream, modules[i].sim.address) != 0) exit(1);
+    }
+
+    stopping = 0;
+    wallBaseNs = wallNs();
+    for (uint8_t i = 0; i < moduleCount; i++) pthread_create(&threads[i], NULL, moduleLoop, &modules[i]);
+    sleepUntilUs((uint64_t)seconds * 1000000ULL);
+    for (uint8_t i = 0; i < lineCount; i++) {  //before stopping cuts data phases short
+        pthread_mutex_lock(&lines[i].lock);
+        result->dataCollisions += lines[i].dataCollisions;
+        result->replyCollisions += lines[i].replyCollisions;
+        result->replyOverlaps += lines[i].replyOverlaps;
+        pthread_mutex_unlock(&lines[i].lock);
+        pthread_mutex_lock(&buses[i].lock);
+        result->holdsExpired += buses[i].holdsExpired;
+        pthread_mutex_unlock(&buses[i].lock);
+    }
+    stopping = 1;
+    for (uint8_t i = 0; i < moduleCount; i++) pthread_join(threads[i], NULL);
+    result->seconds = nowUs() / 1e6;
+
+    for (uint8_t i = 0; i < lineCount; i++) {
+        R30X_busStop(&buses[i]);
+        pthread_mutex_destroy(&lines[i].lock);
+    }
+    for (uint8_t i = 0; i < moduleCount; i++) {
+        result->cycles += modules[i].cycles;
+        result->errors += modules[i].errors;
+        fpsSimFree(&modules[i].sim);
+    }
+    result->perMinute = result->cycles * 60.0 / result->seconds;
+    free(lines);
+    free(buses);
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--modules") == 0 && i + 1 < argc) moduleCount = (uint8_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--percent") == 0 && i + 1 < argc) percent = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--modules n] [--seconds s] [--percent p] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (moduleCount < 2 || moduleCount > BENCH_MAX_MODULES || seconds == 0 || percent == 0) return 2;
+
+    run(&results[0], "one module per line", 1);
+    run(&results[1], "one shared line", moduleCount);
+
+    printf("%u modules at %u baud, %u s, every cycle exports and imports a template (%u data packets each way)\n",
+           moduleCount, FPS_DEFAULT_BAUDRATE, seconds, (FPS_TEMPLATE_SIZE + 127) / 128);
+    printf("%-20s %6s %10s %7s %10s %10s %10s %8s\n", "", "lines", "cycles/min", "errors", "data coll", "reply coll", "overlaps", "expired");
+    for (int i = 0; i < 2; i++) {
+        BENCH_RESULT* result = &results[i];
+        printf("%-20s %6u %10.1f %7llu %10llu %10llu %10llu %8llu\n", result->name, result->lines, result->perMinute,
+               (unsigned long long)result->errors, (unsigned long long)result->dataCollisions,
+               (unsigned long long)result->replyCollisions, (unsigned long long)result->replyOverlaps,
+               (unsigned long long)result->holdsExpired);
+    }
+    printf("the shared line does %.0f %% of the cycles of a line per module\n", results[1].perMinute * 100.0 / results[0].perMinute);
+
+    if (jsonPath != NULL) {
+        FILE* file = fopen(jsonPath, "w");
+        if (file == NULL) {
+            perror(jsonPath);
+            return 1;
+        }
+        fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"modules\": %u,\n  \"runs\": [\n",
+                FPS_BENCH_VERSION, (long long)time(NULL), moduleCount);
+        for (int i = 0; i < 2; i++) {
+            BENCH_RESULT* result = &results[i];
+            fprintf(file, "    { \"name\": \"%s\", \"lines\": %u, \"seconds\": %.1f, \"cycles\": %llu, \"per_minute\": %.1f, \"errors\": %llu,"
+                    " \"data_collisions\": %llu, \"reply_collisions\": %llu, \"reply_overlaps\": %llu, \"holds_expired\": %llu }%s\n",
+                    result->name, result->lines, result->seconds, (unsigned long long)result->cycles, result->perMinute,
+                    (unsigned long long)result->errors, (unsigned long long)result->dataCollisions,
+                    (unsigned long long)result->replyCollisions, (unsigned long long)result->replyOverlaps,
+                    (unsigned long long)result->holdsExpired, i == 1 ? "" : ",");
+        }
+        fprintf(file, "  ]\n}\n");
+        fclose(file);
+    }
+    return results[0].errors + results[1].errors + results[1].dataCollisions > 0 ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
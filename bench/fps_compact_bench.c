@@ -0,0 +1,260 @@
+/*************************************************************************
+ *
+ * finger print library - library compaction crash benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Compacts a scattered library on the simulated module with the file
+ * journal and cuts the power after every single step of the compaction:
+ * after every command the module executed (its reply is lost), after
+ * every journal write and after every onMoved callback. After each cut
+ * the run starts again like after a reboot: R30X_compactResume, a new plan
+ * if there is no journal, and R30X_compactStep until done.
+ *
+ * Every run is checked: the used locations must form one dense range
+ * from location 1, every person's template must be at the location the
+ * user database (kept up to date by onMoved only) has for them, and no
+ * template may be lost or stored twice. Moves reported twice by onMoved
+ * are counted, they are the at-least-once delivery at work.
+ *
+ * usage: fps_compact_bench [--templates n] [--journal file] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "fps_sim.h"
+#include "R30X_compact.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          300
+#define BENCH_FINGER_BASE       5000  //finger of person i is BENCH_FINGER_BASE + i
+#define BENCH_NO_CUT            0xFFFFFFFFUL
+
+typedef struct {
+    __FPS_SIM sim;
+    __FPS stream;
+    uint32_t budget;  //steps until the power is cut, BENCH_NO_CUT for none
+    uint8_t cut;  //the power is off: the module, the journal and the database see nothing more
+    uint64_t commands;  //commands executed by the module, seen by the port
+    uint16_t location[BENCH_CAPACITY];  //user database: location of every person
+    uint32_t repeated;  //onMoved calls for a move that was already applied
+}BENCH_RUN;
+
+static BENCH_RUN run;
+static __FPS_COMPACT compact;
+static __FPS_COMPACT_FILE journalFile;
+static uint16_t templateCount = 120;
+static const char* journalPath = "fps_compact_bench.journal";
+static uint32_t rngState = 2023;
+
+static uint32_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+//one step of the compaction happened, 0 if the power was already off
+static uint8_t step(void) {
+    if (run.cut) return 0;
+    if (run.budget != BENCH_NO_CUT && --run.budget == 0) run.cut = 1;  //this step happens, nothing after it
+    return 1;
+}
+
+static uint32_t cutRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    if (!run.cut) return fpsSimPort.read(context, pBuf, BytesToRead, timeout);
+    memset(pBuf, 0, BytesToRead);  //a dead line reads as garbage, the command fails at once
+    return BytesToRead;
+}
+
+static uint32_t cutWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    if (run.cut) return BytesToWrite;
+    uint32_t written = fpsSimPort.write(context, pBuf, BytesToWrite, timeout);
+    while (run.commands < run.sim.commands) {  //the frame completed a command
+        run.commands++;
+        step();
+    }
+    return written;
+}
+
+static uint8_t cutInitialize(void* context, uint32_t baud) {
+    return fpsSimPort.initializePort(context, baud);
+}
+
+static uint8_t cutDeinitialize(void* context) {
+    return fpsSimPort.deinitializePort(context);
+}
+
+static const __FPS_PORT cutPort = { cutRead, cutWrite, cutInitialize, cutDeinitialize };
+
+static int8_t cutWritePlan(void* context, const __FPS_MOVE* moves, uint16_t moveCount) {
+    return step() ? fpsCompactFileJournal.writePlan(context, moves, moveCount) : -1;
+}
+
+static int8_t cutWriteProgress(void* context, uint16_t nextMove, uint8_t phase) {
+    return step() ? fpsCompactFileJournal.writeProgress(context, nextMove, phase) : -1;
+}
+
+static int8_t cutReadJournal(void* context, __FPS_MOVE* moves, uint16_t* moveCount, uint16_t* nextMove, uint8_t* phase) {
+    return fpsCompactFileJournal.read(context, moves, moveCount, nextMove, phase);
+}
+
+static int8_t cutClear(void* context) {
+    return step() ? fpsCompactFileJournal.clear(context) : -1;
+}
+
+static const __FPS_COMPACT_JOURNAL cutJournal = { cutWritePlan, cutWriteProgress, cutReadJournal, cutClear };
+
+//the user database, a second call for the same move finds nobody at oldId any more
+static void onMoved(void* context, uint16_t oldId, uint16_t newId) {
+    uint8_t applied = 0;
+    (void)context;
+    if (!step()) return;
+    for (uint16_t person = 0; person < templateCount; person++) {
+        if (run.location[person] == oldId) {
+            run.location[person] = newId;
+            applied = 1;
+        }
+    }
+    if (!applied) run.repeated++;
+}
+
+static uint8_t isUsed(const __FPS_SIM* sim, uint16_t location) {
+    return (sim->used[location / 8] >> (location % 8)) & 1;
+}
+
+static void setup(void) {
+    uint8_t taken[BENCH_CAPACITY] = { 0 };
+    fpsSimFree(&run.sim);
+    memset(&run, 0, sizeof(run));
+    if (fpsSimInit(&run.sim, BENCH_CAPACITY) != 0) exit(1);
+    fpsSimAttach(&run.sim, &run.stream);
+    run.stream.port = &cutPort;
+    rngState = 2023;  //the same scattered library for every run
+    for (uint16_t person = 0; person < templateCount; person++) {
+        uint16_t location;
+        do location = (uint16_t)(1 + nextRandom() % (BENCH_CAPACITY - 1));
+        while (taken[location]);
+        taken[location] = 1;
+        run.location[person] = location;
+        fpsSimMakeTemplate(BENCH_FINGER_BASE + person, run.sim.library + (uint32_t)location * FPS_TEMPLATE_SIZE);
+        run.sim.used[location / 8] |= (uint8_t)(1 << (location % 8));
+    }
+    run.budget = BENCH_NO_CUT;
+}
+
+//like after a reboot: resume or plan, then step until done. 0 on success
+static int8_t compactAll(void) {
+    uint8_t used[FPS_COMPACT_BITMAP_LENGTH];
+    journalFile.path = journalPath;
+    if (journalFile.fd >= 0) close(journalFile.fd);
+    journalFile.fd = -1;
+    R30X_compactInit(&compact, &cutJournal, &journalFile);
+    compact.onMoved = onMoved;
+    int8_t resumed = R30X_compactResume(&compact);
+    if (resumed < 0) return -1;
+    if (resumed == 0) {
+        if (R30X_compactReadOccupancy(&run.stream, used) != FPS_RESP_OK) return -1;
+        if (R30X_compactPlan(&compact, used, 1, BENCH_CAPACITY - 1) < 0) return -1;
+    }
+    while (!R30X_compactDone(&compact)) {
+        if (R30X_compactStep(&compact, &run.stream, 8) < 0) return -1;
+    }
+    return 0;
+}
+
+//places that disagree with the database or the dense range
+static uint32_t check(void) {
+    uint8_t templateData[FPS_TEMPLATE_SIZE];
+    uint32_t wrong = 0, used = 0;
+    for (uint16_t location = 0; location < BENCH_CAPACITY; location++) {
+        if (!isUsed(&run.sim, location)) continue;
+        used++;
+        if (location == 0 || location > templateCount) wrong++;
+    }
+    if (used != templateCount) wrong++;
+    for (uint16_t person = 0; person < templateCount; person++) {
+        uint16_t location = run.location[person];
+        fpsSimMakeTemplate(BENCH_FINGER_BASE + person, templateData);
+        if (!isUsed(&run.sim, location) ||
+            memcmp(templateData, run.sim.library + (uint32_t)location * FPS_TEMPLATE_SIZE, FPS_TEMPLATE_SIZE) != 0) wrong++;
+    }
+    if (access(journalPath, F_OK) == 0) wrong++;  //a finished compaction leaves no journal
+    return wrong;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    uint32_t cuts = 0, failed = 0, repeated = 0, steps;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--templates") == 0 && i + 1 < argc) templateCount = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) journalPath = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--templates n] [--journal file] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (templateCount == 0 || templateCount >= BENCH_CAPACITY - 1) return 2;
+    journalFile.fd = -1;
+
+    //without a cut: how many steps there are to cut after
+    unlink(journalPath);
+    setup();
+    uint64_t usBefore = run.sim.clockUs;
+    if (compactAll() != 0 || check() != 0) {
+        printf("compaction without power cut failed\n");
+        return 1;
+    }
+    uint16_t moves = compact.moveCount;
+    double seconds = (run.sim.clockUs - usBefore) / 1e6;
+    steps = (uint32_t)run.commands;
+    run.budget = BENCH_NO_CUT;
+    printf("%u templates in %u locations, %u moves, %.1f s on the line\n", templateCount, BENCH_CAPACITY, moves, seconds);
+
+    for (uint32_t cutAfter = 1;; cutAfter++) {
+        unlink(journalPath);
+        setup();
+        run.budget = cutAfter;
+        int8_t finished = compactAll() == 0 && !run.cut;
+        if (finished) break;  //the compaction needs fewer steps than cutAfter
+        cuts++;
+        run.cut = 0;  //reboot: replies that were on the line when the power went are gone
+        run.budget = BENCH_NO_CUT;
+        run.sim.outTail = run.sim.outHead;
+        run.sim.outFrames = 0;
+        run.sim.frameLength = 0;
+        uint32_t wrong = compactAll() != 0 ? 1 : check();
+        if (wrong) {
+            printf("power cut after step %u: %u wrong\n", cutAfter, wrong);
+            failed++;
+        }
+        repeated += run.repeated;
+    }
+    printf("%u power cuts (one after every command, journal write and callback), %u runs wrong, %u moves reported twice\n",
+           cuts, failed, repeated);
+
+    if (jsonPath != NULL) {
+        FILE* file = fopen(jsonPath, "w");
+        if (file == NULL) {
+            perror(jsonPath);
+            return 1;
+        }
+        fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"templates\": %u,\n"
+                "  \"moves\": %u,\n  \"seconds\": %.1f,\n  \"module_commands\": %u,\n  \"power_cuts\": %u,\n  \"wrong\": %u,\n  \"reported_twice\": %u\n}\n",
+                FPS_BENCH_VERSION, (long long)time(NULL), templateCount, moves, seconds, steps, cuts, failed, repeated);
+        fclose(file);
+    }
+    if (journalFile.fd >= 0) close(journalFile.fd);
+    unlink(journalPath);
+    fpsSimFree(&run.sim);
+    return failed ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,157 @@
+/*************************************************************************
+ *
+ * finger print library - sensor discovery benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Runs R30X_discover over many simulated ports in real time. Every port
+ * with a module has it at another baudrate than the default and at one
+ * of the configured addresses, every fifth port is empty (its module has
+ * an address that is not searched) and is swept completely. Every
+ * seventh module loses the reply to its first readSysPara, which the
+ * discovery must read again. The discovery is timed with the default
+ * number of threads and with four, and every module must be found
+ * once with its baudrate, address and library size.
+ *
+ * usage: fps_discovery_bench [--ports n] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fps_sim.h"
+#include "R30X_discovery.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_MAX_PORTS         256
+#define BENCH_CAPACITY          10
+
+typedef struct {
+    uint16_t threads;
+    double seconds;
+    int32_t found;
+    uint32_t wrong;  //modules not found, found twice or with wrong parameters, and empty ports reported
+    uint32_t probeTimeMax;  //ms
+    double probeTimeMean;
+}BENCH_RESULT;
+
+static const uint32_t addresses[] = { FPS_DEFAULT_ADDRESS, 0x0000CAFEUL, 0x12345678UL, 0xFFFF0001UL };
+#define ADDRESS_COUNT           (sizeof(addresses) / sizeof(addresses[0]))
+
+static __FPS_SIM sims[BENCH_MAX_PORTS];
+static __FPS_DISCOVERY_PORT ports[BENCH_MAX_PORTS];
+static __FPS_DISCOVERY_RESULT found[BENCH_MAX_PORTS];
+static uint16_t portCount = 48;
+
+static double wallSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t hasModule(uint16_t port) {
+    return port % 5 != 4;
+}
+
+static void setup(void) {
+    for (uint16_t i = 0; i < portCount; i++) {
+        __FPS_SIM* sim = &sims[i];
+        fpsSimFree(sim);
+        if (fpsSimInit(sim, (uint16_t)(BENCH_CAPACITY + i)) != 0) exit(1);
+        sim->baud = 9600u * (1 + (i * 5 + 1) % 12);
+        if (sim->baud == FPS_DEFAULT_BAUDRATE) sim->baud = 115200;
+        sim->address = hasModule(i) ? addresses[(i / 3) % ADDRESS_COUNT] : 0xA5A5A5A5UL;
+        if (i % 7 == 3) sim->loseEvery = 2;  //the handshake is answered, the first readSysPara not
+        sim->realTimePercent = 100;
+        sim->hostBaud = 0;  //not opened yet
+        ports[i].port = &fpsSimPort;
+        ports[i].portContext = sim;
+        ports[i].name = NULL;
+    }
+}
+
+static void run(BENCH_RESULT* result, uint16_t threads) {
+    __FPS_DISCOVERY_CONFIG config;
+    uint8_t seen[BENCH_MAX_PORTS] = { 0 };
+    uint64_t probeTimeSum = 0;
+    setup();
+    R30X_discoveryDefaults(&config);
+    config.addresses = addresses;
+    config.addressCount = ADDRESS_COUNT;
+    config.maxThreads = threads;
+
+    memset(result, 0, sizeof(BENCH_RESULT));
+    memset(found, 0xA5, sizeof(found));  //results must not depend on what was in the table
+    result->threads = threads;
+    double start = wallSeconds();
+    result->found = R30X_discover(ports, portCount, &config, found, BENCH_MAX_PORTS);
+    result->seconds = wallSeconds() - start;
+    if (result->found < 0) exit(1);
+
+    for (int32_t i = 0; i < result->found; i++) {
+        const __FPS_DISCOVERY_RESULT* module = &found[i];
+        const __FPS_SIM* sim = &sims[module->portIndex];
+        if (module->portIndex >= portCount || !hasModule(module->portIndex) || seen[module->portIndex]++ ||
+            module->deviceAddress != sim->address || module->deviceBaudrate != sim->baud || module->sysParaStatus != FPS_RESP_OK ||
+            module->templateCount != sim->capacity || module->dataPacketLength != sim->packetLength) {
+            result->wrong++;
+        }
+        probeTimeSum += module->probeTime;
+        if (module->probeTime > result->probeTimeMax) result->probeTimeMax = module->probeTime;
+    }
+    for (uint16_t i = 0; i < portCount; i++) {
+        if (hasModule(i) && !seen[i]) result->wrong++;
+    }
+    result->probeTimeMean = result->found > 0 ? (double)probeTimeSum / result->found : 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    BENCH_RESULT results[2];
+    uint16_t modules = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ports") == 0 && i + 1 < argc) portCount = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--ports n] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (portCount == 0 || portCount > BENCH_MAX_PORTS) return 2;
+    for (uint16_t i = 0; i < portCount; i++) modules += hasModule(i);
+
+    run(&results[0], FPS_DISCOVERY_DEFAULT_THREADS);
+    run(&results[1], 4);
+
+    printf("%u ports, %u modules at other baudrates than %u, %u addresses searched, %u ms handshake\n",
+           portCount, modules, FPS_DEFAULT_BAUDRATE, (unsigned)ADDRESS_COUNT, FPS_DISCOVERY_DEFAULT_TIMEOUT);
+    for (int i = 0; i < 2; i++) {
+        printf("%2u threads: %6.2f s, %d found, %u wrong, time to a module mean %.0f ms max %u ms\n", results[i].threads,
+               results[i].seconds, results[i].found, results[i].wrong, results[i].probeTimeMean, results[i].probeTimeMax);
+    }
+
+    if (jsonPath != NULL) {
+        FILE* file = fopen(jsonPath, "w");
+        if (file == NULL) {
+            perror(jsonPath);
+            return 1;
+        }
+        fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"ports\": %u,\n  \"modules\": %u,\n  \"runs\": [\n",
+                FPS_BENCH_VERSION, (long long)time(NULL), portCount, modules);
+        for (int i = 0; i < 2; i++) {
+            fprintf(file, "    { \"threads\": %u, \"seconds\": %.3f, \"found\": %d, \"wrong\": %u, \"probe_ms_mean\": %.1f, \"probe_ms_max\": %u }%s\n",
+                    results[i].threads, results[i].seconds, results[i].found, results[i].wrong, results[i].probeTimeMean,
+                    results[i].probeTimeMax, i == 1 ? "" : ",");
+        }
+        fprintf(file, "  ]\n}\n");
+        fclose(file);
+    }
+    for (uint16_t i = 0; i < portCount; i++) fpsSimFree(&sims[i]);
+    return results[0].wrong + results[1].wrong > 0 ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
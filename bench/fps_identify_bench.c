@@ -0,0 +1,258 @@
+/*************************************************************************
+ *
+ * finger print library - continuous identify benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Runs a door on the simulated module for some minutes of virtual time:
+ * fingers arrive every 2 to 20 s and stay 0.5 to 0.9 s, one in ten is not
+ * enrolled. The same arrivals are served twice, by the three-step loop of
+ * the readme (generateImage every 100 ms, then generateCharacter and
+ * searchLibrary) and by R30X_identify with the fused scan-and-search
+ * command. Reports results per minute, bus bytes and commands per result
+ * (counted by the simulator, idle traffic included) and the time from the
+ * touch to the result.
+ *
+ * usage: fps_identify_bench [--minutes n] [--enrolled n] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fps_sim.h"
+#include "R30X_identify.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          1000
+#define BENCH_FINGER_BASE       1000  //finger of the template at location i is BENCH_FINGER_BASE + i
+#define BENCH_STRANGER_BASE     100000  //fingers that are not enrolled
+#define BENCH_POLL_DELAY        100  //ms between generateImage polls of the three-step loop
+#define BENCH_MAX_VISITS        4096
+
+typedef struct {
+    uint64_t startUs;
+    uint64_t endUs;
+    uint32_t finger;
+    uint8_t seen;
+}BENCH_VISIT;
+
+typedef struct {
+    const char* name;
+    uint32_t results;
+    uint32_t wrong;  //wrong location, or a stranger identified, or a result without a finger
+    uint32_t missed;  //visits without result
+    uint32_t duplicates;  //second result for one visit
+    double perMinute;
+    double bytesPerResult;
+    double commandsPerResult;
+    double latencyMs;  //touch to result
+    double latencyMaxMs;
+}BENCH_RESULT;
+
+static BENCH_VISIT visits[BENCH_MAX_VISITS];
+static uint32_t visitCount = 0;
+static BENCH_RESULT results[2];
+static __FPS_SIM sim;
+static uint32_t minutes = 30;
+static uint16_t enrolled = 500;
+static uint32_t rngState = 12345;
+
+static uint32_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint32_t simMillis(void) {
+    return (uint32_t)(sim.clockUs / 1000);
+}
+
+static void simDelay(uint32_t ms) {
+    sim.clockUs += (uint64_t)ms * 1000;
+}
+
+//last visit that started at or before us
+static int32_t visitAt(uint64_t us) {
+    int32_t low = 0, high = (int32_t)visitCount - 1, found = -1;
+    while (low <= high) {
+        int32_t middle = (low + high) / 2;
+        if (visits[middle].startUs <= us) {
+            found = middle;
+            low = middle + 1;
+        }
+        else high = middle - 1;
+    }
+    return found;
+}
+
+static uint32_t fingerAt(void* arg, uint64_t us) {
+    (void)arg;
+    int32_t visit = visitAt(us);
+    return visit >= 0 && us < visits[visit].endUs ? visits[visit].finger : FPS_SIM_NO_FINGER;
+}
+
+static void makeVisits(void) {
+    uint64_t endUs = (uint64_t)minutes * 60000000ULL;
+    uint64_t time = 0;
+    visitCount = 0;
+    for (;;) {
+        time += 2000000 + (uint64_t)(nextRandom() % 18000) * 1000;
+        uint64_t duration = 500000 + (uint64_t)(nextRandom() % 400) * 1000;
+        if (time + duration > endUs || visitCount == BENCH_MAX_VISITS) break;
+        BENCH_VISIT* visit = &visits[visitCount++];
+        visit->startUs = time;
+        visit->endUs = time + duration;
+        visit->finger = nextRandom() % 10 == 9 ? BENCH_STRANGER_BASE + visitCount : BENCH_FINGER_BASE + nextRandom() % enrolled;
+        time += duration;
+    }
+}
+
+static void startModule(__FPS* stream) {
+    if (fpsSimInit(&sim, BENCH_CAPACITY) != 0) exit(1);
+    fpsSimAttach(&sim, stream);
+    for (uint16_t location = 0; location < enrolled; location++) {
+        fpsSimMakeTemplate(BENCH_FINGER_BASE + location, sim.library + (uint32_t)location * FPS_TEMPLATE_SIZE);
+        sim.used[location / 8] |= (uint8_t)(1 << (location % 8));
+    }
+    fpsSimFingerSchedule(&sim, fingerAt, NULL);
+    for (uint32_t i = 0; i < visitCount; i++) visits[i].seen = 0;
+}
+
+//check a result against the visit the image was taken from
+static void record(BENCH_RESULT* result, uint8_t response, uint16_t fingerId, uint64_t* latencyTotal, uint64_t* latencyMax) {
+    int32_t visit = visitAt(sim.clockUs);
+    result->results++;
+    if (visit < 0 || sim.imageFinger != visits[visit].finger) {
+        result->wrong++;
+        return;
+    }
+    uint32_t finger = visits[visit].finger;
+    if (finger >= BENCH_STRANGER_BASE ? response != FPS_RESP_NOTFOUND : response != FPS_RESP_OK || fingerId != finger - BENCH_FINGER_BASE) {
+        result->wrong++;
+    }
+    if (visits[visit].seen) {
+        result->duplicates++;
+        return;
+    }
+    visits[visit].seen = 1;
+    uint64_t latency = sim.clockUs - visits[visit].startUs;
+    *latencyTotal += latency;
+    if (latency > *latencyMax) *latencyMax = latency;
+}
+
+static void finish(BENCH_RESULT* result, uint64_t latencyTotal, uint64_t latencyMax) {
+    uint32_t firstResults = result->results - result->duplicates - result->wrong;
+    for (uint32_t i = 0; i < visitCount; i++) result->missed += !visits[i].seen;
+    result->perMinute = result->results / (sim.clockUs / 60000000.0);
+    result->bytesPerResult = result->results ? (double)(sim.bytesToModule + sim.bytesFromModule) / result->results : 0;
+    result->commandsPerResult = result->results ? (double)sim.commands / result->results : 0;
+    result->latencyMs = firstResults ? latencyTotal / 1000.0 / firstResults : 0;
+    result->latencyMaxMs = latencyMax / 1000.0;
+    printf("%-10s %5u results  %6.2f /min  %7.1f bytes/result  %5.1f commands/result  touch to result %6.1f ms (max %6.1f)  missed %u  wrong %u\n",
+           result->name, result->results, result->perMinute, result->bytesPerResult, result->commandsPerResult, result->latencyMs,
+           result->latencyMaxMs, result->missed, result->wrong);
+}
+
+static void runThreeStep(BENCH_RESULT* result) {
+    __FPS stream;
+    uint64_t latencyTotal = 0, latencyMax = 0;
+    uint64_t endUs = (uint64_t)minutes * 60000000ULL;
+    result->name = "three-step";
+    startModule(&stream);
+    while (sim.clockUs < endUs) {
+        uint8_t response = generateImage(&stream);
+        if (response == FPS_RESP_NOFINGER) {
+            simDelay(BENCH_POLL_DELAY);
+            continue;
+        }
+        if (response == FPS_RESP_OK) response = generateCharacter(&stream, 1);
+        if (response == FPS_RESP_OK) response = searchLibrary(&stream, 1, 0, stream.templateCount);
+        if (response == FPS_RESP_OK || response == FPS_RESP_NOTFOUND) {
+            record(result, response, stream.fingerId, &latencyTotal, &latencyMax);
+            simDelay(FPS_IDENTIFY_LIFT_DELAY);
+        }
+        else simDelay(FPS_IDENTIFY_ERROR_DELAY);
+    }
+    finish(result, latencyTotal, latencyMax);
+    fpsSimFree(&sim);
+}
+
+static void runFused(BENCH_RESULT* result) {
+    __FPS stream;
+    __FPS_IDENTIFY identify;
+    __FPS_IDENTIFY_RESULT found;
+    uint64_t latencyTotal = 0, latencyMax = 0;
+    uint64_t endUs = (uint64_t)minutes * 60000000ULL;
+    result->name = "fused";
+    startModule(&stream);
+    R30X_identifyInit(&identify, simMillis, simDelay);
+    //the steps of R30X_identifyRun, ending at the end of the virtual time
+    while (sim.clockUs < endUs) {
+        uint8_t response = R30X_identifyStep(&identify, &stream);
+        if (response == FPS_RESP_OK || response == FPS_RESP_NOTFOUND) {
+            if (!R30X_identifyPop(&identify, &found)) exit(1);
+            record(result, found.status, found.fingerId, &latencyTotal, &latencyMax);
+            simDelay(identify.liftDelay);
+        }
+        else if (response != FPS_RESP_NOFINGER) simDelay(FPS_IDENTIFY_ERROR_DELAY);
+    }
+    finish(result, latencyTotal, latencyMax);
+    if (identify.stats.busBytes != sim.bytesToModule + sim.bytesFromModule) {
+        printf("R30X_identify counted %llu bus bytes, the module %llu\n", (unsigned long long)identify.stats.busBytes,
+               (unsigned long long)(sim.bytesToModule + sim.bytesFromModule));
+        result->wrong++;
+    }
+    fpsSimFree(&sim);
+}
+
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"minutes\": %u,\n  \"enrolled\": %u,\n"
+            "  \"visits\": %u,\n  \"benchmarks\": [\n", FPS_BENCH_VERSION, (long long)time(NULL), minutes, enrolled, visitCount);
+    for (int i = 0; i < 2; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"results\": %u, \"per_minute\": %.2f, \"bytes_per_result\": %.1f, \"commands_per_result\": %.1f, "
+                "\"latency_ms\": %.1f, \"latency_max_ms\": %.1f, \"missed\": %u, \"duplicates\": %u, \"wrong\": %u}%s\n",
+                results[i].name, results[i].results, results[i].perMinute, results[i].bytesPerResult, results[i].commandsPerResult,
+                results[i].latencyMs, results[i].latencyMaxMs, results[i].missed, results[i].duplicates, results[i].wrong, i == 0 ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--minutes") == 0 && i + 1 < argc) minutes = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--enrolled") == 0 && i + 1 < argc) enrolled = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--minutes n] [--enrolled n] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (minutes == 0 || minutes > 600 || enrolled == 0 || enrolled > BENCH_CAPACITY) return 2;
+
+    makeVisits();
+    printf("%u minutes, %u visits, %u templates enrolled\n", minutes, visitCount, enrolled);
+    runThreeStep(&results[0]);
+    runFused(&results[1]);
+    printf("fused: %.1f%% of the bus bytes and %.1f%% of the commands per result\n", 100.0 * results[1].bytesPerResult / results[0].bytesPerResult,
+           100.0 * results[1].commandsPerResult / results[0].commandsPerResult);
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    for (int i = 0; i < 2; i++) {
+        if (results[i].wrong || results[i].missed) return 1;
+    }
+    return 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,243 @@
+/*************************************************************************
+ *
+ * finger print library - image pool stress benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Several threads acquire images from a small R30X_imgpool, keep some of
+ * them for a while, share others with the other threads (retain, hand
+ * over, release there) and so run the pool empty over and over. Every
+ * acquired image is stamped with a number only its acquisition uses, and
+ * every holder checks the stamp before it releases; an image handed out
+ * twice is also caught by the holder count the benchmark keeps per
+ * buffer. Afterwards the statistics of the pool are compared with the
+ * counts of the threads, and the pool is emptied once more from a single
+ * thread: every buffer must come back exactly once.
+ *
+ * usage: fps_imgpool_bench [--threads n] [--buffers n] [--iterations n] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "R30X_imgpool.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_MAX_THREADS       64
+#define BENCH_KEEP              3     //images a thread holds at most
+#define BENCH_SHARED_LENGTH     256   //references handed between the threads
+
+typedef struct {
+    __FPS_IMAGE* image;
+    uint64_t stamp;
+}BENCH_REF;
+
+typedef struct {
+    pthread_t thread;
+    uint32_t rngState;
+    BENCH_REF kept[BENCH_KEEP];
+    uint8_t keptCount;
+    uint64_t acquisitions;
+    uint64_t exhaustions;
+}BENCH_THREAD;
+
+static __FPS_IMGPOOL pool;
+static BENCH_THREAD threads[BENCH_MAX_THREADS];
+static atomic_uint* holders;  //references the benchmark knows of, per buffer
+static atomic_uint_fast64_t nextStamp = 1;
+static atomic_uint inUse;  //buffers with holders
+static atomic_uint peakInUse;
+static atomic_uint_fast64_t doubleHandouts;  //acquired while the benchmark still held it
+static atomic_uint_fast64_t overwritten;  //stamp changed while held
+
+static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+static BENCH_REF shared[BENCH_SHARED_LENGTH];
+static uint32_t sharedCount = 0;
+
+static uint32_t threadCount = 8;
+static uint32_t bufferCount = 8;
+static uint32_t iterations = 200000;
+
+static uint32_t nextRandom(BENCH_THREAD* thread) {
+    thread->rngState ^= thread->rngState << 13;
+    thread->rngState ^= thread->rngState >> 17;
+    thread->rngState ^= thread->rngState << 5;
+    return thread->rngState;
+}
+
+static void stamp(__FPS_IMAGE* image, uint64_t value) {
+    memcpy(image->data, &value, sizeof(value));
+    memcpy(image->data + FPS_IMGPOOL_BUFFER_SIZE - sizeof(value), &value, sizeof(value));
+}
+
+static uint8_t hasStamp(const __FPS_IMAGE* image, uint64_t value) {
+    return memcmp(image->data, &value, sizeof(value)) == 0 &&
+           memcmp(image->data + FPS_IMGPOOL_BUFFER_SIZE - sizeof(value), &value, sizeof(value)) == 0;
+}
+
+static uint8_t acquire(BENCH_THREAD* thread, BENCH_REF* ref) {
+    __FPS_IMAGE* image = R30X_imgpoolAcquire(&pool);
+    if (image == NULL) {
+        thread->exhaustions++;
+        return 0;
+    }
+    thread->acquisitions++;
+    if (atomic_fetch_add(&holders[image->index], 1) != 0) atomic_fetch_add(&doubleHandouts, 1);
+    unsigned count = atomic_fetch_add(&inUse, 1) + 1;
+    unsigned peak = atomic_load(&peakInUse);
+    while (count > peak && !atomic_compare_exchange_weak(&peakInUse, &peak, count)) {}
+    ref->image = image;
+    ref->stamp = atomic_fetch_add(&nextStamp, 1);
+    stamp(image, ref->stamp);
+    return 1;
+}
+
+static void share(const BENCH_REF* ref) {
+    atomic_fetch_add(&holders[ref->image->index], 1);
+    R30X_imgpoolRetain(ref->image);
+    pthread_mutex_lock(&sharedLock);
+    if (sharedCount < BENCH_SHARED_LENGTH) {
+        shared[sharedCount++] = *ref;
+        ref = NULL;
+    }
+    pthread_mutex_unlock(&sharedLock);
+    if (ref != NULL) {  //nobody takes it, drop the reference again
+        atomic_fetch_sub(&holders[ref->image->index], 1);
+        R30X_imgpoolRelease(ref->image);
+    }
+}
+
+static void release(const BENCH_REF* ref) {
+    if (!hasStamp(ref->image, ref->stamp)) atomic_fetch_add(&overwritten, 1);
+    if (atomic_fetch_sub(&holders[ref->image->index], 1) == 1) atomic_fetch_sub(&inUse, 1);  //before the pool can hand it out again
+    R30X_imgpoolRelease(ref->image);
+}
+
+static void* worker(void* arg) {
+    BENCH_THREAD* thread = (BENCH_THREAD*)arg;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t random = nextRandom(thread);
+        BENCH_REF ref;
+        if (thread->keptCount == BENCH_KEEP || (random & 3) == 0) {  //the oldest stage is done
+            if (thread->keptCount > 0) {
+                release(&thread->kept[0]);
+                memmove(thread->kept, thread->kept + 1, --thread->keptCount * sizeof(BENCH_REF));
+            }
+        }
+        if (acquire(thread, &ref)) {
+            for (uint32_t copies = (random >> 2) % 3; copies > 0; copies--) share(&ref);
+            if ((random >> 4) & 1) release(&ref);
+            else thread->kept[thread->keptCount++] = ref;
+        }
+        for (uint32_t taken = (random >> 5) % 3; taken > 0; taken--) {  //references of the other threads
+            uint8_t found = 0;
+            pthread_mutex_lock(&sharedLock);
+            if (sharedCount > 0) {
+                ref = shared[--sharedCount];
+                found = 1;
+            }
+            pthread_mutex_unlock(&sharedLock);
+            if (found) release(&ref);
+        }
+    }
+    while (thread->keptCount > 0) release(&thread->kept[--thread->keptCount]);
+    return NULL;
+}
+
+static double wallSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    __FPS_IMGPOOL_STATS stats;
+    uint64_t acquisitions = 0, exhaustions = 0, errors = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threadCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--buffers") == 0 && i + 1 < argc) bufferCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--threads n] [--buffers n] [--iterations n] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (threadCount == 0 || threadCount > BENCH_MAX_THREADS || bufferCount == 0) return 2;
+    if (R30X_imgpoolCreate(&pool, bufferCount) != 0) return 1;
+    holders = (atomic_uint*)calloc(bufferCount, sizeof(atomic_uint));
+    if (holders == NULL) return 1;
+
+    double start = wallSeconds();
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads[i].rngState = 2023 + i * 7919;
+        pthread_create(&threads[i].thread, NULL, worker, &threads[i]);
+    }
+    for (uint32_t i = 0; i < threadCount; i++) pthread_join(threads[i].thread, NULL);
+    double seconds = wallSeconds() - start;
+    for (uint32_t i = 0; i < sharedCount; i++) release(&shared[i]);
+    sharedCount = 0;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        acquisitions += threads[i].acquisitions;
+        exhaustions += threads[i].exhaustions;
+    }
+
+    R30X_imgpoolGetStats(&pool, &stats);
+    printf("%u threads, %u buffers: %llu acquisitions in %.2f s (%.1f M/s), %llu found the pool empty\n", threadCount, bufferCount,
+           (unsigned long long)acquisitions, seconds, acquisitions / seconds / 1e6, (unsigned long long)exhaustions);
+    printf("handed out twice %llu, overwritten while held %llu\n", (unsigned long long)atomic_load(&doubleHandouts),
+           (unsigned long long)atomic_load(&overwritten));
+    printf("pool statistics: %llu acquisitions, %llu exhaustions, %u in use, peak %u (threads saw %u)\n",
+           (unsigned long long)stats.acquisitions, (unsigned long long)stats.exhaustions, stats.inUse, stats.peakInUse,
+           atomic_load(&peakInUse));
+    errors += atomic_load(&doubleHandouts) + atomic_load(&overwritten);
+    if (stats.acquisitions != acquisitions || stats.exhaustions != exhaustions) errors++;
+    if (stats.inUse != 0 || stats.peakInUse > bufferCount || stats.peakInUse < atomic_load(&peakInUse)) errors++;
+
+    //every buffer is free again: all of them once, then the pool is empty and the peak is the pool size
+    uint8_t* seen = (uint8_t*)calloc(bufferCount, 1);
+    __FPS_IMAGE** images = (__FPS_IMAGE**)calloc(bufferCount, sizeof(__FPS_IMAGE*));
+    if (seen == NULL || images == NULL) return 1;
+    for (uint32_t i = 0; i < bufferCount; i++) {
+        images[i] = R30X_imgpoolAcquire(&pool);
+        if (images[i] == NULL || seen[images[i]->index]++) errors++;
+    }
+    if (R30X_imgpoolAcquire(&pool) != NULL) errors++;
+    R30X_imgpoolGetStats(&pool, &stats);
+    if (stats.exhaustions != exhaustions + 1 || stats.inUse != bufferCount || stats.peakInUse != bufferCount) errors++;
+    for (uint32_t i = 0; i < bufferCount; i++) {
+        if (images[i] != NULL) R30X_imgpoolRelease(images[i]);
+    }
+    R30X_imgpoolGetStats(&pool, &stats);
+    if (stats.inUse != 0) errors++;
+    printf("after the run: every buffer acquired once, then the pool is empty: %s\n", errors ? "FAILED" : "ok");
+
+    if (jsonPath != NULL) {
+        FILE* file = fopen(jsonPath, "w");
+        if (file == NULL) {
+            perror(jsonPath);
+            return 1;
+        }
+        fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"threads\": %u,\n  \"buffers\": %u,\n"
+                "  \"acquisitions\": %llu,\n  \"exhaustions\": %llu,\n  \"seconds\": %.3f,\n  \"double_handouts\": %llu,\n"
+                "  \"overwritten\": %llu,\n  \"errors\": %llu\n}\n",
+                FPS_BENCH_VERSION, (long long)time(NULL), threadCount, bufferCount, (unsigned long long)acquisitions,
+                (unsigned long long)exhaustions, seconds, (unsigned long long)atomic_load(&doubleHandouts),
+                (unsigned long long)atomic_load(&overwritten), (unsigned long long)errors);
+        fclose(file);
+    }
+    free(seen);
+    free(images);
+    free(holders);
+    R30X_imgpoolDestroy(&pool);
+    return errors ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
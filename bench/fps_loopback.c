@@ -0,0 +1,105 @@
+/*************************************************************************
+ *
+ * finger print library - in-memory loopback port
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "fps_loopback.h"
+
+static uint32_t loopbackRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    __FPS_LOOPBACK* loop = (__FPS_LOOPBACK*)context;
+    uint32_t available = loop->rxLength - loop->rxPosition;
+    uint32_t count = BytesToRead < available ? BytesToRead : available;
+    (void)timeout;
+    memcpy(pBuf, loop->rxBuffer + loop->rxPosition, count);
+    loop->rxPosition += count;
+    loop->rxTotal += count;
+    return count;
+}
+
+static uint32_t loopbackWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    __FPS_LOOPBACK* loop = (__FPS_LOOPBACK*)context;
+    (void)timeout;
+    if (loop->txBuffer != NULL) {
+        uint32_t space = loop->txCapacity - loop->txLength;
+        uint32_t count = BytesToWrite < space ? BytesToWrite : space;
+        memcpy(loop->txBuffer + loop->txLength, pBuf, count);
+    }
+    loop->txLength += BytesToWrite;
+    if (loop->txLength > loop->txCapacity) loop->txLength = loop->txCapacity;
+    loop->txTotal += BytesToWrite;
+    return BytesToWrite;
+}
+
+static uint8_t loopbackInitialize(void* context, uint32_t baud) {
+    (void)context;
+    (void)baud;
+    return 0;
+}
+
+static uint8_t loopbackDeinitialize(void* context) {
+    (void)context;
+    return 0;
+}
+
+const __FPS_PORT fpsLoopbackPort = { loopbackRead, loopbackWrite, loopbackInitialize, loopbackDeinitialize };
+
+/*
+*   @brief: prepare a loopback port
+*   @parameter: loopback structure, passed as portContext
+*   @parameter: bytes that read will return
+*   @parameter: number of bytes in rxBuffer
+*   @parameter: buffer for written bytes, can be NULL
+*   @parameter: size of txBuffer
+*   @return: none
+*
+*/
+void fpsLoopbackInit(__FPS_LOOPBACK* loop, uint8_t* rxBuffer, uint32_t rxLength, uint8_t* txBuffer, uint32_t txCapacity) {
+    memset(loop, 0, sizeof(__FPS_LOOPBACK));
+    loop->rxBuffer = rxBuffer;
+    loop->rxLength = rxLength;
+    loop->txBuffer = txBuffer;
+    loop->txCapacity = txBuffer != NULL ? txCapacity : 0;
+}
+
+void fpsLoopbackRewind(__FPS_LOOPBACK* loop) {
+    loop->rxPosition = 0;
+    loop->txLength = 0;
+}
+/*
+*   @brief: build a complete frame like the module sends it
+*   @parameter: output buffer, needs payloadLength + 11 bytes
+*   @parameter: module address
+*   @parameter: packet type (FPS_ID_ACKPACKET, FPS_ID_DATAPACKET, ...)
+*   @parameter: payload, for acknowledge packets the first byte is the confirmation code
+*   @parameter: payload length
+*   @return: size of the frame in bytes
+*
+*/
+uint32_t fpsLoopbackFrame(uint8_t* out, uint32_t address, uint8_t packetType, const uint8_t* payload, uint16_t payloadLength) {
+    uint16_t length = payloadLength + 2;
+    uint16_t checksum;
+    out[0] = FPS_ID_STARTCODE_H;
+    out[1] = FPS_ID_STARTCODE_L;
+    out[2] = (address >> 24) & 0xff;
+    out[3] = (address >> 16) & 0xff;
+    out[4] = (address >> 8) & 0xff;
+    out[5] = (address) & 0xff;
+    out[6] = packetType;
+    out[7] = (length >> 8) & 0xff;
+    out[8] = (length) & 0xff;
+    checksum = out[6] + out[7] + out[8];
+    for (uint16_t i = 0; i < payloadLength; i++) {
+        out[9 + i] = payload[i];
+        checksum += payload[i];
+    }
+    out[9 + payloadLength] = (checksum >> 8) & 0xff;
+    out[10 + payloadLength] = (checksum) & 0xff;
+    return payloadLength + 11;
+}
+
+/********************************END OF FILE*****************************************************/
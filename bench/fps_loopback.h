@@ -0,0 +1,34 @@
+/*************************************************************************
+ *
+ * finger print library - in-memory loopback port
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Reads are served from a prepared receive buffer, writes are stored in a
+ * transmit buffer. Used by the benchmarks to run the protocol code without
+ * a serial line.
+ *
+ **************************************************************************/
+#ifndef FPS_LOOPBACK_H
+#define FPS_LOOPBACK_H
+#include "R30X_FPS.h"
+
+typedef struct {
+	  uint8_t* rxBuffer;  //bytes returned by read
+	  uint32_t rxLength;
+	  uint32_t rxPosition;
+	  uint8_t* txBuffer;  //bytes given to write, can be NULL to only count them
+	  uint32_t txCapacity;
+	  uint32_t txLength;
+	  uint64_t rxTotal;  //total bytes read since init
+	  uint64_t txTotal;  //total bytes written since init
+}__FPS_LOOPBACK;
+
+extern const __FPS_PORT fpsLoopbackPort;
+
+void	 fpsLoopbackInit (__FPS_LOOPBACK *loop, uint8_t *rxBuffer, uint32_t rxLength, uint8_t *txBuffer, uint32_t txCapacity);
+void	 fpsLoopbackRewind (__FPS_LOOPBACK *loop); //serve the receive buffer again from the start and drop written bytes
+uint32_t fpsLoopbackFrame (uint8_t *out, uint32_t address, uint8_t packetType, const uint8_t *payload, uint16_t payloadLength); //build a frame, returns its size
+#endif
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,197 @@
+/*************************************************************************
+ *
+ * finger print library - pipelined commands benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Bulk deleteTemplate and saveTemplate of single locations on the
+ * simulated module, once with the library functions (one round trip per
+ * command) and once through R30X_pipeline with growing windows. The host
+ * turnaround (USB serial adapters: about 1 ms per reply) is what the
+ * pipeline hides behind the module's flash time. Reported in module time
+ * for every baudrate. The simulated module buffers frames that arrive
+ * while it is busy; whether a real R30x does has not been verified, so
+ * the speedups are an upper bound until it is.
+ *
+ * A run with a bad location in the middle checks that the pipeline stops
+ * at the failure and reports which commands took effect.
+ *
+ * usage: fps_pipeline_bench [--commands n] [--turnaround us] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fps_sim.h"
+#include "R30X_pipeline.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          1000
+#define BENCH_MAX_RESULTS       32
+#define BENCH_LIBRARY           0  //window 0 stands for the library functions
+
+typedef struct {
+    const char* workload;
+    uint32_t baud;
+    uint8_t window;
+    double totalMs;
+    double commandsPerSecond;
+    double speedup;
+}BENCH_RESULT;
+
+static const uint32_t bauds[] = { 9600, 57600, 115200 };
+static const uint8_t windows[] = { BENCH_LIBRARY, 1, 2, 4, 8 };
+static BENCH_RESULT results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t commandCount = 200;
+static uint32_t turnaroundUs = 1000;
+
+static void setup(__FPS_SIM* sim, __FPS* stream, uint32_t baud) {
+    uint8_t templateData[FPS_TEMPLATE_SIZE];
+    if (fpsSimInit(sim, BENCH_CAPACITY) != 0) exit(1);
+    sim->baud = baud;
+    sim->timing.hostTurnaround = turnaroundUs;
+    fpsSimAttach(sim, stream);
+    fpsSimMakeTemplate(7, templateData);
+    memcpy(sim->charBuffer[0], templateData, FPS_TEMPLATE_SIZE);
+    for (uint16_t location = 1; location <= commandCount; location++) {
+        memcpy(sim->library + (uint32_t)location * FPS_TEMPLATE_SIZE, templateData, FPS_TEMPLATE_SIZE);
+        sim->used[location / 8] |= (uint8_t)(1 << (location % 8));
+    }
+}
+
+static uint8_t isUsed(const __FPS_SIM* sim, uint16_t location) {
+    return (sim->used[location / 8] >> (location % 8)) & 1;
+}
+
+//the locations are deleted or saved in a scattered order, like removing a list of users
+static uint16_t locationOf(uint32_t i) {
+    return (uint16_t)(1 + (i * 37) % commandCount);
+}
+
+static int runLibrary(__FPS* stream, uint8_t save) {
+    for (uint32_t i = 0; i < commandCount; i++) {
+        uint8_t response = save ? saveTemplate(stream, 1, locationOf(i)) : deleteTemplate(stream, locationOf(i), 1);
+        if (response != FPS_RESP_OK) return -1;
+    }
+    return 0;
+}
+
+static int runPipeline(__FPS* stream, uint8_t save, uint8_t window) {
+    __FPS_PIPELINE pipeline;
+    R30X_pipelineInit(&pipeline, stream, window);
+    for (uint32_t i = 0; i < commandCount;) {
+        R30X_pipelineClear(&pipeline);
+        for (; i < commandCount && pipeline.count < FPS_PIPELINE_MAX_COMMANDS; i++) {
+            if ((save ? R30X_pipelineQueueSave(&pipeline, 1, locationOf(i)) : R30X_pipelineQueueDelete(&pipeline, locationOf(i), 1)) < 0) return -1;
+        }
+        if (R30X_pipelineRun(&pipeline) != FPS_RESP_OK) return -1;
+    }
+    return 0;
+}
+
+static void measure(const char* workload, uint8_t save, uint32_t baud, uint8_t window, double libraryMs) {
+    __FPS_SIM sim;
+    __FPS stream;
+    setup(&sim, &stream, baud);
+    if (save) memset(sim.used, 0, (BENCH_CAPACITY + 7) / 8);
+    uint64_t start = sim.clockUs;
+    int failed = window == BENCH_LIBRARY ? runLibrary(&stream, save) : runPipeline(&stream, save, window);
+    uint64_t elapsed = sim.clockUs - start;
+    for (uint16_t location = 1; location <= commandCount && !failed; location++) {
+        if (isUsed(&sim, location) != save) failed = 1;
+    }
+    fpsSimFree(&sim);
+    if (failed) {
+        fprintf(stderr, "%s at %u baud, window %u failed\n", workload, baud, window);
+        exit(1);
+    }
+    BENCH_RESULT* result = &results[resultCount++];
+    result->workload = workload;
+    result->baud = baud;
+    result->window = window;
+    result->totalMs = elapsed / 1000.0;
+    result->commandsPerSecond = commandCount / (elapsed / 1e6);
+    result->speedup = libraryMs > 0 ? libraryMs / result->totalMs : 1.0;
+    if (window == BENCH_LIBRARY) printf("%-7s %6u  library   %9.1f ms  %7.1f cmd/s\n", workload, baud, result->totalMs, result->commandsPerSecond);
+    else printf("%-7s %6u  window %u  %9.1f ms  %7.1f cmd/s  x%.2f\n", workload, baud, window, result->totalMs, result->commandsPerSecond, result->speedup);
+}
+
+//a bad location in the middle: the commands before it and the ones already on the line are done, the rest is skipped
+static int checkFailure(uint8_t window) {
+    __FPS_SIM sim;
+    __FPS stream;
+    __FPS_PIPELINE pipeline;
+    uint8_t badLocation[3] = { 1, 0xFF, 0xF0 };
+    int errors = 0;
+    setup(&sim, &stream, 57600);
+    memset(sim.used, 0, (BENCH_CAPACITY + 7) / 8);
+    R30X_pipelineInit(&pipeline, &stream, window);
+    for (uint16_t location = 1; location <= 10; location++) R30X_pipelineQueueSave(&pipeline, 1, location);
+    R30X_pipelineQueue(&pipeline, FPS_CMD_STORETEMPLATE, badLocation, 3);
+    for (uint16_t location = 11; location <= 20; location++) R30X_pipelineQueueSave(&pipeline, 1, location);
+
+    if (R30X_pipelineRun(&pipeline) != FPS_RESP_BADLOCATION || pipeline.firstFailure != 10) errors++;
+    for (uint16_t i = 0; i < pipeline.count; i++) {
+        uint8_t expected = i < 10 ? FPS_PIPELINE_DONE : i == 10 ? FPS_PIPELINE_FAILED : i < 10u + window ? FPS_PIPELINE_DONE : FPS_PIPELINE_SKIPPED;
+        if (pipeline.entries[i].state != expected) errors++;
+        if (i != 10 && isUsed(&sim, i < 10 ? i + 1 : i) != (expected == FPS_PIPELINE_DONE)) errors++;
+    }
+    fpsSimFree(&sim);
+    printf("failure in the middle, window %u: %s\n", window, errors ? "WRONG" : "ok");
+    return errors;
+}
+
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"commands\": %u,\n  \"turnaround_us\": %u,\n"
+            "  \"module_buffering\": \"assumed, not verified on hardware\",\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL), commandCount, turnaroundUs);
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"workload\": \"%s\", \"baud\": %u, \"window\": %u, \"total_ms\": %.1f, \"commands_per_s\": %.1f, \"speedup\": %.2f}%s\n",
+                results[i].workload, results[i].baud, results[i].window, results[i].totalMs, results[i].commandsPerSecond,
+                results[i].speedup, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    int errors = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--commands") == 0 && i + 1 < argc) commandCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--turnaround") == 0 && i + 1 < argc) turnaroundUs = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--commands n] [--turnaround us] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (commandCount == 0 || commandCount >= BENCH_CAPACITY) return 2;
+
+    printf("%u commands, host turnaround %u us, module-side buffering assumed (not verified on hardware)\n", commandCount, turnaroundUs);
+    for (uint8_t save = 0; save < 2; save++) {
+        for (size_t b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++) {
+            double libraryMs = 0;
+            for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+                measure(save ? "save" : "delete", save, bauds[b], windows[w], libraryMs);
+                if (windows[w] == BENCH_LIBRARY) libraryMs = results[resultCount - 1].totalMs;
+            }
+        }
+    }
+    for (uint8_t window = 1; window <= 4; window *= 2) errors += checkFailure(window);
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    return errors ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
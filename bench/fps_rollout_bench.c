@@ -0,0 +1,164 @@
+/*************************************************************************
+ *
+ * finger print library - configuration rollout benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Moves a fleet of simulated modules from the defaults to security level
+ * 4, 64 byte packets, a new password and 115200 baud with R30X_rollout,
+ * one unit at a time and with 4, 16 and 64 units in flight. The modules
+ * run in real time scaled by --percent (10: ten times faster), the times
+ * are given in module time. Every 25th module loses every 5th reply, every
+ * 40th acknowledges but ignores FPS_CMD_SETSYSPARA (it must be rolled
+ * back) and every 50th has another address (unreachable). A last run
+ * aborts after 3 failures and restores the units already done.
+ *
+ * After every run each module is checked: done units must have the target
+ * settings, rolled back and skipped units their old ones.
+ *
+ * usage: fps_rollout_bench [--units n] [--percent p] [--report file.csv] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fps_sim.h"
+#include "R30X_rollout.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          10
+#define BENCH_NEW_PASSWORD      0x5EC12E7UL
+#define BENCH_MAX_RESULTS       8
+
+typedef struct {
+    uint16_t inFlight;
+    uint8_t abortRun;
+    double seconds;  //module time of the whole rollout
+    uint32_t states[FPS_ROLLOUT_SKIPPED + 1];
+    uint32_t attempts;
+    uint32_t wrong;  //modules whose settings do not match their state
+}BENCH_RESULT;
+
+static BENCH_RESULT results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t unitCount = 200;
+static uint32_t percent = 10;
+static const char* reportPath = NULL;
+
+static double wallSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t hasSettings(const __FPS_SIM* sim, uint8_t security, uint16_t length, uint32_t password, uint32_t baud) {
+    return sim->securityLevel == security && sim->packetLength == length && sim->password == password && sim->baud == baud;
+}
+
+static void run(uint16_t inFlight, uint8_t abortRun) {
+    __FPS_SIM* sims = (__FPS_SIM*)calloc(unitCount, sizeof(__FPS_SIM));
+    __FPS* streams = (__FPS*)calloc(unitCount, sizeof(__FPS));
+    __FPS_ROLLOUT_UNIT* units = (__FPS_ROLLOUT_UNIT*)calloc(unitCount, sizeof(__FPS_ROLLOUT_UNIT));
+    char (*names)[16] = calloc(unitCount, 16);
+    BENCH_RESULT* result = &results[resultCount++];
+    if (sims == NULL || streams == NULL || units == NULL || names == NULL) exit(1);
+    memset(result, 0, sizeof(BENCH_RESULT));
+
+    for (uint32_t i = 0; i < unitCount; i++) {
+        if (fpsSimInit(&sims[i], BENCH_CAPACITY) != 0) exit(1);
+        fpsSimAttach(&sims[i], &streams[i]);
+        sims[i].realTimePercent = percent;
+        streams[i].commandTimeout = (uint16_t)(FPS_DEFAULT_TIMEOUT * percent / 100);  //in module time like the rest
+        if (i % 25 == 24) sims[i].loseEvery = 5;
+        if (i % 40 == 39) sims[i].ignoreSysPara = 1;
+        if (i % 50 == 49) sims[i].address = FPS_DEFAULT_ADDRESS - 1;
+        if (abortRun && i % 10 == 9) sims[i].ignoreSysPara = 1;
+        snprintf(names[i], 16, "sim%u", i);
+        units[i].stream = &streams[i];
+        units[i].name = names[i];
+    }
+
+    __FPS_ROLLOUT_PARAMS target = { FPS_ROLLOUT_SECURITY_LEVEL | FPS_ROLLOUT_DATA_LENGTH | FPS_ROLLOUT_PASSWORD | FPS_ROLLOUT_BAUDRATE,
+                                    4, 64, BENCH_NEW_PASSWORD, 115200 };
+    __FPS_ROLLOUT_CONFIG config;
+    R30X_rolloutDefaults(&config);
+    config.maxInFlight = inFlight;
+    if (abortRun) {
+        config.maxFailures = 3;
+        config.rollbackOnAbort = 1;
+    }
+    double start = wallSeconds();
+    if (R30X_rollout(units, unitCount, &target, &config) < 0) exit(1);
+    result->seconds = (wallSeconds() - start) * 100 / percent;
+
+    for (uint32_t i = 0; i < unitCount; i++) {
+        uint8_t state = units[i].state;
+        result->states[state]++;
+        result->attempts += units[i].attempts;
+        if (state == FPS_ROLLOUT_DONE) result->wrong += !hasSettings(&sims[i], 4, 64, BENCH_NEW_PASSWORD, 115200);
+        else if (state != FPS_ROLLOUT_FAILED) result->wrong += !hasSettings(&sims[i], FPS_DEFAULT_SECURITY_LEVEL, 128, FPS_DEFAULT_PASSWORD, FPS_DEFAULT_BAUDRATE);
+    }
+    result->inFlight = inFlight;
+    result->abortRun = abortRun;
+    printf("%s in flight %3u  %8.2f s  done %3u  rolled back %3u  failed %u  unreachable %u  skipped %3u  rounds %4u  wrong %u\n",
+           abortRun ? "abort" : "     ", inFlight, result->seconds, result->states[FPS_ROLLOUT_DONE], result->states[FPS_ROLLOUT_ROLLED_BACK],
+           result->states[FPS_ROLLOUT_FAILED], result->states[FPS_ROLLOUT_UNREACHABLE], result->states[FPS_ROLLOUT_SKIPPED], result->attempts,
+           result->wrong);
+    if (reportPath != NULL && !abortRun && R30X_rolloutReport(units, unitCount, reportPath) != 0) perror(reportPath);
+
+    for (uint32_t i = 0; i < unitCount; i++) fpsSimFree(&sims[i]);
+    free(sims);
+    free(streams);
+    free(units);
+    free(names);
+}
+
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"units\": %u,\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL), unitCount);
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"in_flight\": %u, \"abort\": %u, \"seconds\": %.2f, \"done\": %u, \"rolled_back\": %u, \"failed\": %u, "
+                "\"unreachable\": %u, \"skipped\": %u, \"rounds\": %u, \"wrong\": %u}%s\n",
+                results[i].inFlight, results[i].abortRun, results[i].seconds, results[i].states[FPS_ROLLOUT_DONE],
+                results[i].states[FPS_ROLLOUT_ROLLED_BACK], results[i].states[FPS_ROLLOUT_FAILED], results[i].states[FPS_ROLLOUT_UNREACHABLE],
+                results[i].states[FPS_ROLLOUT_SKIPPED], results[i].attempts, results[i].wrong, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    static const uint16_t inFlight[] = { 1, 4, 16, 64 };
+    const char* jsonPath = NULL;
+    uint32_t wrong = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--units") == 0 && i + 1 < argc) unitCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--percent") == 0 && i + 1 < argc) percent = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) reportPath = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--units n] [--percent p] [--report file.csv] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (unitCount == 0 || percent == 0 || percent > 100) return 2;
+
+    printf("%u modules, %u%% of real time\n", unitCount, percent);
+    for (size_t i = 0; i < sizeof(inFlight) / sizeof(inFlight[0]); i++) run(inFlight[i], 0);
+    run(16, 1);
+    for (int i = 0; i < resultCount; i++) wrong += results[i].wrong;
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    return wrong ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,267 @@
+/*************************************************************************
+ *
+ * finger print library - serial transport latency benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Runs commands over a pseudo terminal pair. A thread on the master side
+ * answers like a module (the simulated module with zero processing time),
+ * the library talks to the slave side through
+ *  - fpsLinuxSerialPort: raw mode, nonblocking descriptor, waits in poll
+ *  - a naive port as found in many applications: blocking descriptor with
+ *    VMIN = 0 and VTIME = 0, reads that sleep 1 ms when the bytes are not
+ *    there yet and tcdrain after every write
+ * and reports the round trip time of every command, which is the software
+ * overhead the transport adds to every reply.
+ *
+ * usage: fps_serial_bench [--iterations n] [--json file]
+ *
+ **************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "fps_sim.h"
+#include "R30X_linux_serial.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_MAX_RESULTS       8
+
+typedef struct {
+    const char* transport;
+    const char* command;
+    uint32_t iterations;
+    double p50Us;
+    double p99Us;
+    double meanUs;
+}BENCH_RESULT;
+
+typedef struct {
+    int fd;
+}NAIVE_SERIAL;
+
+static BENCH_RESULT results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t iterations = 2000;
+static int masterFd = -1;
+static __FPS_SIM sim;
+static volatile int responderRunning = 1;
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleepMs(uint32_t ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+//---------------------------------------------------------------------------
+//naive transport
+
+static uint32_t naiveRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    NAIVE_SERIAL* naive = (NAIVE_SERIAL*)context;
+    uint32_t count = 0, elapsed = 0;
+    while (count < BytesToRead) {
+        ssize_t n = read(naive->fd, pBuf + count, BytesToRead - count);
+        if (n > 0) {
+            count += (uint32_t)n;
+            continue;
+        }
+        if (elapsed >= timeout) break;
+        sleepMs(1);
+        elapsed++;
+    }
+    return count;
+}
+
+static uint32_t naiveWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    NAIVE_SERIAL* naive = (NAIVE_SERIAL*)context;
+    (void)timeout;
+    ssize_t n = write(naive->fd, pBuf, BytesToWrite);
+    tcdrain(naive->fd);
+    return n > 0 ? (uint32_t)n : 0;
+}
+
+static uint8_t naiveInitialize(void* context, uint32_t baud) {
+    NAIVE_SERIAL* naive = (NAIVE_SERIAL*)context;
+    struct termios tio;
+    (void)baud;
+    naive->fd = open(ptsname(masterFd), O_RDWR | O_NOCTTY);
+    if (naive->fd < 0 || tcgetattr(naive->fd, &tio) != 0) return 1;
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B57600);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    return tcsetattr(naive->fd, TCSANOW, &tio) == 0 ? 0 : 1;
+}
+
+static uint8_t naiveDeinitialize(void* context) {
+    NAIVE_SERIAL* naive = (NAIVE_SERIAL*)context;
+    if (naive->fd >= 0) close(naive->fd);
+    naive->fd = -1;
+    return 0;
+}
+
+static const __FPS_PORT naivePort = { naiveRead, naiveWrite, naiveInitialize, naiveDeinitialize };
+
+//---------------------------------------------------------------------------
+//module side of the pseudo terminal
+
+static void* responder(void* arg) {
+    uint8_t buffer[512];
+    (void)arg;
+    while (responderRunning) {
+        struct pollfd pfd = { masterFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 10) <= 0) continue;
+        ssize_t n = read(masterFd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            sleepMs(1);  //no slave open
+            continue;
+        }
+        fpsSimPort.write(&sim, buffer, (uint16_t)n, 0);
+        uint32_t reply;
+        while ((reply = fpsSimPort.read(&sim, buffer, sizeof(buffer), 0)) > 0) {
+            uint32_t written = 0;
+            while (written < reply) {
+                ssize_t w = write(masterFd, buffer + written, reply - written);
+                if (w > 0) written += (uint32_t)w;
+                else if (errno != EAGAIN && errno != EINTR) break;
+            }
+        }
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+static int compareNs(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint8_t opVerifyPassword(__FPS* stream) {
+    return verifyPassword(stream, FPS_DEFAULT_PASSWORD);
+}
+
+static uint8_t opSearch(__FPS* stream) {
+    uint8_t response = searchLibrary(stream, 1, 0, 100);
+    return response == FPS_RX_OK && stream->rxConfirmationCode == FPS_RESP_OK ? FPS_RESP_OK : FPS_RESP_NOTFOUND;
+}
+
+static uint8_t opReadSysPara(__FPS* stream) {
+    return readSysPara(stream);
+}
+
+static void measure(const char* transport, const char* command, __FPS* stream, uint8_t (*op)(__FPS*)) {
+    uint64_t* samples = (uint64_t*)malloc(iterations * sizeof(uint64_t));
+    double total = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t start = nowNs();
+        if (op(stream) != FPS_RESP_OK) {
+            fprintf(stderr, "%s %s failed\n", transport, command);
+            exit(1);
+        }
+        samples[i] = nowNs() - start;
+        total += samples[i];
+    }
+    qsort(samples, iterations, sizeof(uint64_t), compareNs);
+    BENCH_RESULT* result = &results[resultCount++];
+    result->transport = transport;
+    result->command = command;
+    result->iterations = iterations;
+    result->p50Us = samples[iterations / 2] / 1000.0;
+    result->p99Us = samples[(uint32_t)(iterations * 0.99)] / 1000.0;
+    result->meanUs = total / iterations / 1000.0;
+    printf("%-8s %-16s p50 %9.1f us  p99 %9.1f us  mean %9.1f us\n", transport, command, result->p50Us, result->p99Us, result->meanUs);
+    free(samples);
+}
+
+static void runTransport(const char* name, const __FPS_PORT* port, void* context) {
+    __FPS stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.port = port;
+    stream.portContext = context;
+    if (R30X_init(&stream, FPS_DEFAULT_PASSWORD, FPS_DEFAULT_ADDRESS) != FPS_RESP_OK) {
+        fprintf(stderr, "%s: R30X_init failed\n", name);
+        exit(1);
+    }
+    measure(name, "verifyPassword", &stream, opVerifyPassword);
+    measure(name, "searchLibrary", &stream, opSearch);
+    measure(name, "readSysPara", &stream, opReadSysPara);
+    R30X_closePort(&stream);
+}
+
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL));
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"transport\": \"%s\", \"command\": \"%s\", \"iterations\": %u, \"p50_us\": %.1f, \"p99_us\": %.1f, \"mean_us\": %.1f}%s\n",
+                results[i].transport, results[i].command, results[i].iterations, results[i].p50Us, results[i].p99Us,
+                results[i].meanUs, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    __FPS_LINUX_SERIAL serial;
+    NAIVE_SERIAL naive = { -1 };
+    pthread_t thread;
+    uint8_t probe[FPS_TEMPLATE_SIZE];
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--iterations n] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) return 2;
+    masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    if (fpsSimInit(&sim, 1000) != 0) return 1;
+    memset(&sim.timing, 0, sizeof(sim.timing));  //only the transport is measured
+    fpsSimMakeTemplate(42, probe);
+    memcpy(sim.library + 42 * FPS_TEMPLATE_SIZE, probe, FPS_TEMPLATE_SIZE);
+    sim.used[42 / 8] |= 1 << (42 % 8);
+    memcpy(sim.charBuffer[0], probe, FPS_TEMPLATE_SIZE);
+    pthread_create(&thread, NULL, responder, NULL);
+
+    printf("pseudo terminal %s, %u iterations\n", ptsname(masterFd), iterations);
+    R30X_linuxSerialInit(&serial, ptsname(masterFd));
+    serial.lowLatency = 1;
+    runTransport("poll", &fpsLinuxSerialPort, &serial);
+    runTransport("naive", &naivePort, &naive);
+
+    responderRunning = 0;
+    pthread_join(thread, NULL);
+    close(masterFd);
+    fpsSimFree(&sim);
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    return 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,524 @@
+/*************************************************************************
+ *
+ * finger print library - simulated module
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <time.h>
+#include "fps_sim.h"
+
+#define SIM_MATCH_SCORE     120
+#define SIM_FULLSEARCH_WAIT 2000000  //capture timeout of FPS_CMD_SCANANDFULLSEARCH in us, within the 3000 ms the library allows
+#define SIM_TIMEOUT_STEP    140000  //unit of the capture timeout of FPS_CMD_SCANANDRANGESEARCH in us
+
+static uint32_t templateFinger(const uint8_t* templateData) {
+    return (uint32_t)templateData[0] | ((uint32_t)templateData[1] << 8) | ((uint32_t)templateData[2] << 16) | ((uint32_t)templateData[3] << 24);
+}
+
+static uint8_t isUsed(const __FPS_SIM* sim, uint16_t location) {
+    return (sim->used[location / 8] >> (location % 8)) & 1;
+}
+
+static uint64_t lineTime(__FPS_SIM* sim, uint32_t bytes) {
+    return (uint64_t)bytes * 10000000ULL / sim->baud;  //start bit, 8 data bits, stop bit
+}
+
+static void queueFrame(__FPS_SIM* sim, uint8_t packetType, const uint8_t* payload, uint16_t payloadLength) {
+    uint16_t length = payloadLength + 2;
+    uint16_t checksum;
+    uint8_t header[9];
+    if (sim->muted) return;
+    if (sim->outHead == sim->outTail) sim->outHead = sim->outTail = sim->outFrames = 0;
+    if (sim->outHead + payloadLength + 11 > FPS_SIM_OUT_LENGTH) return;  //host does not read its replies
+    header[0] = FPS_ID_STARTCODE_H;
+    header[1] = FPS_ID_STARTCODE_L;
+    header[2] = (sim->address >> 24) & 0xff;
+    header[3] = (sim->address >> 16) & 0xff;
+    header[4] = (sim->address >> 8) & 0xff;
+    header[5] = (sim->address) & 0xff;
+    header[6] = packetType;
+    header[7] = (length >> 8) & 0xff;
+    header[8] = (length) & 0xff;
+    checksum = header[6] + header[7] + header[8];
+    for (uint16_t i = 0; i < payloadLength; i++) checksum += payload[i];
+    memcpy(sim->out + sim->outHead, header, 9);
+    memcpy(sim->out + sim->outHead + 9, payload, payloadLength);
+    sim->out[sim->outHead + 9 + payloadLength] = (checksum >> 8) & 0xff;
+    sim->out[sim->outHead + 10 + payloadLength] = (checksum) & 0xff;
+    sim->outHead += payloadLength + 11;
+    sim->bytesFromModule += payloadLength + 11;
+    sim->moduleUs += lineTime(sim, payloadLength + 11);
+    if (sim->outFrames < FPS_SIM_OUT_FRAMES) {
+        sim->outFrameEnd[sim->outFrames] = sim->outHead;
+        sim->outFrameTime[sim->outFrames++] = sim->moduleUs;
+    }
+}
+
+static void reply(__FPS_SIM* sim, uint8_t confirmationCode, const uint8_t* data, uint16_t dataLength) {
+    uint8_t payload[1 + 32];
+    payload[0] = confirmationCode;
+    if (dataLength > 0) memcpy(payload + 1, data, dataLength);
+    queueFrame(sim, FPS_ID_ACKPACKET, payload, dataLength + 1);
+}
+
+static void replyId(__FPS_SIM* sim, uint8_t confirmationCode, uint16_t id, uint16_t score) {
+    uint8_t data[4] = { (uint8_t)(id >> 8), (uint8_t)id, (uint8_t)(score >> 8), (uint8_t)score };
+    reply(sim, confirmationCode, data, 4);
+}
+
+static void sendData(__FPS_SIM* sim, const uint8_t* data, uint16_t length) {
+    for (uint16_t index = 0; index < length; index += sim->packetLength) {
+        uint16_t len = length - index < sim->packetLength ? length - index : sim->packetLength;
+        queueFrame(sim, index + len >= length ? FPS_ID_ENDDATAPACKET : FPS_ID_DATAPACKET, data + index, len);
+    }
+}
+
+static uint8_t validBuffer(uint8_t bufferId) {
+    return bufferId == 1 || bufferId == 2;
+}
+
+static uint32_t fingerOn(__FPS_SIM* sim, uint64_t us) {
+    return sim->fingerAt != NULL ? sim->fingerAt(sim->fingerArg, us) : sim->finger;
+}
+
+//---------------------------------------------------------------------------
+static void search(__FPS_SIM* sim, const uint8_t* args) {
+    uint16_t start = (uint16_t)(args[1] << 8 | args[2]);
+    uint16_t count = (uint16_t)(args[3] << 8 | args[4]);
+    if (!validBuffer(args[0]) || (uint32_t)start + count > sim->capacity) {
+        reply(sim, FPS_RESP_BADLOCATION, NULL, 0);
+        return;
+    }
+    uint32_t finger = templateFinger(sim->charBuffer[args[0] - 1]);
+    uint16_t stored = 0;
+    for (uint16_t location = start; location < start + count; location++) stored += isUsed(sim, location);
+    sim->moduleUs += sim->timing.searchBase + (uint64_t)sim->timing.searchPerTemplate * stored;  //empty locations are skipped
+    for (uint16_t location = start; location < start + count; location++) {
+        if (isUsed(sim, location) && templateFinger(sim->library + (uint32_t)location * FPS_TEMPLATE_SIZE) == finger) {
+            replyId(sim, FPS_RESP_OK, location, SIM_MATCH_SCORE);
+            return;
+        }
+    }
+    replyId(sim, FPS_RESP_NOTFOUND, 0, 0);
+}
+
+//the module captures until there is a finger or the timeout passed, then extracts into buffer 1 and searches
+static void scanAndSearch(__FPS_SIM* sim, uint64_t timeout, uint16_t start, uint16_t count) {
+    uint8_t args[5] = { 1, (uint8_t)(start >> 8), (uint8_t)start, (uint8_t)(count >> 8), (uint8_t)count };
+    uint64_t deadline = sim->moduleUs + timeout;
+    do {
+        sim->moduleUs += sim->timing.capture;
+        sim->imageFinger = fingerOn(sim, sim->moduleUs);
+    } while (sim->imageFinger == FPS_SIM_NO_FINGER && sim->moduleUs < deadline);
+    if (sim->imageFinger == FPS_SIM_NO_FINGER) {
+        replyId(sim, FPS_RESP_NOFINGER, 0, 0);
+        return;
+    }
+    sim->moduleUs += sim->timing.extract;
+    fpsSimMakeTemplate(sim->imageFinger, sim->charBuffer[0]);
+    search(sim, args);
+}
+
+static void readSystemParameters(__FPS_SIM* sim) {
+    uint8_t para[64] = { 0 };
+    uint8_t code = sim->packetLength == 32 ? 0 : sim->packetLength == 64 ? 1 : sim->packetLength == 128 ? 2 : 3;
+    para[4] = (uint8_t)(sim->capacity >> 8);
+    para[5] = (uint8_t)sim->capacity;
+    para[7] = sim->securityLevel;
+    para[8] = (uint8_t)(sim->address >> 24);
+    para[9] = (uint8_t)(sim->address >> 16);
+    para[10] = (uint8_t)(sim->address >> 8);
+    para[11] = (uint8_t)sim->address;
+    para[13] = code;
+    para[15] = (uint8_t)(sim->baud / 9600);
+    memcpy(&para[28], "SIM", 3);
+    reply(sim, FPS_RESP_OK, NULL, 0);
+    queueFrame(sim, FPS_ID_DATAPACKET, para, sizeof(para));
+    queueFrame(sim, FPS_ID_ENDDATAPACKET, NULL, 0);
+}
+
+static void command(__FPS_SIM* sim, uint8_t code, const uint8_t* args, uint16_t argLength) {
+    uint8_t data[32];
+    uint16_t location, count;
+    sim->commands++;
+    sim->muted = sim->loseEvery != 0 && sim->commands % sim->loseEvery == 0;
+    switch (code) {
+    case FPS_CMD_VERIFYPASSWORD:
+        sim->moduleUs += sim->timing.command;
+        reply(sim, argLength >= 4 && ((uint32_t)args[0] << 24 | (uint32_t)args[1] << 16 | (uint32_t)args[2] << 8 | args[3]) == sim->password
+              ? FPS_RESP_OK : FPS_RESP_WRONGPASSOWRD, NULL, 0);
+        break;
+    case FPS_CMD_SETPASSWORD:
+        sim->moduleUs += sim->timing.flashWrite;
+        if (argLength < 4) reply(sim, FPS_RESP_RECIEVEERR, NULL, 0);
+        else {
+            sim->password = (uint32_t)args[0] << 24 | (uint32_t)args[1] << 16 | (uint32_t)args[2] << 8 | args[3];
+            reply(sim, FPS_RESP_OK, NULL, 0);
+        }
+        break;
+    case FPS_CMD_SETSYSPARA:
+        sim->moduleUs += sim->timing.flashWrite;
+        if (argLength < 2 || !((args[0] == 4 && args[1] >= 1 && args[1] <= 12) || (args[0] == 5 && args[1] >= 1 && args[1] <= 5) ||
+                               (args[0] == 6 && args[1] <= 3))) {
+            reply(sim, FPS_RESP_INVALIDREG, NULL, 0);
+            break;
+        }
+        reply(sim, FPS_RESP_OK, NULL, 0);  //still at the old baudrate
+        if (sim->ignoreSysPara) break;
+        if (args[0] == 4) sim->baud = 9600u * args[1];
+        else if (args[0] == 5) sim->securityLevel = args[1];
+        else sim->packetLength = (uint16_t)(32 << args[1]);
+        break;
+    case FPS_CMD_READALL_SYSPARA:
+        sim->moduleUs += sim->timing.command;
+        readSystemParameters(sim);
+        break;
+    case FPS_CMD_TEMPLATECOUNT:
+        sim->moduleUs += sim->timing.command;
+        count = 0;
+        for (location = 0; location < sim->capacity; location++) count += isUsed(sim, location);
+        data[0] = (uint8_t)(count >> 8);
+        data[1] = (uint8_t)count;
+        reply(sim, FPS_RESP_OK, data, 2);
+        break;
+    case FPS_CMD_READINDEXTABLE:
+        sim->moduleUs += sim->timing.command;
+        memset(data, 0, FPS_INDEX_TABLE_LENGTH);
+        if (argLength >= 1 && args[0] < 4) {
+            uint32_t first = (uint32_t)args[0] * FPS_INDEX_TABLE_PAGE_SIZE / 8;
+            for (uint16_t i = 0; i < FPS_INDEX_TABLE_LENGTH && first + i < (sim->capacity + 7u) / 8; i++) data[i] = sim->used[first + i];
+            reply(sim, FPS_RESP_OK, data, FPS_INDEX_TABLE_LENGTH);
+        }
+        else reply(sim, FPS_RESP_INVALIDREG, NULL, 0);
+        break;
+    case FPS_CMD_SCANFINGER:
+        sim->moduleUs += sim->timing.capture;
+        sim->imageFinger = fingerOn(sim, sim->moduleUs);
+        reply(sim, sim->imageFinger == FPS_SIM_NO_FINGER ? FPS_RESP_NOFINGER : FPS_RESP_OK, NULL, 0);
+        break;
+    case FPS_CMD_IMAGETOCHARACTER:
+        sim->moduleUs += sim->timing.extract;
+        if (argLength < 1 || !validBuffer(args[0])) reply(sim, FPS_RESP_INVALIDREG, NULL, 0);
+        else if (sim->imageFinger == FPS_SIM_NO_FINGER) reply(sim, FPS_RESP_FEATUREFAIL, NULL, 0);
+        else {
+            fpsSimMakeTemplate(sim->imageFinger, sim->charBuffer[args[0] - 1]);
+            reply(sim, FPS_RESP_OK, NULL, 0);
+        }
+        break;
+    case FPS_CMD_GENERATETEMPLATE:
+        sim->moduleUs += sim->timing.merge;
+        if (templateFinger(sim->charBuffer[0]) != templateFinger(sim->charBuffer[1])) reply(sim, FPS_RESP_ENROLLMISMATCH, NULL, 0);
+        else reply(sim, FPS_RESP_OK, NULL, 0);
+        break;
+    case FPS_CMD_MATCHTEMPLATES:
+        sim->moduleUs += sim->timing.match;
+        data[0] = 0;
+        data[1] = templateFinger(sim->charBuffer[0]) == templateFinger(sim->charBuffer[1]) ? SIM_MATCH_SCORE : 0;
+        reply(sim, data[1] ? FPS_RESP_OK : FPS_RESP_DONOTMATCH, data, 2);
+        break;
+    case FPS_CMD_SEARCHLIBRARY:
+    case FPS_CMD_HISPEEDSEARCH:
+        if (argLength < 5) reply(sim, FPS_RESP_RECIEVEERR, NULL, 0);
+        else search(sim, args);
+        break;
+    case FPS_CMD_SCANANDRANGESEARCH:
+        if (argLength < 5) reply(sim, FPS_RESP_RECIEVEERR, NULL, 0);
+        else scanAndSearch(sim, (uint64_t)args[0] * SIM_TIMEOUT_STEP, (uint16_t)(args[1] << 8 | args[2]), (uint16_t)(args[3] << 8 | args[4]));
+        break;
+    case FPS_CMD_SCANANDFULLSEARCH:
+        scanAndSearch(sim, SIM_FULLSEARCH_WAIT, 0, sim->capacity);
+        break;
+    case FPS_CMD_STORETEMPLATE:
+    case FPS_CMD_LOADTEMPLATE:
+        location = argLength >= 3 ? (uint16_t)(args[1] << 8 | args[2]) : 0xFFFF;
+        if (argLength < 3 || !validBuffer(args[0]) || location >= sim->capacity) {
+            reply(sim, FPS_RESP_BADLOCATION, NULL, 0);
+        }
+        else if (code == FPS_CMD_STORETEMPLATE) {
+            sim->moduleUs += sim->timing.flashWrite;
+            memcpy(sim->library + (uint32_t)location * FPS_TEMPLATE_SIZE, sim->charBuffer[args[0] - 1], FPS_TEMPLATE_SIZE);
+            sim->used[location / 8] |= (uint8_t)(1 << (location % 8));
+            sim->flashWrites++;
+            reply(sim, FPS_RESP_OK, NULL, 0);
+        }
+        else {
+            sim->moduleUs += sim->timing.flashRead;
+            if (!isUsed(sim, location)) reply(sim, FPS_RESP_INVALIDTEMPLATE, NULL, 0);
+            else {
+                memcpy(sim->charBuffer[args[0] - 1], sim->library + (uint32_t)location * FPS_TEMPLATE_SIZE, FPS_TEMPLATE_SIZE);
+                reply(sim, FPS_RESP_OK, NULL, 0);
+            }
+        }
+        break;
+    case FPS_CMD_DELETETEMPLATE:
+        location = argLength >= 4 ? (uint16_t)(args[0] << 8 | args[1]) : 0xFFFF;
+        count = argLength >= 4 ? (uint16_t)(args[2] << 8 | args[3]) : 0;
+        if ((uint32_t)location + count > sim->capacity) {
+            reply(sim, FPS_RESP_TEMPLATEDELETEFAIL, NULL, 0);
+            break;
+        }
+        sim->moduleUs += (uint64_t)sim->timing.flashErase * count;
+        for (uint16_t i = 0; i < count; i++) sim->used[(location + i) / 8] &= (uint8_t)~(1 << ((location + i) % 8));
+        reply(sim, FPS_RESP_OK, NULL, 0);
+        break;
+    case FPS_CMD_CLEARLIBRARY:
+        sim->moduleUs += (uint64_t)sim->timing.flashErase * sim->capacity;
+        memset(sim->used, 0, (sim->capacity + 7u) / 8);
+        reply(sim, FPS_RESP_OK, NULL, 0);
+        break;
+    case FPS_CMD_IMPORTTEMPLATE:
+        sim->moduleUs += sim->timing.command;
+        if (argLength < 1 || !validBuffer(args[0])) reply(sim, FPS_RESP_INVALIDREG, NULL, 0);
+        else {
+            sim->downloadBuffer = (int8_t)(args[0] - 1);
+            sim->downloadOffset = 0;
+            reply(sim, FPS_RESP_OK, NULL, 0);
+        }
+        break;
+    case FPS_CMD_EXPORTTEMPLATE:
+        sim->moduleUs += sim->timing.command;
+        if (argLength < 1 || !validBuffer(args[0])) reply(sim, FPS_RESP_INVALIDREG, NULL, 0);
+        else {
+            reply(sim, FPS_RESP_OK, NULL, 0);
+            sendData(sim, sim->charBuffer[args[0] - 1], FPS_TEMPLATE_SIZE);
+        }
+        break;
+    case FPS_CMD_EXPORTIMAGE: {
+        uint8_t image[FPS_IMAGE_SIZE];  //a pattern of the finger in the image buffer
+        sim->moduleUs += sim->timing.command;
+        for (uint32_t i = 0; i < FPS_IMAGE_SIZE; i++) image[i] = (uint8_t)(sim->imageFinger + i);
+        reply(sim, FPS_RESP_OK, NULL, 0);
+        sendData(sim, image, FPS_IMAGE_SIZE);
+        break;
+    }
+    case FPS_CMD_READNOTEPAD:
+        sim->moduleUs += sim->timing.command;
+        if (argLength < 1 || args[0] >= FPS_NOTEPAD_PAGES) reply(sim, FPS_RESP_WRONGNOTEPADPAGE, NULL, 0);
+        else reply(sim, FPS_RESP_OK, sim->notepad[args[0]], FPS_NOTEPAD_PAGE_SIZE);
+        break;
+    case FPS_CMD_WRITENOTEPAD:
+        sim->moduleUs += sim->timing.flashWrite;
+        if (argLength < 1 + FPS_NOTEPAD_PAGE_SIZE || args[0] >= FPS_NOTEPAD_PAGES) reply(sim, FPS_RESP_WRONGNOTEPADPAGE, NULL, 0);
+        else {
+            memcpy(sim->notepad[args[0]], args + 1, FPS_NOTEPAD_PAGE_SIZE);
+            sim->flashWrites++;
+            reply(sim, FPS_RESP_OK, NULL, 0);
+        }
+        break;
+    case FPS_CMD_GETRANDOMCODE:
+        sim->moduleUs += sim->timing.command;
+        for (uint8_t i = 0; i < 4; i++) data[i] = (uint8_t)rand();
+        reply(sim, FPS_RESP_OK, data, 4);
+        break;
+    default:
+        sim->moduleUs += sim->timing.command;
+        reply(sim, FPS_RESP_NODEFINITIONERR, NULL, 0);
+        break;
+    }
+}
+
+static void frameReceived(__FPS_SIM* sim) {
+    uint16_t length = (uint16_t)(sim->frame[7] << 8 | sim->frame[8]);
+    uint32_t address = ((uint32_t)sim->frame[2] << 24) | ((uint32_t)sim->frame[3] << 16) | ((uint32_t)sim->frame[4] << 8) | sim->frame[5];
+    uint16_t checksum = 0;
+    if (address != sim->address) return;  //for another module
+    for (uint16_t i = 6; i < 7 + length; i++) checksum += sim->frame[i];
+    if (checksum != (uint16_t)(sim->frame[7 + length] << 8 | sim->frame[8 + length])) {
+        reply(sim, FPS_RESP_RECIEVEERR, NULL, 0);
+        return;
+    }
+    if (sim->moduleUs < sim->lineUs) sim->moduleUs = sim->lineUs;  //idle until the frame is complete
+    if (sim->frame[6] == FPS_ID_COMMANDPACKET) {
+        command(sim, sim->frame[9], sim->frame + 10, length - 3);
+    }
+    else if ((sim->frame[6] == FPS_ID_DATAPACKET || sim->frame[6] == FPS_ID_ENDDATAPACKET) && sim->downloadBuffer >= 0) {
+        uint16_t dataLength = length - 2;
+        if (sim->downloadOffset + dataLength > FPS_TEMPLATE_SIZE) dataLength = FPS_TEMPLATE_SIZE - sim->downloadOffset;
+        memcpy(sim->charBuffer[sim->downloadBuffer] + sim->downloadOffset, sim->frame + 9, dataLength);
+        sim->downloadOffset += dataLength;
+        if (sim->frame[6] == FPS_ID_ENDDATAPACKET) sim->downloadBuffer = -1;
+    }
+}
+
+static void receiveByte(__FPS_SIM* sim, uint8_t byte) {
+    sim->frame[sim->frameLength++] = byte;
+    if (sim->frameLength == 1 && byte != FPS_ID_STARTCODE_H) sim->frameLength = 0;
+    else if (sim->frameLength == 2 && byte != FPS_ID_STARTCODE_L) sim->frameLength = byte == FPS_ID_STARTCODE_H ? 1 : 0;
+    else if (sim->frameLength >= 9) {
+        uint16_t length = (uint16_t)(sim->frame[7] << 8 | sim->frame[8]);
+        if (length < 2 || 9u + length > FPS_SIM_FRAME_LENGTH) sim->frameLength = 0;
+        else if (sim->frameLength == 9 + length) {
+            frameReceived(sim);
+            sim->frameLength = 0;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static uint64_t wallNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+//real time mode: the host idled in wall time, move the virtual clock forward by the same amount
+static void realTimeSync(__FPS_SIM* sim) {
+    if (sim->realTimePercent == 0) return;
+    uint64_t now = wallNs();
+    if (sim->wallBaseNs == 0) {
+        sim->wallBaseNs = now;
+        sim->wallBaseClockUs = sim->clockUs;
+        return;
+    }
+    uint64_t clock = sim->wallBaseClockUs + (now - sim->wallBaseNs) / 10 / sim->realTimePercent;
+    if (sim->clockUs < clock) sim->clockUs = clock;
+}
+
+//real time mode: sleep until the wall clock reaches the virtual clock
+static void realTimeWait(__FPS_SIM* sim) {
+    if (sim->realTimePercent == 0) return;
+    uint64_t target = sim->wallBaseNs + (sim->clockUs - sim->wallBaseClockUs) * 10 * sim->realTimePercent;
+    uint64_t now = wallNs();
+    if (target <= now) return;
+    struct timespec ts = { (time_t)((target - now) / 1000000000ULL), (long)((target - now) % 1000000000ULL) };
+    nanosleep(&ts, NULL);
+}
+
+static uint32_t simRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    __FPS_SIM* sim = (__FPS_SIM*)context;
+    uint32_t available = sim->outHead - sim->outTail;
+    uint32_t count = BytesToRead < available ? BytesToRead : available;
+    (void)timeout;
+    memcpy(pBuf, sim->out + sim->outTail, count);
+    sim->outTail += count;
+    if (count == 0) {
+        if (sim->realTimePercent == 0) sim->clockUs += 1000;  //the host waits 1 ms before it reads again
+        return 0;
+    }
+    uint64_t arrival = sim->moduleUs;  //frames beyond FPS_SIM_OUT_FRAMES
+    for (uint16_t i = 0; i < sim->outFrames; i++) {
+        if (sim->outFrameEnd[i] >= sim->outTail) {
+            arrival = sim->outFrameTime[i];
+            break;
+        }
+    }
+    if (sim->clockUs < arrival) sim->clockUs = arrival;
+    sim->hostRead = 1;
+    realTimeWait(sim);
+    return count;
+}
+
+static uint32_t simWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    __FPS_SIM* sim = (__FPS_SIM*)context;
+    (void)timeout;
+    realTimeSync(sim);
+    sim->bytesToModule += BytesToWrite;
+    if (sim->hostRead) sim->clockUs += sim->timing.hostTurnaround;
+    sim->hostRead = 0;
+    if (sim->lineUs < sim->clockUs) sim->lineUs = sim->clockUs;
+    sim->lineUs += lineTime(sim, BytesToWrite);
+    sim->clockUs = sim->lineUs;  //the write returns when the bytes are sent
+    if (sim->hostBaud != sim->baud) return BytesToWrite;  //garbled, the module sees no frame
+    for (uint16_t i = 0; i < BytesToWrite; i++) receiveByte(sim, pBuf[i]);
+    return BytesToWrite;
+}
+
+static uint8_t simInitialize(void* context, uint32_t baud) {
+    __FPS_SIM* sim = (__FPS_SIM*)context;
+    sim->hostBaud = baud;  //opening works at any baudrate, talking only at the one of the module
+    return 0;
+}
+
+static uint8_t simDeinitialize(void* context) {
+    (void)context;
+    return 0;
+}
+
+const __FPS_PORT fpsSimPort = { simRead, simWrite, simInitialize, simDeinitialize };
+
+/*
+*   @brief: create an empty module with the timing of an R307 at 57600 baud
+*   @parameter: simulator
+*   @parameter: library locations
+*   @return: 0 on success, -1 if out of memory
+*
+*/
+int8_t fpsSimInit(__FPS_SIM* sim, uint16_t capacity) {
+    memset(sim, 0, sizeof(__FPS_SIM));
+    sim->library = (uint8_t*)malloc((size_t)capacity * FPS_TEMPLATE_SIZE);
+    sim->used = (uint8_t*)calloc((capacity + 7u) / 8 + FPS_INDEX_TABLE_LENGTH, 1);
+    if (sim->library == NULL || sim->used == NULL) {
+        fpsSimFree(sim);
+        return -1;
+    }
+    sim->address = FPS_DEFAULT_ADDRESS;
+    sim->password = FPS_DEFAULT_PASSWORD;
+    sim->baud = FPS_DEFAULT_BAUDRATE;
+    sim->hostBaud = FPS_DEFAULT_BAUDRATE;
+    sim->securityLevel = FPS_DEFAULT_SECURITY_LEVEL;
+    sim->capacity = capacity;
+    sim->packetLength = 128;
+    sim->finger = FPS_SIM_NO_FINGER;
+    sim->imageFinger = FPS_SIM_NO_FINGER;
+    sim->downloadBuffer = -1;
+
+    sim->timing.capture = 150000;
+    sim->timing.extract = 100000;
+    sim->timing.merge = 50000;
+    sim->timing.match = 10000;
+    sim->timing.searchBase = 5000;
+    sim->timing.searchPerTemplate = 300;
+    sim->timing.flashWrite = 25000;
+    sim->timing.flashRead = 5000;
+    sim->timing.flashErase = 2000;
+    sim->timing.command = 500;
+    return 0;
+}
+
+void fpsSimFree(__FPS_SIM* sim) {
+    free(sim->library);
+    free(sim->used);
+    sim->library = NULL;
+    sim->used = NULL;
+}
+
+void fpsSimPlaceFinger(__FPS_SIM* sim, uint32_t finger) {
+    sim->finger = finger;
+}
+
+void fpsSimFingerSchedule(__FPS_SIM* sim, uint32_t (*fingerAt)(void* arg, uint64_t us), void* arg) {
+    sim->fingerAt = fingerAt;
+    sim->fingerArg = arg;
+}
+
+void fpsSimMakeTemplate(uint32_t finger, uint8_t* templateData) {
+    uint32_t state = finger * 2654435761UL + 1;
+    templateData[0] = (uint8_t)finger;
+    templateData[1] = (uint8_t)(finger >> 8);
+    templateData[2] = (uint8_t)(finger >> 16);
+    templateData[3] = (uint8_t)(finger >> 24);
+    for (uint16_t i = 4; i < FPS_TEMPLATE_SIZE; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        templateData[i] = (uint8_t)state;
+    }
+}
+
+void fpsSimAttach(__FPS_SIM* sim, __FPS* stream) {
+    resetParameters(stream);
+    stream->port = &fpsSimPort;
+    stream->portContext = sim;
+    stream->deviceAddress = sim->address;
+    stream->deviceBaudrate = sim->baud;
+    sim->hostBaud = sim->baud;  //as if the port was opened
+    stream->dataPacketLength = sim->packetLength;
+    stream->templateCount = sim->capacity;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,107 @@
+/*************************************************************************
+ *
+ * finger print library - simulated module
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * A port that answers commands like a module with a template library, so
+ * whole command sequences can be benchmarked without hardware. Time is
+ * virtual: every byte on the line and every command advance clockUs by
+ * the cost in the timing table, the port itself never waits. With
+ * realTimePercent set the port also sleeps, so other threads see the
+ * module busy like a real one (100: real time, 10: ten times faster).
+ *
+ * A template is FPS_TEMPLATE_SIZE bytes whose first four bytes (little
+ * endian) are the ID of the finger it was made from; two templates match
+ * when these IDs are equal. The finger on the sensor is set with
+ * fpsSimPlaceFinger, or follows a schedule over virtual time given with
+ * fpsSimFingerSchedule. The fused scan-and-search commands capture until
+ * a finger is on the sensor or their timeout passes, like the module.
+ *
+ * FPS_CMD_SETSYSPARA and FPS_CMD_SETPASSWORD change the parameters that
+ * readSysPara reports. After a baudrate change the module only understands
+ * a host port opened with the new baudrate (hostBaud). loseEvery and
+ * ignoreSysPara inject the faults a configuration rollout has to survive.
+ *
+ **************************************************************************/
+#ifndef FPS_SIM_H
+#define FPS_SIM_H
+#include "R30X_FPS.h"
+
+#define FPS_SIM_NO_FINGER           0xFFFFFFFFUL
+#define FPS_SIM_OUT_LENGTH          (48 * 1024)  //reply bytes not read yet, an image with its packet headers fits
+#define FPS_SIM_FRAME_LENGTH        (11 + 256)
+#define FPS_SIM_OUT_FRAMES          512  //reply frames not read yet whose arrival time is kept
+
+//cost of the module operations in microseconds
+typedef struct {
+	  uint32_t capture;            //generateImage
+	  uint32_t extract;            //generateCharacter
+	  uint32_t merge;              //generateTemplate
+	  uint32_t match;              //matchTemplates
+	  uint32_t searchBase;         //searchLibrary, plus searchPerTemplate for every stored template in the range
+	  uint32_t searchPerTemplate;
+	  uint32_t flashWrite;         //saveTemplate
+	  uint32_t flashRead;          //loadTemplate
+	  uint32_t flashErase;         //deleteTemplate, per location
+	  uint32_t command;            //any other command
+	  uint32_t hostTurnaround;     //from reading a reply to the next byte on the line (driver, USB latency timer), 0 by default
+}__FPS_SIM_TIMING;
+
+typedef struct {
+	  uint32_t address;
+	  uint32_t password;
+	  uint32_t baud;  //time of the bytes on the line
+	  uint32_t hostBaud;  //baudrate the host port was opened with, bytes are garbled when it differs from baud
+	  uint8_t securityLevel;
+	  uint16_t capacity;  //library locations
+	  uint16_t packetLength;  //data packet length, 32, 64, 128 or 256
+	  __FPS_SIM_TIMING timing;
+
+	  uint8_t* library;  //capacity * FPS_TEMPLATE_SIZE bytes
+	  uint8_t* used;  //one bit per location like the index table
+	  uint8_t charBuffer[2][FPS_TEMPLATE_SIZE];
+	  uint8_t notepad[FPS_NOTEPAD_PAGES][FPS_NOTEPAD_PAGE_SIZE];
+	  uint32_t finger;  //finger on the sensor or FPS_SIM_NO_FINGER
+	  uint32_t imageFinger;  //finger in the image buffer
+	  uint32_t (*fingerAt) (void *arg, uint64_t us);  //finger on the sensor at a virtual time, replaces finger when set
+	  void* fingerArg;
+
+	  uint8_t frame[FPS_SIM_FRAME_LENGTH];  //frame from the host being assembled
+	  uint16_t frameLength;
+	  uint8_t out[FPS_SIM_OUT_LENGTH];  //reply bytes for the host
+	  uint32_t outHead;
+	  uint32_t outTail;
+	  uint32_t outFrameEnd[FPS_SIM_OUT_FRAMES];  //end offset in out and arrival time at the host of every reply frame
+	  uint64_t outFrameTime[FPS_SIM_OUT_FRAMES];
+	  uint16_t outFrames;
+	  int8_t downloadBuffer;  //character buffer receiving data packets, -1 if none
+	  uint16_t downloadOffset;
+
+	  uint64_t clockUs;  //virtual time of the host
+	  uint64_t lineUs;  //the line to the module is busy until
+	  uint64_t moduleUs;  //the module is busy until
+	  uint8_t hostRead;  //the host has read reply bytes since its last write
+	  uint32_t realTimePercent;  //0: virtual time only, otherwise wall time per virtual time in percent
+	  uint64_t wallBaseNs;  //wall clock at virtual time wallBaseClockUs, set on first use
+	  uint64_t wallBaseClockUs;
+	  uint64_t commands;
+	  uint64_t bytesToModule;
+	  uint64_t bytesFromModule;
+	  uint64_t flashWrites;
+	  uint32_t loseEvery;  //the reply of every n-th command is lost on the line, the command is executed; 0 never
+	  uint8_t ignoreSysPara;  //acknowledge FPS_CMD_SETSYSPARA without changing anything, like a firmware that does not store it
+	  uint8_t muted;  //the reply of the current command is lost
+}__FPS_SIM;
+
+extern const __FPS_PORT fpsSimPort;
+
+int8_t	fpsSimInit (__FPS_SIM *sim, uint16_t capacity); //0 on success, -1 if out of memory
+void	fpsSimFree (__FPS_SIM *sim);
+void	fpsSimPlaceFinger (__FPS_SIM *sim, uint32_t finger); //FPS_SIM_NO_FINGER to lift it
+void	fpsSimFingerSchedule (__FPS_SIM *sim, uint32_t (*fingerAt)(void *arg, uint64_t us), void *arg); //NULL to use fpsSimPlaceFinger again
+void	fpsSimMakeTemplate (uint32_t finger, uint8_t *templateData); //template like the module generates it
+void	fpsSimAttach (__FPS_SIM *sim, __FPS *stream); //use the simulator as port of the stream, with templateCount and packet length set
+#endif
+
+/********************************END OF FILE*****************************************************/
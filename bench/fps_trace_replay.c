@@ -0,0 +1,118 @@
+/*************************************************************************
+ *
+ * finger print library - trace replay through the parser
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Feeds a trace recorded with R30X_traceStart through receivePacket and
+ * receiveDataPacket, reports parser throughput and every frame that fails.
+ * With --realtime the module bytes arrive at their recorded time, so
+ * timeouts seen in the field show up again.
+ *
+ * usage: fps_trace_replay [--realtime] [--repeat N] [--quiet] trace.bin
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "R30X_trace.h"
+
+#define REPLAY_RESULT_CODES     (FPS_RX_WRONG_CHECKSUM - FPS_RX_BADPACKET + 2)  //FPS_RX_OK and the error codes
+
+static const char* rxNames[REPLAY_RESULT_CODES] = { "ok", "bad packet", "wrong address", "wrong response", "timeout", "wrong checksum" };
+
+//slot of an FPS_RX_* code in counts and rxNames, REPLAY_RESULT_CODES if it is none
+static int resultIndex(uint8_t response) {
+    if (response == FPS_RX_OK) return 0;
+    if (response >= FPS_RX_BADPACKET && response <= FPS_RX_WRONG_CHECKSUM) return response - FPS_RX_BADPACKET + 1;
+    return REPLAY_RESULT_CODES;
+}
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+//commands whose acknowledge is followed by data packets
+static uint8_t isMultiPacket(uint8_t command) {
+    return command == FPS_CMD_READALL_SYSPARA || command == FPS_CMD_EXPORTIMAGE || command == FPS_CMD_EXPORTTEMPLATE;
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    uint8_t realTime = 0, quiet = 0;
+    uint32_t repeat = 1;
+    uint64_t frames = 0, commands = 0, noResponse = 0, counts[REPLAY_RESULT_CODES] = { 0 };
+    uint64_t parseNs = 0, rxBytes = 0;
+    static uint8_t scratch[65536];
+    __FPS_TRACE_REPLAY replay;
+    __FPS stream = { 0 };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) realTime = 1;
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = 1;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = (uint32_t)atoi(argv[++i]);
+        else if (path == NULL && argv[i][0] != '-') path = argv[i];
+        else path = NULL, i = argc;
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [--realtime] [--repeat N] [--quiet] trace.bin\n", argv[0]);
+        return 2;
+    }
+    int8_t opened = R30X_replayOpen(&replay, path, realTime);
+    if (opened != 0) {
+        fprintf(stderr, "%s: %s\n", path, opened == -1 ? "can not open" : "not a trace file");
+        return 1;
+    }
+    resetParameters(&stream);
+    stream.port = &fpsTraceReplayPort;
+    stream.portContext = &replay;
+
+    for (uint32_t r = 0; r < repeat; r++) {
+        uint8_t command;
+        uint32_t address;
+        R30X_replayRewind(&replay);
+        while (R30X_replayNextCommand(&replay, &command, &address)) {
+            commands++;
+            if (!R30X_replayRxPending(&replay)) {
+                noResponse++;
+                continue;
+            }
+            stream.deviceAddress = address;
+            uint64_t start = nowNs();
+            uint8_t response = receivePacket(&stream, stream.commandTimeout);
+            frames++;
+            if (response == FPS_RX_OK && stream.rxConfirmationCode == FPS_RESP_OK && isMultiPacket(command)) {
+                uint16_t length;
+                do {
+                    response = receiveDataPacket(&stream, scratch, &length, stream.commandTimeout);
+                    frames++;
+                } while (response == FPS_RX_OK && stream.rxPacketType == FPS_ID_DATAPACKET);
+            }
+            parseNs += nowNs() - start;
+            int slot = resultIndex(response);
+            if (slot < REPLAY_RESULT_CODES) counts[slot]++;
+            if (response != FPS_RX_OK && !quiet && r == 0) {
+                printf("command 0x%02X at trace offset %zu: %s\n", command, replay.tx.offset, slot < REPLAY_RESULT_CODES ? rxNames[slot] : "?");
+            }
+        }
+        rxBytes += replay.rxBytes;
+    }
+    printf("commands        %llu\n", (unsigned long long)commands);
+    printf("frames parsed   %llu\n", (unsigned long long)frames);
+    printf("no response     %llu\n", (unsigned long long)noResponse);
+    for (int i = 0; i < REPLAY_RESULT_CODES; i++) {
+        printf("%-15s %llu\n", rxNames[i], (unsigned long long)counts[i]);
+    }
+    printf("module bytes    %llu\n", (unsigned long long)rxBytes);
+    if (parseNs > 0) {
+        printf("parse time      %.3f ms\n", parseNs / 1e6);
+        printf("throughput      %.0f bytes/s, %.1f ns/frame\n", rxBytes * 1e9 / parseNs, frames ? (double)parseNs / frames : 0.0);
+    }
+    R30X_replayClose(&replay);
+    return 0;
+}
+
+/********************************END OF FILE*****************************************************/
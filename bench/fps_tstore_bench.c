@@ -0,0 +1,216 @@
+/*************************************************************************
+ *
+ * finger print library - template store benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * A fleet of simulated doors with people enrolled on several doors each is
+ * backed up into an R30X_tstore file, in virtual time:
+ *
+ *  - first sync: every used location is exported, equal templates of
+ *    different doors are stored once
+ *  - second sync: nothing changed, nothing is exported
+ *  - after some enrollments and deletions on every door: only the new
+ *    locations are exported
+ *  - after R30X_tstoreInvalidate on every door: everything again, what a
+ *    backup without the store costs every time
+ *
+ * Reports exports, bus bytes and time on the line for every pass, the
+ * distinct templates against the references and the size of the file.
+ * Every location is compared with the store after every pass, after
+ * reopening the file and after restoring a door to a blank module.
+ *
+ * usage: fps_tstore_bench [--doors n] [--people n] [--enrolled n] [--store file] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "fps_sim.h"
+#include "R30X_tstore.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          200
+#define BENCH_FINGER_BASE       1000  //finger of person i is BENCH_FINGER_BASE + i
+#define BENCH_NEW_PEOPLE        5  //enrolled on every door before the third pass
+#define BENCH_DELETED           3  //deleted on every door before the third pass
+#define BENCH_PASSES            4
+
+typedef struct {
+    const char* name;
+    uint64_t downloads;
+    uint64_t skipped;
+    uint64_t busBytes;
+    double seconds;  //on the line, all doors one after the other
+    uint32_t wrong;  //locations whose stored template differs from the door
+}BENCH_RESULT;
+
+static BENCH_RESULT results[BENCH_PASSES];
+static __FPS_SIM* sims;
+static __FPS* streams;
+static uint32_t doors = 20;
+static uint32_t people = 1000;
+static uint16_t enrolled = 150;
+static const char* storePath = "fps_tstore_bench.tst";
+static uint32_t rngState = 2023;
+
+static uint32_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint8_t isUsed(const __FPS_SIM* sim, uint16_t location) {
+    return (sim->used[location / 8] >> (location % 8)) & 1;
+}
+
+static void enroll(__FPS_SIM* sim, uint16_t location, uint32_t person) {
+    fpsSimMakeTemplate(BENCH_FINGER_BASE + person, sim->library + (uint32_t)location * FPS_TEMPLATE_SIZE);
+    sim->used[location / 8] |= (uint8_t)(1 << (location % 8));
+}
+
+//locations of a door that differ from the store
+static uint32_t compare(__FPS_TSTORE* store, uint32_t door, const __FPS_SIM* sim) {
+    uint8_t templateData[FPS_TEMPLATE_SIZE];
+    uint32_t wrong = 0;
+    for (uint16_t location = 1; location < BENCH_CAPACITY; location++) {
+        int8_t found = R30X_tstoreGet(store, door, location, templateData) == 0;
+        if (found != isUsed(sim, location)) wrong++;
+        else if (found && memcmp(templateData, sim->library + (uint32_t)location * FPS_TEMPLATE_SIZE, FPS_TEMPLATE_SIZE) != 0) wrong++;
+    }
+    return wrong;
+}
+
+static void pass(__FPS_TSTORE* store, BENCH_RESULT* result, const char* name) {
+    uint64_t downloads = store->stats.downloads, skipped = store->stats.skipped;
+    uint64_t bytes = 0, us = 0;
+    result->name = name;
+    for (uint32_t i = 0; i < doors; i++) {
+        uint64_t bytesBefore = sims[i].bytesToModule + sims[i].bytesFromModule, usBefore = sims[i].clockUs;
+        uint8_t response = R30X_tstoreSync(store, &streams[i], i);
+        if (response != FPS_RESP_OK) {
+            printf("sync of door %u failed: 0x%02X\n", i, response);
+            result->wrong++;
+        }
+        bytes += sims[i].bytesToModule + sims[i].bytesFromModule - bytesBefore;
+        us += sims[i].clockUs - usBefore;
+        result->wrong += compare(store, i, &sims[i]);
+    }
+    result->downloads = store->stats.downloads - downloads;
+    result->skipped = store->stats.skipped - skipped;
+    result->busBytes = bytes;
+    result->seconds = us / 1e6;
+    printf("%-12s exported %6llu  skipped %6llu  %9.1f kB on the bus  %7.1f s on the line  wrong %u\n", name,
+           (unsigned long long)result->downloads, (unsigned long long)result->skipped, bytes / 1000.0, result->seconds, result->wrong);
+}
+
+static int writeJson(const char* path, const __FPS_TSTORE* store) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"doors\": %u,\n  \"people\": %u,\n"
+            "  \"enrolled\": %u,\n  \"templates\": %llu,\n  \"references\": %llu,\n  \"file_bytes\": %llu,\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL), doors, people, enrolled, (unsigned long long)store->stats.templates,
+            (unsigned long long)store->stats.references, (unsigned long long)store->length);
+    for (int i = 0; i < BENCH_PASSES; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"exported\": %llu, \"skipped\": %llu, \"bus_bytes\": %llu, \"seconds\": %.1f, \"wrong\": %u}%s\n",
+                results[i].name, (unsigned long long)results[i].downloads, (unsigned long long)results[i].skipped,
+                (unsigned long long)results[i].busBytes, results[i].seconds, results[i].wrong, i + 1 < BENCH_PASSES ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    __FPS_TSTORE store;
+    uint32_t wrong = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--doors") == 0 && i + 1 < argc) doors = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--people") == 0 && i + 1 < argc) people = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--enrolled") == 0 && i + 1 < argc) enrolled = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) storePath = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--doors n] [--people n] [--enrolled n] [--store file] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (doors == 0 || people == 0 || enrolled == 0 || enrolled + BENCH_NEW_PEOPLE >= BENCH_CAPACITY) return 2;
+
+    sims = (__FPS_SIM*)calloc(doors, sizeof(__FPS_SIM));
+    streams = (__FPS*)calloc(doors, sizeof(__FPS));
+    if (sims == NULL || streams == NULL) return 1;
+    for (uint32_t i = 0; i < doors; i++) {
+        if (fpsSimInit(&sims[i], BENCH_CAPACITY) != 0) return 1;
+        fpsSimAttach(&sims[i], &streams[i]);
+        for (uint16_t location = 1; location <= enrolled; location++) enroll(&sims[i], location, nextRandom() % people);
+    }
+    unlink(storePath);
+    if (R30X_tstoreOpen(&store, storePath) != 0) {
+        perror(storePath);
+        return 1;
+    }
+
+    printf("%u doors, %u people, %u templates on every door\n", doors, people, enrolled);
+    pass(&store, &results[0], "first");
+    pass(&store, &results[1], "unchanged");
+    for (uint32_t i = 0; i < doors; i++) {
+        for (uint16_t n = 0; n < BENCH_NEW_PEOPLE; n++) enroll(&sims[i], (uint16_t)(enrolled + 1 + n), nextRandom() % people);
+        for (uint16_t n = 0; n < BENCH_DELETED; n++) {
+            uint16_t location = (uint16_t)(1 + nextRandom() % enrolled);
+            sims[i].used[location / 8] &= (uint8_t)~(1 << (location % 8));
+        }
+    }
+    pass(&store, &results[2], "changed");
+    for (uint32_t i = 0; i < doors; i++) {
+        if (R30X_tstoreInvalidate(&store, &streams[i]) != FPS_RESP_OK) wrong++;
+    }
+    pass(&store, &results[3], "invalidated");
+    printf("%llu templates stored for %llu locations (%.2f references per template), store file %.1f kB, %.1f kB without deduplication\n",
+           (unsigned long long)store.stats.templates, (unsigned long long)store.stats.references,
+           (double)store.stats.references / store.stats.templates, store.length / 1000.0,
+           store.stats.references * (double)(4 + 8 + FPS_TEMPLATE_SIZE) / 1000.0);
+    printf("unchanged fleet: %.2f%% of the bus bytes of a full export, changed fleet: %.2f%%\n",
+           100.0 * results[1].busBytes / results[3].busBytes, 100.0 * results[2].busBytes / results[3].busBytes);
+    if (jsonPath != NULL && writeJson(jsonPath, &store) != 0) return 1;
+
+    //the indexes rebuilt from the file must give the same templates
+    uint64_t templates = store.stats.templates;
+    if (R30X_tstoreFlush(&store) != 0) wrong++;
+    R30X_tstoreClose(&store);
+    if (R30X_tstoreOpen(&store, storePath) != 0) {
+        perror(storePath);
+        return 1;
+    }
+    if (store.stats.templates != templates) wrong++;
+    for (uint32_t i = 0; i < doors; i++) wrong += compare(&store, i, &sims[i]);
+
+    //a blank module gets the library of door 0
+    __FPS_SIM blank;
+    __FPS blankStream;
+    if (fpsSimInit(&blank, BENCH_CAPACITY) != 0) return 1;
+    fpsSimAttach(&blank, &blankStream);
+    if (R30X_tstoreRestore(&store, 0, &blankStream) != FPS_RESP_OK) wrong++;
+    wrong += compare(&store, 0, &blank);
+    printf("reopened and restored, wrong %u\n", wrong);
+
+    fpsSimFree(&blank);
+    R30X_tstoreClose(&store);
+    for (uint32_t i = 0; i < doors; i++) fpsSimFree(&sims[i]);
+    free(sims);
+    free(streams);
+    for (int i = 0; i < BENCH_PASSES; i++) wrong += results[i].wrong;
+    return wrong ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,147 @@
+/*************************************************************************
+ *
+ * finger print library - 1:1 verification benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Compares verifyFinger (the location is known, e.g. from a badge) with
+ * the usual identify flow, generateImage, generateCharacter and a
+ * searchLibrary over the whole library, on the simulated module with 100,
+ * 500 and 1000 enrolled templates. Times are module time from the start of
+ * the capture to the result. Every fifth attempt is an impostor claiming
+ * somebody else's location, which must be rejected.
+ *
+ * usage: fps_verify_bench [--attempts n] [--threshold score] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fps_sim.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          1000
+#define BENCH_FINGER_BASE       1000  //finger of the template at location i is BENCH_FINGER_BASE + i
+#define BENCH_MAX_RESULTS       8
+
+typedef struct {
+    uint16_t enrolled;
+    double verifyMs;
+    double identifyMs;
+    double verifyMaxMs;
+    double identifyMaxMs;
+    uint32_t errors;  //wrong accepts or rejects of either flow
+}BENCH_RESULT;
+
+static const uint16_t libraries[] = { 100, 500, 1000 };
+static BENCH_RESULT results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t attempts = 500;
+static uint16_t threshold = 50;
+static uint32_t rngState = 12345;
+
+static uint32_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint8_t identify(__FPS* stream) {
+    uint8_t response = generateImage(stream);
+    if (response == FPS_RESP_OK) response = generateCharacter(stream, 1);
+    if (response == FPS_RESP_OK) response = searchLibrary(stream, 1, 0, stream->templateCount);
+    return response;
+}
+
+static void measure(uint16_t enrolled) {
+    __FPS_SIM sim;
+    __FPS stream;
+    uint64_t verifyTotal = 0, identifyTotal = 0, verifyMax = 0, identifyMax = 0;
+    BENCH_RESULT* result = &results[resultCount++];
+    memset(result, 0, sizeof(BENCH_RESULT));
+    if (fpsSimInit(&sim, BENCH_CAPACITY) != 0) exit(1);
+    fpsSimAttach(&sim, &stream);
+    for (uint16_t location = 0; location < enrolled; location++) {
+        fpsSimMakeTemplate(BENCH_FINGER_BASE + location, sim.library + (uint32_t)location * FPS_TEMPLATE_SIZE);
+        sim.used[location / 8] |= (uint8_t)(1 << (location % 8));
+    }
+
+    for (uint32_t i = 0; i < attempts; i++) {
+        uint16_t claimed = (uint16_t)(1 + nextRandom() % (enrolled - 1));
+        uint8_t impostor = i % 5 == 4;
+        uint16_t owner = impostor ? (uint16_t)((claimed + 1 + nextRandom() % (enrolled - 1)) % enrolled) : claimed;
+        if (impostor && owner == claimed) owner = (uint16_t)((owner + 1) % enrolled);
+        fpsSimPlaceFinger(&sim, BENCH_FINGER_BASE + owner);
+
+        uint64_t start = sim.clockUs;
+        uint8_t response = verifyFinger(&stream, claimed, threshold);
+        uint64_t elapsed = sim.clockUs - start;
+        verifyTotal += elapsed;
+        if (elapsed > verifyMax) verifyMax = elapsed;
+        if (response != (impostor ? FPS_RESP_DONOTMATCH : FPS_RESP_OK)) result->errors++;
+
+        start = sim.clockUs;
+        response = identify(&stream);
+        elapsed = sim.clockUs - start;
+        identifyTotal += elapsed;
+        if (elapsed > identifyMax) identifyMax = elapsed;
+        if (response != FPS_RESP_OK || stream.fingerId != owner) result->errors++;
+    }
+    fpsSimFree(&sim);
+
+    result->enrolled = enrolled;
+    result->verifyMs = verifyTotal / 1000.0 / attempts;
+    result->identifyMs = identifyTotal / 1000.0 / attempts;
+    result->verifyMaxMs = verifyMax / 1000.0;
+    result->identifyMaxMs = identifyMax / 1000.0;
+    printf("%5u templates  verify %7.1f ms (max %7.1f)  search %7.1f ms (max %7.1f)  x%.2f  errors %u\n", enrolled,
+           result->verifyMs, result->verifyMaxMs, result->identifyMs, result->identifyMaxMs, result->identifyMs / result->verifyMs, result->errors);
+}
+
+static int writeJson(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"attempts\": %u,\n  \"benchmarks\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL), attempts);
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"enrolled\": %u, \"verify_ms\": %.1f, \"verify_max_ms\": %.1f, \"search_ms\": %.1f, \"search_max_ms\": %.1f, \"errors\": %u}%s\n",
+                results[i].enrolled, results[i].verifyMs, results[i].verifyMaxMs, results[i].identifyMs, results[i].identifyMaxMs,
+                results[i].errors, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    uint32_t errors = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--attempts") == 0 && i + 1 < argc) attempts = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--attempts n] [--threshold score] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (attempts == 0) return 2;
+
+    printf("%u attempts per library size, threshold %u\n", attempts, threshold);
+    for (size_t i = 0; i < sizeof(libraries) / sizeof(libraries[0]); i++) {
+        measure(libraries[i]);
+        errors += results[resultCount - 1].errors;
+    }
+    if (jsonPath != NULL && writeJson(jsonPath) != 0) return 1;
+    return errors ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,284 @@
+/*************************************************************************
+ *
+ * finger print library - virtual template library benchmark
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Runs an access trace against R30X_vlib on the simulated module and
+ * reports the resident hit rate and the identify latency in module time
+ * (capture, feature extraction and the virtual library search). The first
+ * identify of every user has to page the library until it is found, so
+ * the p99 of users seen before is reported separately. Every layout runs
+ * with maxBatches (FPS_VLIB_DEFAULT_MAX_BATCHES unless --batches is given),
+ * which bounds the time of one identify but misses enrolled users that are
+ * too far back in the paging order. Such a user tries again until found,
+ * the next identify continues paging; the share of enrolled fingers that
+ * needed another attempt is reported as "cut off", p99 and mean are per
+ * identify and "p99 user" is the time until the user is found, all
+ * attempts together. The last row pages all users for comparison.
+ *
+ * The trace draws users from a Zipf distribution whose ranking drifts every
+ * "day", plus a share of fingers that are not enrolled at all.
+ *
+ * usage: fps_vlib_bench [--users n] [--identifies n] [--unknown percent]
+ *                       [--batches n] [--seed n] [--json file]
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "fps_sim.h"
+#include "R30X_vlib.h"
+
+#ifndef FPS_BENCH_VERSION
+#define FPS_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_CAPACITY          1000
+#define BENCH_ZIPF_EXPONENT     1.1
+#define BENCH_DAY_LENGTH        2000  //identifies between ranking changes
+#define BENCH_DAY_SHUFFLE       10    //percent of the ranking that changes every day
+#define BENCH_UNKNOWN_FINGER    0x80000000UL
+#define BENCH_MAX_LAYOUTS       8
+
+typedef struct {
+    uint16_t residentSlots;
+    uint16_t windowSlots;
+    int32_t maxBatches;  //-1 for the value of --batches
+}BENCH_LAYOUT;
+
+typedef struct {
+    BENCH_LAYOUT layout;
+    __FPS_VLIB_STATS stats;
+    double p50Ms;
+    double p99Ms;
+    double p99RepeatMs;
+    double maxMs;
+    double meanMs;
+    double p99UserMs;  //until an enrolled user is found, all attempts
+    uint16_t maxBatches;
+    uint64_t cutOffEnrolled;  //enrolled fingers that needed another attempt because paging stopped after maxBatches
+    uint64_t attempts;  //identifies of all fingers
+    uint64_t errors;  //wrong user, or a failed command
+}BENCH_RESULT;
+
+static const BENCH_LAYOUT layouts[] = { { 100, 100, -1 }, { 400, 100, -1 }, { 899, 100, -1 }, { 949, 50, -1 }, { 899, 100, 0 } };
+static BENCH_RESULT results[BENCH_MAX_LAYOUTS];
+static uint32_t userCount = 3000;
+static uint32_t identifyCount = 10000;
+static double unknownPercent = 1.0;
+static uint16_t maxBatches = FPS_VLIB_DEFAULT_MAX_BATCHES;
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static double uniform(void) {
+    return (double)(nextRandom() >> 11) / 9007199254740992.0;
+}
+
+static int8_t readTemplate(void* context, uint32_t userId, uint8_t* templateData) {
+    (void)context;
+    fpsSimMakeTemplate(userId, templateData);
+    return 0;
+}
+
+static int compareLatency(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentileMs(uint64_t* sorted, uint32_t count, double percent) {
+    if (count == 0) return 0;
+    uint32_t index = (uint32_t)(percent / 100.0 * (count - 1) + 0.5);
+    return sorted[index] / 1000.0;
+}
+/*
+*   @brief: build the trace once, so every layout sees the same fingers
+*
+*/
+static uint32_t* buildTrace(void) {
+    uint32_t* trace = (uint32_t*)malloc(identifyCount * sizeof(uint32_t));
+    uint32_t* ranking = (uint32_t*)malloc(userCount * sizeof(uint32_t));
+    double* cdf = (double*)malloc(userCount * sizeof(double));
+    if (trace == NULL || ranking == NULL || cdf == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    double sum = 0;
+    for (uint32_t i = 0; i < userCount; i++) {
+        sum += 1.0 / pow(i + 1, BENCH_ZIPF_EXPONENT);
+        cdf[i] = sum;
+        ranking[i] = i;
+    }
+    for (uint32_t i = userCount - 1; i > 0; i--) {
+        uint32_t j = (uint32_t)(nextRandom() % (i + 1));
+        uint32_t t = ranking[i]; ranking[i] = ranking[j]; ranking[j] = t;
+    }
+    for (uint32_t n = 0; n < identifyCount; n++) {
+        if (n > 0 && n % BENCH_DAY_LENGTH == 0) {
+            for (uint32_t k = 0; k < userCount * BENCH_DAY_SHUFFLE / 100; k++) {
+                uint32_t i = (uint32_t)(nextRandom() % userCount), j = (uint32_t)(nextRandom() % userCount);
+                uint32_t t = ranking[i]; ranking[i] = ranking[j]; ranking[j] = t;
+            }
+        }
+        if (uniform() * 100.0 < unknownPercent) {
+            trace[n] = BENCH_UNKNOWN_FINGER + n;
+            continue;
+        }
+        double u = uniform() * sum;
+        uint32_t lo = 0, hi = userCount - 1;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (cdf[mid] < u) lo = mid + 1;
+            else hi = mid;
+        }
+        trace[n] = ranking[lo];
+    }
+    free(ranking);
+    free(cdf);
+    return trace;
+}
+
+static void runLayout(const uint32_t* trace, const BENCH_LAYOUT* layout, BENCH_RESULT* result) {
+    static __FPS_VLIB vlib;
+    __FPS_SIM sim;
+    __FPS stream;
+    __FPS_VLIB_USER* users = (__FPS_VLIB_USER*)malloc(userCount * sizeof(__FPS_VLIB_USER));
+    uint16_t batches = layout->maxBatches < 0 ? maxBatches : (uint16_t)layout->maxBatches;
+    uint32_t maxAttempts = batches ? userCount / ((uint32_t)layout->windowSlots * batches) + 2 : 1;
+    uint64_t* latency = (uint64_t*)malloc((size_t)identifyCount * maxAttempts * sizeof(uint64_t));
+    uint64_t* repeat = (uint64_t*)malloc(identifyCount * sizeof(uint64_t));
+    uint64_t* user = (uint64_t*)malloc(identifyCount * sizeof(uint64_t));
+    uint8_t* seen = (uint8_t*)calloc(userCount, 1);
+    uint32_t repeatCount = 0, userFound = 0, count = 0;
+    double total = 0;
+
+    memset(result, 0, sizeof(BENCH_RESULT));
+    result->layout = *layout;
+    if (users == NULL || latency == NULL || repeat == NULL || user == NULL || seen == NULL || fpsSimInit(&sim, BENCH_CAPACITY) != 0) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    fpsSimAttach(&sim, &stream);
+    if (R30X_vlibInit(&vlib, &stream, userCount, users, 1, layout->residentSlots, layout->windowSlots) != 0) {
+        fprintf(stderr, "layout %u + %u does not fit\n", layout->residentSlots, layout->windowSlots);
+        exit(1);
+    }
+    vlib.readTemplate = readTemplate;
+    vlib.maxBatches = batches;
+    result->maxBatches = batches;
+    R30X_vlibClear(&vlib);
+
+    for (uint32_t n = 0; n < identifyCount; n++) {
+        uint8_t enrolled = trace[n] < BENCH_UNKNOWN_FINGER, found = FPS_VLIB_NOT_FOUND;
+        uint64_t first = sim.clockUs;
+        for (uint32_t attempt = 0; attempt < maxAttempts; attempt++) {
+            uint64_t start = sim.clockUs;
+            fpsSimPlaceFinger(&sim, trace[n]);
+            generateImage(&stream);
+            generateCharacter(&stream, 1);
+            found = R30X_vlibIdentify(&vlib);
+            latency[count] = sim.clockUs - start;
+            total += latency[count++];
+            if (found != FPS_VLIB_NOT_FOUND || !enrolled || vlib.maxBatches == 0) break;
+            if (attempt == 0) result->cutOffEnrolled++;
+        }
+        if (found == FPS_VLIB_ERROR) result->errors++;
+        else if (enrolled) {
+            if (found != FPS_VLIB_FOUND || vlib.userId != trace[n]) result->errors++;
+            user[userFound++] = sim.clockUs - first;
+            if (seen[trace[n]]) repeat[repeatCount++] = sim.clockUs - first;
+            seen[trace[n]] = 1;
+        }
+    }
+    qsort(latency, count, sizeof(uint64_t), compareLatency);
+    qsort(repeat, repeatCount, sizeof(uint64_t), compareLatency);
+    qsort(user, userFound, sizeof(uint64_t), compareLatency);
+    result->stats = vlib.stats;
+    result->attempts = count;
+    result->p50Ms = percentileMs(latency, count, 50);
+    result->p99Ms = percentileMs(latency, count, 99);
+    result->p99RepeatMs = percentileMs(repeat, repeatCount, 99);
+    result->p99UserMs = percentileMs(user, userFound, 99);
+    result->maxMs = latency[count - 1] / 1000.0;
+    result->meanMs = total / count / 1000.0;
+
+    char batchText[8];
+    snprintf(batchText, sizeof(batchText), batches ? "%u" : "all", batches);
+    printf("resident %4u window %4u batches %3s  hit %6.2f%%  paged %6.2f%%  miss %5.2f%%  cut off %5.2f%% (%.3f attempts)  promote %6llu evict %6llu "
+           "paged %8llu  p50 %8.1f ms  p99 %9.1f ms  p99 repeat %9.1f ms  p99 user %9.1f ms  mean %8.1f ms%s\n",
+           layout->residentSlots, layout->windowSlots, batchText,
+           100.0 * result->stats.hits / result->stats.identifies, 100.0 * result->stats.pagedHits / result->stats.identifies,
+           100.0 * result->stats.misses / result->stats.identifies, 100.0 * result->cutOffEnrolled / identifyCount,
+           (double)count / identifyCount, (unsigned long long)result->stats.promotions, (unsigned long long)result->stats.evictions,
+           (unsigned long long)result->stats.templatesPaged, result->p50Ms, result->p99Ms, result->p99RepeatMs, result->p99UserMs,
+           result->meanMs, result->errors ? "  ERRORS" : "");
+    free(users);
+    free(latency);
+    free(repeat);
+    free(user);
+    free(seen);
+    fpsSimFree(&sim);
+}
+
+static int writeJson(const char* path, int count) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "{\n  \"library\": \"R30X_FPS\",\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"users\": %u,\n  \"identifies\": %u,\n  \"layouts\": [\n",
+            FPS_BENCH_VERSION, (long long)time(NULL), userCount, identifyCount);
+    for (int i = 0; i < count; i++) {
+        const BENCH_RESULT* r = &results[i];
+        fprintf(file, "    {\"resident\": %u, \"window\": %u, \"max_batches\": %u, \"hit_rate\": %.4f, \"paged_rate\": %.4f, "
+                "\"miss_rate\": %.4f, \"cut_off_rate\": %.4f, \"attempts\": %llu, \"promotions\": %llu, \"evictions\": %llu, \"templates_paged\": %llu, "
+                "\"p50_ms\": %.1f, \"p99_ms\": %.1f, \"p99_repeat_ms\": %.1f, \"p99_user_ms\": %.1f, \"max_ms\": %.1f, \"mean_ms\": %.1f, \"errors\": %llu}%s\n",
+                r->layout.residentSlots, r->layout.windowSlots, r->maxBatches, (double)r->stats.hits / r->stats.identifies,
+                (double)r->stats.pagedHits / r->stats.identifies, (double)r->stats.misses / r->stats.identifies,
+                (double)r->cutOffEnrolled / identifyCount, (unsigned long long)r->attempts,
+                (unsigned long long)r->stats.promotions, (unsigned long long)r->stats.evictions,
+                (unsigned long long)r->stats.templatesPaged, r->p50Ms, r->p99Ms, r->p99RepeatMs, r->p99UserMs, r->maxMs, r->meanMs,
+                (unsigned long long)r->errors, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    int count = (int)(sizeof(layouts) / sizeof(layouts[0]));
+    uint64_t errors = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--users") == 0 && i + 1 < argc) userCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--identifies") == 0 && i + 1 < argc) identifyCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--unknown") == 0 && i + 1 < argc) unknownPercent = atof(argv[++i]);
+        else if (strcmp(argv[i], "--batches") == 0 && i + 1 < argc) maxBatches = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) rngState = (uint64_t)strtoull(argv[++i], NULL, 0) | 1;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--users n] [--identifies n] [--unknown percent] [--batches n] [--seed n] [--json file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (userCount == 0 || identifyCount == 0) return 2;
+    uint32_t* trace = buildTrace();
+    printf("%u users, %u identifies, %.1f%% unknown fingers, library of %u locations\n", userCount, identifyCount, unknownPercent, BENCH_CAPACITY);
+    for (int i = 0; i < count; i++) {
+        runLayout(trace, &layouts[i], &results[i]);
+        errors += results[i].errors;
+    }
+    free(trace);
+    if (jsonPath != NULL && writeJson(jsonPath, count) != 0) return 1;
+    return errors ? 1 : 0;
+}
+
+/********************************END OF FILE*****************************************************/
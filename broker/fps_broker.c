@@ -0,0 +1,539 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "fps_broker.h"
+#include "R30X_pipeline.h"
+
+#define CLIENT_FREE             0
+#define CLIENT_RUNNING          1
+#define CLIENT_FINISHED         2  //the thread has ended and must be joined
+
+typedef struct {
+    __FPS_BROKER_RESPONSE header;
+    uint8_t data[FPS_BROKER_MAX_DATA];
+}RESPONSE;
+
+typedef struct {
+    uint8_t known;
+    uint8_t args;  //FPS_ARGS layout of arg[], to check the ranges
+    uint8_t local;  //answered by the broker without the sensor
+}OPERATION;
+
+static const OPERATION operations[] = {
+    [FPS_BROKER_OP_ATTACH_SHM]        = { 1, FPS_ARGS(FPS_ARG_U32, 0, 0, 0), 1 },
+    [FPS_BROKER_OP_GENERATE_IMAGE]    = { 1, 0, 0 },
+    [FPS_BROKER_OP_GENERATE_CHAR]     = { 1, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), 0 },
+    [FPS_BROKER_OP_GENERATE_TEMPLATE] = { 1, 0, 0 },
+    [FPS_BROKER_OP_SEARCH]            = { 1, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, FPS_ARG_U16, 0), 0 },
+    [FPS_BROKER_OP_IDENTIFY]          = { 1, 0, 0 },
+    [FPS_BROKER_OP_VERIFY]            = { 1, FPS_ARGS(FPS_ARG_U16, FPS_ARG_U16, 0, 0), 0 },
+    [FPS_BROKER_OP_SAVE]              = { 1, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, 0, 0), 0 },
+    [FPS_BROKER_OP_LOAD]              = { 1, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, 0, 0), 0 },
+    [FPS_BROKER_OP_DELETE]            = { 1, FPS_ARGS(FPS_ARG_U16, FPS_ARG_U16, 0, 0), 0 },
+    [FPS_BROKER_OP_MATCH]             = { 1, 0, 0 },
+    [FPS_BROKER_OP_TEMPLATE_COUNT]    = { 1, 0, 0 },
+    [FPS_BROKER_OP_READ_INDEX]        = { 1, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), 0 },
+    [FPS_BROKER_OP_GET_IMAGE]         = { 1, FPS_ARGS(FPS_ARG_U32, 0, 0, 0), 0 },
+    [FPS_BROKER_OP_EXPORT_TEMPLATE]   = { 1, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U32, 0, 0), 0 },
+    [FPS_BROKER_OP_IMPORT_TEMPLATE]   = { 1, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U32, 0, 0), 0 },
+    [FPS_BROKER_OP_STATS]             = { 1, 0, 1 },
+};
+#define OPERATION_COUNT         (sizeof(operations) / sizeof(operations[0]))
+
+_Static_assert(FPS_SCHED_PRIORITIES * sizeof(__FPS_SCHED_STATS) <= FPS_BROKER_MAX_DATA, "statistics do not fit a response");
+
+static uint64_t monotonicUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static uint8_t validRequest(const __FPS_BROKER_REQUEST* request) {
+    if (request->op >= OPERATION_COUNT || !operations[request->op].known) return 0;
+    uint8_t layout = operations[request->op].args;
+    for (uint8_t i = 0; i < 3; i++, layout >>= 2) {
+        if ((layout & 3) == FPS_ARG_NONE && request->arg[i] != 0) return 0;
+        if ((layout & 3) == FPS_ARG_U8 && request->arg[i] > 0xFF) return 0;
+        if ((layout & 3) == FPS_ARG_U16 && request->arg[i] > 0xFFFF) return 0;
+    }
+    return 1;
+}
+
+static void sendResponse(__FPS_BROKER_CLIENT* client, RESPONSE* response) {
+    //a client that went away is noticed by the next read
+    send(client->fd, response, sizeof(__FPS_BROKER_RESPONSE) + response->header.length, MSG_NOSIGNAL);
+}
+
+static void answer(__FPS_BROKER_CLIENT* client, const __FPS_BROKER_REQUEST* request, uint8_t status) {
+    RESPONSE response;
+    memset(&response.header, 0, sizeof(__FPS_BROKER_RESPONSE));
+    response.header.tag = request->tag;
+    response.header.op = request->op;
+    response.header.status = status;
+    sendResponse(client, &response);
+}
+
+//pointer to length bytes at offset of the client's shared memory, NULL if they are not inside it
+static uint8_t* shmRange(__FPS_BROKER_CLIENT* client, uint32_t offset, uint32_t length) {
+    if (client->shm == NULL || (uint64_t)offset + length > client->shmSize) return NULL;
+    return client->shm + offset;
+}
+
+static uint8_t attachShm(__FPS_BROKER_CLIENT* client, const __FPS_BROKER_REQUEST* request, int fd) {
+    struct stat st;
+    if (fd < 0 || request->arg[0] == 0) return FPS_BROKER_ERR_REQUEST;
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK)) return FPS_BROKER_ERR_SHM;  //could be truncated under the mapping, SIGBUS
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < request->arg[0]) return FPS_BROKER_ERR_SHM;
+    void* shm = mmap(NULL, request->arg[0], PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shm == MAP_FAILED) return FPS_BROKER_ERR_SHM;
+    if (client->shm != NULL) munmap(client->shm, client->shmSize);
+    client->shm = (uint8_t*)shm;
+    client->shmSize = request->arg[0];
+    return FPS_RESP_OK;
+}
+
+//requests that need no sensor
+static void executeLocal(__FPS_BROKER_CLIENT* client, const __FPS_BROKER_REQUEST* request, int fd) {
+    __FPS_BROKER* broker = (__FPS_BROKER*)client->broker;
+    RESPONSE response;
+    memset(&response.header, 0, sizeof(__FPS_BROKER_RESPONSE));
+    response.header.tag = request->tag;
+    response.header.op = request->op;
+    if (request->op == FPS_BROKER_OP_ATTACH_SHM) {
+        response.header.status = attachShm(client, request, fd);
+    }
+    else if (request->sensor >= broker->sensorCount) {
+        response.header.status = FPS_BROKER_ERR_SENSOR;
+    }
+    else {  //FPS_BROKER_OP_STATS
+        __FPS_SCHED_STATS stats[FPS_SCHED_PRIORITIES];
+        R30X_schedGetStats(&broker->sensors[request->sensor].sched, stats);
+        memcpy(response.data, stats, sizeof(stats));
+        response.header.length = sizeof(stats);
+    }
+    sendResponse(client, &response);
+}
+
+static uint8_t identify(__FPS* stream, uint16_t capacity) {
+    uint8_t status = generateImage(stream);
+    if (status == FPS_RESP_OK) status = generateCharacter(stream, 1);
+    if (status == FPS_RESP_OK) status = searchLibrary(stream, 1, 0, capacity);
+    return status;
+}
+
+//run one request on the acquired sensor, the response is filled but not sent
+static void execute(__FPS_BROKER_CLIENT* client, __FPS_BROKER_SENSOR* sensor, const __FPS_BROKER_REQUEST* request, RESPONSE* response) {
+    __FPS* stream = sensor->stream;
+    const uint32_t* arg = request->arg;
+    uint8_t* shm;
+    uint8_t status;
+    stream->fingerId = 0;
+    stream->matchScore = 0;
+
+    switch (request->op) {
+    case FPS_BROKER_OP_GENERATE_IMAGE: status = generateImage(stream); break;
+    case FPS_BROKER_OP_GENERATE_CHAR: status = generateCharacter(stream, (uint8_t)arg[0]); break;
+    case FPS_BROKER_OP_GENERATE_TEMPLATE: status = generateTemplate(stream); break;
+    case FPS_BROKER_OP_SEARCH: status = searchLibrary(stream, (uint8_t)arg[0], (uint16_t)arg[1], (uint16_t)arg[2]); break;
+    case FPS_BROKER_OP_IDENTIFY: status = identify(stream, sensor->capacity); break;
+    case FPS_BROKER_OP_VERIFY: status = verifyFinger(stream, (uint16_t)arg[0], (uint16_t)arg[1]); break;
+    case FPS_BROKER_OP_SAVE: status = saveTemplate(stream, (uint8_t)arg[0], (uint16_t)arg[1]); break;
+    case FPS_BROKER_OP_LOAD: status = loadTemplate(stream, (uint8_t)arg[0], (uint16_t)arg[1]); break;
+    case FPS_BROKER_OP_DELETE: status = deleteTemplate(stream, (uint16_t)arg[0], (uint16_t)arg[1]); break;
+    case FPS_BROKER_OP_MATCH: status = matchTemplates(stream); break;
+    case FPS_BROKER_OP_TEMPLATE_COUNT:
+        status = getTemplateCount(stream);
+        response->header.templateCount = stream->templateCount;
+        stream->templateCount = sensor->capacity;  //the library functions check locations against it
+        break;
+    case FPS_BROKER_OP_READ_INDEX:
+        status = readIndexTable(stream, (uint8_t)arg[0], response->data);
+        if (status == FPS_RESP_OK) response->header.length = FPS_INDEX_TABLE_LENGTH;
+        break;
+#if FPS_CFG_IMAGE_TRANSFER
+    case FPS_BROKER_OP_GET_IMAGE:
+        shm = shmRange(client, arg[0], FPS_IMAGE_SIZE);
+        status = shm == NULL ? FPS_BROKER_ERR_SHM : getImage(stream, shm);
+        break;
+#endif
+#if FPS_CFG_TEMPLATE_TRANSFER
+    case FPS_BROKER_OP_EXPORT_TEMPLATE:
+        shm = shmRange(client, arg[1], FPS_TEMPLATE_SIZE);
+        status = shm == NULL ? FPS_BROKER_ERR_SHM : exportCharacter(stream, (uint8_t)arg[0], shm);
+        break;
+    case FPS_BROKER_OP_IMPORT_TEMPLATE:
+        shm = shmRange(client, arg[1], FPS_TEMPLATE_SIZE);
+        status = shm == NULL ? FPS_BROKER_ERR_SHM : importCharacter(stream, (uint8_t)arg[0], shm);
+        break;
+#endif
+    default:
+        (void)shm;
+        status = FPS_BROKER_ERR_REQUEST;  //transfer disabled in R30X_config.h
+        break;
+    }
+    response->header.status = status;
+    response->header.fingerId = stream->fingerId;
+    response->header.matchScore = stream->matchScore;
+}
+
+static uint8_t isFlashWrite(const __FPS_BROKER_REQUEST* request) {
+    return request->op == FPS_BROKER_OP_SAVE || request->op == FPS_BROKER_OP_DELETE;
+}
+
+/*
+*   @brief: chained saves and deletes from first on, as one pipeline with the window of the broker
+*   @return: number of requests answered, 0 if there are fewer than two
+*
+*/
+static uint16_t executePipeline(__FPS_BROKER_CLIENT* client, __FPS* stream, const __FPS_BROKER_REQUEST* requests, uint16_t first, uint16_t count, uint8_t* failed) {
+    __FPS_BROKER* broker = (__FPS_BROKER*)client->broker;
+    __FPS_PIPELINE pipeline;
+    RESPONSE response;
+    uint16_t last = first;
+    while (last + 1 < count && (requests[last].flags & FPS_BROKER_FLAG_CHAIN) && isFlashWrite(&requests[last + 1]) &&
+           validRequest(&requests[last + 1]) && requests[last + 1].sensor == requests[first].sensor &&
+           last + 1 - first < FPS_PIPELINE_MAX_COMMANDS) {
+        last++;
+    }
+    if (last == first) return 0;
+
+    R30X_pipelineInit(&pipeline, stream, broker->pipelineWindow);
+    for (uint16_t i = first; i <= last; i++) {
+        const uint32_t* arg = requests[i].arg;
+        int16_t queued;
+        if (requests[i].op == FPS_BROKER_OP_SAVE) queued = R30X_pipelineQueueSave(&pipeline, (uint8_t)arg[0], (uint16_t)arg[1]);
+        else queued = R30X_pipelineQueueDelete(&pipeline, (uint16_t)arg[0], (uint16_t)arg[1]);
+        if (queued < 0) {  //out of range: it runs alone after the pipeline and gets the error of the library function
+            if (i == first) return 0;
+            last = i - 1;
+            break;
+        }
+    }
+    *failed = R30X_pipelineRun(&pipeline) != FPS_RESP_OK;
+
+    memset(&response.header, 0, sizeof(__FPS_BROKER_RESPONSE));
+    for (uint16_t i = first; i <= last; i++) {
+        const __FPS_PIPELINE_ENTRY* entry = &pipeline.entries[i - first];
+        response.header.tag = requests[i].tag;
+        response.header.op = requests[i].op;
+        if (entry->state == FPS_PIPELINE_DONE) response.header.status = FPS_RESP_OK;
+        else if (entry->state == FPS_PIPELINE_FAILED) response.header.status = entry->confirmationCode;
+        else if (entry->state == FPS_PIPELINE_UNKNOWN) response.header.status = entry->response;
+        else response.header.status = FPS_BROKER_ERR_SKIPPED;
+        sendResponse(client, &response);
+    }
+    return last - first + 1;
+}
+
+//requests from first on for the same sensor, under one acquisition; returns the index of the first request not run
+static uint16_t runBatch(__FPS_BROKER_CLIENT* client, const __FPS_BROKER_REQUEST* requests, uint16_t first, uint16_t count) {
+    __FPS_BROKER* broker = (__FPS_BROKER*)client->broker;
+    const __FPS_BROKER_REQUEST* request = &requests[first];
+    __FPS_BROKER_SENSOR* sensor = &broker->sensors[request->sensor];
+    RESPONSE response;
+    uint8_t skipping = 0;
+    uint16_t i = first;
+
+    uint64_t start = monotonicUs();
+    __FPS* stream = R30X_schedAcquire(&sensor->sched, request->priority);
+    uint64_t wait = (monotonicUs() - start) / 100;
+    atomic_fetch_add(&broker->batches, 1);
+
+    while (1) {
+        request = &requests[i];
+        uint16_t done = 0;
+        uint8_t failed = 0;
+        if (skipping) {
+            answer(client, request, FPS_BROKER_ERR_SKIPPED);
+            failed = 1;
+            done = 1;
+        }
+        else if (broker->pipelineWindow > 0 && isFlashWrite(request)) {
+            done = executePipeline(client, stream, requests, i, count, &failed);
+        }
+        if (done == 0) {
+            memset(&response.header, 0, sizeof(__FPS_BROKER_RESPONSE));
+            response.header.tag = request->tag;
+            response.header.op = request->op;
+            response.header.waitTime = wait > 0xFFFF ? 0xFFFF : (uint16_t)wait;
+            execute(client, sensor, request, &response);
+            sendResponse(client, &response);
+            failed = response.header.status != FPS_RESP_OK;
+            done = 1;
+        }
+        i += done;
+        wait = 0;
+        uint8_t chained = (requests[i - 1].flags & FPS_BROKER_FLAG_CHAIN) != 0;
+        skipping = chained && failed;
+
+        if (i >= count || !validRequest(&requests[i]) || operations[requests[i].op].local || requests[i].sensor != requests[first].sensor) break;
+        if (!chained) {
+            if (requests[i].priority != requests[first].priority) break;
+            start = monotonicUs();
+            if (R30X_schedYield(&sensor->sched)) wait = (monotonicUs() - start) / 100;  //higher priority work of another client ran in between
+        }
+    }
+    R30X_schedRelease(&sensor->sched);
+    return i;
+}
+
+/*
+*   @brief: read the requests the client has sent so far, at least one. A chain is read completely unless
+*           the batch is full
+*   @parameter: requests already in the batch, the start of a chain
+*   @return: number of requests including the kept ones, -1 if the connection is closed
+*
+*/
+static int16_t readRequests(__FPS_BROKER_CLIENT* client, __FPS_BROKER_REQUEST* requests, int* fds, uint16_t kept) {
+    int16_t count = (int16_t)kept;
+    while (count < FPS_BROKER_MAX_BATCH) {
+        union {
+            struct cmsghdr header;
+            uint8_t buffer[CMSG_SPACE(sizeof(int))];
+        } control;
+        struct iovec iov = { &requests[count], sizeof(__FPS_BROKER_REQUEST) };
+        struct msghdr msg = { 0 };
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        uint8_t wait = count == 0 || (requests[count - 1].flags & FPS_BROKER_FLAG_CHAIN);
+
+        memset(&requests[count], 0, sizeof(__FPS_BROKER_REQUEST));
+        ssize_t received = recvmsg(client->fd, &msg, MSG_CMSG_CLOEXEC | (wait ? 0 : MSG_DONTWAIT));
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return count > 0 ? count : -1;  //closed: run what has arrived
+        }
+        fds[count] = -1;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) memcpy(&fds[count], CMSG_DATA(cmsg), sizeof(int));
+        }
+        if (received != sizeof(__FPS_BROKER_REQUEST) || (msg.msg_flags & MSG_TRUNC)) requests[count].op = 0;  //answered as a bad request
+        count++;
+    }
+    return count;
+}
+
+static void* clientThread(void* arg) {
+    __FPS_BROKER_CLIENT* client = (__FPS_BROKER_CLIENT*)arg;
+    __FPS_BROKER* broker = (__FPS_BROKER*)client->broker;
+    __FPS_BROKER_REQUEST requests[FPS_BROKER_MAX_BATCH];
+    int fds[FPS_BROKER_MAX_BATCH];
+    int16_t count;
+    uint16_t kept = 0;  //start of a chain carried over to the next read
+    uint8_t rejecting = 0;  //the rest of a chain longer than the batch is still coming
+
+    while ((count = readRequests(client, requests, fds, kept)) > 0) {
+        uint16_t first = 0, end = (uint16_t)count;
+        atomic_fetch_add(&broker->requests, (uint64_t)(count - kept));
+        kept = 0;
+        while (rejecting && first < end) {
+            answer(client, &requests[first], FPS_BROKER_ERR_REQUEST);
+            rejecting = (requests[first++].flags & FPS_BROKER_FLAG_CHAIN) != 0;
+        }
+        if (end == FPS_BROKER_MAX_BATCH && first < end && (requests[end - 1].flags & FPS_BROKER_FLAG_CHAIN)) {
+            //the batch ends inside a chain: run it with the rest of it after the next read, unless it fills the batch
+            uint16_t chainStart = end - 1;
+            while (chainStart > first && (requests[chainStart - 1].flags & FPS_BROKER_FLAG_CHAIN)) chainStart--;
+            if (chainStart == 0) {
+                for (uint16_t i = 0; i < end; i++) answer(client, &requests[i], FPS_BROKER_ERR_REQUEST);
+                rejecting = 1;
+                first = end;
+            }
+            else {
+                kept = end - chainStart;
+                end = chainStart;
+            }
+        }
+        for (uint16_t i = first; i < end;) {
+            const __FPS_BROKER_REQUEST* request = &requests[i];
+            if (!validRequest(request)) answer(client, request, FPS_BROKER_ERR_REQUEST);
+            else if (operations[request->op].local) executeLocal(client, request, fds[i]);
+            else if (request->sensor >= broker->sensorCount) answer(client, request, FPS_BROKER_ERR_SENSOR);
+            else {
+                i = runBatch(client, requests, i, end);
+                continue;
+            }
+            i++;
+        }
+        for (uint16_t i = 0; i < end; i++) {
+            if (fds[i] >= 0) close(fds[i]);  //mapped or not needed
+        }
+        memmove(requests, &requests[end], kept * sizeof(__FPS_BROKER_REQUEST));
+        memmove(fds, &fds[end], kept * sizeof(int));
+    }
+
+    if (client->shm != NULL) munmap(client->shm, client->shmSize);
+    client->shm = NULL;
+    pthread_mutex_lock(&broker->lock);
+    close(client->fd);
+    client->fd = -1;
+    client->state = CLIENT_FINISHED;
+    pthread_mutex_unlock(&broker->lock);
+    return NULL;
+}
+
+//a free client slot, joining a finished thread if needed; call with the lock held
+static __FPS_BROKER_CLIENT* freeClient(__FPS_BROKER* broker) {
+    for (uint16_t i = 0; i < FPS_BROKER_MAX_CLIENTS; i++) {
+        __FPS_BROKER_CLIENT* client = &broker->clients[i];
+        if (client->state == CLIENT_FINISHED) {
+            pthread_join(client->thread, NULL);
+            client->state = CLIENT_FREE;
+        }
+        if (client->state == CLIENT_FREE) return client;
+    }
+    return NULL;
+}
+
+static void* acceptThread(void* arg) {
+    __FPS_BROKER* broker = (__FPS_BROKER*)arg;
+    struct pollfd fds[2] = { { broker->listenFd, POLLIN, 0 }, { broker->wakeFd[0], POLLIN, 0 } };
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;  //stop
+        int fd = accept4(broker->listenFd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+
+        pthread_mutex_lock(&broker->lock);
+        __FPS_BROKER_CLIENT* client = freeClient(broker);
+        if (client != NULL) {
+            client->fd = fd;
+            client->shm = NULL;
+            client->shmSize = 0;
+            client->broker = broker;
+            client->state = CLIENT_RUNNING;
+            if (pthread_create(&client->thread, NULL, clientThread, client) != 0) {
+                client->state = CLIENT_FREE;
+                client = NULL;
+            }
+        }
+        pthread_mutex_unlock(&broker->lock);
+        if (client == NULL) {
+            close(fd);
+            atomic_fetch_add(&broker->rejected, 1);
+        }
+        else atomic_fetch_add(&broker->connections, 1);
+    }
+    return NULL;
+}
+/*
+*   @brief: prepare a broker without sensors
+*   @parameter: broker
+*   @return: 0 on success, -1 if the mutex can not be created
+*
+*/
+int8_t fpsBrokerInit(__FPS_BROKER* broker) {
+    memset(broker, 0, sizeof(__FPS_BROKER));
+    broker->listenFd = -1;
+    broker->wakeFd[0] = broker->wakeFd[1] = -1;
+    for (uint16_t i = 0; i < FPS_BROKER_MAX_CLIENTS; i++) broker->clients[i].fd = -1;
+    return pthread_mutex_init(&broker->lock, NULL) == 0 ? 0 : -1;
+}
+/*
+*   @brief: serve a module. Its library size is taken from stream->templateCount (readSysPara), the stream must
+*           only be used through the broker afterwards
+*   @parameter: broker, not started yet
+*   @parameter: initialized stream
+*   @return: index of the sensor in requests, -1 if FPS_BROKER_MAX_SENSORS are served or the scheduler fails
+*
+*/
+int8_t fpsBrokerAddSensor(__FPS_BROKER* broker, __FPS* stream) {
+    if (broker->sensorCount >= FPS_BROKER_MAX_SENSORS) return -1;
+    __FPS_BROKER_SENSOR* sensor = &broker->sensors[broker->sensorCount];
+    if (R30X_schedInit(&sensor->sched, stream) != 0) return -1;
+    sensor->stream = stream;
+    sensor->capacity = stream->templateCount;
+    return (int8_t)broker->sensorCount++;
+}
+/*
+*   @brief: create the socket and serve clients in background threads. A stale socket file is replaced
+*   @parameter: broker
+*   @parameter: path of the socket, e.g. FPS_BROKER_DEFAULT_SOCKET
+*   @return: 0 on success, -1 on failure (see errno)
+*
+*/
+int8_t fpsBrokerStart(__FPS_BROKER* broker, const char* socketPath) {
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    strcpy(broker->socketPath, socketPath);
+
+    broker->listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (broker->listenFd < 0) return -1;
+    unlink(socketPath);
+    if (bind(broker->listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || chmod(socketPath, 0660) != 0 ||
+        listen(broker->listenFd, FPS_BROKER_MAX_CLIENTS) != 0 || pipe2(broker->wakeFd, O_CLOEXEC) != 0) {
+        fpsBrokerStop(broker);
+        return -1;
+    }
+    if (pthread_create(&broker->acceptThread, NULL, acceptThread, broker) != 0) {
+        close(broker->wakeFd[0]);
+        close(broker->wakeFd[1]);
+        broker->wakeFd[0] = broker->wakeFd[1] = -1;
+        fpsBrokerStop(broker);
+        return -1;
+    }
+    return 0;
+}
+
+void fpsBrokerStop(__FPS_BROKER* broker) {
+    if (broker->wakeFd[1] >= 0) {
+        uint8_t byte = 0;
+        if (write(broker->wakeFd[1], &byte, 1) == 1) pthread_join(broker->acceptThread, NULL);
+        close(broker->wakeFd[0]);
+        close(broker->wakeFd[1]);
+        broker->wakeFd[0] = broker->wakeFd[1] = -1;
+    }
+    pthread_mutex_lock(&broker->lock);
+    for (uint16_t i = 0; i < FPS_BROKER_MAX_CLIENTS; i++) {
+        if (broker->clients[i].state == CLIENT_RUNNING && broker->clients[i].fd >= 0) shutdown(broker->clients[i].fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&broker->lock);
+    for (uint16_t i = 0; i < FPS_BROKER_MAX_CLIENTS; i++) {
+        if (broker->clients[i].state != CLIENT_FREE) {
+            pthread_join(broker->clients[i].thread, NULL);
+            broker->clients[i].state = CLIENT_FREE;
+        }
+    }
+    if (broker->listenFd >= 0) {
+        close(broker->listenFd);
+        broker->listenFd = -1;
+        unlink(broker->socketPath);
+    }
+}
+
+void fpsBrokerDestroy(__FPS_BROKER* broker) {
+    for (uint8_t i = 0; i < broker->sensorCount; i++) R30X_schedDestroy(&broker->sensors[i].sched);
+    pthread_mutex_destroy(&broker->lock);
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,74 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Owns the __FPS of every module and serves the commands of several
+ * processes (door UI, enrollment tool, monitoring) over a Unix domain
+ * socket, see fps_broker_proto.h. Every sensor has an R30X_scheduler, so
+ * a request waits with the priority the client gives it and identify
+ * requests overtake background work of other clients.
+ *
+ * Every connection has a thread. It reads all requests the client has
+ * sent so far and runs those for the same sensor and priority as a batch
+ * under one acquisition of the sensor, yielding to higher priorities
+ * between requests. Requests joined with FPS_BROKER_FLAG_CHAIN run
+ * without anything in between and stop at the first failure. A chain
+ * that does not end within FPS_BROKER_MAX_BATCH requests is rejected as a
+ * whole. With pipelineWindow set, chained saves and deletes go through
+ * R30X_pipeline, otherwise they run one after the other like any chain.
+ *
+ **************************************************************************/
+#ifndef FPS_BROKER_H
+#define FPS_BROKER_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include "R30X_scheduler.h"
+#include "fps_broker_proto.h"
+
+#define FPS_BROKER_MAX_SENSORS          4
+#define FPS_BROKER_MAX_CLIENTS          32
+#define FPS_BROKER_MAX_BATCH            16  //requests read from a connection at once, and the longest chain
+#define FPS_BROKER_PIPELINE_WINDOW      2   //window of fps_brokerd --pipeline
+
+typedef struct {
+	  uint8_t state;  //free, running or finished
+	  int fd;
+	  pthread_t thread;
+	  uint8_t* shm;  //shared memory of the client, NULL if none
+	  uint32_t shmSize;
+	  void* broker;
+}__FPS_BROKER_CLIENT;
+
+typedef struct {
+	  __FPS* stream;
+	  __FPS_SCHED sched;
+	  uint16_t capacity;  //library locations, searched by FPS_BROKER_OP_IDENTIFY
+}__FPS_BROKER_SENSOR;
+
+typedef struct {
+	  __FPS_BROKER_SENSOR sensors[FPS_BROKER_MAX_SENSORS];
+	  uint8_t sensorCount;
+	  char socketPath[108];
+	  int listenFd;
+	  int wakeFd[2];  //pipe that wakes the accept thread on stop
+	  pthread_t acceptThread;
+	  pthread_mutex_t lock;  //clients
+	  __FPS_BROKER_CLIENT clients[FPS_BROKER_MAX_CLIENTS];
+	  uint8_t pipelineWindow;  //commands on the line for chained saves and deletes, 0 (default): one by one; set before fpsBrokerStart
+
+	  atomic_uint_fast64_t requests;
+	  atomic_uint_fast64_t batches;  //sensor acquisitions
+	  atomic_uint_fast64_t connections;
+	  atomic_uint_fast64_t rejected;  //connections refused because all client slots were used
+}__FPS_BROKER;
+
+int8_t	fpsBrokerInit (__FPS_BROKER *broker); //0 on success
+int8_t	fpsBrokerAddSensor (__FPS_BROKER *broker, __FPS *stream); //index of the sensor, -1 if full; the stream must be initialized
+int8_t	fpsBrokerStart (__FPS_BROKER *broker, const char *socketPath); //listen and serve in background threads, 0 on success
+void	fpsBrokerStop (__FPS_BROKER *broker); //close all connections, wait for the threads and remove the socket
+void	fpsBrokerDestroy (__FPS_BROKER *broker);
+#endif
+
+/********************************END OF FILE*****************************************************/
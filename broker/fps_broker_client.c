@@ -0,0 +1,146 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker client
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "fps_broker_client.h"
+
+/*
+*   @brief: connect to the broker
+*   @parameter: connection
+*   @parameter: path of the broker socket, e.g. FPS_BROKER_DEFAULT_SOCKET
+*   @return: 0 on success, -1 on failure (see errno)
+*
+*/
+int8_t fpsBrokerConnect(__FPS_BROKER_CONN* conn, const char* socketPath) {
+    struct sockaddr_un address;
+    memset(conn, 0, sizeof(__FPS_BROKER_CONN));
+    conn->fd = -1;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    conn->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0) return -1;
+    if (connect(conn->fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void fpsBrokerDisconnect(__FPS_BROKER_CONN* conn) {
+    if (conn->shm != NULL) munmap(conn->shm, conn->shmSize);
+    if (conn->fd >= 0) close(conn->fd);
+    conn->shm = NULL;
+    conn->fd = -1;
+}
+
+static uint8_t sendRequest(__FPS_BROKER_CONN* conn, __FPS_BROKER_REQUEST* request, int fd) {
+    union {
+        struct cmsghdr header;
+        uint8_t buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { request, sizeof(__FPS_BROKER_REQUEST) };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    request->tag = conn->nextTag++;
+    ssize_t sent;
+    do {
+        sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == sizeof(__FPS_BROKER_REQUEST) ? FPS_RESP_OK : FPS_BROKER_ERR_CONNECTION;
+}
+
+uint8_t fpsBrokerSend(__FPS_BROKER_CONN* conn, __FPS_BROKER_REQUEST* request) {
+    return sendRequest(conn, request, -1);
+}
+
+uint8_t fpsBrokerReceive(__FPS_BROKER_CONN* conn, __FPS_BROKER_RESPONSE* response, uint8_t* data) {
+    struct {
+        __FPS_BROKER_RESPONSE header;
+        uint8_t data[FPS_BROKER_MAX_DATA];
+    } message;
+    ssize_t received;
+    do {
+        received = recv(conn->fd, &message, sizeof(message), 0);
+    } while (received < 0 && errno == EINTR);
+    if (received < (ssize_t)sizeof(__FPS_BROKER_RESPONSE) || received != (ssize_t)sizeof(__FPS_BROKER_RESPONSE) + message.header.length) {
+        return FPS_BROKER_ERR_CONNECTION;
+    }
+    *response = message.header;
+    if (data != NULL) memcpy(data, message.data, message.header.length);
+    return FPS_RESP_OK;
+}
+
+uint8_t fpsBrokerCall(__FPS_BROKER_CONN* conn, uint8_t op, uint8_t sensor, uint8_t priority, uint32_t arg0, uint32_t arg1, uint32_t arg2,
+                      __FPS_BROKER_RESPONSE* response, uint8_t* data) {
+    __FPS_BROKER_REQUEST request = { 0, op, sensor, priority, 0, { arg0, arg1, arg2 } };
+    if (fpsBrokerSend(conn, &request) != FPS_RESP_OK || fpsBrokerReceive(conn, response, data) != FPS_RESP_OK) {
+        return FPS_BROKER_ERR_CONNECTION;
+    }
+    return response->status;
+}
+/*
+*   @brief: create shared memory for image and template transfers and pass it to the broker. Offsets in
+*           FPS_BROKER_OP_GET_IMAGE, EXPORT_TEMPLATE and IMPORT_TEMPLATE are relative to conn->shm
+*   @parameter: connection without requests in flight
+*   @parameter: bytes, e.g. FPS_IMAGE_SIZE
+*   @return: 0 on success, FPS_BROKER_ERR_SHM if it can not be created, otherwise the status of the broker
+*
+*/
+uint8_t fpsBrokerAttachShm(__FPS_BROKER_CONN* conn, uint32_t size) {
+    __FPS_BROKER_REQUEST request = { 0, FPS_BROKER_OP_ATTACH_SHM, 0, 0, 0, { size, 0, 0 } };
+    __FPS_BROKER_RESPONSE response;
+    int fd = memfd_create("fps_broker", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) return FPS_BROKER_ERR_SHM;
+    void* shm = MAP_FAILED;
+    if (ftruncate(fd, size) == 0 && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) == 0) {  //the broker refuses memory that can shrink
+        shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (shm == MAP_FAILED) {
+        close(fd);
+        return FPS_BROKER_ERR_SHM;
+    }
+    uint8_t status = sendRequest(conn, &request, fd);
+    close(fd);  //the broker has its own descriptor now
+    if (status == FPS_RESP_OK) status = fpsBrokerReceive(conn, &response, NULL);
+    if (status == FPS_RESP_OK) status = response.status;
+    if (status != FPS_RESP_OK) {
+        munmap(shm, size);
+        return status;
+    }
+    if (conn->shm != NULL) munmap(conn->shm, conn->shmSize);
+    conn->shm = (uint8_t*)shm;
+    conn->shmSize = size;
+    return FPS_RESP_OK;
+}
+
+/********************************END OF FILE*****************************************************/
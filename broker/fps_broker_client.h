@@ -0,0 +1,35 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker client
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Connection of an application to fps_brokerd. fpsBrokerCall sends one
+ * request and waits for its response; fpsBrokerSend and
+ * fpsBrokerReceive keep several requests in flight, which the broker
+ * runs as one batch. fpsBrokerAttachShm creates the shared memory that
+ * images and templates are transferred through.
+ *
+ **************************************************************************/
+#ifndef FPS_BROKER_CLIENT_H
+#define FPS_BROKER_CLIENT_H
+#include "R30X_FPS.h"
+#include "fps_broker_proto.h"
+
+typedef struct {
+	  int fd;
+	  uint32_t nextTag;
+	  uint8_t* shm;  //shared memory, NULL until attached
+	  uint32_t shmSize;
+}__FPS_BROKER_CONN;
+
+int8_t	fpsBrokerConnect (__FPS_BROKER_CONN *conn, const char *socketPath); //0 on success, -1 on failure (see errno)
+void	fpsBrokerDisconnect (__FPS_BROKER_CONN *conn);
+uint8_t fpsBrokerAttachShm (__FPS_BROKER_CONN *conn, uint32_t size); //create and attach size bytes of shared memory, 0 on success
+uint8_t fpsBrokerSend (__FPS_BROKER_CONN *conn, __FPS_BROKER_REQUEST *request); //the tag is assigned, 0 on success
+uint8_t fpsBrokerReceive (__FPS_BROKER_CONN *conn, __FPS_BROKER_RESPONSE *response, uint8_t *data); //next response, data receives up to FPS_BROKER_MAX_DATA bytes (NULL to drop)
+uint8_t fpsBrokerCall (__FPS_BROKER_CONN *conn, uint8_t op, uint8_t sensor, uint8_t priority, uint32_t arg0, uint32_t arg1, uint32_t arg2,
+                       __FPS_BROKER_RESPONSE *response, uint8_t *data); //send and wait, the status of the response
+#endif
+
+/********************************END OF FILE*****************************************************/
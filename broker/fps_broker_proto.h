@@ -0,0 +1,85 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker protocol
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Messages between fps_brokerd and its clients on a SOCK_SEQPACKET Unix
+ * domain socket, one message per request and one per response, in host
+ * byte order (both ends are on the same machine).
+ *
+ * A request is a fixed __FPS_BROKER_REQUEST. A response is a fixed
+ * __FPS_BROKER_RESPONSE followed by length bytes of small data (index
+ * table, statistics). Images and templates never go through the socket:
+ * the client creates a memfd, sends it once with FPS_BROKER_OP_ATTACH_SHM
+ * (SCM_RIGHTS) and names an offset in it in every transfer request. The
+ * broker reads and writes the data there directly. The memfd must carry
+ * F_SEAL_SHRINK, otherwise a client could truncate it under the mapping
+ * of the broker and kill it with SIGBUS; the broker refuses other fds.
+ *
+ * Requests of a connection are answered in order; the tag is echoed so a
+ * client can keep several requests in flight.
+ *
+ **************************************************************************/
+#ifndef FPS_BROKER_PROTO_H
+#define FPS_BROKER_PROTO_H
+#include <stdint.h>
+
+#define FPS_BROKER_DEFAULT_SOCKET       "/run/fps_broker.sock"
+#define FPS_BROKER_MAX_DATA             256  //bytes of data after a response
+
+//operations, arg[] in brackets
+#define FPS_BROKER_OP_ATTACH_SHM        0x01  //[size] the memfd, sealed with F_SEAL_SHRINK, is in the ancillary data
+#define FPS_BROKER_OP_GENERATE_IMAGE    0x02  //generateImage
+#define FPS_BROKER_OP_GENERATE_CHAR     0x03  //[buffer] generateCharacter
+#define FPS_BROKER_OP_GENERATE_TEMPLATE 0x04  //generateTemplate
+#define FPS_BROKER_OP_SEARCH            0x05  //[buffer, start, count] searchLibrary
+#define FPS_BROKER_OP_IDENTIFY          0x06  //generateImage, generateCharacter and searchLibrary of the whole library
+#define FPS_BROKER_OP_VERIFY            0x07  //[location, threshold] verifyFinger
+#define FPS_BROKER_OP_SAVE              0x08  //[buffer, location] saveTemplate
+#define FPS_BROKER_OP_LOAD              0x09  //[buffer, location] loadTemplate
+#define FPS_BROKER_OP_DELETE            0x0A  //[start, count] deleteTemplate
+#define FPS_BROKER_OP_MATCH             0x0B  //matchTemplates
+#define FPS_BROKER_OP_TEMPLATE_COUNT    0x0C  //getTemplateCount
+#define FPS_BROKER_OP_READ_INDEX        0x0D  //[page] readIndexTable, FPS_INDEX_TABLE_LENGTH bytes of data
+#define FPS_BROKER_OP_GET_IMAGE         0x0E  //[offset] getImage, FPS_IMAGE_SIZE bytes into the shared memory
+#define FPS_BROKER_OP_EXPORT_TEMPLATE   0x0F  //[buffer, offset] character buffer, FPS_TEMPLATE_SIZE bytes into the shared memory
+#define FPS_BROKER_OP_IMPORT_TEMPLATE   0x10  //[buffer, offset] importCharacter from the shared memory
+#define FPS_BROKER_OP_STATS             0x11  //scheduler statistics, FPS_SCHED_PRIORITIES __FPS_SCHED_STATS as data
+
+//request flags
+#define FPS_BROKER_FLAG_CHAIN           0x01  //the next request runs without other clients in between, and is skipped if this one fails;
+                                              //a chain of more than 16 requests is answered with FPS_BROKER_ERR_REQUEST
+
+//status codes of the broker, the others are the return codes of the library functions
+#define FPS_BROKER_ERR_REQUEST          0xE0  //unknown operation or bad argument
+#define FPS_BROKER_ERR_SENSOR           0xE1  //no such sensor
+#define FPS_BROKER_ERR_SHM              0xE2  //no shared memory attached, or the transfer does not fit
+#define FPS_BROKER_ERR_SKIPPED          0xE3  //not executed because the request chained before it failed
+#define FPS_BROKER_ERR_CONNECTION       0xE4  //returned by the client functions when the broker can not be reached
+
+typedef struct {
+	  uint32_t tag;  //chosen by the client, echoed in the response
+	  uint8_t op;  //FPS_BROKER_OP_*
+	  uint8_t sensor;  //index of the module
+	  uint8_t priority;  //FPS_PRIORITY_IDENTIFY .. FPS_PRIORITY_BACKGROUND
+	  uint8_t flags;  //FPS_BROKER_FLAG_*
+	  uint32_t arg[3];
+}__FPS_BROKER_REQUEST;
+
+typedef struct {
+	  uint32_t tag;
+	  uint8_t op;
+	  uint8_t status;  //0 on success, the return code of the library function or FPS_BROKER_ERR_*
+	  uint16_t length;  //bytes of data after the response
+	  uint16_t fingerId;
+	  uint16_t matchScore;
+	  uint16_t templateCount;  //FPS_BROKER_OP_TEMPLATE_COUNT: templates stored in the library
+	  uint16_t waitTime;  //time the request waited for the sensor in 100 us steps, saturated
+}__FPS_BROKER_RESPONSE;
+
+_Static_assert(sizeof(__FPS_BROKER_REQUEST) == 20, "request layout");
+_Static_assert(sizeof(__FPS_BROKER_RESPONSE) == 16, "response layout");
+#endif
+
+/********************************END OF FILE*****************************************************/
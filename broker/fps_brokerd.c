@@ -0,0 +1,107 @@
+/*************************************************************************
+ *
+ * finger print library - sensor broker daemon
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Opens the modules on the given serial ports and serves them on a Unix
+ * domain socket until SIGINT or SIGTERM. The sensor index in requests is
+ * the order of the --device options. --pipeline sends chained saves and
+ * deletes with FPS_BROKER_PIPELINE_WINDOW commands on the line; only use
+ * it with modules that are known to buffer a command while busy.
+ *
+ * usage: fps_brokerd [--socket path] [--password n] [--address n]
+ *                    [--low-latency] [--pipeline] --device /dev/ttyUSB0 [--device ...]
+ *
+ **************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include "fps_broker.h"
+#include "R30X_linux_serial.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+int main(int argc, char** argv) {
+    static __FPS streams[FPS_BROKER_MAX_SENSORS];
+    static __FPS_LINUX_SERIAL serials[FPS_BROKER_MAX_SENSORS];
+    static __FPS_BROKER broker;
+    const char* devices[FPS_BROKER_MAX_SENSORS];
+    const char* socketPath = FPS_BROKER_DEFAULT_SOCKET;
+    uint32_t password = FPS_DEFAULT_PASSWORD;
+    uint32_t address = FPS_DEFAULT_ADDRESS;
+    uint8_t lowLatency = 0;
+    uint8_t pipeline = 0;
+    int deviceCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) socketPath = argv[++i];
+        else if (strcmp(argv[i], "--password") == 0 && i + 1 < argc) password = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--address") == 0 && i + 1 < argc) address = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--low-latency") == 0) lowLatency = 1;
+        else if (strcmp(argv[i], "--pipeline") == 0) pipeline = 1;
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc && deviceCount < FPS_BROKER_MAX_SENSORS) devices[deviceCount++] = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--socket path] [--password n] [--address n] [--low-latency] [--pipeline] --device tty [--device tty ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (deviceCount == 0) {
+        fprintf(stderr, "%s: no --device given\n", argv[0]);
+        return 2;
+    }
+
+    if (fpsBrokerInit(&broker) != 0) return 1;
+    if (pipeline) broker.pipelineWindow = FPS_BROKER_PIPELINE_WINDOW;
+    for (int i = 0; i < deviceCount; i++) {
+        R30X_linuxSerialInit(&serials[i], devices[i]);
+        serials[i].lowLatency = lowLatency;
+        serials[i].exclusive = 1;  //nobody else may open the module now
+        streams[i].port = &fpsLinuxSerialPort;
+        streams[i].portContext = &serials[i];
+        int8_t result = R30X_init(&streams[i], password, address);
+        if (result != FPS_RESP_OK) {
+            fprintf(stderr, "%s: %s\n", devices[i], result == -1 ? strerror(serials[i].lastError) : "no module answers with this password");
+            return 1;
+        }
+        fpsBrokerAddSensor(&broker, &streams[i]);
+        printf("sensor %d: %s, %u locations\n", i, devices[i], streams[i].templateCount);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t stopSignals, waitMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &waitMask);  //blocked in the broker threads, delivered in sigsuspend only
+
+    if (fpsBrokerStart(&broker, socketPath) != 0) {
+        fprintf(stderr, "%s: %s\n", socketPath, strerror(errno));
+        return 1;
+    }
+    printf("serving on %s\n", socketPath);
+    fflush(stdout);
+    while (!stopRequested) sigsuspend(&waitMask);
+
+    fpsBrokerStop(&broker);
+    printf("%llu requests in %llu batches from %llu connections\n", (unsigned long long)broker.requests,
+           (unsigned long long)broker.batches, (unsigned long long)broker.connections);
+    for (int i = 0; i < deviceCount; i++) R30X_closePort(&streams[i]);
+    fpsBrokerDestroy(&broker);
+    return 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,15 @@
+/*************************************************************************
+ *
+ * finger print library - size report helper
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * The .bss of this object is sizeof(__FPS) for the profile it is built with.
+ *
+ **************************************************************************/
+
+#include "R30X_FPS.h"
+
+__FPS fpsSizeProbe;
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,70 @@
+# Builds R30X_FPS.c once per feature profile and prints flash and RAM use.
+# Run through the size_report target, which passes:
+#   CC, SIZE, FLAGS (space separated), SOURCE_DIR, OUT_DIR, TARGET_NAME
+
+set(profiles full no_image no_template no_admin door)
+set(full_defines        -DFPS_PROFILE=FPS_PROFILE_FULL)
+set(no_image_defines    -DFPS_PROFILE=FPS_PROFILE_FULL -DFPS_CFG_IMAGE_TRANSFER=0)
+set(no_template_defines -DFPS_PROFILE=FPS_PROFILE_FULL -DFPS_CFG_TEMPLATE_TRANSFER=0)
+set(no_admin_defines    -DFPS_PROFILE=FPS_PROFILE_FULL -DFPS_CFG_ADMIN_SETTERS=0)
+set(door_defines        -DFPS_PROFILE=FPS_PROFILE_DOOR)
+
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+
+# returns text, data and bss of an object file from the berkeley output of size
+function(object_size object out_text out_data out_bss)
+  execute_process(COMMAND ${SIZE} ${object} OUTPUT_VARIABLE output RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${SIZE} ${object} failed")
+  endif()
+  string(REGEX MATCH "\n[ \t]*([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)" row "${output}")
+  set(${out_text} ${CMAKE_MATCH_1} PARENT_SCOPE)
+  set(${out_data} ${CMAKE_MATCH_2} PARENT_SCOPE)
+  set(${out_bss} ${CMAKE_MATCH_3} PARENT_SCOPE)
+endfunction()
+
+message("R30X_FPS size report (${TARGET_NAME}: ${CC} ${FLAGS})")
+message("profile       flash(text+data)  static RAM  sizeof(__FPS)  readSysPara stack  max stack")
+foreach(profile IN LISTS profiles)
+  set(dir ${OUT_DIR}/${profile})
+  file(MAKE_DIRECTORY ${dir})
+  execute_process(
+    COMMAND ${CC} ${flags} ${${profile}_defines} -fstack-usage -I${SOURCE_DIR}/source
+            -c ${SOURCE_DIR}/source/R30X_FPS.c -o ${dir}/R30X_FPS.o
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "building profile ${profile} failed")
+  endif()
+  execute_process(
+    COMMAND ${CC} ${flags} ${${profile}_defines} -fno-common -I${SOURCE_DIR}/source
+            -c ${SOURCE_DIR}/cmake/fps_size_probe.c -o ${dir}/fps_size_probe.o
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "building size probe for ${profile} failed")
+  endif()
+
+  object_size(${dir}/R30X_FPS.o text data bss)
+  object_size(${dir}/fps_size_probe.o probe_text probe_data probe_bss)
+  math(EXPR flash "${text} + ${data}")
+  math(EXPR ram "${data} + ${bss}")
+
+  # the compiler can split a function into parts (readSysPara.part.0), take the largest frame
+  set(sys_stack 0)
+  set(max_stack 0)
+  file(STRINGS ${dir}/R30X_FPS.su stack_lines)
+  foreach(line IN LISTS stack_lines)
+    if(line MATCHES ":([A-Za-z_0-9]+)[^:\t]*\t([0-9]+)\t")
+      if(CMAKE_MATCH_1 STREQUAL "readSysPara" AND CMAKE_MATCH_2 GREATER sys_stack)
+        set(sys_stack ${CMAKE_MATCH_2})
+      endif()
+      if(CMAKE_MATCH_2 GREATER max_stack)
+        set(max_stack ${CMAKE_MATCH_2})
+      endif()
+    endif()
+  endforeach()
+
+  string(LENGTH "${profile}" length)
+  math(EXPR pad "14 - ${length}")
+  string(REPEAT " " ${pad} spaces)
+  message("${profile}${spaces}${flash}\t\t ${ram}\t     ${probe_bss}\t\t    ${sys_stack}\t\t       ${max_stack}")
+endforeach()
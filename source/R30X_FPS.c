@@ -9,18 +9,37 @@
  **************************************************************************/
 
 #include "R30X_FPS.h"
-#ifdef __GNUC__
+#if defined __linux__ || defined __APPLE__
+#include <time.h>
+#elif defined __GNUC__
 extern void HAL_Delay(uint32_t Delay);
 #endif
 
-static delay_1ms(void) {
-#ifdef __GNUC__
+static void delay_1ms(void) {
+#if defined __linux__ || defined __APPLE__
+    struct timespec ts = { 0, 1000000L };
+    nanosleep(&ts, NULL);
+#elif defined __GNUC__
     HAL_Delay(1);
 #elif defined _MSC_VER
     for (int i = 0; i < 100000; i++) {}
 #endif
 }
 
+static uint32_t portRead(__FPS* stream, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+#if FPS_CFG_PORT_CONTEXT
+    if (stream->port != NULL) return stream->port->read(stream->portContext, pBuf, BytesToRead, timeout);
+#endif
+    return stream->read(pBuf, BytesToRead, timeout);
+}
+
+static uint32_t portWrite(__FPS* stream, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+#if FPS_CFG_PORT_CONTEXT
+    if (stream->port != NULL) return stream->port->write(stream->portContext, pBuf, BytesToWrite, timeout);
+#endif
+    return stream->write(pBuf, BytesToWrite, timeout);
+}
+
 /*
 *   @brief: initialize
 *   @parameter: pointer to finger print structure
@@ -30,12 +49,12 @@ static delay_1ms(void) {
 int8_t R30X_init(__FPS *stream, uint32_t password , uint32_t address ){
   stream->deviceAddress = address;
   resetParameters(stream);  //initialize and reset and all parameters
-  if (stream->initializePort(stream->deviceBaudrate) != FPS_RESP_OK) {
-      stream->deinitializePort();
+  if (R30X_openPort(stream, stream->deviceBaudrate) != FPS_RESP_OK) {
+      R30X_closePort(stream);
       return -1;
   }
   if (verifyPassword(stream, password) != FPS_RESP_OK) {
-      stream->deinitializePort();
+      R30X_closePort(stream);
       return -2;
   }
   stream->devicePassword = password;
@@ -54,17 +73,45 @@ void resetParameters (__FPS *stream) {
   stream->baudMultiplier = (uint16_t)(FPS_DEFAULT_BAUDRATE / 9600);
   stream->securityLevel = FPS_DEFAULT_SECURITY_LEVEL;  //threshold level for fingerprint matching
   stream->dataPacketLength = FPS_DEFAULT_RX_DATA_LENGTH;
+  stream->commandTimeout = FPS_DEFAULT_TIMEOUT;
 
   stream->rxPacketType = FPS_ID_COMMANDPACKET; //type of packet
   stream->rxConfirmationCode = FPS_CMD_VERIFYPASSWORD; //
   stream->rxDataBufferLength = 0;
-  memset(stream->rxDataBuffer, 0, FPS_DEFAULT_RX_DATA_LENGTH);
+  memset(stream->rxDataBuffer, 0, FPS_CFG_RX_DATA_LENGTH);
+#if FPS_CFG_DEVICE_NAME
   memset(stream->deviceName, 0, 32);
+#endif
   stream->fingerId = 0; //initialize them
   stream->matchScore = 0;
   stream->templateCount = 0;
 }
 /*
+*   @brief: initialize the serial port through stream->port if set, otherwise through stream->initializePort
+*   @parameter: pointer to finger print structure
+*   @parameter: baudrate
+*   @return: 0 on success
+*
+*/
+uint8_t R30X_openPort(__FPS *stream, uint32_t baud) {
+#if FPS_CFG_PORT_CONTEXT
+    if (stream->port != NULL) return stream->port->initializePort(stream->portContext, baud);
+#endif
+    return stream->initializePort(baud);
+}
+/*
+*   @brief: deinitialize the serial port
+*   @parameter: pointer to finger print structure
+*   @return: 0 on success
+*
+*/
+uint8_t R30X_closePort(__FPS *stream) {
+#if FPS_CFG_PORT_CONTEXT
+    if (stream->port != NULL) return stream->port->deinitializePort(stream->portContext);
+#endif
+    return stream->deinitializePort();
+}
+/*
 *   @brief: send fingerprint instruction packet
 *   @parameter: pointer to finger print structure
 *   @parameter: command to be performed by module
@@ -98,11 +145,46 @@ void sendPacket (__FPS *stream, uint8_t command, uint8_t* data , uint16_t dataLe
     ckeck_arr[0] = (checksum >> 8) & 0xff;
     ckeck_arr[1] = (checksum) & 0xff;
 
-    stream->write(packet,10,5);
+    portWrite(stream, packet,10,5);
     if (data != NULL) {
-        stream->write(data, dataLength, 250);
+        portWrite(stream, data, dataLength, 250);
+    }
+  portWrite(stream, ckeck_arr,2,5);
+}
+/*
+*   @brief: send one data packet of a multi packet transfer (template or image download)
+*   @parameter: pointer to finger print structure
+*   @parameter: FPS_ID_DATAPACKET, or FPS_ID_ENDDATAPACKET for the last packet
+*   @parameter: data
+*   @parameter: length of data, at most stream->dataPacketLength
+*   @return: none
+*
+*/
+void sendDataPacket (__FPS *stream, uint8_t packetType, uint8_t* data , uint16_t dataLength) {
+    uint8_t packet[9];
+    uint16_t packet_length = dataLength + 2;// 2 bytes checksum
+    uint16_t checksum = 0;
+    uint8_t ckeck_arr[2];
+    packet[0] = FPS_ID_STARTCODE_H;
+    packet[1] = FPS_ID_STARTCODE_L;
+    packet[2] = (stream->deviceAddress >> 24) & 0xff;
+    packet[3] = (stream->deviceAddress >> 16) & 0xff;
+    packet[4] = (stream->deviceAddress >> 8) & 0xff;
+    packet[5] = (stream->deviceAddress ) & 0xff;
+    packet[6] = packetType;
+    packet[7] = (packet_length >> 8) & 0xff;
+    packet[8] = (packet_length ) & 0xff;
+
+    checksum = packet[6] + packet[7] + packet[8];
+    for (uint16_t i = 0; i < dataLength; i++) {
+        checksum += data[i];
     }
-  stream->write(ckeck_arr,2,5);
+    ckeck_arr[0] = (checksum >> 8) & 0xff;
+    ckeck_arr[1] = (checksum) & 0xff;
+
+    portWrite(stream, packet, 9, 5);
+    portWrite(stream, data, dataLength, 250);
+    portWrite(stream, ckeck_arr, 2, 5);
 }
 /*
 *   @brief: receive fingerprint instruction packet
@@ -117,11 +199,11 @@ uint8_t receivePacket (__FPS *stream, uint32_t timeout) {
   uint32_t time = 0;
   uint16_t checksum = 0;
 
-  uint16_t read_bytes = stream->read(serialBuffer, 9, 1);
+  uint16_t read_bytes = portRead(stream, serialBuffer, 9, 1);
   while (read_bytes < 9) {
-      read_bytes += stream->read(serialBuffer + read_bytes, 9 - read_bytes, 1);
+      read_bytes += portRead(stream, serialBuffer + read_bytes, 9 - read_bytes, 1);
       time++;
-      if (time == timeout) return FPS_RX_TIMEOUT;
+      if (time >= timeout) return FPS_RX_TIMEOUT;
       delay_1ms();
   }
   if(serialBuffer[0] != FPS_ID_STARTCODE_H || serialBuffer[1] != FPS_ID_STARTCODE_L) return FPS_RX_BADPACKET;
@@ -133,35 +215,36 @@ uint8_t receivePacket (__FPS *stream, uint32_t timeout) {
 
   stream->rxPacketType = serialBuffer[6];
   stream->rxDataBufferLength = serialBuffer[7] << 8 | serialBuffer[8];
+  if (stream->rxDataBufferLength < 3 || stream->rxDataBufferLength - 3 > FPS_CFG_RX_DATA_LENGTH) return FPS_RX_BADPACKET; //garbage, e.g. wrong baudrate
   stream->rxDataBufferLength -= 3;
 
   checksum = serialBuffer[6] + serialBuffer[7] + serialBuffer[8];
   // read confimation code
   time = 0;
-  while (stream->read(&stream->rxConfirmationCode, 1, 1) < 1) {
+  while (portRead(stream, &stream->rxConfirmationCode, 1, 1) < 1) {
       time++;
       delay_1ms();
-      if( time == timeout) return FPS_RX_TIMEOUT;
+      if( time >= timeout) return FPS_RX_TIMEOUT;
   }
   checksum += stream->rxConfirmationCode;
   //read data
   if (stream->rxDataBufferLength) {
       time = 0;
-      read_bytes = stream->read(stream->rxDataBuffer, stream->rxDataBufferLength, timeout);
+      read_bytes = portRead(stream, stream->rxDataBuffer, stream->rxDataBufferLength, timeout);
       while (read_bytes < stream->rxDataBufferLength) {
-          read_bytes += stream->read(stream->rxDataBuffer + read_bytes, stream->rxDataBufferLength - read_bytes, 10);
+          read_bytes += portRead(stream, stream->rxDataBuffer + read_bytes, stream->rxDataBufferLength - read_bytes, 10);
           time += 10;
-          if (time == timeout) return FPS_RX_TIMEOUT;
+          if (time >= timeout) return FPS_RX_TIMEOUT;
           delay_1ms();
       }
   }
   // read ckecksum
   time = 0;
-  read_bytes = stream->read(serialBuffer, 2, 2);
+  read_bytes = portRead(stream, serialBuffer, 2, 2);
   while (read_bytes < 2) {
-      read_bytes += stream->read(serialBuffer + read_bytes, 2 - read_bytes, 1);
+      read_bytes += portRead(stream, serialBuffer + read_bytes, 2 - read_bytes, 1);
       time ++;
-      if (time == timeout) return FPS_RX_TIMEOUT;
+      if (time >= timeout) return FPS_RX_TIMEOUT;
       delay_1ms();
   }
   for (uint16_t i = 0; i < stream->rxDataBufferLength; i++) checksum += stream->rxDataBuffer[i];
@@ -181,11 +264,11 @@ uint8_t receiveDataPacket(__FPS* stream, uint8_t *receive_buffer, uint16_t* rece
     uint32_t time = 0;
     uint16_t checksum = 0;
 
-    uint16_t read_bytes = stream->read(serialBuffer, 9, 1);
+    uint16_t read_bytes = portRead(stream, serialBuffer, 9, 1);
     while (read_bytes < 9) {
-        read_bytes += stream->read(serialBuffer + read_bytes, 9 - read_bytes, 1);
+        read_bytes += portRead(stream, serialBuffer + read_bytes, 9 - read_bytes, 1);
         time++;
-        if (time == timeout) return FPS_RX_TIMEOUT;
+        if (time >= timeout) return FPS_RX_TIMEOUT;
         delay_1ms();
     }
     if (serialBuffer[0] != FPS_ID_STARTCODE_H || serialBuffer[1] != FPS_ID_STARTCODE_L) return FPS_RX_BADPACKET;
@@ -197,6 +280,7 @@ uint8_t receiveDataPacket(__FPS* stream, uint8_t *receive_buffer, uint16_t* rece
 
     stream->rxPacketType = serialBuffer[6];
     stream->rxDataBufferLength = serialBuffer[7] << 8 | serialBuffer[8];
+    if (stream->rxDataBufferLength < 2 || stream->rxDataBufferLength - 2 > FPS_CFG_MAX_DATA_PACKET_LENGTH) return FPS_RX_BADPACKET;
     stream->rxDataBufferLength -= 2;
     *receive_length = stream->rxDataBufferLength;
 
@@ -204,21 +288,21 @@ uint8_t receiveDataPacket(__FPS* stream, uint8_t *receive_buffer, uint16_t* rece
     //read data
     if (stream->rxDataBufferLength) {
         time = 0;
-        read_bytes = stream->read(receive_buffer, stream->rxDataBufferLength, timeout);
+        read_bytes = portRead(stream, receive_buffer, stream->rxDataBufferLength, timeout);
         while (read_bytes < stream->rxDataBufferLength) {
-            read_bytes += stream->read(receive_buffer + read_bytes, stream->rxDataBufferLength - read_bytes, 10);
+            read_bytes += portRead(stream, receive_buffer + read_bytes, stream->rxDataBufferLength - read_bytes, 10);
             time += 10;
-            if (time == timeout) return FPS_RX_TIMEOUT;
+            if (time >= timeout) return FPS_RX_TIMEOUT;
             delay_1ms();
         }
     }
     // read ckecksum
     time = 0;
-    read_bytes = stream->read(serialBuffer, 2, 2);
+    read_bytes = portRead(stream, serialBuffer, 2, 2);
     while (read_bytes < 2) {
-        read_bytes += stream->read(serialBuffer + read_bytes, 2 - read_bytes, 1);
+        read_bytes += portRead(stream, serialBuffer + read_bytes, 2 - read_bytes, 1);
         time++;
-        if (time == timeout) return FPS_RX_TIMEOUT;
+        if (time >= timeout) return FPS_RX_TIMEOUT;
         delay_1ms();
     }
     for (uint16_t i = 0; i < stream->rxDataBufferLength; i++) checksum += receive_buffer[i];
@@ -226,6 +310,188 @@ uint8_t receiveDataPacket(__FPS* stream, uint8_t *receive_buffer, uint16_t* rece
     return FPS_RX_OK;
 }
 /*
+*   @brief: operations of the library, index into commandTable
+*
+*/
+enum {
+  OP_VERIFYPASSWORD,
+  OP_SETPASSWORD,
+  OP_SETADDRESS,
+  OP_SETSYSPARA,
+  OP_PORTCONTROL,
+  OP_READSYSPARA,
+  OP_TEMPLATECOUNT,
+  OP_READINDEXTABLE,
+  OP_RANGESEARCH,
+  OP_FULLSEARCH,
+  OP_SCANFINGER,
+  OP_EXPORTIMAGE,
+  OP_IMPORTIMAGE,
+  OP_IMAGETOCHARACTER,
+  OP_GENERATETEMPLATE,
+  OP_EXPORTTEMPLATE,
+  OP_IMPORTTEMPLATE,
+  OP_STORETEMPLATE,
+  OP_LOADTEMPLATE,
+  OP_DELETETEMPLATE,
+  OP_CLEARLIBRARY,
+  OP_MATCHTEMPLATES,
+  OP_SEARCHLIBRARY,
+  OP_GETRANDOMCODE,
+  OP_READNOTEPAD,
+  OP_WRITENOTEPAD,
+  OP_COUNT
+};
+
+static const __FPS_COMMAND commandTable[OP_COUNT] = {
+  [OP_VERIFYPASSWORD]   = { FPS_CMD_VERIFYPASSWORD, FPS_ARGS(FPS_ARG_U32, 0, 0, 0), FPS_REPLY_NONE, 0, 0 },
+  [OP_SETPASSWORD]      = { FPS_CMD_SETPASSWORD, FPS_ARGS(FPS_ARG_U32, 0, 0, 0), FPS_REPLY_NONE, 0, 0 },
+  [OP_SETADDRESS]       = { FPS_CMD_SETDEVICEADDRESS, FPS_ARGS(FPS_ARG_U32, 0, 0, 0), FPS_REPLY_NONE, 0, 0 },
+  [OP_SETSYSPARA]       = { FPS_CMD_SETSYSPARA, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U8, 0, 0), FPS_REPLY_NONE, 0, 0 },  //register, value
+  [OP_PORTCONTROL]      = { FPS_CMD_PORTCONTROL, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_NONE, 0, 0 },
+  [OP_READSYSPARA]      = { FPS_CMD_READALL_SYSPARA, 0, FPS_REPLY_NONE, FPS_CMD_FLAG_DATA_IN, 0 },
+  [OP_TEMPLATECOUNT]    = { FPS_CMD_TEMPLATECOUNT, 0, FPS_REPLY_COUNT, 0, 0 },
+  [OP_READINDEXTABLE]   = { FPS_CMD_READINDEXTABLE, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_TABLE, 0, 0 },  //page
+  [OP_RANGESEARCH]      = { FPS_CMD_SCANANDRANGESEARCH, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, FPS_ARG_U16, 0), FPS_REPLY_ID_SCORE, 0, 0 },  //capture timeout, start, count
+  [OP_FULLSEARCH]       = { FPS_CMD_SCANANDFULLSEARCH, 0, FPS_REPLY_ID_SCORE, 0, 3000 },
+  [OP_SCANFINGER]       = { FPS_CMD_SCANFINGER, 0, FPS_REPLY_NONE, 0, 0 },
+  [OP_EXPORTIMAGE]      = { FPS_CMD_EXPORTIMAGE, 0, FPS_REPLY_NONE, FPS_CMD_FLAG_DATA_IN | FPS_CMD_FLAG_DATA_EXACT, 0 },
+  [OP_IMPORTIMAGE]      = { FPS_CMD_IMPORTIMAGE, 0, FPS_REPLY_NONE, FPS_CMD_FLAG_DATA_OUT, 0 },
+  [OP_IMAGETOCHARACTER] = { FPS_CMD_IMAGETOCHARACTER, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_NONE, 0, 0 },  //buffer
+  [OP_GENERATETEMPLATE] = { FPS_CMD_GENERATETEMPLATE, 0, FPS_REPLY_NONE, 0, 0 },
+  [OP_EXPORTTEMPLATE]   = { FPS_CMD_EXPORTTEMPLATE, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_NONE, FPS_CMD_FLAG_DATA_IN | FPS_CMD_FLAG_DATA_EXACT, 0 },  //buffer
+  [OP_IMPORTTEMPLATE]   = { FPS_CMD_IMPORTTEMPLATE, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_NONE, FPS_CMD_FLAG_DATA_OUT, 0 },  //buffer
+  [OP_STORETEMPLATE]    = { FPS_CMD_STORETEMPLATE, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, 0, 0), FPS_REPLY_NONE, 0, 0 },  //buffer, location
+  [OP_LOADTEMPLATE]     = { FPS_CMD_LOADTEMPLATE, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, 0, 0), FPS_REPLY_NONE, 0, 0 },  //buffer, location
+  [OP_DELETETEMPLATE]   = { FPS_CMD_DELETETEMPLATE, FPS_ARGS(FPS_ARG_U16, FPS_ARG_U16, 0, 0), FPS_REPLY_NONE, 0, 0 },  //start, count
+  [OP_CLEARLIBRARY]     = { FPS_CMD_CLEARLIBRARY, 0, FPS_REPLY_NONE, 0, 0 },
+  [OP_MATCHTEMPLATES]   = { FPS_CMD_MATCHTEMPLATES, 0, FPS_REPLY_SCORE, 0, 0 },
+  [OP_SEARCHLIBRARY]    = { FPS_CMD_HISPEEDSEARCH, FPS_ARGS(FPS_ARG_U8, FPS_ARG_U16, FPS_ARG_U16, 0), FPS_REPLY_ID_SCORE, 0, 0 },  //buffer, start, count
+  [OP_GETRANDOMCODE]    = { FPS_CMD_GETRANDOMCODE, 0, FPS_REPLY_U32, 0, 0 },
+  [OP_READNOTEPAD]      = { FPS_CMD_READNOTEPAD, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_TABLE, 0, 0 },  //page
+  [OP_WRITENOTEPAD]     = { FPS_CMD_WRITENOTEPAD, FPS_ARGS(FPS_ARG_U8, 0, 0, 0), FPS_REPLY_NONE, FPS_CMD_FLAG_DATA_ARGS, 0 },  //page, then 32 bytes
+};
+
+static uint16_t readU16(const uint8_t* data) {
+  return (uint16_t)((data[0] << 8) | data[1]);  //high byte first, like every value of the protocol
+}
+
+//fields of an acknowledge with FPS_RESP_OK
+static uint8_t decodeReply(__FPS *stream, uint8_t reply, uint8_t* data) {
+  static const uint8_t replyLength[] = { 0, 4, 2, 2, 4, FPS_INDEX_TABLE_LENGTH };
+  if (stream->rxDataBufferLength < replyLength[reply]) return FPS_RX_BADPACKET;
+  switch (reply) {
+  case FPS_REPLY_ID_SCORE:
+    stream->fingerId = readU16(stream->rxDataBuffer);
+    stream->matchScore = readU16(stream->rxDataBuffer + 2);
+    break;
+  case FPS_REPLY_SCORE:
+    stream->matchScore = readU16(stream->rxDataBuffer);
+    break;
+  case FPS_REPLY_COUNT:
+    stream->templateCount = readU16(stream->rxDataBuffer);
+    break;
+  case FPS_REPLY_U32: {
+    uint32_t value = ((uint32_t)readU16(stream->rxDataBuffer) << 16) | readU16(stream->rxDataBuffer + 2);
+    memcpy(data, &value, sizeof(value));
+    break;
+  }
+  case FPS_REPLY_TABLE:
+    memcpy(data, stream->rxDataBuffer, FPS_INDEX_TABLE_LENGTH);
+    break;
+  default:
+    break;
+  }
+  return FPS_RESP_OK;
+}
+
+//data packets after the acknowledge until the end packet. With exact the sink must be filled completely
+static uint8_t receiveData(__FPS *stream, uint8_t* sink, uint32_t capacity, uint8_t exact) {
+#if FPS_CFG_IMAGE_TRANSFER || FPS_CFG_TEMPLATE_TRANSFER
+  uint8_t scratch[FPS_CFG_MAX_DATA_PACKET_LENGTH];  //packets that are discarded, or may not fit the end of the sink
+#endif
+  uint32_t index = 0;
+  uint16_t len;
+  do {
+    uint8_t* target = sink + index;
+    if (sink == NULL || index + FPS_CFG_MAX_DATA_PACKET_LENGTH > capacity) {
+#if FPS_CFG_IMAGE_TRANSFER || FPS_CFG_TEMPLATE_TRANSFER
+      target = scratch;
+#else
+      return FPS_RESP_RECIEVEERR; //more data than the buffer holds
+#endif
+    }
+    uint8_t response = receiveDataPacket(stream, target, &len, stream->commandTimeout);
+    if (response != FPS_RX_OK) return response;
+    if (sink != NULL && target != sink + index) {
+      if (index + len > capacity) return FPS_RESP_RECIEVEERR; //more data than the buffer holds
+      memcpy(sink + index, target, len);
+    }
+    index += len;
+  } while (stream->rxPacketType == FPS_ID_DATAPACKET);
+  if (stream->rxPacketType != FPS_ID_ENDDATAPACKET) return FPS_RESP_RECIEVEERR;
+  if (exact && sink != NULL && index != capacity) return FPS_RESP_RECIEVEERR; //fewer bytes, the rest of the sink is not data
+  return FPS_RESP_OK;
+}
+
+//data of the host as data packets of stream->dataPacketLength bytes
+static void sendData(__FPS *stream, uint8_t* data, uint32_t dataLength) {
+  uint16_t packetLength = stream->dataPacketLength;
+  if (packetLength == 0 || packetLength > FPS_CFG_MAX_DATA_PACKET_LENGTH) packetLength = FPS_CFG_MAX_DATA_PACKET_LENGTH;
+  for (uint32_t index = 0; index < dataLength; index += packetLength) {
+    uint16_t len = dataLength - index < packetLength ? (uint16_t)(dataLength - index) : packetLength;
+    sendDataPacket(stream, index + len >= dataLength ? FPS_ID_ENDDATAPACKET : FPS_ID_DATAPACKET, data + index, len);
+  }
+}
+
+/*
+*   @brief: send a command and receive its reply as described by a command descriptor. Every command of the library goes
+*           through here: the arguments are packed high byte first, the reply fields are decoded into the stream
+*           (fingerId, matchScore, templateCount) or into data, and data packets are received or sent
+*   @parameter: pointer to finger print structure
+*   @parameter: command descriptor
+*   @parameter: one value per argument of the descriptor, NULL if it has none
+*   @parameter: FPS_REPLY_U32, FPS_REPLY_TABLE and FPS_CMD_FLAG_DATA_IN: receives the data, NULL discards data packets.
+*               FPS_CMD_FLAG_DATA_OUT and FPS_CMD_FLAG_DATA_ARGS: the data to send
+*   @parameter: size of data in bytes
+*   @return: FPS_RESP_OK or 0 on success, the confirmation code if the module reports an error, otherwise the FPS_RX_* code.
+*            The confirmation code is also in stream->rxConfirmationCode
+*
+*/
+uint8_t R30X_execute (__FPS *stream, const __FPS_COMMAND *command, const uint32_t *args, uint8_t *data, uint32_t dataLength) {
+  uint8_t packed[16 + FPS_NOTEPAD_PAGE_SIZE];
+  uint16_t length = 0;
+  for (uint8_t layout = command->args, i = 0; layout != 0; layout >>= 2, i++) {
+    uint8_t width = (layout & 3) == FPS_ARG_U32 ? 4 : (layout & 3);
+    while (width-- > 0) packed[length++] = (uint8_t)(args[i] >> (8 * width));
+  }
+  if (command->flags & FPS_CMD_FLAG_DATA_ARGS) {
+    if (length + dataLength > sizeof(packed)) return FPS_BAD_VALUE;
+    memcpy(packed + length, data, dataLength);
+    length += (uint16_t)dataLength;
+  }
+
+  sendPacket(stream, command->opcode, length ? packed : NULL, length); //send the command and data
+  uint8_t response = receivePacket(stream, command->timeout ? command->timeout : stream->commandTimeout); //read response
+  if (response != FPS_RX_OK) { //return packet receive error code
+    return response;
+  }
+  if (stream->rxConfirmationCode != FPS_RESP_OK) { //the module reports an error
+    if (command->reply == FPS_REPLY_ID_SCORE || command->reply == FPS_REPLY_SCORE) {
+      //fingerId = 0 doesn't mean the match was found at location 0
+      //instead it means an error. check the confirmation code to determine the problem
+      stream->fingerId = 0;
+      stream->matchScore = 0;
+    }
+    return stream->rxConfirmationCode;
+  }
+  response = decodeReply(stream, command->reply, data);
+  if (response != FPS_RESP_OK) return response;
+  if (command->flags & FPS_CMD_FLAG_DATA_IN) return receiveData(stream, data, dataLength, command->flags & FPS_CMD_FLAG_DATA_EXACT);
+  if (command->flags & FPS_CMD_FLAG_DATA_OUT) sendData(stream, data, dataLength);
+  return FPS_RESP_OK;
+}
+/*
 *   @brief: verifyPassword
 *   @parameter: pointer to finger print structure
 *   @parameter: device password
@@ -233,50 +499,28 @@ uint8_t receiveDataPacket(__FPS* stream, uint8_t *receive_buffer, uint16_t* rece
 *
 */
 uint8_t verifyPassword (__FPS *stream, uint32_t inputPassword) {
-  uint8_t inputPasswordBytes[4] = {0};  //to store the split password
-  inputPasswordBytes[0] = (inputPassword >> 24) & 0xFFU;
-  inputPasswordBytes[1] = (inputPassword >> 16) & 0xFFU;
-  inputPasswordBytes[2] = (inputPassword >> 8) & 0xFFU;
-  inputPasswordBytes[3] = (inputPassword) & 0xFFU;
-
-  sendPacket(stream, FPS_CMD_VERIFYPASSWORD, inputPasswordBytes, 4); //send the command and data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if (response == FPS_RX_OK) { //if the response packet is valid
-      if (stream->rxConfirmationCode == FPS_RESP_OK) {
-          //save the input password if it is correct
-          //this is actually redundant, but can make sure the right password is available to execute further commands
-          stream->devicePassword = inputPassword;
-          return FPS_RESP_OK; //password is correct
-      }
+  uint8_t response = R30X_execute(stream, &commandTable[OP_VERIFYPASSWORD], &inputPassword, NULL, 0);
+  if (response == FPS_RESP_OK) {
+      //save the input password if it is correct
+      //this is actually redundant, but can make sure the right password is available to execute further commands
+      stream->devicePassword = inputPassword;
   }
-  return response; //return packet receive error code
-
+  return response;
 }
+#if FPS_CFG_ADMIN_SETTERS
 /*
 *   @brief: setPassword of fingerprint
 *   @parameter: pointer to finger print structure
-*   @parameter: desired password 
+*   @parameter: desired password
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t setPassword (__FPS *stream, uint32_t inputPassword) {
-    uint8_t inputPasswordBytes[4] = { 0 };  //to store the split password
-    inputPasswordBytes[0] = (inputPassword >> 24) & 0xFFU;
-    inputPasswordBytes[1] = (inputPassword >> 16) & 0xFFU;
-    inputPasswordBytes[2] = (inputPassword >> 8) & 0xFFU;
-    inputPasswordBytes[3] = (inputPassword) & 0xFFU;
-
-  sendPacket(stream, FPS_CMD_SETPASSWORD, inputPasswordBytes, 4); //send the command and data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confrim code will be saved when the response is received
-      stream->devicePassword = inputPassword; //save the new password (Long)
-	  return FPS_RESP_OK; //password setting complete
-    }
+  uint8_t response = R30X_execute(stream, &commandTable[OP_SETPASSWORD], &inputPassword, NULL, 0);
+  if (response == FPS_RESP_OK) {
+    stream->devicePassword = inputPassword; //save the new password (Long)
   }
-  return response; //return packet receive error code
+  return response;
 }
 /*
 *   @brief: setAddress
@@ -286,55 +530,34 @@ uint8_t setPassword (__FPS *stream, uint32_t inputPassword) {
 *
 */
 uint8_t setAddress (__FPS *stream ,uint32_t address) {
-  uint8_t addressArray[4] = {0}; //just so that we do not need to alter the existing address before successfully changing it
-  addressArray[0] = (address >> 24) & 0xFF;
-  addressArray[1] = (address >> 16) & 0xFF;
-  addressArray[2] = (address >> 8) & 0xFF;
-  addressArray[3] = (address) & 0xFF;
-
-  sendPacket(stream, FPS_CMD_SETDEVICEADDRESS, addressArray, 4); //send the command and data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if( stream->rxConfirmationCode == FPS_RESP_OK ) { //the confrim code will be saved when the response is received
-        stream->deviceAddress = address; //save the new address
-        return FPS_RESP_OK; //address setting complete
-    }
+  uint8_t response = R30X_execute(stream, &commandTable[OP_SETADDRESS], &address, NULL, 0);
+  if (response == FPS_RESP_OK) {
+    stream->deviceAddress = address; //save the new address
   }
-  return response; //return packet receive error code
+  return response;
 }
 /*
 *   @brief: setBaudrate
 *   @parameter: pointer to finger print structure
 *   @parameter: new buadrate for device
-*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*   @return: on success FPS_RESP_OK or 0 , FPS_RESP_COMPORTERR if the serial port can not be opened again
+*            with the new baudrate (the module runs at the new baudrate anyway)
 *
 */
 uint8_t setBaudrate (__FPS *stream ,uint32_t baud) {
-  uint8_t baudNumber = baud / 9600; //check if the baudrate is a multiple of 9600
-  uint8_t dataArray[2] = {0};
-
-  if((baudNumber > 0) && (baudNumber < 13)) { //should be between 1 (9600bps) and 12 (115200bps)
-    dataArray[0] = 4;  //the code for the system parameter number, 4 means baudrate
-    dataArray[1] = baudNumber; 
-
-    sendPacket(stream, FPS_CMD_SETSYSPARA, dataArray, 2); //send the command and data
-    uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-    if(response == FPS_RX_OK) { //if the response packet is valid
-      if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-          stream->deinitializePort();
-          if (stream->initializePort(stream->deviceBaudrate) == FPS_RESP_OK) {
-              stream->deviceBaudrate = baud;
-              return FPS_RESP_OK; //baudrate setting complete
-        }
-      }
-    }
-   return response; //return packet receive error code
-  }
-  else {
+  uint32_t args[2] = { 4, baud / 9600 };  //the code for the system parameter number, 4 means baudrate
+  if ((args[1] < 1) || (args[1] > 12)) { //should be between 1 (9600bps) and 12 (115200bps)
     return FPS_BAD_VALUE;
   }
+  uint8_t response = R30X_execute(stream, &commandTable[OP_SETSYSPARA], args, NULL, 0);
+  if (response == FPS_RESP_OK) {
+    //the module switches after the acknowledge, reopen the port at the new baudrate
+    stream->baudMultiplier = (uint16_t)args[1];
+    stream->deviceBaudrate = args[1] * 9600;
+    R30X_closePort(stream);
+    if (R30X_openPort(stream, stream->deviceBaudrate) != FPS_RESP_OK) return FPS_RESP_COMPORTERR;
+  }
+  return response;
 }
 /*
 *   @brief: setSecurityLevel
@@ -344,26 +567,15 @@ uint8_t setBaudrate (__FPS *stream ,uint32_t baud) {
 *
 */
 uint8_t setSecurityLevel (__FPS *stream ,uint8_t level) {
-  uint8_t dataArray[2] = {0};
-
-  if((level > 0) && (level < 6)) { //should be between 1 and 5
-    dataArray[0] =  5; //the code for the system parameter number, 5 means the security level
-    dataArray[1] = level;
-
-    sendPacket(stream , FPS_CMD_SETSYSPARA, dataArray, 2); //send the command and data
-    uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-    if(response == FPS_RX_OK) { //if the response packet is valid
-      if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-        stream->securityLevel = level;  //save new value
-        return FPS_RESP_OK; //security level setting complete
-      }
-    }
-    return response; //return packet receive error code
+  uint32_t args[2] = { 5, level };  //the code for the system parameter number, 5 means the security level
+  if ((level < 1) || (level > 5)) { //should be between 1 and 5
+    return FPS_BAD_VALUE;
   }
-  else {
-    return FPS_BAD_VALUE; //the received parameter is invalid
+  uint8_t response = R30X_execute(stream, &commandTable[OP_SETSYSPARA], args, NULL, 0);
+  if (response == FPS_RESP_OK) {
+    stream->securityLevel = level;  //save new value
   }
+  return response;
 }
 /*
 *   @brief: setDataLength
@@ -373,346 +585,210 @@ uint8_t setSecurityLevel (__FPS *stream ,uint8_t level) {
 *
 */
 uint8_t setDataLength (__FPS *stream ,uint16_t length) {
-  uint8_t dataArray[2] = {0};
-
-  if((length == 32) || (length == 64) || (length == 128) || (length == 256)) { //should be 32, 64, 128 or 256 bytes
-    if(length == 32)
-      dataArray[1] = 0;  //low byte
-    else if(length == 64)
-      dataArray[1] = 1;  //low byte
-    else if(length == 128)
-      dataArray[1] = 2;  //low byte
-    else if(length == 256)
-      dataArray[1] = 3;  //low byte
+  uint32_t args[2] = { 6, 0 };  //the code for the system parameter number, 6 means the data length
+  if (length == 32) args[1] = 0;
+  else if (length == 64) args[1] = 1;
+  else if (length == 128) args[1] = 2;
+  else if (length == 256) args[1] = 3;
+  else return FPS_BAD_VALUE; //should be 32, 64, 128 or 256 bytes
 
-    dataArray[0] = 6; //the code for the system parameter number
-    sendPacket(stream, FPS_CMD_SETSYSPARA, dataArray, 2); //send the command and data
-    uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-    if(response == FPS_RX_OK) { //if the response packet is valid
-      if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-        stream->dataPacketLength = length;  //save the new data length
-		return FPS_RESP_OK; //length setting complete
-      }
-    }
-    return response; //return packet receive error code
-  }
-  else {
-    return FPS_BAD_VALUE; //the received parameter is invalid
+  uint8_t response = R30X_execute(stream, &commandTable[OP_SETSYSPARA], args, NULL, 0);
+  if (response == FPS_RESP_OK) {
+    stream->dataPacketLength = length;  //save the new data length
   }
+  return response;
 }
 /*
-*   @brief:
+*   @brief: turn the communication port of the module on or off
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
+*   @parameter: 1 on, 0 off
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t portControl (__FPS *stream ,uint8_t value) {
-  uint8_t dataArray[1] = {0};
-
-  if((value == 0) || (value == 1)) { //should be either 1 or 0
-    dataArray[0] = value;
-    sendPacket(stream, FPS_CMD_PORTCONTROL, dataArray, 1); //send the command and data
-    uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-    if(response == FPS_RX_OK) { //if the response packet is valid
-      if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-        return FPS_RESP_OK; //port setting complete
-      }
-    }
-    return response; //return packet receive error code
-  }
-  else {
-    return FPS_BAD_VALUE; //the received parameter is invalid
+  uint32_t args[1] = { value };
+  if ((value != 0) && (value != 1)) { //should be either 1 or 0
+    return FPS_BAD_VALUE;
   }
+  return R30X_execute(stream, &commandTable[OP_PORTCONTROL], args, NULL, 0);
 }
+#endif
 /*
-*   @brief:
+*   @brief: read the system parameters: library size, security level, address, packet length, baudrate and the device name
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t readSysPara(__FPS *stream) {
-  sendPacket(stream, FPS_CMD_READALL_SYSPARA, NULL , 0); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-  uint16_t len, index = 0;
-  uint8_t data_buffer[512];
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-        while (receiveDataPacket(stream, data_buffer + index, &len, FPS_DEFAULT_TIMEOUT) == FPS_RX_OK && stream->rxPacketType == FPS_ID_DATAPACKET) {
-            index += len;
-        }
-        if (stream->rxPacketType == FPS_ID_ENDDATAPACKET) {
-            stream->templateCount = ((uint16_t)(data_buffer[4]) << 8) + data_buffer[5];
-            stream->securityLevel = ((uint16_t)(data_buffer[6]) << 8) + data_buffer[7];
+  uint8_t data_buffer[FPS_SYSPARA_BUFFER_LENGTH];
+  uint8_t response = R30X_execute(stream, &commandTable[OP_READSYSPARA], NULL, data_buffer, FPS_SYSPARA_BUFFER_LENGTH);
+  if (response != FPS_RESP_OK) {
+    return response;
+  }
+  stream->templateCount = readU16(&data_buffer[4]);
+  stream->securityLevel = readU16(&data_buffer[6]);
 
-            stream->deviceAddress = ((uint32_t)(data_buffer[8]) << 24) + ((uint32_t)(data_buffer[9]) << 16) + ((uint32_t)(data_buffer[10]) << 8) + data_buffer[11];
+  stream->deviceAddress = ((uint32_t)(data_buffer[8]) << 24) + ((uint32_t)(data_buffer[9]) << 16) + ((uint32_t)(data_buffer[10]) << 8) + data_buffer[11];
 
-            stream->dataPacketLengthCode = ((uint16_t)(data_buffer[12]) << 8) + data_buffer[13];
-            stream->baudMultiplier = ((uint16_t)(data_buffer[14]) << 8) + data_buffer[15];
-            memcpy(stream->deviceName, &data_buffer[28], 32);
+  stream->dataPacketLengthCode = readU16(&data_buffer[12]);
+  stream->baudMultiplier = readU16(&data_buffer[14]);
+#if FPS_CFG_DEVICE_NAME
+  memcpy(stream->deviceName, &data_buffer[28], 32);
+#endif
 
-            if (stream->dataPacketLengthCode == 0)
-                stream->dataPacketLength = 32;
-            else if (stream->dataPacketLengthCode == 1)
-                stream->dataPacketLength = 64;
-            else if (stream->dataPacketLengthCode == 2)
-                stream->dataPacketLength = 128;
-            else if (stream->dataPacketLengthCode == 3)
-                stream->dataPacketLength = 256;
+  if (stream->dataPacketLengthCode <= 3)
+    stream->dataPacketLength = (uint16_t)(32 << stream->dataPacketLengthCode);  //32, 64, 128 or 256
 
-            stream->deviceBaudrate = (uint32_t)(stream->baudMultiplier * 9600);  //baudrate is retrieved as a multiplier
-            return FPS_RESP_OK; //just the confirmation code only
-        }
-        else {
-            return FPS_RESP_RECIEVEERR;
-        }
-    }
-  }
-  return response; //return packet receive error code
+  stream->deviceBaudrate = (uint32_t)(stream->baudMultiplier * 9600);  //baudrate is retrieved as a multiplier
+  return FPS_RESP_OK;
 }
 /*
-*   @brief:
+*   @brief: read the number of templates stored in the library into stream->templateCount
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t getTemplateCount(__FPS *stream) {
-  sendPacket(stream, FPS_CMD_TEMPLATECOUNT, 0 , 0); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      stream->templateCount = ((uint16_t)(stream->rxDataBuffer[1]) << 8) + stream->rxDataBuffer[0];  //high byte + low byte
-      return FPS_RESP_OK;
-    }
-  }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_TEMPLATECOUNT], NULL, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: read one page of the index table, bit (n % 8) of byte (n / 8) is set when location page * 256 + n holds a template
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
+*   @parameter: index table page 0 to 3
+*   @parameter: buffer of FPS_INDEX_TABLE_LENGTH bytes that receives the table
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
-uint8_t captureAndRangeSearch (__FPS *stream ,uint16_t captureTimeout, uint16_t startLocation, uint16_t count) {
-  if(captureTimeout > 25500) { //25500 is the max timeout the device supports
+uint8_t readIndexTable(__FPS *stream, uint8_t page, uint8_t *table) {
+#if FPS_CFG_RX_DATA_LENGTH < FPS_INDEX_TABLE_LENGTH
+  (void)stream; (void)page; (void)table;
+  return FPS_BAD_VALUE; //rxDataBuffer is too small for the table
+#else
+  uint32_t args[1] = { page };
+  if (page > 3) {
     return FPS_BAD_VALUE;
   }
-
-  if( startLocation > stream->templateCount ) { //if not in range (0-999)
+  return R30X_execute(stream, &commandTable[OP_READINDEXTABLE], args, table, FPS_INDEX_TABLE_LENGTH);
+#endif
+}
+/*
+*   @brief: scan a finger and search a range of the library, like generateImage, generateCharacter and searchLibrary
+*   @parameter: pointer to finger print structure
+*   @parameter: time to wait for a finger in milliseconds, at most 25500
+*   @parameter: first location, the same IDs as saveTemplate and searchLibrary
+*   @parameter: number of locations
+*   @return: on success FPS_RESP_OK or 0 , the location is in stream->fingerId and the score in stream->matchScore.
+*            fingerId is the location given to saveTemplate
+*
+*/
+uint8_t captureAndRangeSearch (__FPS *stream ,uint16_t captureTimeout, uint16_t startLocation, uint16_t count) {
+  uint32_t args[3] = { captureTimeout / 140, startLocation, count };  //the module counts the timeout in steps of 140 ms
+  if (captureTimeout > 25500) { //25500 is the max timeout the device supports
     return FPS_BAD_VALUE;
   }
-
-  if((startLocation + count) > 1001) { //if range overflows
+  if ((uint32_t)startLocation + count > stream->templateCount) { //if range overflows
     return FPS_BAD_VALUE;
   }
-
-  uint8_t dataArray[5] = {0}; //need 5 bytes here
-
-  //generate the data array
-  dataArray[4] = (uint8_t)(captureTimeout / 140);  //this byte is sent first
-  dataArray[3] = ((startLocation-1) >> 8) & 0xFFU;  //high byte
-  dataArray[2] = (uint8_t)((startLocation-1) & 0xFFU);  //low byte
-  dataArray[1] = (count >> 8) & 0xFFU; //high byte
-  dataArray[0] = (uint8_t)(count & 0xFFU); //low byte
-
-  sendPacket(stream, FPS_CMD_SCANANDRANGESEARCH, dataArray, 5); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream ,captureTimeout + 100); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      stream->fingerId = ((uint16_t)(stream->rxDataBuffer[3]) << 8) + stream->rxDataBuffer[2];  //high byte + low byte
-
-      stream->matchScore = ((uint16_t)(stream->rxDataBuffer[1]) << 8) + stream->rxDataBuffer[0];  //data length will be 4 here
-      return FPS_RESP_OK;
-    }
-    else {
-    	stream->fingerId = 0;
-    	stream->matchScore = 0;
-	  return stream->rxConfirmationCode;  //setting was unsuccessful and so send confirmation code
-    }
-  }
-  else {
-    return response; //return packet receive error code
-  }
+  __FPS_COMMAND command = commandTable[OP_RANGESEARCH];
+  command.timeout = captureTimeout + stream->commandTimeout;  //the capture, then the search
+  return R30X_execute(stream, &command, args, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: scan a finger and search the whole library
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
-*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*   @return: on success FPS_RESP_OK or 0 , the location is in stream->fingerId and the score in stream->matchScore.
+*            fingerId is the location given to saveTemplate
 *
 */
 uint8_t captureAndFullSearch (__FPS *stream) {
-  sendPacket(stream , FPS_CMD_SCANANDFULLSEARCH, 0 , 0); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , 3000); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      stream->fingerId = ((uint16_t)(stream->rxDataBuffer[3]) << 8) + stream->rxDataBuffer[2];  //high byte + low byte
-      stream->fingerId += 1;  //because IDs start from #1
-      stream->matchScore = ((uint16_t)(stream->rxDataBuffer[1]) << 8) + stream->rxDataBuffer[0];  //data length will be 4 here
-	  return FPS_RESP_OK;
-    }
-    else {
-      stream->fingerId = 0;
-      stream->matchScore = 0;
-	  return stream->rxConfirmationCode;  //setting was unsuccessful and so send confirmation code
-    }
-  }
-  else {
-    return response; //return packet receive error code
-  }
+  return R30X_execute(stream, &commandTable[OP_FULLSEARCH], NULL, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: scan a finger into the image buffer of the module
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
-*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*   @return: on success FPS_RESP_OK or 0 , FPS_RESP_NOFINGER if there is no finger on the sensor
 *
 */
 uint8_t generateImage (__FPS *stream) {
-  sendPacket(stream , FPS_CMD_SCANFINGER, 0 , 0); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-  }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_SCANFINGER], NULL, NULL, 0);
 }
+#if FPS_CFG_IMAGE_TRANSFER
 /*
-*   @brief:
+*   @brief: export the image buffer of the module, the data packets are read and discarded. Use getImage to keep them
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t exportImage (__FPS *stream) {
-  sendPacket(stream , FPS_CMD_EXPORTIMAGE, 0 , 0); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-    else {
-      return stream->rxConfirmationCode;  //setting was unsuccessful and so send confirmation code
-    }
-  }
-  else {
-    return response; //return packet receive error code
-  }
+  return R30X_execute(stream, &commandTable[OP_EXPORTIMAGE], NULL, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: import an image into the image buffer of the module
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
+*   @parameter: image of FPS_IMAGE_SIZE bytes, two pixels per byte
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t importImage (__FPS *stream ,uint8_t* dataBuffer) {
-  sendPacket(stream, FPS_CMD_IMPORTIMAGE, dataBuffer, 64); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-    else {
-      return stream->rxConfirmationCode;  //setting was unsuccessful and so send confirmation code
-    }
-  }
-  else {
-    return response; //return packet receive error code
-  }
+  return R30X_execute(stream, &commandTable[OP_IMPORTIMAGE], NULL, dataBuffer, FPS_IMAGE_SIZE);
 }
+#endif
 /*
-*   @brief:
+*   @brief: generate a character file from the image buffer
 *   @parameter: pointer to finger print structure
 *   @parameter: select bufferID 1 or 2
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t generateCharacter (__FPS *stream ,uint8_t bufferId) {
-  if(bufferId != 1 && bufferId != 2) { //if the value is not 1 or 2
-	return FPS_BAD_VALUE;
-  }
-  uint8_t dataBuffer[1] = {bufferId}; //create data array
-  
-  sendPacket(stream , FPS_CMD_IMAGETOCHARACTER, dataBuffer, 1);
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
+  uint32_t args[1] = { bufferId };
+  if (bufferId != 1 && bufferId != 2) { //if the value is not 1 or 2
+    return FPS_BAD_VALUE;
   }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_IMAGETOCHARACTER], args, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: combine the character files of both buffers into a template
 *   @parameter: pointer to finger print structure
-*   @parameter: none
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t generateTemplate (__FPS *stream) {
-  sendPacket(stream , FPS_CMD_GENERATETEMPLATE, 0 , 0); //send the command, there's no additional data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-  }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_GENERATETEMPLATE], NULL, NULL, 0);
 }
+#if FPS_CFG_TEMPLATE_TRANSFER
 /*
-*   @brief:
+*   @brief: export a character buffer. The data packets are put together in dataBuffer in the order they arrive,
+*           whatever the packet length of the module is
 *   @parameter: pointer to finger print structure
 *   @parameter: select bufferID 1 or 2
-*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*   @parameter: receives the template, FPS_TEMPLATE_SIZE bytes. NULL reads and discards the data packets
+*   @return: on success FPS_RESP_OK or 0 , FPS_RESP_RECIEVEERR if the module sends fewer or more than FPS_TEMPLATE_SIZE bytes
 *
 */
-uint8_t exportCharacter (__FPS *stream ,uint8_t bufferId) {
-  uint8_t dataBuffer[1] = {bufferId}; //create data array
-  sendPacket(stream , FPS_CMD_IMPORTIMAGE, 0 , 0);
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
+uint8_t exportCharacter (__FPS *stream ,uint8_t bufferId, uint8_t* dataBuffer) {
+  uint32_t args[1] = { bufferId };
+  if (bufferId != 1 && bufferId != 2) { //if the value is not 1 or 2
+    return FPS_BAD_VALUE;
   }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_EXPORTTEMPLATE], args, dataBuffer, dataBuffer != NULL ? FPS_TEMPLATE_SIZE : 0);
 }
 /*
 *   @brief:
 *   @parameter: pointer to finger print structure
 *   @parameter: select bufferID 1 or 2
+*   @parameter: template data, FPS_TEMPLATE_SIZE bytes
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t importCharacter (__FPS *stream ,uint8_t bufferId, uint8_t* dataBuffer) {
-  uint8_t dataArray[sizeof(dataBuffer)+1] = {0}; //create data array
-  dataArray[sizeof(dataBuffer)];
-  sendPacket(stream , FPS_CMD_IMPORTIMAGE, 0 , 0);
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
+  uint32_t args[1] = { bufferId };
+  if (bufferId != 1 && bufferId != 2) { //if the value is not 1 or 2
+    return FPS_BAD_VALUE;
   }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_IMPORTTEMPLATE], args, dataBuffer, FPS_TEMPLATE_SIZE);
 }
+#endif
 /*
 *   @brief:
 *   @parameter: pointer to finger print structure
@@ -722,221 +798,171 @@ uint8_t importCharacter (__FPS *stream ,uint8_t bufferId, uint8_t* dataBuffer) {
 *
 */
 uint8_t saveTemplate (__FPS *stream ,uint8_t bufferId, uint16_t location) {
-  if(!((bufferId > 0) && (bufferId < 3))) { //if the value is not 1 or 2
+  uint32_t args[2] = { bufferId, location };
+  if (!((bufferId > 0) && (bufferId < 3))) { //if the value is not 1 or 2
     return FPS_BAD_VALUE;
   }
-
-  if((location > stream->templateCount) || (location < 1)) { //if the value is not in range
-	return FPS_BAD_VALUE;
-  }
-  uint8_t dataArray[3] = {0}; //create data array
-  dataArray[0] = bufferId;  //highest byte
-  dataArray[1] = (location >> 8) & 0xFFU; //high byte of location
-  dataArray[2] = (location & 0xFFU); //low byte of location
-
-  sendPacket(stream, FPS_CMD_STORETEMPLATE, dataArray, 3); //send the command and data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
+  if ((location > stream->templateCount) || (location < 1)) { //if the value is not in range
+    return FPS_BAD_VALUE;
   }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_STORETEMPLATE], args, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: load a template from the library into a character buffer
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
+*   @parameter: select bufferID 1 or 2
+*   @parameter: location
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t loadTemplate (__FPS *stream ,uint8_t bufferId, uint16_t location) {
-  if(!((bufferId > 0) && (bufferId < 3))) { //if the value is not 1 or 2
-	return FPS_BAD_VALUE;
-  }
-
-  if((location > stream->templateCount) || (location < 1)) { //if the value is not in range
+  uint32_t args[2] = { bufferId, location };
+  if (!((bufferId > 0) && (bufferId < 3))) { //if the value is not 1 or 2
     return FPS_BAD_VALUE;
   }
-
-  uint8_t dataArray[3] = {0}; //create data array
-  dataArray[0] = bufferId;  //highest byte
-  dataArray[1] = (location >> 8) & 0xFFU; //high byte of location
-  dataArray[2] = (location & 0xFFU); //low byte of location
-
-  sendPacket(stream, FPS_CMD_LOADTEMPLATE, dataArray, 3); //send the command and data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
+  if ((location > stream->templateCount) || (location < 1)) { //if the value is not in range
+    return FPS_BAD_VALUE;
   }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_LOADTEMPLATE], args, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: delete count templates starting at startLocation
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
+*   @parameter: first location
+*   @parameter: number of locations
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t deleteTemplate (__FPS *stream ,uint16_t startLocation, uint16_t count) {
-  if((startLocation > stream->templateCount) || (startLocation < 1)) { //if the value is not 1 or 2
+  uint32_t args[2] = { startLocation, count };
+  if ((startLocation > stream->templateCount) || (startLocation < 1)) { //if the value is not in range
     return FPS_BAD_VALUE;
   }
-
-  if((count + startLocation) > stream->templateCount + 1) { //if the value is not in range
+  if ((count + startLocation) > stream->templateCount + 1) { //if the value is not in range
     return FPS_BAD_VALUE;
   }
-
-  uint8_t dataArray[4] = {0}; //create data array
-  dataArray[0] = (startLocation >> 8) & 0xFFU; //high byte of location
-  dataArray[1] = (startLocation & 0xFFU); //low byte of location
-  dataArray[2] = (count >> 8) & 0xFFU; //high byte of total no. of templates to delete
-  dataArray[3] = (count & 0xFFU); //low byte of count
-  
-  sendPacket(stream, FPS_CMD_DELETETEMPLATE, dataArray, 4); //send the command and data
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-  }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_DELETETEMPLATE], args, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: delete all templates of the library
 *   @parameter: pointer to finger print structure
-*   @parameter: none
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t clearLibrary (__FPS *stream) {
-
-  sendPacket(stream , FPS_CMD_CLEARLIBRARY, 0 , 0); //send the command
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-  }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_CLEARLIBRARY], NULL, NULL, 0);
 }
 /*
-*   @brief:
+*   @brief: match the character buffers 1 and 2
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
-*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*   @return: on success FPS_RESP_OK or 0 and the score in stream->matchScore, FPS_RESP_DONOTMATCH if they do not match
 *
 */
 uint8_t matchTemplates (__FPS *stream) {
+  return R30X_execute(stream, &commandTable[OP_MATCHTEMPLATES], NULL, NULL, 0);
+}
+/*
+*   @brief: 1:1 verification against the template of a claimed location: generateImage, generateCharacter into buffer 1,
+*           loadTemplate of the claimed location into buffer 2 and matchTemplates. Unlike searchLibrary the time does not
+*           depend on the size of the library
+*   @parameter: pointer to finger print structure
+*   @parameter: claimed location, 1 to stream->templateCount
+*   @parameter: lowest matchScore that is accepted
+*   @return: FPS_RESP_OK or 0 if the finger matches with a score of at least threshold, FPS_RESP_DONOTMATCH if it does not,
+*            otherwise the error of the step that failed (e.g. FPS_RESP_NOFINGER). The score is in stream->matchScore
+*
+*/
+uint8_t verifyFinger (__FPS *stream ,uint16_t claimedId, uint16_t threshold) {
+  if ((claimedId > stream->templateCount) || (claimedId < 1)) { //if the value is not in range
+    return FPS_BAD_VALUE;
+  }
+  stream->matchScore = 0;
 
-  sendPacket(stream , FPS_CMD_MATCHTEMPLATES, 0 , 0); //send the command
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      stream->matchScore = (uint16_t)(stream->rxDataBuffer[1] << 8) + stream->rxDataBuffer[0];
-      return FPS_RESP_OK; //just the confirmation code only
-    }
+  uint8_t response = generateImage(stream);
+  if (response == FPS_RESP_OK) response = generateCharacter(stream, 1);
+  if (response == FPS_RESP_OK) response = loadTemplate(stream, 2, claimedId);
+  if (response == FPS_RESP_OK) response = matchTemplates(stream);
+  if (response != FPS_RESP_OK) { //no finger, bad image, empty location, no match or a lost packet
+    return response;
   }
-  return response; //return packet receive error code
+  return stream->matchScore >= threshold ? FPS_RESP_OK : FPS_RESP_DONOTMATCH;
 }
 /*
-*   @brief:
+*   @brief: search a range of the library for the character file in a buffer
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
-*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*   @parameter: select bufferID 1 or 2
+*   @parameter: first location
+*   @parameter: number of locations
+*   @return: on success FPS_RESP_OK or 0 , the location is in stream->fingerId and the score in stream->matchScore,
+*            FPS_RESP_NOTFOUND if there is no match
 *
 */
 uint8_t searchLibrary (__FPS *stream ,uint8_t bufferId, uint16_t startLocation, uint16_t count) {
-  if(bufferId != 1 && bufferId != 2) { //if the value is not 1 or 2
+  uint32_t args[3] = { bufferId, startLocation, count };
+  if (bufferId != 1 && bufferId != 2) { //if the value is not 1 or 2
     return FPS_BAD_VALUE;
   }
-
-  if((startLocation > stream->templateCount) ) { //if not in range (0-999)
+  if ((uint32_t)startLocation + count > stream->templateCount) { //if range overflows
     return FPS_BAD_VALUE;
   }
-
-  if((startLocation + count) > stream->templateCount) { //if range overflows
+  return R30X_execute(stream, &commandTable[OP_SEARCHLIBRARY], args, NULL, 0);
+}
+#if FPS_CFG_IMAGE_TRANSFER
+/*
+*   @brief: download the image buffer of the module
+*   @parameter: pointer to finger print structure
+*   @parameter: pointer to a buffer containing image at least (288 * 256  / 2) bytes ~ 36KB
+*   @return: on success FPS_RESP_OK or 0 , FPS_RESP_RECIEVEERR if the module sends fewer or more than FPS_IMAGE_SIZE bytes
+*
+*/
+uint8_t getImage(__FPS* stream,uint8_t* image_buffer) {
+  return R30X_execute(stream, &commandTable[OP_EXPORTIMAGE], NULL, image_buffer, FPS_IMAGE_SIZE);
+}
+#endif
+/*
+*   @brief: read a page of the notepad, 512 bytes of user data in the flash of the module
+*   @parameter: pointer to finger print structure
+*   @parameter: page 0 to 15
+*   @parameter: buffer of FPS_NOTEPAD_PAGE_SIZE bytes that receives the page
+*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*
+*/
+uint8_t readNotepad(__FPS *stream, uint8_t page, uint8_t *data) {
+#if FPS_CFG_RX_DATA_LENGTH < FPS_NOTEPAD_PAGE_SIZE
+  (void)stream; (void)page; (void)data;
+  return FPS_BAD_VALUE; //rxDataBuffer is too small for the page
+#else
+  uint32_t args[1] = { page };
+  if (page >= FPS_NOTEPAD_PAGES) {
     return FPS_BAD_VALUE;
   }
-
-  uint8_t dataArray[5] = {0};
-  dataArray[0] = bufferId;
-  dataArray[1] = (startLocation >> 8) & 0xFFU;  //high byte
-  dataArray[2] = (startLocation & 0xFFU); //low byte
-  dataArray[3] = (count >> 8) & 0xFFU; //high byte
-  dataArray[4] = (count & 0xFFU); //low byte
-
-  sendPacket(stream , FPS_CMD_HISPEEDSEARCH, dataArray, 5); //send the command
-  uint8_t response = receivePacket(stream , FPS_DEFAULT_TIMEOUT); //read response
-
-  if(response == FPS_RX_OK) { //if the response packet is valid
-    if(stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-      stream->fingerId = ((uint16_t)(stream->rxDataBuffer[0]) << 8) + stream->rxDataBuffer[1];  //add high byte and low byte
-      stream->matchScore = ((uint16_t)(stream->rxDataBuffer[2]) << 8) + stream->rxDataBuffer[3];  //add high byte and low byte
-
-      return FPS_RESP_OK; //just the confirmation code only
-    }
-    else {
-      //fingerId = 0 doesn't mean the match was found at location 0
-      //instead it means an error. check the confirmation code to determine the problem
-      stream->fingerId = 0;
-      stream->matchScore = 0;
-    }
-  }
-  return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_READNOTEPAD], args, data, FPS_NOTEPAD_PAGE_SIZE);
+#endif
 }
 /*
-*   @brief:
+*   @brief: write a page of the notepad
 *   @parameter: pointer to finger print structure
-*   @parameter: pointer to a buffer containing image at least (288 * 256  / 2) bytes ~ 36KB
-*   @parameter: none
+*   @parameter: page 0 to 15
+*   @parameter: FPS_NOTEPAD_PAGE_SIZE bytes
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
-uint8_t getImage(__FPS* stream,uint8_t* image_buffer) {
-
-    sendPacket(stream, FPS_CMD_EXPORTIMAGE, 0, 0); //send the command
-    uint8_t response = receivePacket(stream, FPS_DEFAULT_TIMEOUT); //read response
-    uint16_t len , index = 0;
-    if (response == FPS_RX_OK) { //if the response packet is valid
-        if (stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-            while (receiveDataPacket(stream, image_buffer + index, &len, FPS_DEFAULT_TIMEOUT) == FPS_RX_OK && stream->rxPacketType == FPS_ID_DATAPACKET) {
-                index += len;
-            }
-            if (stream->rxPacketType == FPS_ID_ENDDATAPACKET) {
-                return FPS_RESP_OK; //just the confirmation code only
-            }
-            else {
-                return FPS_RESP_RECIEVEERR;
-            }
-        }
-    }
-    return response; //return packet receive error code
+uint8_t writeNotepad(__FPS *stream, uint8_t page, const uint8_t *data) {
+  uint32_t args[1] = { page };
+  if (page >= FPS_NOTEPAD_PAGES) {
+    return FPS_BAD_VALUE;
+  }
+  return R30X_execute(stream, &commandTable[OP_WRITENOTEPAD], args, (uint8_t*)data, FPS_NOTEPAD_PAGE_SIZE);
 }
 /*
-*   @brief:
+*   @brief: read a random number generated by the module
 *   @parameter: pointer to finger print structure
-*   @parameter: new security level for device
+*   @parameter: receives the number
 *   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
 *
 */
 uint8_t generateRandomNumber(__FPS* stream,uint32_t *random) {
-    sendPacket(stream, FPS_CMD_GETRANDOMCODE, 0, 0); //send the command and data
-    uint8_t response = receivePacket(stream, FPS_DEFAULT_TIMEOUT); //read response
-
-    if (response == FPS_RX_OK) { //if the response packet is valid
-        if (stream->rxConfirmationCode == FPS_RESP_OK) { //the confirm code will be saved when the response is received
-            *random = (uint32_t)stream->rxDataBuffer[0] | ((uint32_t)stream->rxDataBuffer[1] << 8) | ((uint32_t)stream->rxDataBuffer[2] << 16) | ((uint32_t)stream->rxDataBuffer[3] << 24);
-            return FPS_RESP_OK; //port setting complete
-        }
-    }
-    return response; //return packet receive error code
+  return R30X_execute(stream, &commandTable[OP_GETRANDOMCODE], NULL, (uint8_t*)random, sizeof(uint32_t));
 }
 
 /********************************END OF FILE*****************************************************/
@@ -11,6 +11,7 @@
 #define R30X_FPS_H
 #include "stdint.h"
 #include "string.h"
+#include "R30X_config.h"
 //=========================================================================//
 //Response codes from FPS to the commands sent to it
 //FPS = Fingerprint Scanner
@@ -50,13 +51,14 @@
 
 //-------------------------------------------------------------------------//
 //Received packet verification status codes from host device
+//above the confirmation codes, so one return value can carry either
 
 #define FPS_RX_OK                       0x00  //when the response is correct
-#define FPS_RX_BADPACKET                0x01  //if the packet received from FPS is badly formatted
-#define FPS_RX_WRONG_ADDRESS			0x02  // if address of received packet is wrong
-#define FPS_RX_WRONG_RESPONSE           0x03  //unexpected response
-#define FPS_RX_TIMEOUT                  0x04  //when no response was received
-#define FPS_RX_WRONG_CHECKSUM           0x05  //when no response was received
+#define FPS_RX_BADPACKET                0xF1  //if the packet received from FPS is badly formatted
+#define FPS_RX_WRONG_ADDRESS            0xF2  // if address of received packet is wrong
+#define FPS_RX_WRONG_RESPONSE           0xF3  //unexpected response
+#define FPS_RX_TIMEOUT                  0xF4  //when no response was received
+#define FPS_RX_WRONG_CHECKSUM           0xF5  //when the checksum of the received packet is wrong
 
 //-------------------------------------------------------------------------//
 //Packet IDs
@@ -97,9 +99,10 @@
 #define FPS_CMD_WRITENOTEPAD				 0x18    //write to device notepad
 #define FPS_CMD_READNOTEPAD					 0x19    //read from device notepad
 #define FPS_CMD_HISPEEDSEARCH				 0x1B    //highspeed search of fingerprint
+#define FPS_CMD_READINDEXTABLE				 0x1F    //read which library locations hold a template
 #define FPS_CMD_TEMPLATECOUNT				 0x1D    //read total template count
-#define FPS_CMD_SCANANDRANGESEARCH			 0x32    //read total template count
-#define FPS_CMD_SCANANDFULLSEARCH			 0x34    //read total template count
+#define FPS_CMD_SCANANDRANGESEARCH			 0x32    //wait for a finger, capture it and search a range of the library
+#define FPS_CMD_SCANANDFULLSEARCH			 0x34    //wait for a finger, capture it and search the whole library
 
 #define FPS_DEFAULT_TIMEOUT                 1000	//UART reading timeout in milliseconds
 #define FPS_DEFAULT_BAUDRATE                57600  //9600*6
@@ -108,12 +111,59 @@
 #define FPS_DEFAULT_PASSWORD                0x00000000
 #define FPS_DEFAULT_ADDRESS                 0xFFFFFFFF
 #define FPS_BAD_VALUE                       0x1FU //some bad value or paramter was delivered
+#define FPS_INDEX_TABLE_LENGTH              32   //bytes of one index table page, one bit per location
+#define FPS_INDEX_TABLE_PAGE_SIZE           256  //locations covered by one index table page
+#define FPS_TEMPLATE_SIZE                   512  //bytes of a character file or template
+#define FPS_NOTEPAD_PAGES                   16   //pages of the notepad, 0 to 15
+#define FPS_NOTEPAD_PAGE_SIZE               32   //bytes of one notepad page
+#define FPS_IMAGE_WIDTH                     256
+#define FPS_IMAGE_HEIGHT                    288
+#define FPS_IMAGE_SIZE                      (FPS_IMAGE_WIDTH * FPS_IMAGE_HEIGHT / 2)  //bytes of an image from getImage, two pixels per byte
+
+//-------------------------------------------------------------------------//
+//Command descriptors for R30X_execute
+
+#define FPS_ARG_NONE                        0    //argument layout, 2 bits per argument, first argument in the lowest bits
+#define FPS_ARG_U8                          1
+#define FPS_ARG_U16                         2
+#define FPS_ARG_U32                         3
+#define FPS_ARGS(a, b, c, d)                ((a) | ((b) << 2) | ((c) << 4) | ((d) << 6))
+
+#define FPS_REPLY_NONE                      0    //nothing after the confirmation code
+#define FPS_REPLY_ID_SCORE                  1    //fingerId and matchScore
+#define FPS_REPLY_SCORE                     2    //matchScore
+#define FPS_REPLY_COUNT                     3    //templateCount
+#define FPS_REPLY_U32                       4    //a 32 bit value into data
+#define FPS_REPLY_TABLE                     5    //FPS_INDEX_TABLE_LENGTH bytes into data (index table, notepad page)
+
+#define FPS_CMD_FLAG_DATA_IN                0x01 //data packets from the module follow the acknowledge
+#define FPS_CMD_FLAG_DATA_OUT               0x02 //data packets to the module follow the acknowledge
+#define FPS_CMD_FLAG_DATA_ARGS              0x04 //data is sent in the command packet after the arguments
+#define FPS_CMD_FLAG_DATA_EXACT             0x08 //with DATA_IN: the module must send exactly dataLength bytes, unless they are discarded
+
+typedef struct {
+	  uint8_t opcode;  //FPS_CMD_*
+	  uint8_t args;  //FPS_ARGS of FPS_ARG_*
+	  uint8_t reply;  //FPS_REPLY_*
+	  uint8_t flags;  //FPS_CMD_FLAG_*
+	  uint16_t timeout;  //time to wait for the acknowledge in milliseconds, 0 for stream->commandTimeout
+}__FPS_COMMAND;
+
+//serial port functions that receive a context pointer, so one implementation can serve many ports
+typedef struct {
+	  uint32_t(*read)(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timout); // return number of bytes read
+	  uint32_t(*write)(void* context, uint8_t* pBuff, uint16_t BytesToWrite, uint16_t timout); // returns number of bytes written
+	  uint8_t (*initializePort) (void* context, uint32_t baud); // retun 0 on success
+	  uint8_t (*deinitializePort) (void* context);
+}__FPS_PORT;
 
 typedef struct {
 	//common parameters
 	  uint32_t devicePassword; //32-bit single value version of password (L = long)
 	  uint32_t deviceAddress;  //module's address
+#if FPS_CFG_DEVICE_NAME
 	  char deviceName[32];
+#endif
 
 	  uint16_t statusRegister;  //contents of the FPS status register
 	  uint16_t securityLevel;  //threshold level for fingerprint matching
@@ -121,11 +171,12 @@ typedef struct {
 	  uint16_t dataPacketLength; //the max length of data in packet. can be 32, 64, 128 or 256
 	  uint16_t baudMultiplier;  //value between 1-12
 	  uint32_t deviceBaudrate;  //UART speed (9600 * baud multiplier)
+	  uint16_t commandTimeout;  //time to wait for a response in milliseconds
 
 	  //receive packet parameters
 	  uint8_t	rxPacketType; //type of packet
 	  uint8_t	rxConfirmationCode; //the return codes from the FPS
-	  uint8_t	rxDataBuffer[FPS_DEFAULT_RX_DATA_LENGTH]; //packet data buffer
+	  uint8_t	rxDataBuffer[FPS_CFG_RX_DATA_LENGTH]; //packet data buffer
 	  uint32_t	rxDataBufferLength;  //the length of the data only. this doesn't include instruction or confirmation code
 
 	  uint16_t fingerId; //location of fingerprint in the library
@@ -136,38 +187,60 @@ typedef struct {
 	  uint32_t(*write)(uint8_t* pBuff, uint16_t BytesToWrite,uint16_t timout); // returns number of bytes written
 	  uint8_t (*initializePort) (uint32_t baud); // retun 0 on success
 	  uint8_t(*deinitializePort) (void);
+
+#if FPS_CFG_PORT_CONTEXT
+	  const __FPS_PORT* port; //optional, when not NULL it is used instead of the four functions above
+	  void* portContext; //passed to the port functions
+#endif
 }__FPS;
   
 int8_t	R30X_init(__FPS *stream, uint32_t password , uint32_t address );
 void	resetParameters (__FPS *stream); //initialize and reset and all parameters
+uint8_t R30X_openPort (__FPS *stream, uint32_t baud); //initialize the serial port at the given baudrate
+uint8_t R30X_closePort (__FPS *stream); //deinitialize the serial port
 uint8_t verifyPassword (__FPS *stream,uint32_t password ); //verify the user supplied password
+#if FPS_CFG_ADMIN_SETTERS
 uint8_t setPassword (__FPS *stream,uint32_t password);  //set FPS password
 uint8_t setAddress (__FPS *stream,uint32_t address );  //set FPS address
 uint8_t setBaudrate (__FPS *stream,uint32_t baud);  //set UART baudrate, default is 57000
 uint8_t setSecurityLevel (__FPS *stream,uint8_t level); //set the threshold for fingerprint matching
 uint8_t setDataLength (__FPS *stream,uint16_t length); //set the max length of data in a packet
 uint8_t portControl (__FPS *stream,uint8_t value);  //turn the comm port on or off
+#endif
 void    sendPacket (__FPS *stream, uint8_t command, uint8_t* data , uint16_t dataLength); //assemble and send packets to FPS
+void    sendDataPacket (__FPS *stream, uint8_t packetType, uint8_t* data , uint16_t dataLength); //send one data packet of a multi packet transfer
 uint8_t receivePacket (__FPS *stream, uint32_t timeout); //receive packet from FPS
+uint8_t receiveDataPacket (__FPS *stream, uint8_t *receive_buffer, uint16_t* receive_length, uint32_t timeout); //receive one data packet of a multi packet transfer
+uint8_t R30X_execute (__FPS *stream, const __FPS_COMMAND *command, const uint32_t *args, uint8_t *data, uint32_t dataLength); //send a command described by a descriptor and decode its reply
 uint8_t readSysPara (__FPS *stream); //read FPS system configuration
-uint8_t captureAndRangeSearch (__FPS *stream,uint16_t captureTimeout, uint16_t startId, uint16_t count); //scan a finger and search a range of locations
+uint8_t captureAndRangeSearch (__FPS *stream,uint16_t captureTimeout, uint16_t startLocation, uint16_t count); //scan a finger and search a range of locations, same IDs as saveTemplate
 uint8_t captureAndFullSearch (__FPS *stream);  //scan a finger and search the entire library
 uint8_t generateImage (__FPS *stream); //scan a finger, generate an image and store it in the buffer
+#if FPS_CFG_IMAGE_TRANSFER
 uint8_t exportImage (__FPS *stream); //export a fingerprint image from the sensor to the computer
 uint8_t importImage (__FPS *stream, uint8_t* dataBuffer);  //import a fingerprint image from the computer to sensor
+#endif
 uint8_t generateCharacter (__FPS *stream, uint8_t bufferId); //generate character file from image
 uint8_t generateTemplate (__FPS *stream);  //combine the two character files and generate a single template
-uint8_t exportCharacter (__FPS *stream, uint8_t bufferId); //export a character file from the sensor to computer
-uint8_t importCharacter (__FPS *stream, uint8_t bufferId, uint8_t* dataBuffer);  //import a character file to the sensor from computer
+#if FPS_CFG_TEMPLATE_TRANSFER
+uint8_t exportCharacter (__FPS *stream, uint8_t bufferId, uint8_t* dataBuffer); //export a character file of FPS_TEMPLATE_SIZE bytes from the sensor to computer
+uint8_t importCharacter (__FPS *stream, uint8_t bufferId, uint8_t* dataBuffer);  //import a character file of FPS_TEMPLATE_SIZE bytes to the sensor from computer
+#endif
 uint8_t saveTemplate (__FPS *stream, uint8_t bufferId, uint16_t location);  //store the template in the buffer to a location in the library
 uint8_t loadTemplate (__FPS *stream, uint8_t bufferId, uint16_t location); //load a template from library to one of the buffers
 uint8_t deleteTemplate (__FPS *stream, uint16_t startLocation, uint16_t count);  //delete a set of templates from library
 uint8_t clearLibrary (__FPS *stream);  //delete all templates from library
 uint8_t matchTemplates (__FPS *stream);  //match the templates stored in the two character buffers
+uint8_t verifyFinger (__FPS *stream, uint16_t claimedId, uint16_t threshold);  //scan a finger and match it against the template of one location
 uint8_t searchLibrary (__FPS *stream, uint8_t bufferId, uint16_t startLocation, uint16_t count); //search the library for a template stored in the buffer
 uint8_t getTemplateCount (__FPS *stream);  //get the total no. of templates in the library
+uint8_t readIndexTable (__FPS *stream, uint8_t page, uint8_t *table); //read which locations of a 256 location page are used
+uint8_t readNotepad (__FPS *stream, uint8_t page, uint8_t *data); //read FPS_NOTEPAD_PAGE_SIZE bytes of user data from the flash of the module
+uint8_t writeNotepad (__FPS *stream, uint8_t page, const uint8_t *data); //write FPS_NOTEPAD_PAGE_SIZE bytes of user data
 uint8_t generateRandomNumber(__FPS* stream, uint32_t* random);
+#if FPS_CFG_IMAGE_TRANSFER
 uint8_t getImage(__FPS* stream, uint8_t* image_buffer);
 #endif
+#endif
 
 /********************************END OF FILE*****************************************************/
@@ -0,0 +1,350 @@
+/*************************************************************************
+ *
+ * finger print library - several modules on one serial line
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_bus.h"
+#include <errno.h>
+#include <time.h>
+
+#define BUS_RX_MASK             (FPS_BUS_RX_LENGTH - 1)
+#define BUS_FRAME_IDLE_POLLS    20    //polls without a byte before a partial frame is dropped
+#define BUS_HOLD_IDLE_POLLS     (FPS_BUS_HOLD_TIMEOUT / FPS_BUS_POLL_TIMEOUT)
+
+#if (FPS_BUS_RX_LENGTH & BUS_RX_MASK) != 0
+#error "FPS_BUS_RX_LENGTH must be a power of two"
+#endif
+
+static void deadlineAfter(struct timespec* ts, uint32_t ms) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static int initCondition(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int result = pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return result;
+}
+
+//commands followed by data packets in either direction
+static uint8_t hasDataPhase(uint8_t code) {
+    switch (code) {
+    case FPS_CMD_EXPORTTEMPLATE:
+    case FPS_CMD_IMPORTTEMPLATE:
+    case FPS_CMD_EXPORTIMAGE:
+    case FPS_CMD_IMPORTIMAGE:
+    case FPS_CMD_READALL_SYSPARA:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+//call with the lock held
+static void releaseHold(__FPS_BUS* bus) {
+    bus->holder = NULL;
+    bus->holdIdlePolls = 0;
+    pthread_cond_broadcast(&bus->changed);
+}
+
+//---------------------------------------------------------------------------
+//endpoint port, used by the __FPS of every module
+
+static uint32_t endpointRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    __FPS_BUS_ENDPOINT* endpoint = (__FPS_BUS_ENDPOINT*)context;
+    __FPS_BUS* bus = endpoint->bus;
+    struct timespec deadline;
+    uint32_t count = 0;
+
+    deadlineAfter(&deadline, timeout);
+    pthread_mutex_lock(&bus->lock);
+    while (endpoint->rxHead == endpoint->rxTail && bus->running) {
+        if (pthread_cond_timedwait(&endpoint->rxReady, &bus->lock, &deadline) == ETIMEDOUT) break;
+    }
+    while (count < BytesToRead && endpoint->rxTail != endpoint->rxHead) {
+        pBuf[count++] = endpoint->rx[endpoint->rxTail & BUS_RX_MASK];
+        endpoint->rxTail++;
+    }
+    endpoint->bytesReceived += count;
+    pthread_mutex_unlock(&bus->lock);
+    return count;
+}
+
+//send the assembled frame when the line is free and not held by another endpoint
+static void endpointTransmit(__FPS_BUS_ENDPOINT* endpoint, uint16_t length) {
+    __FPS_BUS* bus = endpoint->bus;
+    uint8_t identifier = endpoint->tx[6];
+    pthread_mutex_lock(&bus->lock);
+    while ((bus->transmitting || bus->receiving || (bus->holder != NULL && bus->holder != endpoint)) && bus->running) {
+        pthread_cond_wait(&bus->changed, &bus->lock);
+    }
+    bus->transmitting = 1;
+    if (identifier == FPS_ID_COMMANDPACKET) {
+        //a new command ends an earlier data phase of this endpoint that timed out
+        bus->holder = hasDataPhase(endpoint->tx[9]) ? endpoint : NULL;
+    }
+    bus->holdIdlePolls = 0;
+    pthread_mutex_unlock(&bus->lock);
+
+    bus->port->write(bus->portContext, endpoint->tx, length, 250);
+
+    pthread_mutex_lock(&bus->lock);
+    bus->transmitting = 0;
+    bus->holdIdlePolls = 0;
+    if (identifier == FPS_ID_ENDDATAPACKET && bus->holder == endpoint) releaseHold(bus);  //last packet of an import
+    endpoint->framesSent++;
+    endpoint->bytesSent += length;
+    pthread_cond_broadcast(&bus->changed);
+    pthread_mutex_unlock(&bus->lock);
+}
+
+static uint32_t endpointWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    __FPS_BUS_ENDPOINT* endpoint = (__FPS_BUS_ENDPOINT*)context;
+    (void)timeout;
+    if (endpoint->txLength + BytesToWrite > FPS_BUS_FRAME_LENGTH) {
+        endpoint->txLength = 0;  //larger than any frame, drop it
+        return 0;
+    }
+    memcpy(endpoint->tx + endpoint->txLength, pBuf, BytesToWrite);
+    endpoint->txLength += BytesToWrite;
+    if (endpoint->txLength >= 9) {
+        uint16_t total = 9 + (uint16_t)((endpoint->tx[7] << 8) | endpoint->tx[8]);
+        if (total > FPS_BUS_FRAME_LENGTH) {
+            endpoint->txLength = 0;
+            return 0;
+        }
+        if (endpoint->txLength >= total) {
+            endpointTransmit(endpoint, total);
+            endpoint->txLength = 0;
+        }
+    }
+    return BytesToWrite;
+}
+
+static uint8_t endpointInitialize(void* context, uint32_t baud) {
+    __FPS_BUS_ENDPOINT* endpoint = (__FPS_BUS_ENDPOINT*)context;
+    __FPS_BUS* bus = endpoint->bus;
+    if (baud != bus->baud) return 1;  //the line is shared, one module can not change its speed
+    pthread_mutex_lock(&bus->lock);
+    endpoint->rxTail = endpoint->rxHead;
+    endpoint->txLength = 0;
+    if (bus->holder == endpoint) releaseHold(bus);
+    pthread_cond_broadcast(&bus->changed);
+    pthread_mutex_unlock(&bus->lock);
+    return 0;
+}
+
+static uint8_t endpointDeinitialize(void* context) {
+    (void)context;
+    return 0;
+}
+
+const __FPS_PORT fpsBusEndpointPort = { endpointRead, endpointWrite, endpointInitialize, endpointDeinitialize };
+
+//---------------------------------------------------------------------------
+//receive thread
+
+static void routeFrame(__FPS_BUS* bus) {
+    uint32_t address = ((uint32_t)bus->frame[2] << 24) | ((uint32_t)bus->frame[3] << 16) | ((uint32_t)bus->frame[4] << 8) | bus->frame[5];
+    pthread_mutex_lock(&bus->lock);
+    bus->receiving = 0;
+    pthread_cond_broadcast(&bus->changed);
+    if (bus->holder != NULL && bus->holder->address == address) {
+        //the data phase ends with the end data packet, or with an error instead of the data
+        if (bus->frame[6] == FPS_ID_ENDDATAPACKET || (bus->frame[6] == FPS_ID_ACKPACKET && bus->frame[9] != FPS_RESP_OK)) releaseHold(bus);
+        else bus->holdIdlePolls = 0;
+    }
+    for (uint8_t i = 0; i < bus->endpointCount; i++) {
+        __FPS_BUS_ENDPOINT* endpoint = &bus->endpoints[i];
+        if (endpoint->address != address) continue;
+        if (FPS_BUS_RX_LENGTH - (endpoint->rxHead - endpoint->rxTail) < bus->frameLength) {
+            endpoint->framesDropped++;  //the endpoint thread is behind; waiting for it would stall the other modules
+            pthread_mutex_unlock(&bus->lock);
+            return;
+        }
+        for (uint16_t j = 0; j < bus->frameLength; j++) {
+            endpoint->rx[endpoint->rxHead & BUS_RX_MASK] = bus->frame[j];
+            endpoint->rxHead++;
+        }
+        endpoint->framesReceived++;
+        bus->framesRouted++;
+        pthread_cond_signal(&endpoint->rxReady);
+        pthread_mutex_unlock(&bus->lock);
+        return;
+    }
+    bus->framesDropped++;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+static void setReceiving(__FPS_BUS* bus, uint8_t receiving) {
+    pthread_mutex_lock(&bus->lock);
+    bus->receiving = receiving;
+    pthread_cond_broadcast(&bus->changed);
+    pthread_mutex_unlock(&bus->lock);
+}
+
+//a receive poll without a byte: give the line back if the holder went quiet
+static void holdIdle(__FPS_BUS* bus) {
+    pthread_mutex_lock(&bus->lock);
+    if (bus->holder != NULL && !bus->transmitting && ++bus->holdIdlePolls >= BUS_HOLD_IDLE_POLLS) {
+        bus->holdsExpired++;
+        releaseHold(bus);
+    }
+    pthread_mutex_unlock(&bus->lock);
+}
+
+static void* busReceiver(void* arg) {
+    __FPS_BUS* bus = (__FPS_BUS*)arg;
+    uint16_t expected = 1, idlePolls = 0;
+
+    while (bus->running) {
+        uint32_t count = bus->port->read(bus->portContext, bus->frame + bus->frameLength, expected - bus->frameLength, FPS_BUS_POLL_TIMEOUT);
+        if (count == 0) {
+            if (bus->frameLength == 0) holdIdle(bus);
+            if (bus->frameLength > 0 && ++idlePolls >= BUS_FRAME_IDLE_POLLS) {
+                bus->bytesSkipped += bus->frameLength;  //module stopped in the middle of a frame
+                bus->frameLength = 0;
+                expected = 1;
+                setReceiving(bus, 0);
+            }
+            continue;
+        }
+        idlePolls = 0;
+        bus->frameLength += (uint16_t)count;
+        if (bus->frameLength < expected) continue;
+
+        if (bus->frameLength == 1) {
+            if (bus->frame[0] == FPS_ID_STARTCODE_H) expected = 2;
+            else bus->frameLength = 0, bus->bytesSkipped++;
+        }
+        else if (bus->frameLength == 2) {
+            if (bus->frame[1] == FPS_ID_STARTCODE_L) {
+                expected = 9;
+                setReceiving(bus, 1);
+            }
+            else {
+                bus->bytesSkipped++;
+                bus->frame[0] = bus->frame[1];
+                bus->frameLength = bus->frame[0] == FPS_ID_STARTCODE_H ? 1 : 0;
+                if (bus->frameLength == 0) bus->bytesSkipped++;
+            }
+        }
+        else if (bus->frameLength == 9) {
+            expected = 9 + (uint16_t)((bus->frame[7] << 8) | bus->frame[8]);
+            if (expected > FPS_BUS_FRAME_LENGTH || expected < 11) {
+                bus->framesDropped++;
+                bus->frameLength = 0;
+                expected = 1;
+                setReceiving(bus, 0);
+            }
+        }
+        else {
+            routeFrame(bus);
+            bus->frameLength = 0;
+            expected = 1;
+        }
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+/*
+*   @brief: open the shared line and start the receive thread
+*   @parameter: bus
+*   @parameter: port functions of the line
+*   @parameter: context of the port functions
+*   @parameter: baudrate of all modules on the line
+*   @return: 0 on success, -1 if the port can not be opened, -2 if the thread can not be started
+*
+*/
+int8_t R30X_busStart(__FPS_BUS* bus, const __FPS_PORT* port, void* portContext, uint32_t baud) {
+    memset(bus, 0, sizeof(__FPS_BUS));
+    bus->port = port;
+    bus->portContext = portContext;
+    bus->baud = baud;
+    if (port->initializePort(portContext, baud) != 0) {
+        port->deinitializePort(portContext);
+        return -1;
+    }
+    pthread_mutex_init(&bus->lock, NULL);
+    initCondition(&bus->changed);
+    for (uint8_t i = 0; i < FPS_BUS_MAX_ENDPOINTS; i++) initCondition(&bus->endpoints[i].rxReady);
+    bus->running = 1;
+    if (pthread_create(&bus->receiver, NULL, busReceiver, bus) != 0) {
+        bus->running = 0;
+        R30X_busStop(bus);
+        return -2;
+    }
+    return 0;
+}
+/*
+*   @brief: stop the receive thread, wake up all waiting endpoints and close the line
+*   @parameter: bus
+*   @return: none
+*
+*/
+void R30X_busStop(__FPS_BUS* bus) {
+    pthread_mutex_lock(&bus->lock);
+    uint8_t wasRunning = bus->running;
+    bus->running = 0;
+    pthread_cond_broadcast(&bus->changed);
+    for (uint8_t i = 0; i < bus->endpointCount; i++) pthread_cond_broadcast(&bus->endpoints[i].rxReady);
+    pthread_mutex_unlock(&bus->lock);
+    if (wasRunning) pthread_join(bus->receiver, NULL);
+
+    bus->port->deinitializePort(bus->portContext);
+    for (uint8_t i = 0; i < FPS_BUS_MAX_ENDPOINTS; i++) pthread_cond_destroy(&bus->endpoints[i].rxReady);
+    pthread_cond_destroy(&bus->changed);
+    pthread_mutex_destroy(&bus->lock);
+}
+/*
+*   @brief: route the module with the given address to a stream. Use the stream from one thread at a time,
+*           different streams can be used from different threads
+*   @parameter: bus
+*   @parameter: pointer to finger print structure, its port is replaced by the bus endpoint
+*   @parameter: address of the module
+*   @return: 0 on success, -1 if all endpoints are used or the address is attached already
+*
+*/
+int8_t R30X_busAttach(__FPS_BUS* bus, __FPS* stream, uint32_t address) {
+    pthread_mutex_lock(&bus->lock);
+    for (uint8_t i = 0; i < bus->endpointCount; i++) {
+        if (bus->endpoints[i].address == address) {
+            pthread_mutex_unlock(&bus->lock);
+            return -1;
+        }
+    }
+    if (bus->endpointCount >= FPS_BUS_MAX_ENDPOINTS) {
+        pthread_mutex_unlock(&bus->lock);
+        return -1;
+    }
+    __FPS_BUS_ENDPOINT* endpoint = &bus->endpoints[bus->endpointCount];
+    endpoint->bus = bus;
+    endpoint->address = address;
+    endpoint->rxHead = endpoint->rxTail = 0;
+    endpoint->txLength = 0;
+    bus->endpointCount++;
+    pthread_mutex_unlock(&bus->lock);
+
+    stream->port = &fpsBusEndpointPort;
+    stream->portContext = endpoint;
+    stream->deviceAddress = address;
+    stream->deviceBaudrate = bus->baud;
+    stream->baudMultiplier = (uint16_t)(bus->baud / 9600);
+    return 0;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,94 @@
+/*************************************************************************
+ *
+ * finger print library - several modules on one serial line
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * The bus owns the shared port. Every module gets its own __FPS with its
+ * own address (see setAddress) that is attached to the bus, and can be used
+ * from its own thread with the normal library functions. Frames written by
+ * an endpoint are sent in one piece, a receive thread reads the line and
+ * hands every frame to the endpoint with the matching address. So commands
+ * to other modules go out while one module is busy in a long
+ * captureAndRangeSearch or generateCharacter.
+ *
+ * The shared port must allow a read and a write at the same time. New frames
+ * are not sent while a frame from a module is being received. A command with
+ * a data phase (export and import of templates and images, readSysPara)
+ * holds the line for its module until the end data packet of that module
+ * has been sent or routed, or until it answers with an error, so no other
+ * endpoint sends between the data packets. A hold that sees no traffic for
+ * FPS_BUS_HOLD_TIMEOUT is released and counted. A frame for an
+ * endpoint whose receive buffer is full is dropped and counted, the receive
+ * thread never waits for one slow endpoint. Needs POSIX threads.
+ *
+ **************************************************************************/
+#ifndef R30X_BUS_H
+#define R30X_BUS_H
+#include <pthread.h>
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_PORT_CONTEXT
+#error "R30X_bus needs FPS_CFG_PORT_CONTEXT"
+#endif
+
+#define FPS_BUS_MAX_ENDPOINTS           16
+#define FPS_BUS_RX_LENGTH               4096  //receive buffer of every endpoint
+#define FPS_BUS_FRAME_LENGTH            (11 + FPS_CFG_MAX_DATA_PACKET_LENGTH)  //largest frame on the line
+#define FPS_BUS_POLL_TIMEOUT            5     //read timeout of the receive thread in milliseconds
+#define FPS_BUS_HOLD_TIMEOUT            1000  //a data phase without traffic for this many milliseconds releases the line
+
+struct __FPS_BUS_S;
+
+typedef struct __FPS_BUS_ENDPOINT_S {
+	  struct __FPS_BUS_S* bus;
+	  uint32_t address;
+	  uint8_t rx[FPS_BUS_RX_LENGTH];  //frames routed to this endpoint, ring buffer
+	  uint32_t rxHead;
+	  uint32_t rxTail;
+	  pthread_cond_t rxReady;
+	  uint8_t tx[FPS_BUS_FRAME_LENGTH];  //frame being assembled from the writes of sendPacket
+	  uint16_t txLength;
+
+	  uint64_t framesSent;
+	  uint64_t framesReceived;
+	  uint64_t bytesSent;
+	  uint64_t bytesReceived;
+	  uint64_t framesDropped;  //frames for this endpoint that did not fit into rx, the command times out
+}__FPS_BUS_ENDPOINT;
+
+typedef struct __FPS_BUS_S {
+	  const __FPS_PORT* port;  //the shared line
+	  void* portContext;
+	  uint32_t baud;
+
+	  pthread_mutex_t lock;
+	  pthread_cond_t changed;  //the line became free
+	  pthread_t receiver;
+	  volatile uint8_t running;
+	  uint8_t transmitting;
+	  uint8_t receiving;  //a frame from a module is on the line
+	  struct __FPS_BUS_ENDPOINT_S* holder;  //endpoint in a data phase, only it may send; NULL if none
+	  uint16_t holdIdlePolls;  //receive polls without traffic since the last frame of the holder
+
+	  __FPS_BUS_ENDPOINT endpoints[FPS_BUS_MAX_ENDPOINTS];
+	  uint8_t endpointCount;
+
+	  //receive thread
+	  uint8_t frame[FPS_BUS_FRAME_LENGTH];
+	  uint16_t frameLength;
+
+	  uint64_t framesRouted;
+	  uint64_t framesDropped;  //frames for addresses without endpoint or too long
+	  uint64_t bytesSkipped;  //bytes outside of frames
+	  uint64_t holdsExpired;  //data phases that ended without end data packet or error, see FPS_BUS_HOLD_TIMEOUT
+}__FPS_BUS;
+
+extern const __FPS_PORT fpsBusEndpointPort;
+
+int8_t	R30X_busStart (__FPS_BUS *bus, const __FPS_PORT *port, void *portContext, uint32_t baud); //open the line and start the receive thread, 0 on success
+void	R30X_busStop (__FPS_BUS *bus); //stop the receive thread and close the line
+int8_t	R30X_busAttach (__FPS_BUS *bus, __FPS *stream, uint32_t address); //use stream for the module with this address, 0 on success
+#endif
+
+/********************************END OF FILE*****************************************************/
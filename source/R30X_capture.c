@@ -0,0 +1,151 @@
+/*************************************************************************
+ *
+ * finger print library - finger capture engine
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_capture.h"
+
+//1 when time a is at or after time b, works across the wrap around of millis
+static uint8_t reached(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) >= 0;
+}
+
+static void recordLatency(__FPS_CAPTURE_STATS* stats, uint32_t latency) {
+    stats->lastLatency = latency;
+    if (stats->latencyCount == 0 || latency < stats->minLatency) stats->minLatency = latency;
+    if (latency > stats->maxLatency) stats->maxLatency = latency;
+    stats->totalLatency += latency;
+    stats->latencyCount++;
+}
+/*
+*   @brief: prepare a capture engine with the default intervals
+*   @parameter: capture engine
+*   @parameter: function returning milliseconds
+*   @parameter: function waiting milliseconds, may return early
+*   @return: none
+*
+*/
+void R30X_captureInit(__FPS_CAPTURE* capture, uint32_t (*millis)(void), void (*delay)(uint32_t ms)) {
+    memset(capture, 0, sizeof(__FPS_CAPTURE));
+    capture->millis = millis;
+    capture->delay = delay;
+    capture->minInterval = FPS_CAPTURE_MIN_INTERVAL;
+    capture->maxInterval = FPS_CAPTURE_MAX_INTERVAL;
+    capture->activeTime = FPS_CAPTURE_ACTIVE_TIME;
+    capture->touchWindow = FPS_CAPTURE_TOUCH_WINDOW;
+    capture->interval = FPS_CAPTURE_MIN_INTERVAL;
+    capture->lastActivity = millis();
+    capture->nextPoll = capture->lastActivity;
+}
+/*
+*   @brief: a finger touched the sensor. Only sets two fields, safe to call from the touch interrupt
+*   @parameter: capture engine
+*   @return: none
+*
+*/
+void R30X_captureNotifyTouch(__FPS_CAPTURE* capture) {
+    capture->touchTime = capture->millis();
+    capture->touched = 1;
+}
+
+void R30X_captureActivity(__FPS_CAPTURE* capture) {
+    capture->lastActivity = capture->millis();
+    capture->interval = capture->minInterval;
+    if (!reached(capture->lastActivity + capture->interval, capture->nextPoll)) capture->nextPoll = capture->lastActivity + capture->interval;
+}
+/*
+*   @brief: poll the sensor if it is time for it, never waits
+*   @parameter: capture engine
+*   @parameter: pointer to finger print structure
+*   @return: FPS_RESP_OK when an image was taken, FPS_RESP_NOFINGER if not (also when no poll was due),
+*            otherwise the error of generateImage
+*
+*/
+uint8_t R30X_capturePoll(__FPS_CAPTURE* capture, __FPS* stream) {
+    uint32_t now = capture->millis();
+    if (capture->touched) {
+        capture->touched = 0;
+        capture->stats.touches++;
+        if (!capture->touchPending) {
+            capture->touchPending = 1;
+            capture->pendingTouchTime = capture->touchTime;
+        }
+        capture->nextPoll = now;
+    }
+    if (capture->touchPending && reached(now, capture->pendingTouchTime + capture->touchWindow)) {
+        capture->touchPending = 0;  //touch without finger, e.g. a sleeve or a drop of water
+        capture->stats.spuriousTouches++;
+    }
+    if (capture->touchOnly && !capture->touchPending) return FPS_RESP_NOFINGER;
+    if (!reached(now, capture->nextPoll)) return FPS_RESP_NOFINGER;
+
+    uint8_t response = generateImage(stream);
+    capture->lastResponse = response;
+    capture->stats.polls++;
+    now = capture->millis();
+
+    if (response == FPS_RX_OK && stream->rxConfirmationCode == FPS_RESP_OK) {
+        if (capture->touchPending) recordLatency(&capture->stats, now - capture->pendingTouchTime);
+        else if (capture->emptyPollValid) recordLatency(&capture->stats, now - capture->lastEmptyPoll);
+        capture->stats.images++;
+        capture->touchPending = 0;
+        capture->emptyPollValid = 0;
+        capture->lastActivity = now;
+        capture->interval = capture->minInterval;
+        capture->nextPoll = now + capture->interval;
+        return FPS_RESP_OK;
+    }
+    if (response == FPS_RESP_NOFINGER) {
+        capture->stats.emptyPolls++;
+        capture->lastEmptyPoll = now;
+        capture->emptyPollValid = 1;
+        if (capture->touchPending || !reached(now, capture->lastActivity + capture->activeTime)) {
+            capture->interval = capture->minInterval;
+        }
+        else {
+            capture->interval *= 2;  //idle, back off
+            if (capture->interval > capture->maxInterval) capture->interval = capture->maxInterval;
+        }
+        capture->nextPoll = now + capture->interval;
+        return FPS_RESP_NOFINGER;
+    }
+    capture->emptyPollValid = 0;
+    capture->nextPoll = now + capture->interval;
+    return response;
+}
+/*
+*   @brief: wait until an image of a finger is taken
+*   @parameter: capture engine
+*   @parameter: pointer to finger print structure
+*   @parameter: timeout in milliseconds
+*   @return: FPS_RESP_OK when the image is in the module, FPS_RESP_NOFINGER on timeout, otherwise the error of generateImage
+*
+*/
+uint8_t R30X_captureWait(__FPS_CAPTURE* capture, __FPS* stream, uint32_t timeout) {
+    uint32_t start = capture->millis();
+    for (;;) {
+        uint8_t response = R30X_capturePoll(capture, stream);
+        if (response != FPS_RESP_NOFINGER) return response;
+
+        uint32_t now = capture->millis();
+        uint32_t elapsed = now - start;
+        if (elapsed >= timeout) return FPS_RESP_NOFINGER;
+        uint32_t wait = timeout - elapsed;
+        if (!(capture->touchOnly && !capture->touchPending) && wait > capture->nextPoll - now) {
+            wait = reached(now, capture->nextPoll) ? 0 : capture->nextPoll - now;
+        }
+        if (wait > capture->minInterval) wait = capture->minInterval;  //a blocking delay (HAL_Delay) sees a touch within minInterval
+        if (wait > 0 && !capture->touched) capture->delay(wait);
+    }
+}
+
+void R30X_captureResetStats(__FPS_CAPTURE* capture) {
+    memset(&capture->stats, 0, sizeof(__FPS_CAPTURE_STATS));
+}
+
+/********************************END OF FILE*****************************************************/
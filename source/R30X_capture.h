@@ -0,0 +1,78 @@
+/*************************************************************************
+ *
+ * finger print library - finger capture engine
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Waits for a finger without hammering generateImage. Right after activity
+ * (a capture or R30X_captureActivity) the sensor is polled every
+ * minInterval, when nothing happens for activeTime the interval doubles on
+ * every empty poll up to maxInterval.
+ *
+ * When the touch output of the module (WAKEUP / TOUCH pin) is connected,
+ * call R30X_captureNotifyTouch from its interrupt. The next poll happens
+ * at once and is repeated every minInterval for touchWindow; with
+ * touchOnly set the sensor is not polled at all without a touch.
+ *
+ * Needs no threads: millis and delay are given by the application. delay
+ * may return early (e.g. sleep until the next interrupt), the engine
+ * checks the time again. R30X_captureWait delays at most minInterval at a
+ * time and checks for a touch in between, so with a blocking delay like
+ * HAL_Delay a touch is seen within minInterval, with a delay that returns
+ * on the interrupt at once.
+ *
+ **************************************************************************/
+#ifndef R30X_CAPTURE_H
+#define R30X_CAPTURE_H
+#include "R30X_FPS.h"
+
+#define FPS_CAPTURE_MIN_INTERVAL        20    //default poll interval after activity in ms
+#define FPS_CAPTURE_MAX_INTERVAL        1000  //default longest poll interval when idle in ms
+#define FPS_CAPTURE_ACTIVE_TIME         5000  //default time after activity with fast polling in ms
+#define FPS_CAPTURE_TOUCH_WINDOW        1500  //default time after a touch with fast polling in ms
+
+typedef struct {
+	  uint32_t polls;  //generateImage commands
+	  uint32_t emptyPolls;  //polls without finger
+	  uint32_t images;  //images captured
+	  uint32_t touches;  //R30X_captureNotifyTouch calls
+	  uint32_t spuriousTouches;  //touches without image within touchWindow
+	  uint32_t latencyCount;  //images with a touch time
+	  uint32_t lastLatency;  //touch to image in ms. The touch time is from the interrupt, without it the last empty poll (worst case)
+	  uint32_t minLatency;
+	  uint32_t maxLatency;
+	  uint64_t totalLatency;
+}__FPS_CAPTURE_STATS;
+
+typedef struct {
+	  uint32_t (*millis) (void);  //milliseconds since any start point, may wrap around
+	  void (*delay) (uint32_t ms);  //may return early
+	  uint16_t minInterval;
+	  uint16_t maxInterval;
+	  uint16_t activeTime;
+	  uint16_t touchWindow;
+	  uint8_t touchOnly;  //1 to poll only after a touch, needs the touch interrupt
+
+	  volatile uint8_t touched;  //set by R30X_captureNotifyTouch
+	  volatile uint32_t touchTime;
+	  uint8_t touchPending;  //touch not yet followed by an image
+	  uint32_t pendingTouchTime;
+	  uint32_t interval;  //current poll interval
+	  uint32_t lastActivity;
+	  uint32_t lastEmptyPoll;
+	  uint8_t emptyPollValid;  //the last poll saw no finger
+	  uint32_t nextPoll;
+	  uint8_t lastResponse;  //response of the last generateImage
+
+	  __FPS_CAPTURE_STATS stats;
+}__FPS_CAPTURE;
+
+void	R30X_captureInit (__FPS_CAPTURE *capture, uint32_t (*millis)(void), void (*delay)(uint32_t ms));
+void	R30X_captureNotifyTouch (__FPS_CAPTURE *capture); //finger touched the sensor, can be called from an interrupt
+void	R30X_captureActivity (__FPS_CAPTURE *capture); //a finger is expected soon, poll fast again
+uint8_t R30X_capturePoll (__FPS_CAPTURE *capture, __FPS *stream); //one step for a main loop, FPS_RESP_OK when an image was taken
+uint8_t R30X_captureWait (__FPS_CAPTURE *capture, __FPS *stream, uint32_t timeout); //wait for an image, FPS_RESP_OK, FPS_RESP_NOFINGER on timeout or the error
+void	R30X_captureResetStats (__FPS_CAPTURE *capture);
+#endif
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,318 @@
+/*************************************************************************
+ *
+ * finger print library - library compaction
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_compact.h"
+#if defined __linux__ || defined __APPLE__
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+static uint8_t slotUsed(const uint8_t* bitmap, uint16_t slot) {
+    return (bitmap[slot / 8] >> (slot % 8)) & 1;
+}
+
+//read the index table page of a location, 0 if the command failed
+static uint8_t locationFree(__FPS_COMPACT* compact, __FPS* stream, uint16_t location, uint8_t* vacant) {
+    uint8_t table[FPS_INDEX_TABLE_LENGTH];
+    uint8_t response = readIndexTable(stream, (uint8_t)(location / FPS_INDEX_TABLE_PAGE_SIZE), table);
+    compact->lastResponse = response;
+    if (response != FPS_RESP_OK) return 0;
+    *vacant = !slotUsed(table, location % FPS_INDEX_TABLE_PAGE_SIZE);
+    return 1;
+}
+
+//1 if the command went through and the module accepted it
+static uint8_t commandOk(__FPS_COMPACT* compact, __FPS* stream, uint8_t response) {
+    compact->lastResponse = response;
+    return response == FPS_RX_OK && stream->rxConfirmationCode == FPS_RESP_OK;
+}
+
+/*
+*   @brief: prepare a compaction
+*   @parameter: compaction state
+*   @parameter: journal functions, NULL runs without journal (not safe against power loss)
+*   @parameter: context of the journal functions
+*   @return: none
+*
+*/
+void R30X_compactInit(__FPS_COMPACT* compact, const __FPS_COMPACT_JOURNAL* journal, void* journalContext) {
+    memset(compact, 0, sizeof(__FPS_COMPACT));
+    compact->journal = journal;
+    compact->journalContext = journalContext;
+    compact->bufferId = 2;
+}
+/*
+*   @brief: read all index table pages that cover the library (stream->templateCount locations)
+*   @parameter: pointer to finger print structure
+*   @parameter: receives one bit per location
+*   @return: on success FPS_RESP_OK or 0 , packet information is in the stream structure
+*
+*/
+uint8_t R30X_compactReadOccupancy(__FPS* stream, uint8_t bitmap[FPS_COMPACT_BITMAP_LENGTH]) {
+    uint16_t slots = stream->templateCount;
+    uint8_t pages;
+    if (slots == 0 || slots > FPS_COMPACT_MAX_SLOTS) slots = FPS_COMPACT_MAX_SLOTS;
+    pages = (uint8_t)((slots + FPS_INDEX_TABLE_PAGE_SIZE - 1) / FPS_INDEX_TABLE_PAGE_SIZE);
+    memset(bitmap, 0, FPS_COMPACT_BITMAP_LENGTH);
+    for (uint8_t page = 0; page < pages; page++) {
+        uint8_t response = readIndexTable(stream, page, bitmap + page * FPS_INDEX_TABLE_LENGTH);
+        if (response != FPS_RX_OK) return response;
+        if (stream->rxConfirmationCode != FPS_RESP_OK) return stream->rxConfirmationCode;
+    }
+    return FPS_RESP_OK;
+}
+/*
+*   @brief: plan the moves that make the used locations between firstSlot and lastSlot dense, starting at firstSlot.
+*           The highest used location is moved into the lowest free one until they meet, which needs the fewest moves.
+*           The plan is written to the journal before anything is moved
+*   @parameter: compaction state
+*   @parameter: one bit per location, from R30X_compactReadOccupancy
+*   @parameter: first location of the range, at least 1 (location 0 is refused by saveTemplate)
+*   @parameter: last location of the range
+*   @return: number of planned moves, negative if the range is invalid or the journal can not be written
+*
+*/
+int32_t R30X_compactPlan(__FPS_COMPACT* compact, const uint8_t bitmap[FPS_COMPACT_BITMAP_LENGTH], uint16_t firstSlot, uint16_t lastSlot) {
+    uint16_t hole = firstSlot, used = lastSlot, count = 0;
+    if (firstSlot == 0 || lastSlot >= FPS_COMPACT_MAX_SLOTS || firstSlot > lastSlot) return -1;
+
+    for (;;) {
+        while (hole < used && slotUsed(bitmap, hole)) hole++;
+        while (used > hole && !slotUsed(bitmap, used)) used--;
+        if (hole >= used) break;
+        compact->moves[count].oldId = used;
+        compact->moves[count].newId = hole;
+        count++;
+        hole++;
+        used--;
+    }
+    compact->moveCount = count;
+    compact->nextMove = 0;
+    compact->phase = FPS_COMPACT_PENDING;
+    compact->resumed = 0;
+    if (compact->journal != NULL) {
+        if (count == 0) return compact->journal->clear(compact->journalContext) == 0 ? 0 : -2;
+        if (compact->journal->writePlan(compact->journalContext, compact->moves, count) != 0) return -2;
+        if (compact->journal->writeProgress(compact->journalContext, 0, FPS_COMPACT_PENDING) != 0) return -2;
+    }
+    return count;
+}
+/*
+*   @brief: load an unfinished plan from the journal, e.g. after a power loss
+*   @parameter: compaction state
+*   @return: 1 if a plan was loaded, 0 if there is none, negative if the journal is unreadable
+*
+*/
+int8_t R30X_compactResume(__FPS_COMPACT* compact) {
+    if (compact->journal == NULL) return 0;
+    int8_t result = compact->journal->read(compact->journalContext, compact->moves, &compact->moveCount,
+                                           &compact->nextMove, &compact->phase);
+    if (result == 1) {
+        compact->moveCount = 0;
+        compact->nextMove = 0;
+        return 0;
+    }
+    if (result != 0 || compact->moveCount > FPS_COMPACT_MAX_SLOTS || compact->nextMove > compact->moveCount) {
+        compact->moveCount = 0;
+        compact->nextMove = 0;
+        return -1;
+    }
+    compact->resumed = compact->nextMove < compact->moveCount;
+    return compact->resumed;
+}
+/*
+*   @brief: do up to maxMoves moves of the plan. A move that was interrupted is finished first:
+*           if the template was not stored yet it is loaded and stored again, if it was stored only the old location is deleted.
+*           Other moves check first that their new location is still free. onMoved is called before the journal records
+*           the move as finished, so after a power loss the last move can be reported twice
+*   @parameter: compaction state
+*   @parameter: pointer to finger print structure
+*   @parameter: maximum number of moves for this call
+*   @return: moves finished in this call, negative if a command or the journal failed (see compact->lastResponse and stream->rxConfirmationCode),
+*            -3 if the new location holds a template (lastResponse FPS_COMPACT_OCCUPIED): read the occupancy and plan again
+*
+*/
+int32_t R30X_compactStep(__FPS_COMPACT* compact, __FPS* stream, uint16_t maxMoves) {
+    int32_t done = 0;
+    const __FPS_COMPACT_JOURNAL* journal = compact->journal;
+
+    while (done < maxMoves && compact->nextMove < compact->moveCount) {
+        const __FPS_MOVE* move = &compact->moves[compact->nextMove];
+        if (compact->phase == FPS_COMPACT_PENDING) {
+            uint8_t vacant = 1;
+            if (!compact->resumed && !locationFree(compact, stream, move->newId, &vacant)) return -1;
+            if (!vacant) {
+                compact->lastResponse = FPS_COMPACT_OCCUPIED;
+                return -3;
+            }
+            if (!commandOk(compact, stream, loadTemplate(stream, compact->bufferId, move->oldId))) return -1;
+            if (!commandOk(compact, stream, saveTemplate(stream, compact->bufferId, move->newId))) return -1;
+            compact->phase = FPS_COMPACT_SAVED;
+            if (journal != NULL && journal->writeProgress(compact->journalContext, compact->nextMove, FPS_COMPACT_SAVED) != 0) return -2;
+        }
+        if (!commandOk(compact, stream, deleteTemplate(stream, move->oldId, 1))) return -1;
+        //before the journal moves on: after a power loss here the move is finished again and reported again
+        if (compact->onMoved != NULL) compact->onMoved(compact->callbackContext, move->oldId, move->newId);
+        compact->nextMove++;
+        compact->phase = FPS_COMPACT_PENDING;
+        compact->resumed = 0;
+        if (journal != NULL) {
+            int8_t written = compact->nextMove == compact->moveCount ? journal->clear(compact->journalContext)
+                                                                     : journal->writeProgress(compact->journalContext, compact->nextMove, FPS_COMPACT_PENDING);
+            if (written != 0) return -2;
+        }
+        done++;
+    }
+    return done;
+}
+
+uint8_t R30X_compactDone(const __FPS_COMPACT* compact) {
+    return compact->nextMove >= compact->moveCount;
+}
+
+#if defined __linux__ || defined __APPLE__
+//---------------------------------------------------------------------------
+//file journal: "R30XCMP1", uint16 move count, uint16 reserved, moves as uint16 old/new pairs,
+//then the 4 byte progress record (uint16 next move, phase, check byte) that is rewritten in place
+
+#define JOURNAL_HEADER_SIZE     12
+static const uint8_t journalMagic[8] = { 'R', '3', '0', 'X', 'C', 'M', 'P', '1' };
+
+static int8_t writeAll(int fd, const uint8_t* data, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+        offset += written;
+    }
+    return 0;
+}
+
+static int8_t readAll(int fd, uint8_t* data, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t count = pread(fd, data, length, offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return -1;
+        data += count;
+        length -= (size_t)count;
+        offset += count;
+    }
+    return 0;
+}
+
+static uint8_t progressCheck(const uint8_t* record) {
+    return (uint8_t)~(record[0] ^ record[1] ^ record[2]);
+}
+
+//fsync the directory of a path, so a rename in it survives a power loss
+static int8_t syncDirectory(const char* path) {
+    char directory[FPS_COMPACT_PATH_LENGTH];
+    const char* slash = strrchr(path, '/');
+    size_t length = slash == NULL ? 0 : (size_t)(slash - path);
+    if (length >= sizeof(directory)) return -1;
+    if (slash == NULL) strcpy(directory, ".");
+    else if (length == 0) strcpy(directory, "/");
+    else {
+        memcpy(directory, path, length);
+        directory[length] = 0;
+    }
+    int fd = open(directory, O_RDONLY);
+    if (fd < 0) return -1;
+    int8_t result = fsync(fd) == 0 ? 0 : -1;
+    close(fd);
+    return result;
+}
+
+//the plan and a first progress record go to a temporary file that replaces the journal when it is complete,
+//a power loss in between leaves no journal (or the old one) instead of a torn one
+static int8_t fileWritePlan(void* context, const __FPS_MOVE* moves, uint16_t moveCount) {
+    __FPS_COMPACT_FILE* file = (__FPS_COMPACT_FILE*)context;
+    uint8_t header[JOURNAL_HEADER_SIZE] = { 0 };
+    uint8_t pair[4], record[4] = { 0, 0, FPS_COMPACT_PENDING, 0 };
+    char temporary[FPS_COMPACT_PATH_LENGTH];
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", file->path) >= (int)sizeof(temporary)) return -1;
+    if (file->fd >= 0) close(file->fd);
+    file->fd = -1;
+    int fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    memcpy(header, journalMagic, sizeof(journalMagic));
+    header[8] = moveCount & 0xff;
+    header[9] = (moveCount >> 8) & 0xff;
+    int8_t result = writeAll(fd, header, sizeof(header), 0);
+    for (uint16_t i = 0; i < moveCount && result == 0; i++) {
+        pair[0] = moves[i].oldId & 0xff;
+        pair[1] = (moves[i].oldId >> 8) & 0xff;
+        pair[2] = moves[i].newId & 0xff;
+        pair[3] = (moves[i].newId >> 8) & 0xff;
+        result = writeAll(fd, pair, sizeof(pair), JOURNAL_HEADER_SIZE + (off_t)i * 4);
+    }
+    record[3] = progressCheck(record);
+    if (result == 0) result = writeAll(fd, record, sizeof(record), JOURNAL_HEADER_SIZE + (off_t)moveCount * 4);
+    if (result == 0 && fsync(fd) != 0) result = -1;
+    if (result == 0 && rename(temporary, file->path) != 0) result = -1;
+    if (result != 0) {
+        close(fd);
+        unlink(temporary);
+        return -1;
+    }
+    file->fd = fd;  //the descriptor follows the rename
+    file->moveCount = moveCount;
+    return syncDirectory(file->path);
+}
+
+static int8_t fileWriteProgress(void* context, uint16_t nextMove, uint8_t phase) {
+    __FPS_COMPACT_FILE* file = (__FPS_COMPACT_FILE*)context;
+    uint8_t record[4] = { nextMove & 0xff, (nextMove >> 8) & 0xff, phase, 0 };
+    if (file->fd < 0) return -1;
+    record[3] = progressCheck(record);
+    if (writeAll(file->fd, record, sizeof(record), JOURNAL_HEADER_SIZE + (off_t)file->moveCount * 4) != 0) return -1;
+    return fsync(file->fd) == 0 ? 0 : -1;
+}
+
+static int8_t fileRead(void* context, __FPS_MOVE* moves, uint16_t* moveCount, uint16_t* nextMove, uint8_t* phase) {
+    __FPS_COMPACT_FILE* file = (__FPS_COMPACT_FILE*)context;
+    uint8_t header[JOURNAL_HEADER_SIZE], pair[4], record[4];
+    if (file->fd < 0) file->fd = open(file->path, O_RDWR);
+    if (file->fd < 0) return errno == ENOENT ? 1 : -1;
+    if (readAll(file->fd, header, sizeof(header), 0) != 0 || memcmp(header, journalMagic, sizeof(journalMagic)) != 0) return -1;
+    file->moveCount = (uint16_t)(header[8] | (header[9] << 8));
+    if (file->moveCount > FPS_COMPACT_MAX_SLOTS) return -1;
+    for (uint16_t i = 0; i < file->moveCount; i++) {
+        if (readAll(file->fd, pair, sizeof(pair), JOURNAL_HEADER_SIZE + (off_t)i * 4) != 0) return -1;
+        moves[i].oldId = (uint16_t)(pair[0] | (pair[1] << 8));
+        moves[i].newId = (uint16_t)(pair[2] | (pair[3] << 8));
+    }
+    if (readAll(file->fd, record, sizeof(record), JOURNAL_HEADER_SIZE + (off_t)file->moveCount * 4) != 0) return -1;
+    if (record[3] != progressCheck(record)) return -1;
+    *moveCount = file->moveCount;
+    *nextMove = (uint16_t)(record[0] | (record[1] << 8));
+    *phase = record[2];
+    return 0;
+}
+
+static int8_t fileClear(void* context) {
+    __FPS_COMPACT_FILE* file = (__FPS_COMPACT_FILE*)context;
+    if (file->fd >= 0) close(file->fd);
+    file->fd = -1;
+    file->moveCount = 0;
+    if (unlink(file->path) != 0 && errno != ENOENT) return -1;
+    return syncDirectory(file->path);
+}
+
+const __FPS_COMPACT_JOURNAL fpsCompactFileJournal = { fileWritePlan, fileWriteProgress, fileRead, fileClear };
+#endif
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,86 @@
+/*************************************************************************
+ *
+ * finger print library - library compaction
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Moves templates from the end of the library into free locations at the
+ * start, so the used locations form one dense range. Every move is
+ * loadTemplate into a character buffer, saveTemplate to the lower location
+ * and deleteTemplate of the old one. The move plan and the progress are
+ * written to a journal before the module is touched, after a power loss
+ * R30X_compactResume continues where it stopped. Moves can be done a few at
+ * a time with R30X_compactStep whenever the sensor is idle. Before a
+ * template is stored its new location is read from the index table again:
+ * if a finger was enrolled there since the plan was made the step fails
+ * with FPS_COMPACT_OCCUPIED, read the occupancy and plan again. After a
+ * restart resume before enrolling, the location of the interrupted move
+ * is not checked.
+ *
+ * onMoved reports every finished move before the journal moves past it, so
+ * the old to new mapping is delivered at least once: a move interrupted
+ * after its callback is finished and reported again by the resumed step.
+ * The callback must therefore accept the same move twice. The file journal
+ * writes a new plan to "<path>.tmp" and renames it over the journal once it
+ * is on disk.
+ *
+ **************************************************************************/
+#ifndef R30X_COMPACT_H
+#define R30X_COMPACT_H
+#include "R30X_FPS.h"
+
+#define FPS_COMPACT_MAX_SLOTS           1024 //4 index table pages
+#define FPS_COMPACT_BITMAP_LENGTH       (FPS_COMPACT_MAX_SLOTS / 8)
+#define FPS_COMPACT_PATH_LENGTH         256  //longest path of the file journal, with ".tmp"
+
+#define FPS_COMPACT_PENDING             0   //the current move has not stored the template yet
+#define FPS_COMPACT_SAVED               1   //the template is stored at the new location, old one not deleted yet
+#define FPS_COMPACT_OCCUPIED            0xFB  //lastResponse when the new location of a move was used since the plan was made
+
+typedef struct {
+	  uint16_t oldId;
+	  uint16_t newId;
+}__FPS_MOVE;
+
+//persistent storage of the plan and the progress, every function returns 0 on success.
+//writePlan replaces the journal in one step, a power loss while it runs must leave the old journal or none
+typedef struct {
+	  int8_t (*writePlan) (void* context, const __FPS_MOVE* moves, uint16_t moveCount);
+	  int8_t (*writeProgress) (void* context, uint16_t nextMove, uint8_t phase);
+	  int8_t (*read) (void* context, __FPS_MOVE* moves, uint16_t* moveCount, uint16_t* nextMove, uint8_t* phase); //1 if there is no journal
+	  int8_t (*clear) (void* context);
+}__FPS_COMPACT_JOURNAL;
+
+typedef struct {
+	  const __FPS_COMPACT_JOURNAL* journal;
+	  void* journalContext;
+	  void (*onMoved) (void* context, uint16_t oldId, uint16_t newId); //called after every finished move, can be NULL. Must be idempotent: after a power loss a move can be reported again
+	  void* callbackContext;
+	  uint8_t bufferId;  //character buffer used for moving, 1 or 2
+
+	  uint16_t moveCount;
+	  uint16_t nextMove;
+	  uint8_t phase;
+	  uint8_t resumed;  //the current move was interrupted, its new location may already hold the template
+	  uint8_t lastResponse;  //return code of the command that failed, confirmation code or FPS_RX_* code
+	  __FPS_MOVE moves[FPS_COMPACT_MAX_SLOTS];  //the plan, also the old to new ID mapping
+}__FPS_COMPACT;
+
+void	R30X_compactInit (__FPS_COMPACT *compact, const __FPS_COMPACT_JOURNAL *journal, void *journalContext);
+uint8_t R30X_compactReadOccupancy (__FPS *stream, uint8_t bitmap[FPS_COMPACT_BITMAP_LENGTH]); //read the index table of the whole library
+int32_t R30X_compactPlan (__FPS_COMPACT *compact, const uint8_t bitmap[FPS_COMPACT_BITMAP_LENGTH], uint16_t firstSlot, uint16_t lastSlot); //number of moves, negative if the journal fails
+int8_t	R30X_compactResume (__FPS_COMPACT *compact); //1 if an unfinished plan was loaded, 0 if there is none, negative on journal error
+int32_t R30X_compactStep (__FPS_COMPACT *compact, __FPS *stream, uint16_t maxMoves); //moves done, negative on failure, -3 if a location is occupied
+uint8_t R30X_compactDone (const __FPS_COMPACT *compact);
+
+#if defined __linux__ || defined __APPLE__
+extern const __FPS_COMPACT_JOURNAL fpsCompactFileJournal;  //journal in a file, the context is a __FPS_COMPACT_FILE
+typedef struct {
+	  const char* path;
+	  int fd;  //set to -1 before first use
+	  uint16_t moveCount;
+}__FPS_COMPACT_FILE;
+#endif
+#endif
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,82 @@
+/*************************************************************************
+ *
+ * finger print library - compile time configuration
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Select a profile with -DFPS_PROFILE=FPS_PROFILE_DOOR (or FULL) and
+ * override single options with -DFPS_CFG_xxx=0/1. A project header can be
+ * pulled in with -DFPS_USER_CONFIG="my_fps_config.h".
+ *
+ **************************************************************************/
+#ifndef R30X_CONFIG_H
+#define R30X_CONFIG_H
+
+#ifdef FPS_USER_CONFIG
+#include FPS_USER_CONFIG
+#endif
+
+#define FPS_PROFILE_FULL                    0   //every command and field
+#define FPS_PROFILE_DOOR                    1   //identify only door reader on small MCUs
+
+#ifndef FPS_PROFILE
+#define FPS_PROFILE                         FPS_PROFILE_FULL
+#endif
+
+#if FPS_PROFILE == FPS_PROFILE_DOOR
+#ifndef FPS_CFG_IMAGE_TRANSFER
+#define FPS_CFG_IMAGE_TRANSFER              0
+#endif
+#ifndef FPS_CFG_TEMPLATE_TRANSFER
+#define FPS_CFG_TEMPLATE_TRANSFER           0
+#endif
+#ifndef FPS_CFG_ADMIN_SETTERS
+#define FPS_CFG_ADMIN_SETTERS               0
+#endif
+#ifndef FPS_CFG_DEVICE_NAME
+#define FPS_CFG_DEVICE_NAME                 0
+#endif
+#ifndef FPS_CFG_PORT_CONTEXT
+#define FPS_CFG_PORT_CONTEXT                0
+#endif
+#ifndef FPS_CFG_MAX_DATA_PACKET_LENGTH
+#define FPS_CFG_MAX_DATA_PACKET_LENGTH      128
+#endif
+#ifndef FPS_CFG_RX_DATA_LENGTH
+#define FPS_CFG_RX_DATA_LENGTH              16
+#endif
+#endif
+
+#ifndef FPS_CFG_IMAGE_TRANSFER
+#define FPS_CFG_IMAGE_TRANSFER              1   //getImage, exportImage, importImage
+#endif
+#ifndef FPS_CFG_TEMPLATE_TRANSFER
+#define FPS_CFG_TEMPLATE_TRANSFER           1   //exportCharacter, importCharacter
+#endif
+#ifndef FPS_CFG_ADMIN_SETTERS
+#define FPS_CFG_ADMIN_SETTERS               1   //setPassword, setAddress, setBaudrate, setSecurityLevel, setDataLength, portControl
+#endif
+#ifndef FPS_CFG_DEVICE_NAME
+#define FPS_CFG_DEVICE_NAME                 1   //keep __FPS.deviceName (32 bytes)
+#endif
+#ifndef FPS_CFG_PORT_CONTEXT
+#define FPS_CFG_PORT_CONTEXT                1   //keep __FPS.port and __FPS.portContext
+#endif
+#ifndef FPS_CFG_MAX_DATA_PACKET_LENGTH
+#define FPS_CFG_MAX_DATA_PACKET_LENGTH      256 //largest dataPacketLength the modules are set to: 32, 64, 128 or 256
+#endif
+
+#ifndef FPS_CFG_RX_DATA_LENGTH
+#define FPS_CFG_RX_DATA_LENGTH              32  //size of __FPS.rxDataBuffer, 32 bytes are needed for readIndexTable and readNotepad
+#endif
+
+#if FPS_CFG_MAX_DATA_PACKET_LENGTH != 32 && FPS_CFG_MAX_DATA_PACKET_LENGTH != 64 && FPS_CFG_MAX_DATA_PACKET_LENGTH != 128 && FPS_CFG_MAX_DATA_PACKET_LENGTH != 256
+#error "FPS_CFG_MAX_DATA_PACKET_LENGTH must be 32, 64, 128 or 256"
+#endif
+
+//stack buffer of readSysPara, room for two packets of the largest size (512 bytes with 256 byte packets)
+#define FPS_SYSPARA_BUFFER_LENGTH           (FPS_CFG_MAX_DATA_PACKET_LENGTH < 64 ? 128 : 2 * FPS_CFG_MAX_DATA_PACKET_LENGTH)
+
+#endif
+
+/********************************END OF FILE*****************************************************/
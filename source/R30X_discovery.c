@@ -0,0 +1,203 @@
+/*************************************************************************
+ *
+ * finger print library - sensor discovery
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_discovery.h"
+#include <pthread.h>
+#include <time.h>
+
+//most modules are left at the default 57600 or were moved to 115200, try those first
+static const uint8_t baudOrder[FPS_DISCOVERY_BAUD_MULTIPLIERS] = { 6, 12, 1, 2, 4, 3, 8, 5, 7, 9, 10, 11 };
+static const uint32_t defaultAddress[1] = { FPS_DEFAULT_ADDRESS };
+
+typedef struct {
+    const __FPS_DISCOVERY_PORT* ports;
+    uint16_t portCount;
+    __FPS_DISCOVERY_CONFIG config;
+    __FPS_DISCOVERY_RESULT* results;
+    uint16_t maxResults;
+    uint16_t nextPort;  //next port to be taken by a worker
+    int32_t found;
+    pthread_mutex_t lock;
+}__FPS_DISCOVERY_JOB;
+
+static uint32_t millis(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void addResult(__FPS_DISCOVERY_JOB* job, const __FPS* stream, uint16_t portIndex, uint8_t sysParaStatus, uint32_t probeTime) {
+    pthread_mutex_lock(&job->lock);
+    if (job->found < job->maxResults) {
+        __FPS_DISCOVERY_RESULT* result = &job->results[job->found];
+        memset(result, 0, sizeof(__FPS_DISCOVERY_RESULT));
+        result->portIndex = portIndex;
+        result->deviceAddress = stream->deviceAddress;
+        result->deviceBaudrate = stream->deviceBaudrate;
+        result->baudMultiplier = stream->baudMultiplier;
+        result->securityLevel = stream->securityLevel;
+        result->dataPacketLength = stream->dataPacketLength;
+        result->templateCount = stream->templateCount;
+#if FPS_CFG_DEVICE_NAME
+        memcpy(result->deviceName, stream->deviceName, sizeof(result->deviceName));
+#endif
+        result->sysParaStatus = sysParaStatus;
+        result->probeTime = probeTime;
+        job->found++;
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+/*
+*   @brief: sweep all baudrates and addresses on one port
+*   @parameter: discovery job
+*   @parameter: index of the port
+*   @return: none
+*
+*/
+static void probePort(__FPS_DISCOVERY_JOB* job, uint16_t portIndex) {
+    const __FPS_DISCOVERY_PORT* port = &job->ports[portIndex];
+    const __FPS_DISCOVERY_CONFIG* config = &job->config;
+    __FPS stream = { 0 };
+    uint32_t start = millis();
+
+    stream.port = port->port;
+    stream.portContext = port->portContext;
+    for (uint8_t i = 0; i < FPS_DISCOVERY_BAUD_MULTIPLIERS; i++) {
+        uint32_t baud = (uint32_t)baudOrder[i] * 9600;
+        uint8_t found = 0;
+        if (R30X_openPort(&stream, baud) != FPS_RESP_OK) {
+            R30X_closePort(&stream);
+            continue;
+        }
+        for (uint8_t a = 0; a < config->addressCount; a++) {
+            resetParameters(&stream);
+            stream.deviceAddress = config->addresses[a];
+            stream.deviceBaudrate = baud;
+            stream.baudMultiplier = baudOrder[i];
+            stream.commandTimeout = config->handshakeTimeout;
+            if (verifyPassword(&stream, config->password) != FPS_RX_OK || stream.rxConfirmationCode != FPS_RESP_OK) {
+                continue;
+            }
+            //the module is there, give the multi packet system parameter read the usual deadline
+            stream.commandTimeout = FPS_DEFAULT_TIMEOUT;
+            uint8_t status = readSysPara(&stream);
+            for (uint8_t attempt = 1; attempt < FPS_DISCOVERY_SYSPARA_ATTEMPTS && status != FPS_RESP_OK; attempt++) status = readSysPara(&stream);
+            addResult(job, &stream, portIndex, status, millis() - start);
+            found = 1;
+            if (config->singleModulePerPort) break;
+        }
+        R30X_closePort(&stream);
+        if (found && config->singleModulePerPort) return;
+    }
+}
+
+static void* discoveryWorker(void* arg) {
+    __FPS_DISCOVERY_JOB* job = (__FPS_DISCOVERY_JOB*)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        uint16_t portIndex = job->nextPort;
+        if (portIndex < job->portCount) job->nextPort++;
+        pthread_mutex_unlock(&job->lock);
+        if (portIndex >= job->portCount) return NULL;
+        probePort(job, portIndex);
+    }
+}
+/*
+*   @brief: fill discovery configuration with default values
+*   @parameter: pointer to configuration
+*   @return: none
+*
+*/
+void R30X_discoveryDefaults(__FPS_DISCOVERY_CONFIG* config) {
+    memset(config, 0, sizeof(__FPS_DISCOVERY_CONFIG));
+    config->password = FPS_DEFAULT_PASSWORD;
+    config->addresses = defaultAddress;
+    config->addressCount = 1;
+    config->handshakeTimeout = FPS_DISCOVERY_DEFAULT_TIMEOUT;
+    config->maxThreads = FPS_DISCOVERY_DEFAULT_THREADS;
+    config->singleModulePerPort = 1;
+}
+/*
+*   @brief: probe all ports concurrently. Every port is swept through all 12 baudrate multipliers
+*           and all configured addresses with verifyPassword, modules that answer are read with readSysPara
+*           (see sysParaStatus of the result)
+*   @parameter: array of ports to probe
+*   @parameter: number of ports
+*   @parameter: configuration, NULL for defaults
+*   @parameter: table that receives the found modules
+*   @parameter: size of the table
+*   @return: number of modules found, negative value if the worker threads could not be started
+*
+*/
+int32_t R30X_discover(const __FPS_DISCOVERY_PORT* ports, uint16_t portCount, const __FPS_DISCOVERY_CONFIG* config,
+                      __FPS_DISCOVERY_RESULT* results, uint16_t maxResults) {
+    __FPS_DISCOVERY_JOB job;
+    pthread_t threads[FPS_DISCOVERY_DEFAULT_THREADS * 4];
+    uint16_t threadCount, started = 0;
+
+    memset(&job, 0, sizeof(job));
+    if (config != NULL) job.config = *config;
+    else R30X_discoveryDefaults(&job.config);
+    if (job.config.addresses == NULL || job.config.addressCount == 0) {
+        job.config.addresses = defaultAddress;
+        job.config.addressCount = 1;
+    }
+    if (job.config.handshakeTimeout == 0) job.config.handshakeTimeout = FPS_DISCOVERY_DEFAULT_TIMEOUT;
+    if (job.config.maxThreads == 0) job.config.maxThreads = FPS_DISCOVERY_DEFAULT_THREADS;
+
+    job.ports = ports;
+    job.portCount = portCount;
+    job.results = results;
+    job.maxResults = maxResults;
+    pthread_mutex_init(&job.lock, NULL);
+
+    threadCount = job.config.maxThreads;
+    if (threadCount > portCount) threadCount = portCount;
+    if (threadCount > sizeof(threads) / sizeof(threads[0])) threadCount = sizeof(threads) / sizeof(threads[0]);
+    for (; started < threadCount; started++) {
+        if (pthread_create(&threads[started], NULL, discoveryWorker, &job) != 0) break;
+    }
+    if (started == 0 && portCount > 0) {
+        pthread_mutex_destroy(&job.lock);
+        return -1;
+    }
+    for (uint16_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&job.lock);
+    return job.found;
+}
+/*
+*   @brief: initialize a stream for a module found by R30X_discover
+*   @parameter: pointer to finger print structure
+*   @parameter: port the module was found on
+*   @parameter: discovery result of the module
+*   @parameter: device password
+*   @return: return 0 if intialize is ok if not OK return negetive value
+*
+*/
+int8_t R30X_initDiscovered(__FPS* stream, const __FPS_DISCOVERY_PORT* port, const __FPS_DISCOVERY_RESULT* result, uint32_t password) {
+    stream->port = port->port;
+    stream->portContext = port->portContext;
+    resetParameters(stream);
+    stream->deviceAddress = result->deviceAddress;
+    stream->deviceBaudrate = result->deviceBaudrate;
+    stream->baudMultiplier = result->baudMultiplier;
+    if (R30X_openPort(stream, stream->deviceBaudrate) != FPS_RESP_OK) {
+        R30X_closePort(stream);
+        return -1;
+    }
+    if (verifyPassword(stream, password) != FPS_RX_OK || stream->rxConfirmationCode != FPS_RESP_OK) {
+        R30X_closePort(stream);
+        return -2;
+    }
+    readSysPara(stream);
+    return FPS_RESP_OK;
+}
+
+/********************************END OF FILE*****************************************************/
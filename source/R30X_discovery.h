@@ -0,0 +1,59 @@
+/*************************************************************************
+ *
+ * finger print library - sensor discovery
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Probes several serial ports in parallel for R30x modules, sweeping all
+ * baudrate multipliers and a list of addresses with a short handshake
+ * deadline. Needs POSIX threads.
+ *
+ **************************************************************************/
+#ifndef R30X_DISCOVERY_H
+#define R30X_DISCOVERY_H
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_PORT_CONTEXT
+#error "R30X_discovery needs FPS_CFG_PORT_CONTEXT"
+#endif
+
+#define FPS_DISCOVERY_DEFAULT_TIMEOUT      40     //handshake deadline in milliseconds for every probe
+#define FPS_DISCOVERY_DEFAULT_THREADS      16     //number of ports probed at the same time
+#define FPS_DISCOVERY_BAUD_MULTIPLIERS     12     //9600 * (1 .. 12)
+#define FPS_DISCOVERY_SYSPARA_ATTEMPTS     2      //readSysPara of a module that answered the handshake
+
+typedef struct {
+	  const __FPS_PORT* port;  //port functions of this serial line
+	  void* portContext;  //context passed to the port functions
+	  const char* name;  //label of the port, only used in reports (can be NULL)
+}__FPS_DISCOVERY_PORT;
+
+typedef struct {
+	  uint32_t password;  //password used for the verifyPassword handshake
+	  const uint32_t* addresses;  //addresses to try, NULL means only FPS_DEFAULT_ADDRESS
+	  uint8_t addressCount;
+	  uint16_t handshakeTimeout;  //response deadline of every probe in milliseconds, 0 means FPS_DISCOVERY_DEFAULT_TIMEOUT
+	  uint16_t maxThreads;  //ports probed concurrently, 0 means FPS_DISCOVERY_DEFAULT_THREADS
+	  uint8_t singleModulePerPort;  //stop sweeping a port after the first module answered
+}__FPS_DISCOVERY_CONFIG;
+
+typedef struct {
+	  uint16_t portIndex;  //index in the ports array given to R30X_discover
+	  uint32_t deviceAddress;
+	  uint32_t deviceBaudrate;
+	  uint16_t baudMultiplier;
+	  uint16_t securityLevel;
+	  uint16_t dataPacketLength;
+	  uint16_t templateCount;  //library size reported by readSysPara
+	  char deviceName[32];  //empty without FPS_CFG_DEVICE_NAME
+	  uint8_t sysParaStatus;  //return code of readSysPara; if not FPS_RESP_OK, security level, packet length, library size and name were not read
+	  uint32_t probeTime;  //time spent on this port until the module answered, in milliseconds
+}__FPS_DISCOVERY_RESULT;
+
+void	R30X_discoveryDefaults (__FPS_DISCOVERY_CONFIG *config); //fill config with default values
+int32_t R30X_discover (const __FPS_DISCOVERY_PORT *ports, uint16_t portCount, const __FPS_DISCOVERY_CONFIG *config,
+					   __FPS_DISCOVERY_RESULT *results, uint16_t maxResults); //returns number of modules found or negative value on error
+int8_t	R30X_initDiscovered (__FPS *stream, const __FPS_DISCOVERY_PORT *port, const __FPS_DISCOVERY_RESULT *result, uint32_t password); //like R30X_init for a discovered module
+#endif
+
+/********************************END OF FILE*****************************************************/
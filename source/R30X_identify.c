@@ -0,0 +1,141 @@
+/*************************************************************************
+ *
+ * finger print library - continuous identify
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_identify.h"
+
+#define FRAME_OVERHEAD      12  //start code, address, packet type, length, instruction or confirmation code, checksum
+#define RANGE_SEARCH_ARGS   5   //capture timeout, start and count
+
+static void pushResult(__FPS_IDENTIFY* identify, __FPS* stream, uint8_t status) {
+    unsigned head = atomic_load_explicit(&identify->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&identify->tail, memory_order_acquire);
+    if (head - tail >= FPS_IDENTIFY_QUEUE_LENGTH) {
+        identify->stats.dropped++;
+        return;
+    }
+    __FPS_IDENTIFY_RESULT* result = &identify->queue[head % FPS_IDENTIFY_QUEUE_LENGTH];
+    result->status = status;
+    result->fingerId = stream->fingerId;
+    result->matchScore = stream->matchScore;
+    result->time = identify->millis();
+    atomic_store_explicit(&identify->head, head + 1, memory_order_release);
+}
+/*
+*   @brief: prepare an identify engine searching the whole library with the default timeouts
+*   @parameter: identify engine
+*   @parameter: function returning milliseconds
+*   @parameter: function waiting milliseconds
+*   @return: none
+*
+*/
+void R30X_identifyInit(__FPS_IDENTIFY* identify, uint32_t (*millis)(void), void (*delay)(uint32_t ms)) {
+    memset(identify, 0, sizeof(__FPS_IDENTIFY));
+    identify->millis = millis;
+    identify->delay = delay;
+    identify->captureTimeout = FPS_IDENTIFY_CAPTURE_TIMEOUT;
+    identify->liftDelay = FPS_IDENTIFY_LIFT_DELAY;
+    atomic_init(&identify->head, 0);
+    atomic_init(&identify->tail, 0);
+    identify->stats.startTime = millis();
+}
+/*
+*   @brief: one scan-and-search command. The module waits up to captureTimeout for a finger
+*   @parameter: identify engine
+*   @parameter: pointer to finger print structure
+*   @return: FPS_RESP_OK (queued with fingerId), FPS_RESP_NOTFOUND (queued), FPS_RESP_NOFINGER, otherwise the error
+*
+*/
+uint8_t R30X_identifyStep(__FPS_IDENTIFY* identify, __FPS* stream) {
+    uint16_t count = identify->count;
+    if (count == 0 && identify->startLocation < stream->templateCount) count = stream->templateCount - identify->startLocation;
+    uint8_t response = captureAndRangeSearch(stream, identify->captureTimeout, identify->startLocation, count);
+    if (response == FPS_BAD_VALUE) {  //rejected before anything was sent
+        identify->stats.errors++;
+        identify->stats.lastError = response;
+        return response;
+    }
+    identify->stats.commands++;
+    identify->stats.busBytes += FRAME_OVERHEAD + RANGE_SEARCH_ARGS;
+    if (response < FPS_RX_BADPACKET) identify->stats.busBytes += FRAME_OVERHEAD + stream->rxDataBufferLength;  //the module answered
+    switch (response) {
+    case FPS_RESP_OK:
+        identify->stats.identified++;
+        pushResult(identify, stream, response);
+        break;
+    case FPS_RESP_NOTFOUND:
+        identify->stats.notFound++;
+        pushResult(identify, stream, response);
+        break;
+    case FPS_RESP_NOFINGER:
+        identify->stats.noFinger++;
+        break;
+    default:
+        identify->stats.errors++;
+        identify->stats.lastError = response;
+        break;
+    }
+    return response;
+}
+/*
+*   @brief: identify until R30X_identifyStop, for a thread of its own or the main loop of a device without other work
+*   @parameter: identify engine
+*   @parameter: pointer to finger print structure
+*   @return: none
+*
+*/
+void R30X_identifyRun(__FPS_IDENTIFY* identify, __FPS* stream) {
+    while (!identify->stop) {
+        uint8_t response = R30X_identifyStep(identify, stream);
+        if (response == FPS_RESP_OK || response == FPS_RESP_NOTFOUND) identify->delay(identify->liftDelay);
+        else if (response != FPS_RESP_NOFINGER) identify->delay(FPS_IDENTIFY_ERROR_DELAY);  //do not hammer a module that fails
+    }
+}
+
+void R30X_identifyStop(__FPS_IDENTIFY* identify) {
+    identify->stop = 1;
+}
+/*
+*   @brief: take the oldest result
+*   @parameter: identify engine
+*   @parameter: result
+*   @return: 1 if a result was taken, 0 if the queue is empty
+*
+*/
+uint8_t R30X_identifyPop(__FPS_IDENTIFY* identify, __FPS_IDENTIFY_RESULT* result) {
+    unsigned tail = atomic_load_explicit(&identify->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&identify->head, memory_order_acquire);
+    if (head == tail) return 0;
+    *result = identify->queue[tail % FPS_IDENTIFY_QUEUE_LENGTH];
+    atomic_store_explicit(&identify->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+uint32_t R30X_identifyPerMinute(__FPS_IDENTIFY* identify) {
+    uint32_t elapsed = identify->millis() - identify->stats.startTime;
+    uint64_t results = (uint64_t)identify->stats.identified + identify->stats.notFound;
+    return elapsed == 0 ? 0 : (uint32_t)(results * 60000 / elapsed);
+}
+
+uint32_t R30X_identifyBytesPerResult(__FPS_IDENTIFY* identify) {
+    uint64_t results = (uint64_t)identify->stats.identified + identify->stats.notFound;
+    return results == 0 ? 0 : (uint32_t)(identify->stats.busBytes / results);
+}
+/*
+*   @brief: clear the counters, results in the queue are kept
+*   @parameter: identify engine
+*   @return: none
+*
+*/
+void R30X_identifyResetStats(__FPS_IDENTIFY* identify) {
+    memset(&identify->stats, 0, sizeof(__FPS_IDENTIFY_STATS));
+    identify->stats.startTime = identify->millis();
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,77 @@
+/*************************************************************************
+ *
+ * finger print library - continuous identify
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Identifies fingers with one command per attempt: FPS_CMD_SCANANDRANGESEARCH
+ * makes the module itself wait up to captureTimeout for a finger, extract
+ * it and search the library, so the host neither polls generateImage nor
+ * sends generateCharacter and searchLibrary. An idle sensor costs one
+ * command and one reply per captureTimeout.
+ *
+ * Results (identified or not in the library) go into a bounded queue for
+ * the application. One thread runs R30X_identifyRun, one other thread
+ * takes the results with R30X_identifyPop; when the queue is full the
+ * newest result is dropped and counted. After a result the engine waits
+ * liftDelay so a finger that stays on the sensor is reported once.
+ *
+ * R30X_identifyStop takes effect after the command on the line, at most
+ * captureTimeout later.
+ *
+ **************************************************************************/
+#ifndef R30X_IDENTIFY_H
+#define R30X_IDENTIFY_H
+#include <stdatomic.h>
+#include "R30X_FPS.h"
+
+#define FPS_IDENTIFY_QUEUE_LENGTH       16    //results kept for the application, a power of two
+#define FPS_IDENTIFY_CAPTURE_TIMEOUT    5000  //default time the module waits for a finger per command in ms
+#define FPS_IDENTIFY_LIFT_DELAY         1000  //default pause after a result in ms
+#define FPS_IDENTIFY_ERROR_DELAY        100   //pause after a failed command in ms
+
+typedef struct {
+	  uint8_t status;  //FPS_RESP_OK: fingerId identified, FPS_RESP_NOTFOUND: a finger not in the searched range
+	  uint16_t fingerId;
+	  uint16_t matchScore;
+	  uint32_t time;  //millis when the reply arrived
+}__FPS_IDENTIFY_RESULT;
+
+typedef struct {
+	  uint32_t commands;  //scan-and-search commands sent
+	  uint32_t identified;
+	  uint32_t notFound;
+	  uint32_t noFinger;  //commands that ended with the capture timeout
+	  uint32_t errors;  //other confirmation codes and lost replies
+	  uint32_t dropped;  //results lost because the queue was full
+	  uint64_t busBytes;  //bytes of all command and reply frames
+	  uint32_t startTime;  //millis of R30X_identifyInit or R30X_identifyResetStats
+	  uint8_t lastError;
+}__FPS_IDENTIFY_STATS;
+
+typedef struct {
+	  uint32_t (*millis) (void);  //milliseconds since any start point, may wrap around
+	  void (*delay) (uint32_t ms);
+	  uint16_t captureTimeout;  //ms, at most 25500, the module counts it in steps of 140 ms
+	  uint16_t startLocation;  //first location searched, the same IDs as saveTemplate and the results
+	  uint16_t count;  //locations searched, 0 for everything from startLocation to the end of the library
+	  uint16_t liftDelay;
+	  volatile uint8_t stop;
+
+	  __FPS_IDENTIFY_RESULT queue[FPS_IDENTIFY_QUEUE_LENGTH];
+	  atomic_uint head;  //written by the thread running the engine
+	  atomic_uint tail;  //written by the thread taking results
+	  __FPS_IDENTIFY_STATS stats;
+}__FPS_IDENTIFY;
+
+void	R30X_identifyInit (__FPS_IDENTIFY *identify, uint32_t (*millis)(void), void (*delay)(uint32_t ms));
+uint8_t R30X_identifyStep (__FPS_IDENTIFY *identify, __FPS *stream); //one attempt, queues the result; FPS_RESP_OK, NOTFOUND, NOFINGER or the error
+void	R30X_identifyRun (__FPS_IDENTIFY *identify, __FPS *stream); //attempts until R30X_identifyStop
+void	R30X_identifyStop (__FPS_IDENTIFY *identify);
+uint8_t R30X_identifyPop (__FPS_IDENTIFY *identify, __FPS_IDENTIFY_RESULT *result); //1 if a result was taken, 0 if the queue is empty
+uint32_t R30X_identifyPerMinute (__FPS_IDENTIFY *identify); //results (identified or not found) per minute since the start of the stats
+uint32_t R30X_identifyBytesPerResult (__FPS_IDENTIFY *identify); //bus bytes per result, idle commands included
+void	R30X_identifyResetStats (__FPS_IDENTIFY *identify);
+#endif
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,166 @@
+/*************************************************************************
+ *
+ * finger print library - pool of image buffers
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include "R30X_imgpool.h"
+
+#define HEAD_INDEX(head)        ((uint32_t)((head) & 0xFFFFFFFFULL))
+#define HEAD_TAG(head)          ((uint64_t)(head) >> 32)
+#define MAKE_HEAD(tag, index)   (((uint64_t)(tag) << 32) | (uint32_t)(index))
+
+static void pushFree(__FPS_IMGPOOL* pool, __FPS_IMAGE* image) {
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&image->next, HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, MAKE_HEAD(HEAD_TAG(head) + 1, image->index),
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static __FPS_IMAGE* popFree(__FPS_IMGPOOL* pool) {
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    for (;;) {
+        uint32_t index = HEAD_INDEX(head);
+        if (index == FPS_IMGPOOL_END) return NULL;
+        uint32_t next = atomic_load_explicit(&pool->images[index].next, memory_order_relaxed);
+        //the tag changes on every push and pop, so a stale next is never installed
+        if (atomic_compare_exchange_weak_explicit(&pool->head, &head, MAKE_HEAD(HEAD_TAG(head) + 1, next),
+                                                  memory_order_acquire, memory_order_acquire)) {
+            return &pool->images[index];
+        }
+    }
+}
+/*
+*   @brief: allocate the pool, the only allocation it makes
+*   @parameter: pool
+*   @parameter: number of image buffers
+*   @return: 0 on success, -1 if out of memory
+*
+*/
+int8_t R30X_imgpoolCreate(__FPS_IMGPOOL* pool, uint32_t count) {
+    memset(pool, 0, sizeof(__FPS_IMGPOOL));
+    if (count == 0 || count >= FPS_IMGPOOL_END) return -1;
+    pool->images = (__FPS_IMAGE*)calloc(count, sizeof(__FPS_IMAGE));
+    pool->memory = (uint8_t*)malloc((size_t)count * FPS_IMGPOOL_BUFFER_SIZE);
+    if (pool->images == NULL || pool->memory == NULL) {
+        free(pool->images);
+        free(pool->memory);
+        return -1;
+    }
+    pool->count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        __FPS_IMAGE* image = &pool->images[i];
+        image->data = pool->memory + (size_t)i * FPS_IMGPOOL_BUFFER_SIZE;
+        image->index = i;
+        image->pool = pool;
+        atomic_init(&image->refs, 0);
+        atomic_init(&image->next, i + 1 < count ? i + 1 : FPS_IMGPOOL_END);
+    }
+    atomic_init(&pool->head, MAKE_HEAD(0, 0));
+    atomic_init(&pool->acquisitions, 0);
+    atomic_init(&pool->exhaustions, 0);
+    atomic_init(&pool->inUse, 0);
+    atomic_init(&pool->peakInUse, 0);
+    return 0;
+}
+
+void R30X_imgpoolDestroy(__FPS_IMGPOOL* pool) {
+    free(pool->images);
+    free(pool->memory);
+    pool->images = NULL;
+    pool->memory = NULL;
+    pool->count = 0;
+}
+/*
+*   @brief: take a free buffer
+*   @parameter: pool
+*   @return: image with one reference, NULL if all buffers are in use
+*
+*/
+__FPS_IMAGE* R30X_imgpoolAcquire(__FPS_IMGPOOL* pool) {
+    __FPS_IMAGE* image = popFree(pool);
+    if (image == NULL) {
+        atomic_fetch_add_explicit(&pool->exhaustions, 1, memory_order_relaxed);
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&pool->acquisitions, 1, memory_order_relaxed);
+    unsigned inUse = atomic_fetch_add_explicit(&pool->inUse, 1, memory_order_relaxed) + 1;
+    unsigned peak = atomic_load_explicit(&pool->peakInUse, memory_order_relaxed);
+    while (inUse > peak && !atomic_compare_exchange_weak_explicit(&pool->peakInUse, &peak, inUse, memory_order_relaxed, memory_order_relaxed)) {}
+    image->length = 0;
+    image->unpacked = 0;
+    atomic_store_explicit(&image->refs, 1, memory_order_relaxed);
+    return image;
+}
+
+void R30X_imgpoolRetain(__FPS_IMAGE* image) {
+    atomic_fetch_add_explicit(&image->refs, 1, memory_order_relaxed);
+}
+/*
+*   @brief: drop a reference. The image must not be used by the caller afterwards
+*   @parameter: image
+*   @return: none
+*
+*/
+void R30X_imgpoolRelease(__FPS_IMAGE* image) {
+    if (atomic_fetch_sub_explicit(&image->refs, 1, memory_order_acq_rel) != 1) return;
+    __FPS_IMGPOOL* pool = (__FPS_IMGPOOL*)image->pool;
+    atomic_fetch_sub_explicit(&pool->inUse, 1, memory_order_relaxed);
+    pushFree(pool, image);
+}
+/*
+*   @brief: download the image buffer of the module (after generateImage) into a pool buffer
+*   @parameter: pool
+*   @parameter: pointer to finger print structure
+*   @parameter: receives the image with one reference, NULL on failure
+*   @return: on success FPS_RESP_OK or 0, FPS_IMGPOOL_EXHAUSTED if no buffer is free, otherwise the error of getImage
+*            (the confirmation code if the module rejected the command)
+*
+*/
+uint8_t R30X_imgpoolCapture(__FPS_IMGPOOL* pool, __FPS* stream, __FPS_IMAGE** image) {
+    __FPS_IMAGE* buffer = R30X_imgpoolAcquire(pool);
+    *image = NULL;
+    if (buffer == NULL) return FPS_IMGPOOL_EXHAUSTED;
+
+    uint8_t response = getImage(stream, buffer->data);
+    if (response != FPS_RESP_OK) {
+        R30X_imgpoolRelease(buffer);
+        return response;
+    }
+    buffer->length = FPS_IMAGE_SIZE;
+    *image = buffer;
+    return FPS_RESP_OK;
+}
+/*
+*   @brief: expand the 4 bit pixels of the module to one byte per pixel (0..255), in place.
+*           Call it before other references are taken
+*   @parameter: image
+*   @return: none
+*
+*/
+void R30X_imgpoolUnpack(__FPS_IMAGE* image) {
+    if (image->unpacked || image->length > FPS_IMGPOOL_BUFFER_SIZE / 2) return;
+    for (uint32_t i = image->length; i-- > 0;) {  //from the end, so no byte is overwritten before it is read
+        uint8_t packed = image->data[i];
+        image->data[2 * i] = (uint8_t)((packed >> 4) * 17);
+        image->data[2 * i + 1] = (uint8_t)((packed & 0x0F) * 17);
+    }
+    image->length *= 2;
+    image->unpacked = 1;
+}
+
+void R30X_imgpoolGetStats(__FPS_IMGPOOL* pool, __FPS_IMGPOOL_STATS* stats) {
+    stats->acquisitions = atomic_load_explicit(&pool->acquisitions, memory_order_relaxed);
+    stats->exhaustions = atomic_load_explicit(&pool->exhaustions, memory_order_relaxed);
+    stats->inUse = atomic_load_explicit(&pool->inUse, memory_order_relaxed);
+    stats->peakInUse = atomic_load_explicit(&pool->peakInUse, memory_order_relaxed);
+    stats->count = pool->count;
+}
+
+/********************************END OF FILE*****************************************************/
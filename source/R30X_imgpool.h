@@ -0,0 +1,75 @@
+/*************************************************************************
+ *
+ * finger print library - pool of image buffers
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * A fixed number of image buffers allocated once. R30X_imgpoolCapture
+ * downloads an image into a free buffer and returns a handle with one
+ * reference. Every stage that keeps the image (quality check, encoder,
+ * archiver, network sender) takes its own reference with
+ * R30X_imgpoolRetain and drops it with R30X_imgpoolRelease; all of them
+ * read the same buffer, and the last release puts it back into the pool.
+ *
+ * The free list is lock free (C11 atomics, index plus tag against the ABA
+ * problem), so handles can be acquired and released from any thread. When
+ * the pool is empty the capture fails and the exhaustion is counted, the
+ * pool never falls back to the heap.
+ *
+ * The image data must not be changed after a second reference exists:
+ * unpack it before handing it out.
+ *
+ **************************************************************************/
+#ifndef R30X_IMGPOOL_H
+#define R30X_IMGPOOL_H
+#include <stdatomic.h>
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_IMAGE_TRANSFER
+#error "R30X_imgpool needs FPS_CFG_IMAGE_TRANSFER"
+#endif
+
+#define FPS_IMGPOOL_BUFFER_SIZE         (FPS_IMAGE_WIDTH * FPS_IMAGE_HEIGHT)  //one byte per pixel after unpacking
+#define FPS_IMGPOOL_EXHAUSTED           0xFE  //returned by R30X_imgpoolCapture when no buffer is free
+#define FPS_IMGPOOL_END                 0xFFFFFFFFUL
+
+typedef struct {
+	  uint8_t* data;  //FPS_IMGPOOL_BUFFER_SIZE bytes
+	  uint32_t length;  //bytes of image data
+	  uint8_t unpacked;  //1 when data has one byte per pixel
+	  uint32_t index;  //position in the pool
+	  atomic_uint refs;
+	  atomic_uint next;  //free list
+	  void* pool;
+}__FPS_IMAGE;
+
+typedef struct {
+	  uint64_t acquisitions;
+	  uint64_t exhaustions;  //acquisitions that found the pool empty
+	  uint32_t inUse;
+	  uint32_t peakInUse;
+	  uint32_t count;
+}__FPS_IMGPOOL_STATS;
+
+typedef struct {
+	  __FPS_IMAGE* images;
+	  uint8_t* memory;
+	  uint32_t count;
+	  atomic_uint_fast64_t head;  //tag in the upper 32 bits, index of the first free image in the lower
+	  atomic_uint_fast64_t acquisitions;
+	  atomic_uint_fast64_t exhaustions;
+	  atomic_uint inUse;
+	  atomic_uint peakInUse;
+}__FPS_IMGPOOL;
+
+int8_t	R30X_imgpoolCreate (__FPS_IMGPOOL *pool, uint32_t count); //allocate count buffers, 0 on success
+void	R30X_imgpoolDestroy (__FPS_IMGPOOL *pool); //all handles must be released
+__FPS_IMAGE* R30X_imgpoolAcquire (__FPS_IMGPOOL *pool); //free buffer with one reference, NULL if the pool is empty
+void	R30X_imgpoolRetain (__FPS_IMAGE *image); //take another reference
+void	R30X_imgpoolRelease (__FPS_IMAGE *image); //drop a reference, the last one returns the buffer
+uint8_t R30X_imgpoolCapture (__FPS_IMGPOOL *pool, __FPS *stream, __FPS_IMAGE **image); //download the image buffer of the module into a pool buffer
+void	R30X_imgpoolUnpack (__FPS_IMAGE *image); //one byte per pixel, in place
+void	R30X_imgpoolGetStats (__FPS_IMGPOOL *pool, __FPS_IMGPOOL_STATS *stats);
+#endif
+
+/********************************END OF FILE*****************************************************/
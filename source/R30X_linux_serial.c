@@ -0,0 +1,166 @@
+/*************************************************************************
+ *
+ * finger print library - Linux serial port
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_linux_serial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>  //termios2 for BOTHER, <termios.h> must not be included with it
+#include <linux/serial.h>
+
+static uint64_t monotonicMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+//standard speed constant of a baudrate, BOTHER for the multipliers without one
+static tcflag_t speedFlag(uint32_t baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return BOTHER;
+    }
+}
+
+static int configure(__FPS_LINUX_SERIAL* serial, uint32_t baud) {
+    struct termios2 tio;
+    if (ioctl(serial->fd, TCGETS2, &tio) != 0) return -1;
+    tio.c_iflag &= ~(tcflag_t)(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+    tio.c_oflag &= ~(tcflag_t)OPOST;
+    tio.c_lflag &= ~(tcflag_t)(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(tcflag_t)(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= CS8 | CREAD | CLOCAL | speedFlag(baud);
+    tio.c_ispeed = baud;
+    tio.c_ospeed = baud;
+    tio.c_cc[VMIN] = 1;  //reads do not block anyway, poll does the waiting
+    tio.c_cc[VTIME] = 0;
+    if (ioctl(serial->fd, TCSETS2, &tio) != 0) return -1;
+    ioctl(serial->fd, TCFLSH, TCIOFLUSH);
+    serial->baud = baud;
+    return 0;
+}
+
+static void requestLowLatency(__FPS_LINUX_SERIAL* serial) {
+    struct serial_struct info;
+    serial->lowLatencyActive = 0;
+    if (ioctl(serial->fd, TIOCGSERIAL, &info) != 0) return;  //e.g. a pseudo terminal
+    info.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(serial->fd, TIOCSSERIAL, &info) == 0) serial->lowLatencyActive = 1;
+}
+
+//---------------------------------------------------------------------------
+static uint32_t serialRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    __FPS_LINUX_SERIAL* serial = (__FPS_LINUX_SERIAL*)context;
+    uint64_t deadline = monotonicMs() + timeout;
+    uint32_t count = 0;
+    if (serial->fd < 0) return 0;
+    for (;;) {
+        ssize_t n = read(serial->fd, pBuf + count, BytesToRead - count);
+        if (n > 0) {
+            count += (uint32_t)n;
+            if (count >= BytesToRead) break;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            serial->lastError = errno;
+            break;
+        }
+        uint64_t now = monotonicMs();
+        if (now >= deadline) break;
+        struct pollfd pfd = { serial->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, (int)(deadline - now)) == 0) break;
+    }
+    serial->bytesRead += count;
+    if (count < BytesToRead) serial->readTimeouts++;
+    return count;
+}
+
+static uint32_t serialWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    __FPS_LINUX_SERIAL* serial = (__FPS_LINUX_SERIAL*)context;
+    uint64_t deadline = monotonicMs() + timeout;
+    uint32_t count = 0;
+    if (serial->fd < 0) return 0;
+    while (count < BytesToWrite) {
+        ssize_t n = write(serial->fd, pBuf + count, BytesToWrite - count);
+        if (n > 0) {
+            count += (uint32_t)n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            serial->lastError = errno;
+            break;
+        }
+        uint64_t now = monotonicMs();
+        if (now >= deadline) break;
+        struct pollfd pfd = { serial->fd, POLLOUT, 0 };
+        poll(&pfd, 1, (int)(deadline - now));
+    }
+    serial->bytesWritten += count;
+    return count;
+}
+/*
+*   @brief: open the tty, or change the baudrate when it is open already (setBaudrate)
+*   @return: 0 on success, 1 if the tty can not be opened or the baudrate is not a multiple of 9600 from 1 to 12
+*
+*/
+static uint8_t serialInitialize(void* context, uint32_t baud) {
+    __FPS_LINUX_SERIAL* serial = (__FPS_LINUX_SERIAL*)context;
+    if (baud % 9600 != 0 || baud / 9600 < 1 || baud / 9600 > 12) return 1;
+    if (serial->fd < 0) {
+        serial->fd = open(serial->path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (serial->fd < 0) {
+            serial->lastError = errno;
+            return 1;
+        }
+        if (serial->exclusive && ioctl(serial->fd, TIOCEXCL) != 0) {
+            serial->lastError = errno;
+            close(serial->fd);
+            serial->fd = -1;
+            return 1;
+        }
+        if (serial->lowLatency) requestLowLatency(serial);
+    }
+    if (configure(serial, baud) != 0) {
+        serial->lastError = errno;
+        return 1;
+    }
+    return 0;
+}
+
+static uint8_t serialDeinitialize(void* context) {
+    __FPS_LINUX_SERIAL* serial = (__FPS_LINUX_SERIAL*)context;
+    if (serial->fd >= 0) close(serial->fd);
+    serial->fd = -1;
+    return 0;
+}
+
+const __FPS_PORT fpsLinuxSerialPort = { serialRead, serialWrite, serialInitialize, serialDeinitialize };
+
+/*
+*   @brief: prepare a serial port context. Set lowLatency or exclusive afterwards if wanted
+*   @parameter: context, used as portContext of the stream
+*   @parameter: path of the tty
+*   @return: none
+*
+*/
+void R30X_linuxSerialInit(__FPS_LINUX_SERIAL* serial, const char* path) {
+    memset(serial, 0, sizeof(__FPS_LINUX_SERIAL));
+    serial->path = path;
+    serial->fd = -1;
+}
+
+/********************************END OF FILE*****************************************************/
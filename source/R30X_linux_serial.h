@@ -0,0 +1,50 @@
+/*************************************************************************
+ *
+ * finger print library - Linux serial port
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Port functions for a tty on Linux (USB serial adapters, SoC UARTs).
+ * The tty is set to raw 8N1 with the exact baudrate of every multiplier
+ * setBaudrate supports (9600 .. 115200, through BOTHER where there is no
+ * standard rate), the descriptor is nonblocking and reads wait in poll,
+ * so a reply is returned as soon as its last byte arrives.
+ *
+ * With lowLatency set the driver is asked for ASYNC_LOW_LATENCY, which
+ * makes USB serial adapters pass bytes on at once instead of after their
+ * latency timer (often 16 ms). Drivers that do not support it are used
+ * as they are, see lowLatencyActive.
+ *
+ **************************************************************************/
+#ifndef R30X_LINUX_SERIAL_H
+#define R30X_LINUX_SERIAL_H
+#include "R30X_FPS.h"
+
+#ifndef __linux__
+#error "R30X_linux_serial is only for Linux"
+#endif
+#if !FPS_CFG_PORT_CONTEXT
+#error "R30X_linux_serial needs FPS_CFG_PORT_CONTEXT"
+#endif
+
+typedef struct {
+	  const char* path;  //e.g. "/dev/ttyUSB0"
+	  uint8_t lowLatency;  //1 to request ASYNC_LOW_LATENCY
+	  uint8_t exclusive;  //1 to lock the tty against other opens (TIOCEXCL)
+
+	  int fd;  //-1 while closed
+	  uint32_t baud;
+	  uint8_t lowLatencyActive;  //the driver accepted ASYNC_LOW_LATENCY
+	  int lastError;  //errno of the last failure
+
+	  uint64_t bytesRead;
+	  uint64_t bytesWritten;
+	  uint64_t readTimeouts;  //reads that returned fewer bytes than asked
+}__FPS_LINUX_SERIAL;
+
+extern const __FPS_PORT fpsLinuxSerialPort;
+
+void	R30X_linuxSerialInit (__FPS_LINUX_SERIAL *serial, const char *path); //prepare the context, the port is opened by R30X_init
+#endif
+
+/********************************END OF FILE*****************************************************/
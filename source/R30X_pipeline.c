@@ -0,0 +1,180 @@
+/*************************************************************************
+ *
+ * finger print library - pipelined commands
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_pipeline.h"
+
+//commands answered by more than one packet, or after which the module answers at another baudrate or address
+static uint8_t pipelinable(uint8_t command, const uint8_t* args, uint8_t argLength) {
+    switch (command) {
+    case FPS_CMD_EXPORTTEMPLATE:
+    case FPS_CMD_IMPORTTEMPLATE:
+    case FPS_CMD_EXPORTIMAGE:
+    case FPS_CMD_IMPORTIMAGE:
+    case FPS_CMD_READALL_SYSPARA:
+    case FPS_CMD_SETDEVICEADDRESS:
+        return 0;
+    case FPS_CMD_SETSYSPARA:
+        return !(argLength >= 1 && args[0] == 4);  //4 is the baudrate
+    default:
+        return 1;
+    }
+}
+
+static void sendEntry(__FPS_PIPELINE* pipeline, __FPS_PIPELINE_ENTRY* entry) {
+    sendPacket(pipeline->stream, entry->command, entry->argLength ? entry->args : NULL, entry->argLength);
+    entry->state = FPS_PIPELINE_SENT;
+}
+
+static void receiveEntry(__FPS_PIPELINE* pipeline, __FPS_PIPELINE_ENTRY* entry) {
+    __FPS* stream = pipeline->stream;
+    entry->response = receivePacket(stream, stream->commandTimeout);
+    if (entry->response != FPS_RX_OK) {
+        entry->state = FPS_PIPELINE_UNKNOWN;
+        return;
+    }
+    entry->confirmationCode = stream->rxConfirmationCode;
+    memcpy(entry->data, stream->rxDataBuffer, stream->rxDataBufferLength < sizeof(entry->data) ? stream->rxDataBufferLength : sizeof(entry->data));
+    entry->state = entry->confirmationCode == FPS_RESP_OK ? FPS_PIPELINE_DONE : FPS_PIPELINE_FAILED;
+}
+
+/*
+*   @brief: prepare an empty pipeline
+*   @parameter: pipeline
+*   @parameter: pointer to finger print structure
+*   @parameter: commands on the line at once, 1 to FPS_PIPELINE_MAX_WINDOW
+*   @return: none
+*
+*/
+void R30X_pipelineInit(__FPS_PIPELINE* pipeline, __FPS* stream, uint8_t window) {
+    memset(pipeline, 0, sizeof(__FPS_PIPELINE));
+    pipeline->stream = stream;
+    pipeline->window = window < 1 ? 1 : window > FPS_PIPELINE_MAX_WINDOW ? FPS_PIPELINE_MAX_WINDOW : window;
+    pipeline->firstFailure = FPS_PIPELINE_NONE;
+}
+
+void R30X_pipelineClear(__FPS_PIPELINE* pipeline) {
+    pipeline->count = 0;
+    pipeline->done = 0;
+    pipeline->firstFailure = FPS_PIPELINE_NONE;
+    pipeline->peakInFlight = 0;
+    pipeline->entries[0].barrier = 0;
+}
+/*
+*   @brief: add a command to the end of the pipeline
+*   @parameter: pipeline
+*   @parameter: FPS_CMD_* code
+*   @parameter: arguments like for sendPacket, NULL if none
+*   @parameter: length of the arguments, at most FPS_PIPELINE_MAX_ARGS
+*   @return: index of the entry, -1 if the pipeline is full or the arguments are too long, -2 if the command can not be pipelined
+*
+*/
+int16_t R30X_pipelineQueue(__FPS_PIPELINE* pipeline, uint8_t command, const uint8_t* args, uint8_t argLength) {
+    if (pipeline->count >= FPS_PIPELINE_MAX_COMMANDS || argLength > FPS_PIPELINE_MAX_ARGS) return -1;
+    if (!pipelinable(command, args, argLength)) return -2;
+    __FPS_PIPELINE_ENTRY* entry = &pipeline->entries[pipeline->count];
+    uint8_t barrier = entry->barrier;
+    memset(entry, 0, sizeof(__FPS_PIPELINE_ENTRY));
+    entry->command = command;
+    entry->barrier = barrier;
+    if (argLength) memcpy(entry->args, args, argLength);
+    entry->argLength = argLength;
+    pipeline->count++;
+    if (pipeline->count < FPS_PIPELINE_MAX_COMMANDS) pipeline->entries[pipeline->count].barrier = 0;
+    return (int16_t)(pipeline->count - 1);
+}
+
+void R30X_pipelineBarrier(__FPS_PIPELINE* pipeline) {
+    if (pipeline->count < FPS_PIPELINE_MAX_COMMANDS) pipeline->entries[pipeline->count].barrier = 1;
+}
+/*
+*   @brief: queue saveTemplate, with the checks of saveTemplate
+*   @parameter: pipeline
+*   @parameter: character buffer, 1 or 2
+*   @parameter: library location, 1 to stream->templateCount
+*   @return: index of the entry, negative if it can not be queued or the values are out of range
+*
+*/
+int16_t R30X_pipelineQueueSave(__FPS_PIPELINE* pipeline, uint8_t bufferId, uint16_t location) {
+    uint8_t dataArray[3];
+    if (bufferId < 1 || bufferId > 2 || location < 1 || location > pipeline->stream->templateCount) return -3;
+    dataArray[0] = bufferId;
+    dataArray[1] = (location >> 8) & 0xFFU;
+    dataArray[2] = location & 0xFFU;
+    return R30X_pipelineQueue(pipeline, FPS_CMD_STORETEMPLATE, dataArray, 3);
+}
+/*
+*   @brief: queue deleteTemplate, with the checks of deleteTemplate
+*   @parameter: pipeline
+*   @parameter: first location, 1 to stream->templateCount
+*   @parameter: number of locations
+*   @return: index of the entry, negative if it can not be queued or the values are out of range
+*
+*/
+int16_t R30X_pipelineQueueDelete(__FPS_PIPELINE* pipeline, uint16_t startLocation, uint16_t count) {
+    uint8_t dataArray[4];
+    uint16_t templateCount = pipeline->stream->templateCount;
+    if (startLocation < 1 || startLocation > templateCount || (uint32_t)startLocation + count > templateCount + 1u) return -3;
+    dataArray[0] = (startLocation >> 8) & 0xFFU;
+    dataArray[1] = startLocation & 0xFFU;
+    dataArray[2] = (count >> 8) & 0xFFU;
+    dataArray[3] = count & 0xFFU;
+    return R30X_pipelineQueue(pipeline, FPS_CMD_DELETETEMPLATE, dataArray, 4);
+}
+/*
+*   @brief: send the queued commands, up to window of them ahead of the replies, and match the replies in order.
+*           After the first failure no more commands are sent, the replies of the commands already sent are collected.
+*           A lost reply (timeout, bad packet) also ends the collection, the rest of the sent commands stay unknown
+*   @parameter: pipeline
+*   @return: FPS_RESP_OK or 0 if all commands are done, otherwise the confirmation code (FPS_PIPELINE_FAILED) or the
+*            FPS_RX_* code (FPS_PIPELINE_UNKNOWN) of the entry at firstFailure. The state of every entry is in entries
+*
+*/
+uint8_t R30X_pipelineRun(__FPS_PIPELINE* pipeline) {
+    uint16_t next = 0, head = 0;
+    uint8_t stop = 0, lost = 0;
+    for (uint16_t i = 0; i < pipeline->count; i++) pipeline->entries[i].state = FPS_PIPELINE_QUEUED;
+    pipeline->done = 0;
+    pipeline->firstFailure = FPS_PIPELINE_NONE;
+
+    while (head < pipeline->count) {
+        while (!stop && next < pipeline->count && next - head < pipeline->window) {
+            if (pipeline->entries[next].barrier && head < next) break;  //wait for the earlier replies
+            sendEntry(pipeline, &pipeline->entries[next++]);
+            if (next - head > pipeline->peakInFlight) pipeline->peakInFlight = (uint8_t)(next - head);
+        }
+        if (head == next) break;  //stopped, nothing on the line
+
+        __FPS_PIPELINE_ENTRY* entry = &pipeline->entries[head++];
+        if (lost) {
+            entry->state = FPS_PIPELINE_UNKNOWN;
+            entry->response = pipeline->entries[head - 2].response;
+            continue;
+        }
+        receiveEntry(pipeline, entry);
+        if (entry->state == FPS_PIPELINE_DONE) {
+            pipeline->done++;
+            continue;
+        }
+        stop = 1;
+        //after a checksum error the next reply starts where expected, otherwise the stream is out of step
+        if (entry->state == FPS_PIPELINE_UNKNOWN && entry->response != FPS_RX_WRONG_CHECKSUM) lost = 1;
+    }
+    for (uint16_t i = next; i < pipeline->count; i++) pipeline->entries[i].state = FPS_PIPELINE_SKIPPED;
+
+    for (uint16_t i = 0; i < pipeline->count; i++) {
+        __FPS_PIPELINE_ENTRY* entry = &pipeline->entries[i];
+        if (entry->state == FPS_PIPELINE_DONE) continue;
+        pipeline->firstFailure = i;
+        return entry->state == FPS_PIPELINE_FAILED ? entry->confirmationCode : entry->response;
+    }
+    return FPS_RESP_OK;
+}
+
+/********************************END OF FILE*****************************************************/
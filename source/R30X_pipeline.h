@@ -0,0 +1,76 @@
+/*************************************************************************
+ *
+ * finger print library - pipelined commands
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Every function of the library sends one command and waits for its
+ * reply before the next command can be sent, so a sequence pays the host
+ * turnaround (driver, USB latency timer, scheduling) on every command.
+ * A pipeline queues a sequence of commands and keeps up to window of them
+ * on the line: the next frames are sent while the module still works on
+ * the previous one, and the module starts the next command as soon as it
+ * has replied.
+ *
+ * Replies carry no command code, they are matched to the commands in the
+ * order they were sent. At the first failed command nothing more is
+ * sent; the commands already on the line are still executed by the
+ * module, their replies are collected, and the state of every entry tells
+ * which commands took effect. A barrier makes a command wait until all
+ * commands before it succeeded, for steps that must not run after a
+ * failure (e.g. saveTemplate after generateTemplate).
+ *
+ * Only commands that are answered by a single acknowledge packet can be
+ * queued. The module must buffer frames that arrive while it is busy;
+ * window 1 sends like the library does.
+ *
+ **************************************************************************/
+#ifndef R30X_PIPELINE_H
+#define R30X_PIPELINE_H
+#include "R30X_FPS.h"
+
+#define FPS_PIPELINE_MAX_COMMANDS       64
+#define FPS_PIPELINE_MAX_ARGS           33  //writeNotepad: page and 32 bytes
+#define FPS_PIPELINE_MAX_WINDOW         8
+
+#define FPS_PIPELINE_QUEUED             0   //not sent
+#define FPS_PIPELINE_SENT               1   //on the line, reply not received yet
+#define FPS_PIPELINE_DONE               2   //acknowledged with FPS_RESP_OK, took effect
+#define FPS_PIPELINE_FAILED             3   //acknowledged with an error, see confirmationCode
+#define FPS_PIPELINE_UNKNOWN            4   //sent, but the reply was lost (see response), the command may have taken effect
+#define FPS_PIPELINE_SKIPPED            5   //not sent because an earlier command failed
+
+#define FPS_PIPELINE_NONE               0xFFFF
+
+typedef struct {
+	  uint8_t command;
+	  uint8_t args[FPS_PIPELINE_MAX_ARGS];
+	  uint8_t argLength;
+	  uint8_t barrier;  //1 to send only after all earlier commands are done
+	  uint8_t state;  //FPS_PIPELINE_*
+	  uint8_t response;  //FPS_RX_* code of the reply
+	  uint8_t confirmationCode;
+	  uint8_t data[4];  //first bytes of the reply data, e.g. ID and score of a search
+}__FPS_PIPELINE_ENTRY;
+
+typedef struct {
+	  __FPS* stream;
+	  uint8_t window;  //commands on the line at once, 1 to FPS_PIPELINE_MAX_WINDOW
+
+	  __FPS_PIPELINE_ENTRY entries[FPS_PIPELINE_MAX_COMMANDS];
+	  uint16_t count;
+	  uint16_t done;  //entries acknowledged with FPS_RESP_OK
+	  uint16_t firstFailure;  //index of the first entry not done, FPS_PIPELINE_NONE if all are done
+	  uint8_t peakInFlight;
+}__FPS_PIPELINE;
+
+void	R30X_pipelineInit (__FPS_PIPELINE *pipeline, __FPS *stream, uint8_t window);
+void	R30X_pipelineClear (__FPS_PIPELINE *pipeline); //remove all entries
+int16_t R30X_pipelineQueue (__FPS_PIPELINE *pipeline, uint8_t command, const uint8_t *args, uint8_t argLength); //index of the entry, negative if it can not be queued
+void	R30X_pipelineBarrier (__FPS_PIPELINE *pipeline); //the next queued command waits for all earlier ones
+int16_t R30X_pipelineQueueSave (__FPS_PIPELINE *pipeline, uint8_t bufferId, uint16_t location); //saveTemplate
+int16_t R30X_pipelineQueueDelete (__FPS_PIPELINE *pipeline, uint16_t startLocation, uint16_t count); //deleteTemplate
+uint8_t R30X_pipelineRun (__FPS_PIPELINE *pipeline); //send all entries, FPS_RESP_OK if all are done
+#endif
+
+/********************************END OF FILE*****************************************************/
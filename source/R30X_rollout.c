@@ -0,0 +1,260 @@
+/*************************************************************************
+ *
+ * finger print library - configuration rollout
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_rollout.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct {
+    __FPS_ROLLOUT_UNIT* units;
+    uint32_t unitCount;
+    __FPS_ROLLOUT_PARAMS target;
+    __FPS_ROLLOUT_CONFIG config;
+    uint32_t nextUnit;  //next unit to be taken by a worker
+    uint32_t failures;
+    uint8_t aborted;
+    uint8_t restoring;  //second pass after an abort, restores the units done
+    pthread_mutex_t lock;
+}__FPS_ROLLOUT_JOB;
+
+static uint32_t millis(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+//read the parameters; when the module does not answer, look for it at the other baudrates it may run at
+static uint8_t relink(__FPS* stream, const uint32_t bauds[2]) {
+    uint8_t response = readSysPara(stream);
+    for (uint8_t i = 0; i < 2 && response >= FPS_RX_BADPACKET; i++) {
+        if (bauds[i] == stream->deviceBaudrate) continue;
+        R30X_closePort(stream);
+        stream->deviceBaudrate = bauds[i];
+        stream->baudMultiplier = (uint16_t)(bauds[i] / 9600);
+        response = R30X_openPort(stream, bauds[i]) == FPS_RESP_OK ? readSysPara(stream) : FPS_RESP_COMPORTERR;
+    }
+    return response;
+}
+
+//set the fields that differ from the parameters last read, the baudrate last
+static uint8_t apply(__FPS* stream, const __FPS_ROLLOUT_PARAMS* params, uint8_t* failedField) {
+    uint8_t response = FPS_RESP_OK;
+    if ((params->fields & FPS_ROLLOUT_SECURITY_LEVEL) && stream->securityLevel != params->securityLevel) {
+        *failedField = FPS_ROLLOUT_SECURITY_LEVEL;
+        response = setSecurityLevel(stream, params->securityLevel);
+    }
+    if (response == FPS_RESP_OK && (params->fields & FPS_ROLLOUT_DATA_LENGTH) && stream->dataPacketLength != params->dataPacketLength) {
+        *failedField = FPS_ROLLOUT_DATA_LENGTH;
+        response = setDataLength(stream, params->dataPacketLength);
+    }
+    if (response == FPS_RESP_OK && (params->fields & FPS_ROLLOUT_PASSWORD) && stream->devicePassword != params->password) {
+        *failedField = FPS_ROLLOUT_PASSWORD;
+        response = setPassword(stream, params->password);
+    }
+    if (response == FPS_RESP_OK && (params->fields & FPS_ROLLOUT_BAUDRATE) && stream->deviceBaudrate != params->baudrate) {
+        *failedField = FPS_ROLLOUT_BAUDRATE;
+        response = setBaudrate(stream, params->baudrate);
+    }
+    return response;
+}
+
+static uint8_t verify(__FPS* stream, const __FPS_ROLLOUT_PARAMS* params, const uint32_t bauds[2], uint8_t* failedField) {
+    *failedField = 0;
+    uint8_t response = relink(stream, bauds);
+    if (response != FPS_RESP_OK) return response;
+    if ((params->fields & FPS_ROLLOUT_SECURITY_LEVEL) && stream->securityLevel != params->securityLevel) *failedField = FPS_ROLLOUT_SECURITY_LEVEL;
+    else if ((params->fields & FPS_ROLLOUT_DATA_LENGTH) && stream->dataPacketLength != params->dataPacketLength) *failedField = FPS_ROLLOUT_DATA_LENGTH;
+    else if ((params->fields & FPS_ROLLOUT_BAUDRATE) && stream->deviceBaudrate != params->baudrate) *failedField = FPS_ROLLOUT_BAUDRATE;
+    else if (params->fields & FPS_ROLLOUT_PASSWORD) {
+        *failedField = FPS_ROLLOUT_PASSWORD;
+        response = verifyPassword(stream, params->password);
+        if (response == FPS_RESP_OK) *failedField = 0;
+        return response;
+    }
+    return *failedField ? FPS_ROLLOUT_MISMATCH : FPS_RESP_OK;
+}
+/*
+*   @brief: apply and verify parameters, up to retries more rounds. Failures are recorded in the unit
+*   @parameter: rollout job
+*   @parameter: unit with its parameters read
+*   @parameter: parameters to reach
+*   @parameter: baudrates the module may run at
+*   @return: FPS_RESP_OK when the parameters are verified, otherwise the last failure
+*
+*/
+static uint8_t converge(__FPS_ROLLOUT_JOB* job, __FPS_ROLLOUT_UNIT* unit, const __FPS_ROLLOUT_PARAMS* params, const uint32_t bauds[2]) {
+    uint8_t response = FPS_RESP_OK;
+    for (uint8_t round = 0; round <= job->config.retries; round++) {
+        uint8_t failedField = 0;
+        unit->attempts++;
+        if (round > 0) response = relink(unit->stream, bauds);  //the last round may have left the unit anywhere
+        if (response == FPS_RESP_OK) response = apply(unit->stream, params, &failedField);
+        if (response == FPS_RESP_OK) response = verify(unit->stream, params, bauds, &failedField);
+        if (response == FPS_RESP_OK) return FPS_RESP_OK;
+        unit->error = response;
+        unit->failedField = failedField;
+    }
+    return response;
+}
+
+static void snapshot(__FPS_ROLLOUT_UNIT* unit, uint8_t fields) {
+    unit->before.fields = fields;
+    unit->before.securityLevel = (uint8_t)unit->stream->securityLevel;
+    unit->before.dataPacketLength = unit->stream->dataPacketLength;
+    unit->before.password = unit->stream->devicePassword;
+    unit->before.baudrate = unit->stream->deviceBaudrate;
+}
+
+static void restore(__FPS_ROLLOUT_JOB* job, __FPS_ROLLOUT_UNIT* unit, const uint32_t bauds[2]) {
+    unit->state = converge(job, unit, &unit->before, bauds) == FPS_RESP_OK ? FPS_ROLLOUT_ROLLED_BACK : FPS_ROLLOUT_FAILED;
+}
+
+static void rolloutUnit(__FPS_ROLLOUT_JOB* job, __FPS_ROLLOUT_UNIT* unit) {
+    uint32_t bauds[2];
+    uint8_t response = FPS_RESP_OK;
+    for (uint8_t round = 0; round <= job->config.retries; round++) {
+        response = readSysPara(unit->stream);
+        if (response == FPS_RESP_OK) break;
+    }
+    if (response != FPS_RESP_OK) {
+        unit->state = FPS_ROLLOUT_UNREACHABLE;
+        unit->error = response;
+        return;
+    }
+    snapshot(unit, job->target.fields);
+    bauds[0] = (job->target.fields & FPS_ROLLOUT_BAUDRATE) ? job->target.baudrate : unit->before.baudrate;
+    bauds[1] = unit->before.baudrate;
+    if (converge(job, unit, &job->target, bauds) == FPS_RESP_OK) unit->state = FPS_ROLLOUT_DONE;
+    else restore(job, unit, bauds);
+}
+
+static void* rolloutWorker(void* arg) {
+    __FPS_ROLLOUT_JOB* job = (__FPS_ROLLOUT_JOB*)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        uint32_t index = job->nextUnit++;
+        uint8_t aborted = job->aborted;
+        pthread_mutex_unlock(&job->lock);
+        if (index >= job->unitCount) break;
+
+        __FPS_ROLLOUT_UNIT* unit = &job->units[index];
+        uint32_t start = millis();
+        if (job->restoring) {
+            if (unit->state != FPS_ROLLOUT_DONE) continue;
+            uint32_t bauds[2] = { unit->stream->deviceBaudrate, unit->before.baudrate };
+            restore(job, unit, bauds);
+        }
+        else if (aborted) {
+            unit->state = FPS_ROLLOUT_SKIPPED;
+            continue;
+        }
+        else rolloutUnit(job, unit);
+        unit->time += millis() - start;
+
+        if (!job->restoring && unit->state != FPS_ROLLOUT_DONE) {
+            pthread_mutex_lock(&job->lock);
+            job->failures++;
+            if (job->config.maxFailures != 0 && job->failures >= job->config.maxFailures) job->aborted = 1;
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+    return NULL;
+}
+
+//run the workers over all units, 0 on success
+static int8_t runWorkers(__FPS_ROLLOUT_JOB* job) {
+    pthread_t threads[FPS_ROLLOUT_MAX_THREADS];
+    uint32_t threadCount = job->config.maxInFlight, started = 0;
+    if (threadCount > job->unitCount) threadCount = job->unitCount;
+    if (threadCount > FPS_ROLLOUT_MAX_THREADS) threadCount = FPS_ROLLOUT_MAX_THREADS;
+    job->nextUnit = 0;
+    for (; started < threadCount; started++) {
+        if (pthread_create(&threads[started], NULL, rolloutWorker, job) != 0) break;
+    }
+    if (started == 0 && job->unitCount > 0) return -1;
+    for (uint32_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    return 0;
+}
+
+void R30X_rolloutDefaults(__FPS_ROLLOUT_CONFIG* config) {
+    memset(config, 0, sizeof(__FPS_ROLLOUT_CONFIG));
+    config->maxInFlight = FPS_ROLLOUT_DEFAULT_IN_FLIGHT;
+    config->retries = FPS_ROLLOUT_DEFAULT_RETRIES;
+}
+/*
+*   @brief: bring all units to the target parameters, maxInFlight units at a time. Returns when every unit is done,
+*           rolled back, failed, unreachable or skipped; the state of each unit is in units[i].state
+*   @parameter: units with initialized streams, every stream on a port of its own
+*   @parameter: number of units
+*   @parameter: parameters to set
+*   @parameter: configuration, NULL for defaults
+*   @return: number of units done, negative value if the worker threads could not be started
+*
+*/
+int32_t R30X_rollout(__FPS_ROLLOUT_UNIT* units, uint32_t unitCount, const __FPS_ROLLOUT_PARAMS* target, const __FPS_ROLLOUT_CONFIG* config) {
+    __FPS_ROLLOUT_JOB job;
+    int32_t done = 0;
+    memset(&job, 0, sizeof(job));
+    if (config != NULL) job.config = *config;
+    else R30X_rolloutDefaults(&job.config);
+    if (job.config.maxInFlight == 0) job.config.maxInFlight = FPS_ROLLOUT_DEFAULT_IN_FLIGHT;
+    job.units = units;
+    job.unitCount = unitCount;
+    job.target = *target;
+    for (uint32_t i = 0; i < unitCount; i++) {
+        units[i].state = FPS_ROLLOUT_PENDING;
+        units[i].attempts = 0;
+        units[i].error = FPS_RESP_OK;
+        units[i].failedField = 0;
+        units[i].time = 0;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+
+    int8_t result = runWorkers(&job);
+    if (result == 0 && job.aborted && job.config.rollbackOnAbort) {
+        job.restoring = 1;
+        result = runWorkers(&job);
+    }
+    pthread_mutex_destroy(&job.lock);
+    if (result != 0) return -1;
+    for (uint32_t i = 0; i < unitCount; i++) done += units[i].state == FPS_ROLLOUT_DONE;
+    return done;
+}
+
+const char* R30X_rolloutStateName(uint8_t state) {
+    static const char* const names[] = { "pending", "done", "rolled back", "failed", "unreachable", "skipped" };
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "unknown";
+}
+/*
+*   @brief: write the result of every unit as CSV: state, rounds, last error, the snapshot and the parameters read
+*           last (the password is not written)
+*   @parameter: units after R30X_rollout
+*   @parameter: number of units
+*   @parameter: path of the report
+*   @return: 0 on success, -1 if the file can not be written
+*
+*/
+int8_t R30X_rolloutReport(const __FPS_ROLLOUT_UNIT* units, uint32_t unitCount, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return -1;
+    fprintf(file, "unit,name,state,attempts,error,failed_field,security_before,length_before,baud_before,security,length,baud,time_ms\n");
+    for (uint32_t i = 0; i < unitCount; i++) {
+        const __FPS_ROLLOUT_UNIT* unit = &units[i];
+        fprintf(file, "%u,%s,%s,%u,0x%02X,0x%02X,", i, unit->name != NULL ? unit->name : "", R30X_rolloutStateName(unit->state),
+                unit->attempts, unit->error, unit->failedField);
+        if (unit->state == FPS_ROLLOUT_UNREACHABLE || unit->state == FPS_ROLLOUT_SKIPPED) fprintf(file, ",,,");
+        else fprintf(file, "%u,%u,%u,", unit->before.securityLevel, unit->before.dataPacketLength, unit->before.baudrate);
+        fprintf(file, "%u,%u,%u,%u\n", unit->stream->securityLevel, unit->stream->dataPacketLength, unit->stream->deviceBaudrate, unit->time);
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,85 @@
+/*************************************************************************
+ *
+ * finger print library - configuration rollout
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Sets security level, data packet length, password and baudrate on many
+ * modules at once, with at most maxInFlight modules being changed at the
+ * same time. Every unit is handled like this:
+ *
+ *  - snapshot: readSysPara, the unit is unreachable if it does not answer
+ *  - apply the fields that differ from the target, the baudrate last
+ *  - verify: readSysPara again and compare, verifyPassword for the password
+ *  - on failure apply and verify again, up to retries more rounds
+ *  - still failing: restore the snapshot the same way (rolled back)
+ *
+ * When a unit does not answer after a baudrate change it is looked for at
+ * the target and at the old baudrate. After maxFailures units that are not
+ * done no new unit is started, and with rollbackOnAbort the units already
+ * done are restored too, so the fleet keeps one setting.
+ *
+ * Every unit needs a port of its own. Needs POSIX threads.
+ *
+ **************************************************************************/
+#ifndef R30X_ROLLOUT_H
+#define R30X_ROLLOUT_H
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_ADMIN_SETTERS
+#error "R30X_rollout needs FPS_CFG_ADMIN_SETTERS"
+#endif
+
+#define FPS_ROLLOUT_DEFAULT_IN_FLIGHT   16
+#define FPS_ROLLOUT_DEFAULT_RETRIES     2
+#define FPS_ROLLOUT_MAX_THREADS         64
+#define FPS_ROLLOUT_MISMATCH            0xFD  //the module acknowledged a change but reads back another value
+
+//fields of __FPS_ROLLOUT_PARAMS
+#define FPS_ROLLOUT_SECURITY_LEVEL      0x01
+#define FPS_ROLLOUT_DATA_LENGTH         0x02
+#define FPS_ROLLOUT_PASSWORD            0x04
+#define FPS_ROLLOUT_BAUDRATE            0x08
+
+//state of a unit
+#define FPS_ROLLOUT_PENDING             0
+#define FPS_ROLLOUT_DONE                1  //target applied and verified
+#define FPS_ROLLOUT_ROLLED_BACK         2  //target not verified, the snapshot is restored
+#define FPS_ROLLOUT_FAILED              3  //neither the target nor the snapshot verified, check the unit by hand
+#define FPS_ROLLOUT_UNREACHABLE         4  //no snapshot, nothing was changed
+#define FPS_ROLLOUT_SKIPPED             5  //not started, the rollout was aborted
+
+typedef struct {
+	  uint8_t fields;  //FPS_ROLLOUT_* to set
+	  uint8_t securityLevel;  //1 to 5
+	  uint16_t dataPacketLength;  //32, 64, 128 or 256
+	  uint32_t password;
+	  uint32_t baudrate;  //9600 * (1 .. 12)
+}__FPS_ROLLOUT_PARAMS;
+
+typedef struct {
+	  __FPS* stream;  //initialized stream of the unit
+	  const char* name;  //label of the unit, only used in reports (can be NULL)
+	  uint8_t state;  //FPS_ROLLOUT_PENDING until the unit was handled
+	  uint8_t attempts;  //apply and verify rounds, rollback included
+	  uint8_t error;  //last failure: confirmation code, FPS_RX_* code, FPS_RESP_COMPORTERR or FPS_ROLLOUT_MISMATCH
+	  uint8_t failedField;  //field of the last failure, 0 if the parameters could not be read
+	  __FPS_ROLLOUT_PARAMS before;  //snapshot of the fields of the target
+	  uint32_t time;  //milliseconds spent on the unit
+}__FPS_ROLLOUT_UNIT;
+
+typedef struct {
+	  uint16_t maxInFlight;  //units changed at the same time, 0 means FPS_ROLLOUT_DEFAULT_IN_FLIGHT
+	  uint8_t retries;  //extra rounds before a unit is rolled back
+	  uint32_t maxFailures;  //abort after this many units that are not done, 0 never aborts
+	  uint8_t rollbackOnAbort;  //restore the units already done when the rollout aborts
+}__FPS_ROLLOUT_CONFIG;
+
+void	R30X_rolloutDefaults (__FPS_ROLLOUT_CONFIG *config); //fill config with default values
+int32_t R30X_rollout (__FPS_ROLLOUT_UNIT *units, uint32_t unitCount, const __FPS_ROLLOUT_PARAMS *target,
+					  const __FPS_ROLLOUT_CONFIG *config); //returns number of units done or negative value on error
+int8_t	R30X_rolloutReport (const __FPS_ROLLOUT_UNIT *units, uint32_t unitCount, const char *path); //one CSV line per unit, 0 on success
+const char* R30X_rolloutStateName (uint8_t state);
+#endif
+
+/********************************END OF FILE*****************************************************/
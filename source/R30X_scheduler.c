@@ -0,0 +1,204 @@
+/*************************************************************************
+ *
+ * finger print library - shared sensor access with priorities
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_scheduler.h"
+#include <time.h>
+
+static uint64_t monotonicUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+//1 if a thread with a higher priority than the given one is waiting, call with the lock held
+static uint8_t higherWaiting(const __FPS_SCHED* sched, uint8_t priority) {
+    for (uint8_t p = 0; p < priority; p++) {
+        if (sched->stats[p].queueDepth > 0) return 1;
+    }
+    return 0;
+}
+
+static void acquireLocked(__FPS_SCHED* sched, uint8_t priority) {
+    __FPS_SCHED_STATS* stats = &sched->stats[priority];
+    uint32_t ticket = sched->nextTicket[priority]++;
+    uint64_t start = monotonicUs();
+
+    stats->queueDepth++;
+    if (stats->queueDepth > stats->maxQueueDepth) stats->maxQueueDepth = stats->queueDepth;
+    while (sched->busy || sched->serving[priority] != ticket || higherWaiting(sched, priority)) {
+        pthread_cond_wait(&sched->released, &sched->lock);
+    }
+    stats->queueDepth--;
+    sched->serving[priority]++;
+    sched->busy = 1;
+    sched->ownerPriority = priority;
+
+    uint64_t wait = monotonicUs() - start;
+    stats->acquisitions++;
+    stats->totalWait += wait;
+    if (wait > stats->maxWait) stats->maxWait = wait > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)wait;
+}
+
+static void releaseLocked(__FPS_SCHED* sched) {
+    sched->busy = 0;
+    pthread_cond_broadcast(&sched->released);
+}
+/*
+*   @brief: prepare a scheduler for a stream. The stream must only be used through the scheduler afterwards
+*   @parameter: scheduler
+*   @parameter: pointer to finger print structure
+*   @return: 0 on success, -1 if the mutex or condition can not be created
+*
+*/
+int8_t R30X_schedInit(__FPS_SCHED* sched, __FPS* stream) {
+    memset(sched, 0, sizeof(__FPS_SCHED));
+    sched->stream = stream;
+    if (pthread_mutex_init(&sched->lock, NULL) != 0) return -1;
+    if (pthread_cond_init(&sched->released, NULL) != 0) {
+        pthread_mutex_destroy(&sched->lock);
+        return -1;
+    }
+    return 0;
+}
+
+void R30X_schedDestroy(__FPS_SCHED* sched) {
+    pthread_cond_destroy(&sched->released);
+    pthread_mutex_destroy(&sched->lock);
+}
+/*
+*   @brief: wait until the sensor is free for this priority
+*   @parameter: scheduler
+*   @parameter: FPS_PRIORITY_IDENTIFY (highest) .. FPS_PRIORITY_BACKGROUND (lowest)
+*   @return: the stream, use it only until R30X_schedRelease
+*
+*/
+__FPS* R30X_schedAcquire(__FPS_SCHED* sched, uint8_t priority) {
+    if (priority >= FPS_SCHED_PRIORITIES) priority = FPS_SCHED_PRIORITIES - 1;
+    pthread_mutex_lock(&sched->lock);
+    acquireLocked(sched, priority);
+    pthread_mutex_unlock(&sched->lock);
+    return sched->stream;
+}
+
+void R30X_schedRelease(__FPS_SCHED* sched) {
+    pthread_mutex_lock(&sched->lock);
+    releaseLocked(sched);
+    pthread_mutex_unlock(&sched->lock);
+}
+/*
+*   @brief: command boundary of a long job. If a higher priority is waiting the sensor is handed over
+*           and the call returns when it is this job's turn again
+*   @parameter: scheduler, must be held by the caller
+*   @return: 1 if the sensor was handed over, 0 if nothing was waiting
+*
+*/
+uint8_t R30X_schedYield(__FPS_SCHED* sched) {
+    uint8_t yielded = 0;
+    pthread_mutex_lock(&sched->lock);
+    uint8_t priority = sched->ownerPriority;
+    if (higherWaiting(sched, priority)) {
+        sched->stats[priority].yields++;
+        releaseLocked(sched);
+        acquireLocked(sched, priority);
+        yielded = 1;
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return yielded;
+}
+/*
+*   @brief: run a sequence of commands without other threads in between
+*   @parameter: scheduler
+*   @parameter: priority
+*   @parameter: function that runs the commands on the stream
+*   @parameter: argument for the function
+*   @return: the return value of the sequence
+*
+*/
+uint8_t R30X_schedRun(__FPS_SCHED* sched, uint8_t priority, uint8_t (*sequence)(__FPS* stream, void* arg), void* arg) {
+    __FPS* stream = R30X_schedAcquire(sched, priority);
+    uint8_t response = sequence(stream, arg);
+    R30X_schedRelease(sched);
+    return response;
+}
+
+static void saveResult(const __FPS* stream, uint8_t response, __FPS_SCHED_RESULT* result) {
+    result->response = response;
+    result->confirmationCode = stream->rxConfirmationCode;
+    result->fingerId = stream->fingerId;
+    result->matchScore = stream->matchScore;
+}
+/*
+*   @brief: generate the character file of the scanned image and search the library with it, as one atomic step.
+*           The results are copied before the sensor is released
+*   @parameter: scheduler
+*   @parameter: priority
+*   @parameter: character buffer 1 or 2
+*   @parameter: first location to search
+*   @parameter: number of locations to search
+*   @parameter: receives response, confirmation code, fingerId and matchScore
+*   @return: none
+*
+*/
+void R30X_schedSearch(__FPS_SCHED* sched, uint8_t priority, uint8_t bufferId, uint16_t startLocation, uint16_t count, __FPS_SCHED_RESULT* result) {
+    __FPS* stream = R30X_schedAcquire(sched, priority);
+    uint8_t response = generateCharacter(stream, bufferId);
+    if (response == FPS_RX_OK && stream->rxConfirmationCode == FPS_RESP_OK) {
+        response = searchLibrary(stream, bufferId, startLocation, count);
+    }
+    saveResult(stream, response, result);
+    R30X_schedRelease(sched);
+}
+
+#if FPS_CFG_TEMPLATE_TRANSFER
+/*
+*   @brief: import a template into a character buffer and store it in the library, as one atomic step
+*   @parameter: scheduler
+*   @parameter: priority
+*   @parameter: character buffer 1 or 2
+*   @parameter: template data
+*   @parameter: page ID in the library
+*   @parameter: receives response and confirmation code
+*   @return: none
+*
+*/
+void R30X_schedStore(__FPS_SCHED* sched, uint8_t priority, uint8_t bufferId, uint8_t* templateData, uint16_t location, __FPS_SCHED_RESULT* result) {
+    __FPS* stream = R30X_schedAcquire(sched, priority);
+    uint8_t response = importCharacter(stream, bufferId, templateData);
+    if (response == FPS_RX_OK && stream->rxConfirmationCode == FPS_RESP_OK) {
+        response = saveTemplate(stream, bufferId, location);
+    }
+    saveResult(stream, response, result);
+    R30X_schedRelease(sched);
+}
+#endif
+
+void R30X_schedGetStats(__FPS_SCHED* sched, __FPS_SCHED_STATS stats[FPS_SCHED_PRIORITIES]) {
+    pthread_mutex_lock(&sched->lock);
+    memcpy(stats, sched->stats, sizeof(sched->stats));
+    pthread_mutex_unlock(&sched->lock);
+}
+/*
+*   @brief: clear the counters, the current queue depths are kept
+*   @parameter: scheduler
+*   @return: none
+*
+*/
+void R30X_schedResetStats(__FPS_SCHED* sched) {
+    pthread_mutex_lock(&sched->lock);
+    for (uint8_t p = 0; p < FPS_SCHED_PRIORITIES; p++) {
+        uint32_t depth = sched->stats[p].queueDepth;
+        memset(&sched->stats[p], 0, sizeof(__FPS_SCHED_STATS));
+        sched->stats[p].queueDepth = depth;
+        sched->stats[p].maxQueueDepth = depth;
+    }
+    pthread_mutex_unlock(&sched->lock);
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,67 @@
+/*************************************************************************
+ *
+ * finger print library - shared sensor access with priorities
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Several threads can use one module through a scheduler. A thread acquires
+ * the sensor with a priority, runs one command or an atomic sequence of
+ * commands and releases it. The sensor is always handed to the highest
+ * priority that is waiting, first come first served inside a priority. Long
+ * background jobs call R30X_schedYield between commands so identification
+ * does not wait for the whole job. Needs POSIX threads.
+ *
+ **************************************************************************/
+#ifndef R30X_SCHEDULER_H
+#define R30X_SCHEDULER_H
+#include <pthread.h>
+#include "R30X_FPS.h"
+
+#define FPS_SCHED_PRIORITIES            4
+#define FPS_PRIORITY_IDENTIFY           0   //highest, people waiting at the door
+#define FPS_PRIORITY_ENROLL             1
+#define FPS_PRIORITY_HEALTH             2
+#define FPS_PRIORITY_BACKGROUND         3   //lowest, template sync and provisioning
+
+typedef struct {
+	  uint32_t queueDepth;  //threads waiting right now
+	  uint32_t maxQueueDepth;
+	  uint64_t acquisitions;
+	  uint64_t totalWait;  //sum of waiting times in microseconds
+	  uint32_t maxWait;  //longest wait in microseconds
+	  uint64_t yields;  //times a job of this priority gave the sensor to a higher priority
+}__FPS_SCHED_STATS;
+
+typedef struct {
+	  uint8_t response;  //return code of the last command of the sequence, confirmation code or FPS_RX_* code
+	  uint8_t confirmationCode;  //confirmation code of the last command
+	  uint16_t fingerId;
+	  uint16_t matchScore;
+}__FPS_SCHED_RESULT;
+
+typedef struct {
+	  __FPS* stream;
+	  pthread_mutex_t lock;
+	  pthread_cond_t released;
+	  uint8_t busy;
+	  uint8_t ownerPriority;
+	  uint32_t nextTicket[FPS_SCHED_PRIORITIES];  //first come first served inside a priority
+	  uint32_t serving[FPS_SCHED_PRIORITIES];
+	  __FPS_SCHED_STATS stats[FPS_SCHED_PRIORITIES];
+}__FPS_SCHED;
+
+int8_t	R30X_schedInit (__FPS_SCHED *sched, __FPS *stream); //0 on success
+void	R30X_schedDestroy (__FPS_SCHED *sched);
+__FPS*	R30X_schedAcquire (__FPS_SCHED *sched, uint8_t priority); //wait for the sensor, returns the stream to use until release
+void	R30X_schedRelease (__FPS_SCHED *sched);
+uint8_t R30X_schedYield (__FPS_SCHED *sched); //between commands of a long job, returns 1 if higher priority work ran
+uint8_t R30X_schedRun (__FPS_SCHED *sched, uint8_t priority, uint8_t (*sequence)(__FPS *stream, void *arg), void *arg); //run a sequence atomically
+void	R30X_schedSearch (__FPS_SCHED *sched, uint8_t priority, uint8_t bufferId, uint16_t startLocation, uint16_t count, __FPS_SCHED_RESULT *result); //generateCharacter and searchLibrary
+#if FPS_CFG_TEMPLATE_TRANSFER
+void	R30X_schedStore (__FPS_SCHED *sched, uint8_t priority, uint8_t bufferId, uint8_t *templateData, uint16_t location, __FPS_SCHED_RESULT *result); //importCharacter and saveTemplate
+#endif
+void	R30X_schedGetStats (__FPS_SCHED *sched, __FPS_SCHED_STATS stats[FPS_SCHED_PRIORITIES]);
+void	R30X_schedResetStats (__FPS_SCHED *sched);
+#endif
+
+/********************************END OF FILE*****************************************************/
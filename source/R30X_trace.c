@@ -0,0 +1,334 @@
+/*************************************************************************
+ *
+ * finger print library - UART trace recording and replay
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_trace.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const uint8_t traceMagic[8] = { 'R', '3', '0', 'X', 'T', 'R', 'C', 0 };
+
+static uint64_t monotonicUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void sleepUs(uint64_t us) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000ULL);
+    ts.tv_nsec = (long)(us % 1000000ULL) * 1000L;
+    nanosleep(&ts, NULL);
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+//---------------------------------------------------------------------------
+//recording
+
+static void traceRecord(__FPS_TRACE_TAP* tap, uint8_t type, const uint8_t* data, uint16_t length) {
+    uint8_t header[FPS_TRACE_RECORD_SIZE];
+    uint64_t now = monotonicUs();
+    uint64_t delta = now - tap->lastTime;
+    if (delta > 0xFFFFFFFFULL) delta = 0xFFFFFFFFULL;  //gaps over 71 minutes are clamped
+    tap->lastTime = now;
+    header[0] = delta & 0xff;
+    header[1] = (delta >> 8) & 0xff;
+    header[2] = (delta >> 16) & 0xff;
+    header[3] = (delta >> 24) & 0xff;
+    header[4] = length & 0xff;
+    header[5] = (length >> 8) & 0xff;
+    header[6] = type;
+    header[7] = 0;
+    fwrite(header, 1, sizeof(header), tap->file);
+    if (length) fwrite(data, 1, length, tap->file);
+    tap->records++;
+    if (type == FPS_TRACE_TX || type == FPS_TRACE_RX) tap->bytes[type] += length;
+}
+
+static uint32_t tapRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    __FPS_TRACE_TAP* tap = (__FPS_TRACE_TAP*)context;
+    uint32_t count;
+    if (tap->port != NULL) count = tap->port->read(tap->portContext, pBuf, BytesToRead, timeout);
+    else count = tap->read(pBuf, BytesToRead, timeout);
+    if (count > 0) traceRecord(tap, FPS_TRACE_RX, pBuf, (uint16_t)count);
+    return count;
+}
+
+static uint32_t tapWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    __FPS_TRACE_TAP* tap = (__FPS_TRACE_TAP*)context;
+    traceRecord(tap, FPS_TRACE_TX, pBuf, BytesToWrite);
+    if (tap->port != NULL) return tap->port->write(tap->portContext, pBuf, BytesToWrite, timeout);
+    return tap->write(pBuf, BytesToWrite, timeout);
+}
+
+static uint8_t tapInitialize(void* context, uint32_t baud) {
+    __FPS_TRACE_TAP* tap = (__FPS_TRACE_TAP*)context;
+    uint8_t data[4] = { baud & 0xff, (baud >> 8) & 0xff, (baud >> 16) & 0xff, (baud >> 24) & 0xff };
+    traceRecord(tap, FPS_TRACE_OPEN, data, 4);
+    if (tap->port != NULL) return tap->port->initializePort(tap->portContext, baud);
+    return tap->initializePort(baud);
+}
+
+static uint8_t tapDeinitialize(void* context) {
+    __FPS_TRACE_TAP* tap = (__FPS_TRACE_TAP*)context;
+    traceRecord(tap, FPS_TRACE_CLOSE, NULL, 0);
+    if (tap->port != NULL) return tap->port->deinitializePort(tap->portContext);
+    return tap->deinitializePort();
+}
+
+const __FPS_PORT fpsTraceTapPort = { tapRead, tapWrite, tapInitialize, tapDeinitialize };
+
+/*
+*   @brief: start recording all traffic of a stream. The tap takes over the port of the stream
+*           and forwards every call to it
+*   @parameter: pointer to finger print structure
+*   @parameter: tap structure, must stay valid until R30X_traceStop
+*   @parameter: path of the trace file, an existing file is overwritten
+*   @return: 0 on success, -1 if the file can not be created
+*
+*/
+int8_t R30X_traceStart(__FPS* stream, __FPS_TRACE_TAP* tap, const char* path) {
+    uint8_t header[FPS_TRACE_HEADER_SIZE] = { 0 };
+    memset(tap, 0, sizeof(__FPS_TRACE_TAP));
+    tap->file = fopen(path, "wb");
+    if (tap->file == NULL) return -1;
+    memcpy(header, traceMagic, sizeof(traceMagic));
+    header[8] = FPS_TRACE_VERSION;
+    fwrite(header, 1, sizeof(header), tap->file);
+    tap->lastTime = monotonicUs();
+
+    tap->port = stream->port;
+    tap->portContext = stream->portContext;
+    tap->read = stream->read;
+    tap->write = stream->write;
+    tap->initializePort = stream->initializePort;
+    tap->deinitializePort = stream->deinitializePort;
+    stream->port = &fpsTraceTapPort;
+    stream->portContext = tap;
+    return 0;
+}
+/*
+*   @brief: give the stream its port back and close the trace file
+*   @parameter: pointer to finger print structure
+*   @parameter: tap given to R30X_traceStart
+*   @return: 0 on success, -1 if the file could not be written completely
+*
+*/
+int8_t R30X_traceStop(__FPS* stream, __FPS_TRACE_TAP* tap) {
+    int8_t result = 0;
+    if (stream->port == &fpsTraceTapPort && stream->portContext == tap) {
+        stream->port = tap->port;
+        stream->portContext = tap->portContext;
+    }
+    if (tap->file != NULL) {
+        if (ferror(tap->file) || fclose(tap->file) != 0) result = -1;
+        tap->file = NULL;
+    }
+    return result;
+}
+
+//---------------------------------------------------------------------------
+//replay
+
+static uint8_t cursorValid(const __FPS_TRACE_REPLAY* replay, const __FPS_TRACE_CURSOR* cursor) {
+    if (cursor->offset + FPS_TRACE_RECORD_SIZE > replay->size) return 0;
+    return cursor->offset + FPS_TRACE_RECORD_SIZE + get16(replay->data + cursor->offset + 4) <= replay->size;
+}
+
+static uint8_t cursorType(const __FPS_TRACE_REPLAY* replay, const __FPS_TRACE_CURSOR* cursor) {
+    return replay->data[cursor->offset + 6];
+}
+
+static uint16_t cursorLength(const __FPS_TRACE_REPLAY* replay, const __FPS_TRACE_CURSOR* cursor) {
+    return get16(replay->data + cursor->offset + 4);
+}
+
+static const uint8_t* cursorData(const __FPS_TRACE_REPLAY* replay, const __FPS_TRACE_CURSOR* cursor) {
+    return replay->data + cursor->offset + FPS_TRACE_RECORD_SIZE;
+}
+
+static void cursorStart(const __FPS_TRACE_REPLAY* replay, __FPS_TRACE_CURSOR* cursor) {
+    cursor->offset = FPS_TRACE_HEADER_SIZE;
+    cursor->consumed = 0;
+    cursor->time = cursorValid(replay, cursor) ? get32(replay->data + cursor->offset) : 0;
+}
+
+static void cursorNext(const __FPS_TRACE_REPLAY* replay, __FPS_TRACE_CURSOR* cursor) {
+    cursor->offset += FPS_TRACE_RECORD_SIZE + cursorLength(replay, cursor);
+    cursor->consumed = 0;
+    if (cursorValid(replay, cursor)) cursor->time += get32(replay->data + cursor->offset);
+}
+
+//move the cursor forward to the next record of the given type that still has bytes to serve
+static uint8_t cursorSeek(const __FPS_TRACE_REPLAY* replay, __FPS_TRACE_CURSOR* cursor, uint8_t type) {
+    while (cursorValid(replay, cursor)) {
+        if (cursorType(replay, cursor) == type && cursor->consumed < cursorLength(replay, cursor)) return 1;
+        cursorNext(replay, cursor);
+    }
+    return 0;
+}
+
+//a write that starts a new command frame, the responses to it follow in the trace
+static void syncToCommand(__FPS_TRACE_REPLAY* replay) {
+    replay->timeOffset = (int64_t)monotonicUs() - (int64_t)replay->tx.time;
+    if (replay->rx.offset < replay->tx.offset) {
+        replay->rx = replay->tx;
+        replay->rx.consumed = 0;
+    }
+}
+
+static uint8_t isCommandFrame(const uint8_t* data, uint16_t length) {
+    return length >= 10 && data[0] == FPS_ID_STARTCODE_H && data[1] == FPS_ID_STARTCODE_L && data[6] == FPS_ID_COMMANDPACKET;
+}
+
+static uint32_t replayRead(void* context, uint8_t* pBuf, uint16_t BytesToRead, uint16_t timeout) {
+    __FPS_TRACE_REPLAY* replay = (__FPS_TRACE_REPLAY*)context;
+    uint32_t count = 0;
+    while (count < BytesToRead && cursorSeek(replay, &replay->rx, FPS_TRACE_RX)) {
+        uint16_t available = cursorLength(replay, &replay->rx) - replay->rx.consumed;
+        uint16_t take = BytesToRead - count < available ? (uint16_t)(BytesToRead - count) : available;
+        if (replay->realTime) {
+            int64_t due = (int64_t)replay->rx.time + replay->timeOffset;
+            int64_t now = (int64_t)monotonicUs();
+            if (due > now) {
+                //not received yet at this point of the recording
+                if (count > 0) break;
+                if (due - now > (int64_t)timeout * 1000) {
+                    sleepUs((uint64_t)timeout * 1000);
+                    break;
+                }
+                sleepUs((uint64_t)(due - now));
+            }
+        }
+        memcpy(pBuf + count, cursorData(replay, &replay->rx) + replay->rx.consumed, take);
+        replay->rx.consumed += take;
+        count += take;
+    }
+    replay->rxBytes += count;
+    return count;
+}
+
+static uint32_t replayWrite(void* context, uint8_t* pBuf, uint16_t BytesToWrite, uint16_t timeout) {
+    __FPS_TRACE_REPLAY* replay = (__FPS_TRACE_REPLAY*)context;
+    (void)timeout;
+    replay->txBytes += BytesToWrite;
+    if (!cursorSeek(replay, &replay->tx, FPS_TRACE_TX)) {
+        replay->txMismatch += BytesToWrite;
+        return BytesToWrite;
+    }
+    const uint8_t* recorded = cursorData(replay, &replay->tx);
+    uint16_t length = cursorLength(replay, &replay->tx);
+    if (isCommandFrame(pBuf, BytesToWrite)) syncToCommand(replay);
+    for (uint16_t i = 0; i < BytesToWrite; i++) {
+        if (i >= length || recorded[i] != pBuf[i]) replay->txMismatch++;
+    }
+    cursorNext(replay, &replay->tx);
+    return BytesToWrite;
+}
+
+static uint8_t replayInitialize(void* context, uint32_t baud) {
+    (void)context;
+    (void)baud;
+    return 0;
+}
+
+static uint8_t replayDeinitialize(void* context) {
+    (void)context;
+    return 0;
+}
+
+const __FPS_PORT fpsTraceReplayPort = { replayRead, replayWrite, replayInitialize, replayDeinitialize };
+
+/*
+*   @brief: map a trace file for replay. Use fpsTraceReplayPort as stream->port and the replay as portContext
+*   @parameter: replay structure
+*   @parameter: path of the trace file
+*   @parameter: 1 to deliver bytes at the recorded time after each command, 0 as fast as possible
+*   @return: 0 on success, -1 if the file can not be opened, -2 if it is not a trace file
+*
+*/
+int8_t R30X_replayOpen(__FPS_TRACE_REPLAY* replay, const char* path, uint8_t realTime) {
+    struct stat st;
+    int fd;
+    memset(replay, 0, sizeof(__FPS_TRACE_REPLAY));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < FPS_TRACE_HEADER_SIZE) {
+        close(fd);
+        return -2;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    replay->data = (const uint8_t*)map;
+    replay->size = (size_t)st.st_size;
+    if (memcmp(replay->data, traceMagic, sizeof(traceMagic)) != 0 || get16(replay->data + 8) != FPS_TRACE_VERSION) {
+        R30X_replayClose(replay);
+        return -2;
+    }
+    replay->realTime = realTime;
+    R30X_replayRewind(replay);
+    return 0;
+}
+
+void R30X_replayClose(__FPS_TRACE_REPLAY* replay) {
+    if (replay->data != NULL) munmap((void*)replay->data, replay->size);
+    replay->data = NULL;
+    replay->size = 0;
+}
+
+void R30X_replayRewind(__FPS_TRACE_REPLAY* replay) {
+    cursorStart(replay, &replay->rx);
+    cursorStart(replay, &replay->tx);
+    replay->timeOffset = (int64_t)monotonicUs();
+    replay->rxBytes = 0;
+    replay->txBytes = 0;
+    replay->txMismatch = 0;
+}
+/*
+*   @brief: move to the next command frame the host sent, for driving the parser without the command functions.
+*           The module bytes are served from the response of this command on
+*   @parameter: replay structure
+*   @parameter: receives the command code
+*   @parameter: receives the address the command was sent to
+*   @return: 1 if a command was found, 0 at the end of the trace
+*
+*/
+uint8_t R30X_replayNextCommand(__FPS_TRACE_REPLAY* replay, uint8_t* command, uint32_t* address) {
+    while (cursorSeek(replay, &replay->tx, FPS_TRACE_TX)) {
+        const uint8_t* data = cursorData(replay, &replay->tx);
+        uint16_t length = cursorLength(replay, &replay->tx);
+        if (isCommandFrame(data, length)) {
+            *command = data[9];
+            *address = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 8) | data[5];
+            syncToCommand(replay);
+            cursorNext(replay, &replay->tx);
+            return 1;
+        }
+        cursorNext(replay, &replay->tx);
+    }
+    return 0;
+}
+
+uint8_t R30X_replayRxPending(const __FPS_TRACE_REPLAY* replay) {
+    __FPS_TRACE_CURSOR cursor = replay->rx;
+    return cursorSeek(replay, &cursor, FPS_TRACE_RX);
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,82 @@
+/*************************************************************************
+ *
+ * finger print library - UART trace recording and replay
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * The trace tap sits between the library and the real port and writes every
+ * byte with its direction and a monotonic timestamp to a binary file. The
+ * replay port serves a recorded file back to receivePacket and
+ * receiveDataPacket, either at the original speed or as fast as possible.
+ *
+ * File layout (little endian):
+ *   header  : "R30XTRC" 0x00, uint16 version, uint16 reserved, uint32 reserved
+ *   records : uint32 microseconds since previous record, uint16 length,
+ *             uint8 type (FPS_TRACE_*), uint8 reserved, length bytes of data
+ *
+ **************************************************************************/
+#ifndef R30X_TRACE_H
+#define R30X_TRACE_H
+#include <stdio.h>
+#include <stddef.h>
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_PORT_CONTEXT
+#error "R30X_trace needs FPS_CFG_PORT_CONTEXT"
+#endif
+
+#define FPS_TRACE_VERSION           1
+#define FPS_TRACE_HEADER_SIZE       16
+#define FPS_TRACE_RECORD_SIZE       8   //size of a record header
+
+#define FPS_TRACE_TX                0   //bytes written to the module
+#define FPS_TRACE_RX                1   //bytes read from the module
+#define FPS_TRACE_OPEN              2   //port initialized, data is the uint32 baudrate
+#define FPS_TRACE_CLOSE             3   //port deinitialized
+
+typedef struct {
+	  //port that is being traced
+	  const __FPS_PORT* port;
+	  void* portContext;
+	  uint32_t(*read)(uint8_t* pBuf, uint16_t BytesToRead, uint16_t timout);
+	  uint32_t(*write)(uint8_t* pBuff, uint16_t BytesToWrite, uint16_t timout);
+	  uint8_t (*initializePort) (uint32_t baud);
+	  uint8_t(*deinitializePort) (void);
+
+	  FILE* file;
+	  uint64_t lastTime;  //monotonic time of the last record in microseconds
+	  uint32_t records;
+	  uint64_t bytes[2];  //traced bytes for FPS_TRACE_TX and FPS_TRACE_RX
+}__FPS_TRACE_TAP;
+
+typedef struct {
+	  size_t offset;  //offset of the record header in the file
+	  uint64_t time;  //time of the record in microseconds since the start of the trace
+	  uint16_t consumed;  //bytes of the record already served
+}__FPS_TRACE_CURSOR;
+
+typedef struct {
+	  const uint8_t* data;  //mapped trace file
+	  size_t size;
+	  uint8_t realTime;  //1 to serve bytes at the recorded time, 0 as fast as possible
+	  int64_t timeOffset;  //monotonic time minus trace time, updated on every write
+	  __FPS_TRACE_CURSOR rx;
+	  __FPS_TRACE_CURSOR tx;
+	  uint64_t rxBytes;
+	  uint64_t txBytes;
+	  uint32_t txMismatch;  //written bytes that differ from the recording
+}__FPS_TRACE_REPLAY;
+
+extern const __FPS_PORT fpsTraceTapPort;
+extern const __FPS_PORT fpsTraceReplayPort;
+
+int8_t	R30X_traceStart (__FPS *stream, __FPS_TRACE_TAP *tap, const char *path); //insert a tap between stream and its port, 0 on success
+int8_t	R30X_traceStop (__FPS *stream, __FPS_TRACE_TAP *tap); //remove the tap and close the file
+int8_t	R30X_replayOpen (__FPS_TRACE_REPLAY *replay, const char *path, uint8_t realTime); //map a trace file, 0 on success
+void	R30X_replayClose (__FPS_TRACE_REPLAY *replay);
+void	R30X_replayRewind (__FPS_TRACE_REPLAY *replay);
+uint8_t R30X_replayNextCommand (__FPS_TRACE_REPLAY *replay, uint8_t *command, uint32_t *address); //find the next command frame written by the host, 0 at end of trace
+uint8_t R30X_replayRxPending (const __FPS_TRACE_REPLAY *replay); //1 while recorded bytes from the module are left
+#endif
+
+/********************************END OF FILE*****************************************************/
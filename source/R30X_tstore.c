@@ -0,0 +1,442 @@
+/*************************************************************************
+ *
+ * finger print library - template store
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_tstore.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RECORD_HEADER       4   //uint16 length, uint8 type, uint8 reserved
+#define TEMPLATE_PAYLOAD    (8 + FPS_TEMPLATE_SIZE)
+#define REF_PAYLOAD         12
+#define STAMP_PAYLOAD       8
+#define FIRST_ENTRIES       1024
+
+static const char storeMagic[8] = "R30XTST";
+
+uint64_t R30X_tstoreHash(const uint8_t* templateData) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (uint32_t i = 0; i < FPS_TEMPLATE_SIZE; i++) {
+        hash ^= templateData[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static uint32_t readU32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+static uint32_t newStoreId(void) {
+    uint32_t id = 0;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        if (read(fd, &id, sizeof(id)) != sizeof(id)) id = 0;
+        close(fd);
+    }
+    if (id == 0) id = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+    return id ? id : 1;
+}
+
+//make room for a record of length bytes at the end of the log, remapping the file when it grows
+static uint32_t beginRecord(__FPS_TSTORE* store, uint16_t length) {
+    size_t end = store->length + RECORD_HEADER + length;
+    if (end > UINT32_MAX) return 0;  //offsets are 32 bit
+    if (end > store->mapSize) {
+        size_t size = (end / FPS_TSTORE_GROW + 1) * FPS_TSTORE_GROW;
+        if (ftruncate(store->fd, (off_t)size) != 0) return 0;
+        uint8_t* map = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+        if (map == MAP_FAILED) return 0;
+        munmap(store->map, store->mapSize);
+        store->map = map;
+        store->mapSize = size;
+    }
+    uint32_t offset = (uint32_t)store->length;
+    memcpy(store->map + offset, &length, 2);
+    store->length = end;
+    return offset;
+}
+
+//the type makes the record part of the log
+static void endRecord(__FPS_TSTORE* store, uint32_t offset, uint8_t type) {
+    store->map[offset + 2] = type;
+}
+
+static int8_t insertEntry(__FPS_TSTORE* store, uint64_t hash, uint32_t offset) {
+    if ((store->stats.templates + 1) * 4 > (uint64_t)store->entryCapacity * 3) {  //keep the table at most 3/4 full
+        uint32_t capacity = store->entryCapacity ? store->entryCapacity * 2 : FIRST_ENTRIES;
+        __FPS_TSTORE_ENTRY* entries = (__FPS_TSTORE_ENTRY*)calloc(capacity, sizeof(__FPS_TSTORE_ENTRY));
+        if (entries == NULL) return -1;
+        for (uint32_t i = 0; i < store->entryCapacity; i++) {
+            if (store->entries[i].offset == 0) continue;
+            uint32_t slot = (uint32_t)store->entries[i].hash & (capacity - 1);
+            while (entries[slot].offset != 0) slot = (slot + 1) & (capacity - 1);
+            entries[slot] = store->entries[i];
+        }
+        free(store->entries);
+        store->entries = entries;
+        store->entryCapacity = capacity;
+    }
+    uint32_t slot = (uint32_t)hash & (store->entryCapacity - 1);
+    while (store->entries[slot].offset != 0) slot = (slot + 1) & (store->entryCapacity - 1);
+    store->entries[slot].hash = hash;
+    store->entries[slot].offset = offset;
+    store->stats.templates++;
+    return 0;
+}
+
+//offset of the record holding these bytes, 0 if they are not stored
+static uint32_t findTemplate(__FPS_TSTORE* store, uint64_t hash, const uint8_t* templateData) {
+    if (store->entryCapacity == 0) return 0;
+    for (uint32_t slot = (uint32_t)hash & (store->entryCapacity - 1); store->entries[slot].offset != 0;
+         slot = (slot + 1) & (store->entryCapacity - 1)) {
+        uint32_t offset = store->entries[slot].offset;
+        if (store->entries[slot].hash == hash && memcmp(store->map + offset + RECORD_HEADER + 8, templateData, FPS_TEMPLATE_SIZE) == 0) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+//offset of the record of the template, appended if the bytes are new
+static uint32_t storeTemplate(__FPS_TSTORE* store, const uint8_t* templateData) {
+    uint64_t hash = R30X_tstoreHash(templateData);
+    uint32_t offset = findTemplate(store, hash, templateData);
+    if (offset != 0) {
+        store->stats.duplicates++;
+        return offset;
+    }
+    offset = beginRecord(store, TEMPLATE_PAYLOAD);
+    if (offset == 0) return 0;
+    memcpy(store->map + offset + RECORD_HEADER, &hash, 8);
+    memcpy(store->map + offset + RECORD_HEADER + 8, templateData, FPS_TEMPLATE_SIZE);
+    if (insertEntry(store, hash, offset) != 0) {
+        store->length = offset;  //drop the record, it has no type yet
+        return 0;
+    }
+    endRecord(store, offset, FPS_TSTORE_TEMPLATE);
+    return offset;
+}
+
+//modules are sorted by id; create adds a missing one
+static __FPS_TSTORE_MODULE* findModule(__FPS_TSTORE* store, uint32_t moduleId, uint8_t create) {
+    uint32_t low = 0, high = store->moduleCount;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (store->modules[middle].moduleId < moduleId) low = middle + 1;
+        else high = middle;
+    }
+    if (low < store->moduleCount && store->modules[low].moduleId == moduleId) return &store->modules[low];
+    if (!create) return NULL;
+    if (store->moduleCount == store->moduleCapacity) {
+        uint32_t capacity = store->moduleCapacity ? store->moduleCapacity * 2 : 16;
+        __FPS_TSTORE_MODULE* modules = (__FPS_TSTORE_MODULE*)realloc(store->modules, capacity * sizeof(__FPS_TSTORE_MODULE));
+        if (modules == NULL) return NULL;
+        store->modules = modules;
+        store->moduleCapacity = capacity;
+    }
+    memmove(&store->modules[low + 1], &store->modules[low], (store->moduleCount - low) * sizeof(__FPS_TSTORE_MODULE));
+    memset(&store->modules[low], 0, sizeof(__FPS_TSTORE_MODULE));
+    store->modules[low].moduleId = moduleId;
+    store->moduleCount++;
+    return &store->modules[low];
+}
+
+//point a location to a template record (0 empties it), log only when the reference is new
+static int8_t setRef(__FPS_TSTORE* store, __FPS_TSTORE_MODULE* module, uint16_t location, uint32_t offset, uint8_t log) {
+    if (location >= module->locations) {
+        if (offset == 0) return 0;
+        uint16_t locations = module->locations ? (uint16_t)(module->locations * 2) : 64;
+        if (locations <= location) locations = (uint16_t)(location + 1);
+        if (locations > FPS_TSTORE_MAX_LOCATIONS) locations = FPS_TSTORE_MAX_LOCATIONS;
+        uint32_t* refs = (uint32_t*)realloc(module->refs, locations * sizeof(uint32_t));
+        if (refs == NULL) return -1;
+        memset(refs + module->locations, 0, (locations - module->locations) * sizeof(uint32_t));
+        module->refs = refs;
+        module->locations = locations;
+    }
+    if (module->refs[location] == offset) return 0;
+    if (log) {
+        uint32_t record = beginRecord(store, REF_PAYLOAD);
+        if (record == 0) return -1;
+        uint8_t* payload = store->map + record + RECORD_HEADER;
+        memcpy(payload, &module->moduleId, 4);
+        memcpy(payload + 4, &location, 2);
+        memset(payload + 6, 0, 2);
+        memcpy(payload + 8, &offset, 4);
+        endRecord(store, record, FPS_TSTORE_REF);
+    }
+    if (module->refs[location] == 0) store->stats.references++;
+    else if (offset == 0) store->stats.references--;
+    module->refs[location] = offset;
+    return 0;
+}
+
+static int8_t logStamp(__FPS_TSTORE* store, __FPS_TSTORE_MODULE* module, uint32_t generation) {
+    uint32_t record = beginRecord(store, STAMP_PAYLOAD);
+    if (record == 0) return -1;
+    memcpy(store->map + record + RECORD_HEADER, &module->moduleId, 4);
+    memcpy(store->map + record + RECORD_HEADER + 4, &generation, 4);
+    endRecord(store, record, FPS_TSTORE_STAMP);
+    module->generation = generation;
+    return 0;
+}
+
+//rebuild the indexes from the records, the log ends at the first record that is not complete
+static int8_t replay(__FPS_TSTORE* store) {
+    size_t offset = FPS_TSTORE_HEADER_SIZE;
+    while (offset + RECORD_HEADER <= store->mapSize) {
+        const uint8_t* record = store->map + offset;
+        uint16_t length;
+        memcpy(&length, record, 2);
+        uint8_t type = record[2];
+        if (type == 0 || offset + RECORD_HEADER + length > store->mapSize) break;
+        const uint8_t* payload = record + RECORD_HEADER;
+        if (type == FPS_TSTORE_TEMPLATE && length == TEMPLATE_PAYLOAD) {
+            uint64_t hash;
+            memcpy(&hash, payload, 8);
+            if (insertEntry(store, hash, (uint32_t)offset) != 0) return -1;
+        }
+        else if (type == FPS_TSTORE_REF && length == REF_PAYLOAD) {
+            uint16_t location;
+            uint32_t target = readU32(payload + 8);
+            memcpy(&location, payload + 4, 2);
+            if (location >= FPS_TSTORE_MAX_LOCATIONS) break;
+            if (target != 0 && (target < FPS_TSTORE_HEADER_SIZE || target >= offset || store->map[target + 2] != FPS_TSTORE_TEMPLATE)) break;  //not a record before this one
+            __FPS_TSTORE_MODULE* module = findModule(store, readU32(payload), 1);
+            if (module == NULL || setRef(store, module, location, target, 0) != 0) return -1;
+        }
+        else if (type == FPS_TSTORE_STAMP && length == STAMP_PAYLOAD) {
+            __FPS_TSTORE_MODULE* module = findModule(store, readU32(payload), 1);
+            if (module == NULL) return -1;
+            module->generation = readU32(payload + 4);
+            if (module->generation > store->generation) store->generation = module->generation;
+        }
+        offset += RECORD_HEADER + length;
+    }
+    store->length = offset;
+    return 0;
+}
+/*
+*   @brief: open a store file, a missing or empty file is created
+*   @parameter: store
+*   @parameter: path of the file
+*   @return: 0 on success, -1 on I/O or memory error, -2 if the file is no store of this version
+*
+*/
+int8_t R30X_tstoreOpen(__FPS_TSTORE* store, const char* path) {
+    struct stat info;
+    memset(store, 0, sizeof(__FPS_TSTORE));
+    store->notepadPage = FPS_TSTORE_NOTEPAD_PAGE;
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0) return -1;
+    if (fstat(store->fd, &info) != 0) {
+        close(store->fd);
+        return -1;
+    }
+    uint8_t create = info.st_size == 0;
+    store->mapSize = create ? FPS_TSTORE_GROW : (size_t)info.st_size;
+    if (!create && store->mapSize < FPS_TSTORE_HEADER_SIZE) {
+        close(store->fd);
+        return -2;
+    }
+    if (create && ftruncate(store->fd, (off_t)store->mapSize) != 0) {
+        close(store->fd);
+        return -1;
+    }
+    store->map = (uint8_t*)mmap(NULL, store->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if (store->map == MAP_FAILED) {
+        close(store->fd);
+        return -1;
+    }
+    pthread_mutex_init(&store->lock, NULL);
+    if (create) {
+        uint16_t version = FPS_TSTORE_VERSION;
+        store->storeId = newStoreId();
+        memcpy(store->map, storeMagic, 8);
+        memcpy(store->map + 8, &version, 2);
+        memcpy(store->map + 12, &store->storeId, 4);
+    }
+    else {
+        uint16_t version;
+        memcpy(&version, store->map + 8, 2);
+        if (memcmp(store->map, storeMagic, 8) != 0 || version != FPS_TSTORE_VERSION) {
+            R30X_tstoreClose(store);
+            return -2;
+        }
+        store->storeId = readU32(store->map + 12);
+    }
+    if (replay(store) != 0) {
+        R30X_tstoreClose(store);
+        return -1;
+    }
+    return 0;
+}
+
+void R30X_tstoreClose(__FPS_TSTORE* store) {
+    for (uint32_t i = 0; i < store->moduleCount; i++) free(store->modules[i].refs);
+    free(store->modules);
+    free(store->entries);
+    munmap(store->map, store->mapSize);
+    close(store->fd);
+    pthread_mutex_destroy(&store->lock);
+    store->modules = NULL;
+    store->entries = NULL;
+    store->map = NULL;
+    store->fd = -1;
+}
+
+int8_t R30X_tstoreFlush(__FPS_TSTORE* store) {
+    pthread_mutex_lock(&store->lock);
+    int result = msync(store->map, store->length, MS_SYNC);
+    pthread_mutex_unlock(&store->lock);
+    return result == 0 ? 0 : -1;
+}
+
+static void makeStamp(const __FPS_TSTORE* store, uint32_t generation, uint8_t* page) {
+    memset(page, 0, FPS_NOTEPAD_PAGE_SIZE);
+    memcpy(page, storeMagic, 8);
+    memcpy(page + 8, &store->storeId, 4);
+    memcpy(page + 12, &generation, 4);
+}
+/*
+*   @brief: bring the references of a module up to date. stream->templateCount must hold the library size of the module,
+*           locations beyond FPS_TSTORE_MAX_LOCATIONS are not synced. Only one sync per module at a time
+*   @parameter: store
+*   @parameter: pointer to finger print structure of the module
+*   @parameter: id of the module in the store, the address or any other number that stays with the module
+*   @return: FPS_RESP_OK or 0 on success, FPS_TSTORE_IO_ERROR if the store failed, otherwise the error of the module.
+*            After an error the references read so far are kept and the stamp is not changed
+*
+*/
+uint8_t R30X_tstoreSync(__FPS_TSTORE* store, __FPS* stream, uint32_t moduleId) {
+    uint8_t page[FPS_NOTEPAD_PAGE_SIZE];
+    uint8_t stamp[FPS_NOTEPAD_PAGE_SIZE];
+    uint8_t table[FPS_TSTORE_MAX_LOCATIONS / 8];
+    uint8_t templateData[FPS_TEMPLATE_SIZE];
+    uint16_t locations = stream->templateCount < FPS_TSTORE_MAX_LOCATIONS ? stream->templateCount : FPS_TSTORE_MAX_LOCATIONS;
+
+    uint8_t response = readNotepad(stream, store->notepadPage, page);
+    for (uint8_t i = 0; response == FPS_RESP_OK && i < (locations + 255) / 256; i++) {
+        response = readIndexTable(stream, i, table + i * FPS_INDEX_TABLE_LENGTH);
+    }
+    if (response != FPS_RESP_OK) return response;
+
+    pthread_mutex_lock(&store->lock);
+    __FPS_TSTORE_MODULE* module = findModule(store, moduleId, 1);
+    uint8_t trusted = 0;
+    if (module != NULL) {
+        makeStamp(store, module->generation, stamp);
+        trusted = module->generation != 0 && memcmp(page, stamp, FPS_NOTEPAD_PAGE_SIZE) == 0;
+        if (!trusted) store->stats.staleStamps++;
+    }
+    pthread_mutex_unlock(&store->lock);
+    if (module == NULL) return FPS_TSTORE_IO_ERROR;
+
+    for (uint16_t location = 1; location < locations; location++) {
+        uint8_t used = (table[location / 8] >> (location % 8)) & 1;
+        pthread_mutex_lock(&store->lock);
+        module = findModule(store, moduleId, 0);  //the array moves when other syncs add modules
+        uint32_t known = location < module->locations ? module->refs[location] : 0;
+        if (!used && known != 0 && setRef(store, module, location, 0, 1) != 0) response = FPS_TSTORE_IO_ERROR;
+        if (used && known != 0 && trusted) store->stats.skipped++;
+        pthread_mutex_unlock(&store->lock);
+        if (response != FPS_RESP_OK) return response;
+        if (!used || (known != 0 && trusted)) continue;
+
+        response = loadTemplate(stream, 1, location);
+        if (response == FPS_RESP_OK) response = exportCharacter(stream, 1, templateData);
+        if (response != FPS_RESP_OK) return response;
+        pthread_mutex_lock(&store->lock);
+        store->stats.downloads++;
+        module = findModule(store, moduleId, 0);
+        uint32_t offset = storeTemplate(store, templateData);
+        if (offset == 0 || setRef(store, module, location, offset, 1) != 0) response = FPS_TSTORE_IO_ERROR;
+        pthread_mutex_unlock(&store->lock);
+        if (response != FPS_RESP_OK) return response;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    uint32_t generation = ++store->generation;
+    pthread_mutex_unlock(&store->lock);
+    makeStamp(store, generation, stamp);
+    response = writeNotepad(stream, store->notepadPage, stamp);
+    if (response != FPS_RESP_OK) return response;  //the old generation does not match the page any more, the next sync downloads all
+    pthread_mutex_lock(&store->lock);
+    module = findModule(store, moduleId, 0);
+    if (logStamp(store, module, generation) != 0) response = FPS_TSTORE_IO_ERROR;
+    else store->stats.syncs++;
+    pthread_mutex_unlock(&store->lock);
+    return response;
+}
+/*
+*   @brief: clear the stamp of a module, for tools that overwrite used locations
+*   @parameter: store
+*   @parameter: pointer to finger print structure of the module
+*   @return: on success FPS_RESP_OK or 0
+*
+*/
+uint8_t R30X_tstoreInvalidate(__FPS_TSTORE* store, __FPS* stream) {
+    uint8_t page[FPS_NOTEPAD_PAGE_SIZE] = { 0 };
+    return writeNotepad(stream, store->notepadPage, page);
+}
+/*
+*   @brief: write the stored templates of a module to the same locations of a module, for example a replacement.
+*           Locations without a stored template are not changed, character buffer 1 is overwritten
+*   @parameter: store
+*   @parameter: id of the module whose templates are written
+*   @parameter: pointer to finger print structure of the module written to
+*   @return: FPS_RESP_OK or 0 on success, FPS_TSTORE_IO_ERROR if the store has no such module, otherwise the error of the module
+*
+*/
+uint8_t R30X_tstoreRestore(__FPS_TSTORE* store, uint32_t moduleId, __FPS* stream) {
+    uint8_t templateData[FPS_TEMPLATE_SIZE];
+    uint16_t locations = 0;
+    pthread_mutex_lock(&store->lock);
+    __FPS_TSTORE_MODULE* module = findModule(store, moduleId, 0);
+    if (module != NULL) locations = module->locations;
+    pthread_mutex_unlock(&store->lock);
+    if (module == NULL) return FPS_TSTORE_IO_ERROR;
+
+    for (uint16_t location = 1; location < locations; location++) {
+        if (R30X_tstoreGet(store, moduleId, location, templateData) != 0) continue;
+        uint8_t response = importCharacter(stream, 1, templateData);
+        if (response == FPS_RESP_OK) response = saveTemplate(stream, 1, location);
+        if (response != FPS_RESP_OK) return response;
+    }
+    return FPS_RESP_OK;
+}
+/*
+*   @brief: copy the stored template of a location of a module
+*   @parameter: store
+*   @parameter: id of the module
+*   @parameter: location in the library of the module
+*   @parameter: receives FPS_TEMPLATE_SIZE bytes
+*   @return: 0 on success, -1 if there is no template stored for the location
+*
+*/
+int8_t R30X_tstoreGet(__FPS_TSTORE* store, uint32_t moduleId, uint16_t location, uint8_t* templateData) {
+    int8_t result = -1;
+    pthread_mutex_lock(&store->lock);
+    __FPS_TSTORE_MODULE* module = findModule(store, moduleId, 0);
+    if (module != NULL && location < module->locations && module->refs[location] != 0) {
+        memcpy(templateData, store->map + module->refs[location] + RECORD_HEADER + 8, FPS_TEMPLATE_SIZE);
+        result = 0;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return result;
+}
+
+/********************************END OF FILE*****************************************************/
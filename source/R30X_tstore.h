@@ -0,0 +1,106 @@
+/*************************************************************************
+ *
+ * finger print library - template store
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Backup of the libraries of many modules on the host. Every distinct
+ * template is kept once, found by a 64 bit hash of its bytes (templates
+ * with equal hashes are compared byte for byte), and every module has a
+ * reference per location of its library. The store is one append-only
+ * file mapped into memory, the indexes are rebuilt from it on open.
+ *
+ * R30X_tstoreSync reads the index table of a module and a page of its
+ * notepad. At the end of every sync the store writes a stamp to that page;
+ * when the page still holds the stamp of the last sync, locations that were
+ * used then and still are keep their reference and are not downloaded.
+ * The other used locations are exported (loadTemplate, exportCharacter).
+ * Locations deleted or enrolled since are seen in the index table; a tool
+ * that writes a location which was used at the last sync (overwrite, or
+ * delete and enroll again) must call R30X_tstoreInvalidate. Location 0 is
+ * not used, like in saveTemplate and loadTemplate.
+ *
+ * File (multi-byte values in host order):
+ *   header : "R30XTST" 0x00, uint16 version, uint16 reserved, uint32 store id
+ *   record : uint16 length, uint8 type, uint8 reserved, length bytes
+ *     FPS_TSTORE_TEMPLATE : uint64 hash, FPS_TEMPLATE_SIZE bytes
+ *     FPS_TSTORE_REF      : uint32 module, uint16 location, uint16 reserved,
+ *                           uint32 offset of the template record, 0 if the location was emptied
+ *     FPS_TSTORE_STAMP    : uint32 module, uint32 generation
+ * The type is written last, the log ends at the first record of type 0.
+ *
+ * Syncs of different modules can run in threads of their own, every module
+ * needs a port of its own. Needs POSIX (mmap) and POSIX threads.
+ *
+ **************************************************************************/
+#ifndef R30X_TSTORE_H
+#define R30X_TSTORE_H
+#include <pthread.h>
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_TEMPLATE_TRANSFER
+#error "R30X_tstore needs FPS_CFG_TEMPLATE_TRANSFER"
+#endif
+
+#define FPS_TSTORE_VERSION              1
+#define FPS_TSTORE_HEADER_SIZE          16
+#define FPS_TSTORE_GROW                 (1024 * 1024)  //the file grows in steps of this many bytes
+#define FPS_TSTORE_NOTEPAD_PAGE         15  //default notepad page of the stamp
+#define FPS_TSTORE_MAX_LOCATIONS        1024  //4 pages of the index table
+#define FPS_TSTORE_IO_ERROR             0xFC  //the store file could not grow or memory ran out
+
+//record types
+#define FPS_TSTORE_TEMPLATE             1
+#define FPS_TSTORE_REF                  2
+#define FPS_TSTORE_STAMP                3
+
+typedef struct {
+	  uint64_t syncs;  //syncs that completed
+	  uint64_t downloads;  //templates exported from modules
+	  uint64_t skipped;  //used locations not downloaded because the stamp was unchanged
+	  uint64_t duplicates;  //downloads whose bytes were already stored
+	  uint64_t templates;  //distinct templates in the store
+	  uint64_t references;  //used locations of all modules
+	  uint64_t staleStamps;  //syncs that found another or no stamp
+}__FPS_TSTORE_STATS;
+
+typedef struct {
+	  uint32_t moduleId;
+	  uint32_t generation;  //stamp of the last sync, 0 if none
+	  uint16_t locations;  //entries in refs
+	  uint32_t* refs;  //offset of the template record of every location, 0 if empty
+}__FPS_TSTORE_MODULE;
+
+typedef struct {
+	  uint64_t hash;
+	  uint32_t offset;  //of the template record, 0 for a free slot
+}__FPS_TSTORE_ENTRY;
+
+typedef struct {
+	  int fd;
+	  uint8_t* map;
+	  size_t mapSize;  //bytes of the file, all mapped
+	  size_t length;  //bytes of the log in use
+	  uint32_t storeId;  //random, tells the stamps of this store from those of another
+	  uint32_t generation;  //highest generation written
+	  uint8_t notepadPage;  //page of the stamp, FPS_TSTORE_NOTEPAD_PAGE after open
+	  __FPS_TSTORE_ENTRY* entries;  //hash index, open addressing
+	  uint32_t entryCapacity;  //power of two
+	  __FPS_TSTORE_MODULE* modules;
+	  uint32_t moduleCount;
+	  uint32_t moduleCapacity;
+	  pthread_mutex_t lock;
+	  __FPS_TSTORE_STATS stats;
+}__FPS_TSTORE;
+
+int8_t	R30X_tstoreOpen (__FPS_TSTORE *store, const char *path); //open or create, 0 on success, -1 on I/O error, -2 if the file is no store
+void	R30X_tstoreClose (__FPS_TSTORE *store);
+int8_t	R30X_tstoreFlush (__FPS_TSTORE *store); //write the mapped file to disk, 0 on success
+uint8_t R30X_tstoreSync (__FPS_TSTORE *store, __FPS *stream, uint32_t moduleId); //bring the references of a module up to date
+uint8_t R30X_tstoreInvalidate (__FPS_TSTORE *store, __FPS *stream); //clear the stamp, the next sync downloads every location
+uint8_t R30X_tstoreRestore (__FPS_TSTORE *store, uint32_t moduleId, __FPS *stream); //write the stored templates of a module to a module
+int8_t	R30X_tstoreGet (__FPS_TSTORE *store, uint32_t moduleId, uint16_t location, uint8_t *templateData); //0 on success, -1 if there is none
+uint64_t R30X_tstoreHash (const uint8_t *templateData); //FNV-1a of FPS_TEMPLATE_SIZE bytes
+#endif
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,271 @@
+/*************************************************************************
+ *
+ * finger print library - virtual template library
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ *
+ *
+ **************************************************************************/
+
+#include "R30X_vlib.h"
+
+static uint8_t commandOk(__FPS_VLIB* vlib, uint8_t response) {
+    vlib->lastResponse = response;
+    return response == FPS_RESP_OK;
+}
+
+//---------------------------------------------------------------------------
+//least recently used list of the resident slots
+
+static void lruUnlink(__FPS_VLIB* vlib, uint16_t slot) {
+    uint16_t prev = vlib->lruPrev[slot], next = vlib->lruNext[slot];
+    if (prev != FPS_VLIB_NO_SLOT) vlib->lruNext[prev] = next;
+    else vlib->lruHead = next;
+    if (next != FPS_VLIB_NO_SLOT) vlib->lruPrev[next] = prev;
+    else vlib->lruTail = prev;
+}
+
+static void lruPushFront(__FPS_VLIB* vlib, uint16_t slot) {
+    vlib->lruPrev[slot] = FPS_VLIB_NO_SLOT;
+    vlib->lruNext[slot] = vlib->lruHead;
+    if (vlib->lruHead != FPS_VLIB_NO_SLOT) vlib->lruPrev[vlib->lruHead] = slot;
+    else vlib->lruTail = slot;
+    vlib->lruHead = slot;
+}
+
+//most recently matched users first, the paging order
+static void mruMoveFront(__FPS_VLIB* vlib, uint32_t user) {
+    __FPS_VLIB_USER* users = vlib->users;
+    if (vlib->mruHead == user) return;
+    if (users[user].prev != FPS_VLIB_NONE) users[users[user].prev].next = users[user].next;
+    if (users[user].next != FPS_VLIB_NONE) users[users[user].next].prev = users[user].prev;
+    else vlib->mruTail = users[user].prev;
+    users[user].prev = FPS_VLIB_NONE;
+    users[user].next = vlib->mruHead;
+    users[vlib->mruHead].prev = user;
+    vlib->mruHead = user;
+}
+
+//free resident slot, or the least recently used one. The user in it stays until evict
+static uint16_t residentVictim(__FPS_VLIB* vlib) {
+    if (vlib->residentCount < vlib->residentSlots) {
+        for (uint16_t slot = 0; slot < vlib->residentSlots; slot++) {
+            if (vlib->slotUser[slot] == FPS_VLIB_NONE) return slot;
+        }
+    }
+    return vlib->lruTail;
+}
+
+static void evict(__FPS_VLIB* vlib, uint16_t slot) {
+    if (vlib->slotUser[slot] == FPS_VLIB_NONE) return;
+    lruUnlink(vlib, slot);
+    vlib->users[vlib->slotUser[slot]].slot = FPS_VLIB_NO_SLOT;
+    vlib->slotUser[slot] = FPS_VLIB_NONE;
+    vlib->residentCount--;
+    vlib->stats.evictions++;
+}
+
+//copy the template from a window slot into the resident area
+static uint8_t promote(__FPS_VLIB* vlib, uint16_t windowSlot) {
+    uint32_t user = vlib->slotUser[vlib->residentSlots + windowSlot];
+    uint16_t slot = residentVictim(vlib);
+    if (!commandOk(vlib, loadTemplate(vlib->stream, 2, vlib->windowStart + windowSlot))) return 0;
+    uint8_t response = saveTemplate(vlib->stream, 2, vlib->residentStart + slot);
+    if (!commandOk(vlib, response)) {
+        if (response >= FPS_RX_BADPACKET) evict(vlib, slot);  //reply lost, the location may hold either template
+        return 0;
+    }
+    evict(vlib, slot);
+    vlib->slotUser[slot] = user;
+    vlib->users[user].slot = slot;
+    lruPushFront(vlib, slot);
+    vlib->residentCount++;
+    if (slot + 1 > vlib->residentEnd) vlib->residentEnd = slot + 1;
+    vlib->stats.promotions++;
+    return 1;
+}
+/*
+*   @brief: search a range of the module library for the probe in buffer 1
+*   @return: FPS_VLIB_FOUND with stream->fingerId set, FPS_VLIB_NOT_FOUND or FPS_VLIB_ERROR
+*
+*/
+static uint8_t searchRange(__FPS_VLIB* vlib, uint16_t start, uint16_t count) {
+    uint8_t response = searchLibrary(vlib->stream, 1, start, count);
+    if (commandOk(vlib, response)) return FPS_VLIB_FOUND;
+    if (response == FPS_RESP_NOTFOUND) return FPS_VLIB_NOT_FOUND;
+    return FPS_VLIB_ERROR;
+}
+
+static uint8_t searchWindow(__FPS_VLIB* vlib, uint16_t count) {
+    uint8_t result = searchRange(vlib, vlib->windowStart, count);
+    vlib->stats.windowSearches++;
+    if (result != FPS_VLIB_FOUND) return result;
+    uint16_t windowSlot = vlib->stream->fingerId - vlib->windowStart;
+    vlib->userId = vlib->slotUser[vlib->residentSlots + windowSlot];
+    vlib->matchScore = vlib->stream->matchScore;
+    vlib->stats.pagedHits++;
+    if (vlib->userId == FPS_VLIB_NONE) return FPS_VLIB_ERROR;  //module holds a template the library does not know
+    mruMoveFront(vlib, vlib->userId);
+    if (vlib->users[vlib->userId].slot == FPS_VLIB_NO_SLOT || vlib->users[vlib->userId].slot >= vlib->residentSlots) {
+        if (!promote(vlib, windowSlot)) return FPS_VLIB_ERROR;
+    }
+    return FPS_VLIB_FOUND;
+}
+
+//download the next batch of users that are not on the module into the window
+static uint8_t pageBatch(__FPS_VLIB* vlib, uint32_t* cursor, uint16_t* count) {
+    uint8_t templateData[FPS_TEMPLATE_SIZE];
+    *count = 0;
+    while (*count < vlib->windowSlots && *cursor != FPS_VLIB_NONE) {
+        uint32_t user = *cursor;
+        *cursor = vlib->users[user].next;
+        if (vlib->users[user].slot != FPS_VLIB_NO_SLOT) continue;  //resident or already in the window
+        if (vlib->readTemplate(vlib->context, user, templateData) != 0) continue;
+
+        uint16_t slot = vlib->residentSlots + *count;
+        uint32_t previous = vlib->slotUser[slot];
+        if (previous != FPS_VLIB_NONE && vlib->users[previous].slot == slot) vlib->users[previous].slot = FPS_VLIB_NO_SLOT;
+        vlib->slotUser[slot] = FPS_VLIB_NONE;
+        if (!commandOk(vlib, importCharacter(vlib->stream, 2, templateData))) return 0;
+        if (!commandOk(vlib, saveTemplate(vlib->stream, 2, vlib->windowStart + *count))) return 0;
+        vlib->slotUser[slot] = user;
+        vlib->users[user].slot = slot;
+        vlib->stats.templatesPaged++;
+        (*count)++;
+    }
+    if (*count > vlib->windowCount) vlib->windowCount = *count;
+    return 1;
+}
+
+//---------------------------------------------------------------------------
+/*
+*   @brief: prepare a virtual library. Set vlib->readTemplate and vlib->context before the first identify
+*   @parameter: virtual library
+*   @parameter: pointer to finger print structure, templateCount must hold the library size (readSysPara)
+*   @parameter: number of users
+*   @parameter: array of userCount entries used by the library
+*   @parameter: first location of the resident area, at least 1
+*   @parameter: locations of the resident area
+*   @parameter: locations of the window, it follows the resident area
+*   @return: 0 on success, -1 if the layout does not fit
+*
+*/
+int8_t R30X_vlibInit(__FPS_VLIB* vlib, __FPS* stream, uint32_t userCount, __FPS_VLIB_USER* users, uint16_t residentStart, uint16_t residentSlots, uint16_t windowSlots) {
+    memset(vlib, 0, sizeof(__FPS_VLIB));
+    if (residentStart < 1 || residentSlots == 0 || windowSlots == 0) return -1;
+    if ((uint32_t)residentSlots + windowSlots > FPS_VLIB_MAX_SLOTS) return -1;
+    if ((uint32_t)residentStart + residentSlots + windowSlots > stream->templateCount) return -1;
+    vlib->stream = stream;
+    vlib->userCount = userCount;
+    vlib->users = users;
+    vlib->residentStart = residentStart;
+    vlib->residentSlots = residentSlots;
+    vlib->windowStart = residentStart + residentSlots;
+    vlib->windowSlots = windowSlots;
+    vlib->lruHead = vlib->lruTail = FPS_VLIB_NO_SLOT;
+    vlib->userId = FPS_VLIB_NONE;
+    vlib->maxBatches = FPS_VLIB_DEFAULT_MAX_BATCHES;
+    vlib->pageCursor = FPS_VLIB_NONE;
+    for (uint32_t i = 0; i < userCount; i++) {
+        users[i].prev = i > 0 ? i - 1 : FPS_VLIB_NONE;
+        users[i].next = i + 1 < userCount ? i + 1 : FPS_VLIB_NONE;
+        users[i].slot = FPS_VLIB_NO_SLOT;
+    }
+    vlib->mruHead = userCount > 0 ? 0 : FPS_VLIB_NONE;
+    vlib->mruTail = userCount > 0 ? userCount - 1 : FPS_VLIB_NONE;
+    for (uint16_t i = 0; i < FPS_VLIB_MAX_SLOTS; i++) vlib->slotUser[i] = FPS_VLIB_NONE;
+    return 0;
+}
+/*
+*   @brief: delete the resident area and the window on the module, needed once before the first identify
+*   @parameter: virtual library
+*   @return: on success FPS_RESP_OK or 0, otherwise the failed response
+*
+*/
+uint8_t R30X_vlibClear(__FPS_VLIB* vlib) {
+    uint8_t response = deleteTemplate(vlib->stream, vlib->residentStart, vlib->residentSlots + vlib->windowSlots);
+    if (!commandOk(vlib, response)) return response;
+    for (uint32_t i = 0; i < vlib->userCount; i++) vlib->users[i].slot = FPS_VLIB_NO_SLOT;
+    for (uint16_t i = 0; i < FPS_VLIB_MAX_SLOTS; i++) vlib->slotUser[i] = FPS_VLIB_NONE;
+    vlib->lruHead = vlib->lruTail = FPS_VLIB_NO_SLOT;
+    vlib->residentCount = vlib->residentEnd = vlib->windowCount = 0;
+    vlib->pageCursor = FPS_VLIB_NONE;
+    return FPS_RESP_OK;
+}
+/*
+*   @brief: identify the probe in character buffer 1 (generateImage, generateCharacter(1) before).
+*           Searches the resident area first, then the window and then pages the other users through the window
+*   @parameter: virtual library
+*   @return: FPS_VLIB_FOUND with the user in vlib->userId, FPS_VLIB_NOT_FOUND, or FPS_VLIB_ERROR with the
+*            response in vlib->lastResponse and the confirmation code in the stream
+*
+*/
+uint8_t R30X_vlibIdentify(__FPS_VLIB* vlib) {
+    uint8_t result;
+    vlib->stats.identifies++;
+    vlib->userId = FPS_VLIB_NONE;
+
+    if (vlib->residentCount > 0) {
+        result = searchRange(vlib, vlib->residentStart, vlib->residentEnd);
+        if (result == FPS_VLIB_ERROR) return result;
+        if (result == FPS_VLIB_FOUND) {
+            uint16_t slot = vlib->stream->fingerId - vlib->residentStart;
+            vlib->userId = vlib->slotUser[slot];
+            vlib->matchScore = vlib->stream->matchScore;
+            if (vlib->userId == FPS_VLIB_NONE) return FPS_VLIB_ERROR;
+            lruUnlink(vlib, slot);
+            lruPushFront(vlib, slot);
+            mruMoveFront(vlib, vlib->userId);
+            vlib->stats.hits++;
+            return FPS_VLIB_FOUND;
+        }
+    }
+    if (vlib->windowCount > 0) {
+        result = searchWindow(vlib, vlib->windowCount);
+        if (result != FPS_VLIB_NOT_FOUND) return result;
+    }
+    uint32_t cursor = vlib->pageCursor != FPS_VLIB_NONE ? vlib->pageCursor : vlib->mruHead;
+    vlib->pageCursor = FPS_VLIB_NONE;
+    for (uint16_t batch = 0; cursor != FPS_VLIB_NONE && (vlib->maxBatches == 0 || batch < vlib->maxBatches); batch++) {
+        uint16_t count;
+        if (!pageBatch(vlib, &cursor, &count)) return FPS_VLIB_ERROR;
+        if (count == 0) break;
+        result = searchWindow(vlib, count);
+        if (result != FPS_VLIB_NOT_FOUND) return result;
+    }
+    if (cursor != FPS_VLIB_NONE) {  //the next identify continues here, so a finger that tries again is searched further
+        vlib->pageCursor = cursor;
+        vlib->stats.cutOff++;
+    }
+    vlib->stats.misses++;
+    return FPS_VLIB_NOT_FOUND;
+}
+/*
+*   @brief: delete a user from the module, call it when the user is deleted or its template changes
+*   @parameter: virtual library
+*   @parameter: user
+*   @return: 0 on success, -1 if a command failed
+*
+*/
+int8_t R30X_vlibRemove(__FPS_VLIB* vlib, uint32_t userId) {
+    if (userId >= vlib->userCount) return -1;
+    for (uint16_t slot = 0; slot < vlib->residentSlots + vlib->windowSlots; slot++) {
+        if (vlib->slotUser[slot] != userId) continue;
+        uint16_t location = slot < vlib->residentSlots ? vlib->residentStart + slot : vlib->windowStart + slot - vlib->residentSlots;
+        if (!commandOk(vlib, deleteTemplate(vlib->stream, location, 1))) return -1;
+        if (slot < vlib->residentSlots) {
+            lruUnlink(vlib, slot);
+            vlib->residentCount--;
+        }
+        vlib->slotUser[slot] = FPS_VLIB_NONE;
+    }
+    vlib->users[userId].slot = FPS_VLIB_NO_SLOT;
+    return 0;
+}
+
+void R30X_vlibResetStats(__FPS_VLIB* vlib) {
+    memset(&vlib->stats, 0, sizeof(__FPS_VLIB_STATS));
+}
+
+/********************************END OF FILE*****************************************************/
@@ -0,0 +1,100 @@
+/*************************************************************************
+ *
+ * finger print library - virtual template library
+ * author  :	Masoud Babaabasi
+ * October 2023
+ *
+ * Keeps more users than fit in the module. All templates live on the host,
+ * the module library is used as a cache with two areas:
+ *  - the resident area holds the most recently matched users, replaced in
+ *    least recently used order,
+ *  - the window is filled with batches of the other users (importCharacter
+ *    and saveTemplate) when the resident area has no match.
+ * A user matched in the window is promoted into the resident area, which
+ * evicts the least recently used resident user when it is full. The other
+ * users are paged in the order they were last matched, so recently evicted
+ * users are found in the first batches. One identify pages at most
+ * maxBatches batches, so an unknown finger does not page the whole user
+ * list. A user that is not reached is reported as not found (counted in
+ * cutOff) and the next identify continues paging where this one stopped,
+ * so a finger that tries again is searched further.
+ *
+ * The probe must be in character buffer 1, buffer 2 is used for paging.
+ *
+ **************************************************************************/
+#ifndef R30X_VLIB_H
+#define R30X_VLIB_H
+#include "R30X_FPS.h"
+
+#if !FPS_CFG_TEMPLATE_TRANSFER
+#error "R30X_vlib needs FPS_CFG_TEMPLATE_TRANSFER"
+#endif
+
+#define FPS_VLIB_MAX_SLOTS              1000  //resident plus window locations
+#define FPS_VLIB_NONE                   0xFFFFFFFFUL  //slot without user
+#define FPS_VLIB_NO_SLOT                0xFFFF  //user not on the module
+#define FPS_VLIB_DEFAULT_MAX_BATCHES    4   //see bench/fps_vlib_bench for the share of users it cuts off
+
+#define FPS_VLIB_FOUND                  0   //the user is in vlib->userId
+#define FPS_VLIB_NOT_FOUND              1   //no user matches the probe
+#define FPS_VLIB_ERROR                  2   //a command failed, see lastResponse and the stream
+
+typedef struct {
+	  uint64_t identifies;
+	  uint64_t hits;  //matched in the resident area
+	  uint64_t pagedHits;  //matched in the window
+	  uint64_t misses;  //no user matched
+	  uint64_t cutOff;  //misses that stopped after maxBatches with users left to page
+	  uint64_t promotions;
+	  uint64_t evictions;
+	  uint64_t templatesPaged;  //templates downloaded into the window
+	  uint64_t windowSearches;
+}__FPS_VLIB_STATS;
+
+//state of one user, the array of all users is given to R30X_vlibInit
+typedef struct {
+	  uint32_t prev;  //list of all users, most recently matched first
+	  uint32_t next;
+	  uint16_t slot;  //resident or window slot, or FPS_VLIB_NO_SLOT
+}__FPS_VLIB_USER;
+
+typedef struct {
+	  __FPS* stream;
+	  //copies the template of a user (FPS_TEMPLATE_SIZE bytes), returns 0 on success
+	  int8_t (*readTemplate) (void* context, uint32_t userId, uint8_t* templateData);
+	  void* context;
+	  uint32_t userCount;  //users are numbered 0 .. userCount - 1
+	  __FPS_VLIB_USER* users;  //userCount entries
+	  uint32_t mruHead;
+	  uint32_t mruTail;
+	  uint32_t pageCursor;  //user where the next identify continues paging, FPS_VLIB_NONE to start at mruHead
+	  uint16_t maxBatches;  //window batches paged by one identify, 0 for all. Limits the time of unknown fingers, FPS_VLIB_DEFAULT_MAX_BATCHES after init
+
+	  uint16_t residentStart;  //first location of the resident area
+	  uint16_t residentSlots;
+	  uint16_t windowStart;  //first location of the window, right after the resident area
+	  uint16_t windowSlots;
+
+	  uint32_t slotUser[FPS_VLIB_MAX_SLOTS];  //user in every resident slot, then in every window slot
+	  uint16_t lruPrev[FPS_VLIB_MAX_SLOTS];  //resident slots, most recently used first
+	  uint16_t lruNext[FPS_VLIB_MAX_SLOTS];
+	  uint16_t lruHead;
+	  uint16_t lruTail;
+	  uint16_t residentCount;
+	  uint16_t residentEnd;  //resident slots above this are empty
+	  uint16_t windowCount;  //window slots holding a template
+
+	  uint32_t userId;  //result of the last identify
+	  uint16_t matchScore;
+	  uint8_t lastResponse;
+	  __FPS_VLIB_STATS stats;
+}__FPS_VLIB;
+
+int8_t	R30X_vlibInit (__FPS_VLIB *vlib, __FPS *stream, uint32_t userCount, __FPS_VLIB_USER *users, uint16_t residentStart, uint16_t residentSlots, uint16_t windowSlots); //0 on success, -1 if the layout does not fit
+uint8_t R30X_vlibClear (__FPS_VLIB *vlib); //delete both areas on the module, FPS_RESP_OK on success
+uint8_t R30X_vlibIdentify (__FPS_VLIB *vlib); //search the probe in character buffer 1, FPS_VLIB_FOUND, FPS_VLIB_NOT_FOUND or FPS_VLIB_ERROR
+int8_t	R30X_vlibRemove (__FPS_VLIB *vlib, uint32_t userId); //forget a deleted user, 0 on success
+void	R30X_vlibResetStats (__FPS_VLIB *vlib);
+#endif
+
+/********************************END OF FILE*****************************************************/